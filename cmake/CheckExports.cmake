@@ -0,0 +1,67 @@
+# Check the symbols exported by a shared build of the core against the public header and the version script
+#
+# Usage: cmake -DLIBRARY=<path> -DNM=<path> -DHEADER=<path> -DMAP=<path> -P CheckExports.cmake
+#
+# Every function declared with PSTATED_API must be listed in the version script, and the library must export exactly
+# the listed functions, each under the version node it was published in.
+
+# Collect the functions declared in the header
+file(STRINGS ${HEADER} declarations REGEX "^PSTATED_API ")
+
+set(declared "")
+
+foreach(declaration IN LISTS declarations)
+  string(REGEX MATCH "([A-Za-z0-9_]+)\\(" match "${declaration}")
+  list(APPEND declared ${CMAKE_MATCH_1})
+endforeach()
+
+# Collect the functions listed in the version script, with the node of each
+file(STRINGS ${MAP} lines)
+
+set(node "")
+set(listed "")
+set(expected "")
+
+foreach(line IN LISTS lines)
+  if(line MATCHES "^([A-Za-z0-9_.]+) {")
+    set(node ${CMAKE_MATCH_1})
+  elseif(line MATCHES "^ +([A-Za-z0-9_]+);$")
+    list(APPEND listed ${CMAKE_MATCH_1})
+    list(APPEND expected "${CMAKE_MATCH_1}@@${node}")
+  endif()
+endforeach()
+
+# Collect the functions exported by the library, with their version
+execute_process(
+  COMMAND ${NM} -D --defined-only ${LIBRARY}
+  OUTPUT_VARIABLE output
+  RESULT_VARIABLE result
+)
+
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "Unable to list the symbols of ${LIBRARY}")
+endif()
+
+string(REPLACE "\n" ";" symbols "${output}")
+
+set(exported "")
+
+foreach(symbol IN LISTS symbols)
+  if(symbol MATCHES " T ([A-Za-z0-9_]+@@[A-Za-z0-9_.]+)$")
+    list(APPEND exported ${CMAKE_MATCH_1})
+  endif()
+endforeach()
+
+# Compare the lists
+list(SORT declared)
+list(SORT listed)
+list(SORT expected)
+list(SORT exported)
+
+if(NOT declared STREQUAL listed)
+  message(FATAL_ERROR "The functions of include/pstated.h and src/pstated.map differ\n  header: ${declared}\n  map: ${listed}")
+endif()
+
+if(NOT exported STREQUAL expected)
+  message(FATAL_ERROR "The exports of ${LIBRARY} don't match src/pstated.map\n  exported: ${exported}\n  expected: ${expected}")
+endif()
@@ -0,0 +1,116 @@
+/*
+ * Example of embedding the nvidia-pstated core in another process.
+ *
+ * The example runs the base policy on every GPU for the given number of iterations, then hands the GPUs back to
+ * the driver. Usage: pstated-embed [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <unistd.h>
+#endif
+
+#include <pstated.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Interval (in milliseconds) between iterations
+#define INTERVAL 100
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static void sleep_ms(unsigned int ms) {
+  #ifdef _WIN32
+    Sleep(ms);
+  #else
+    usleep(ms * 1000);
+  #endif
+}
+
+int main(int argc, char * argv[]) {
+  // Number of iterations to run
+  unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 100;
+
+  // Check that the library shares the ABI of the header
+  if (pstated_version() >> 16 != PSTATED_API_VERSION_MAJOR) {
+    fprintf(stderr, "libpstated %u.%u is not compatible with this program\n", pstated_version() >> 16, pstated_version() & 0xffff);
+    return EXIT_FAILURE;
+  }
+
+  // Initialize the core
+  pstated_context * context;
+  int status = pstated_open(PSTATED_API_VERSION_MAJOR, &context);
+
+  if (status != PSTATED_OK) {
+    fprintf(stderr, "pstated_open(): %s\n", pstated_status_string(status));
+    return EXIT_FAILURE;
+  }
+
+  // Print the paired GPUs
+  unsigned int count = pstated_gpu_count(context);
+
+  printf("Driver %s, %u GPUs\n", pstated_driver_version(context), count);
+
+  for (unsigned int gpu = 0; gpu < count; gpu++) {
+    char uuid[96];
+
+    if (pstated_gpu_uuid(context, gpu, uuid, sizeof(uuid)) == PSTATED_OK) {
+      printf("GPU %u: %s\n", gpu, uuid);
+    }
+
+    // Switch to the low performance state after one second of idleness
+    pstated_policy policy = { .size = sizeof(policy) };
+
+    pstated_policy_default(&policy);
+    policy.iterationsBeforeSwitch = 1000 / INTERVAL;
+    pstated_policy_set(context, gpu, &policy);
+  }
+
+  // Performance state applied to each GPU, the GPUs start managed by the driver
+  unsigned int * applied = malloc((count > 0 ? count : 1) * sizeof(unsigned int));
+
+  if (applied == NULL) {
+    pstated_close(context);
+    return EXIT_FAILURE;
+  }
+
+  for (unsigned int gpu = 0; gpu < count; gpu++) {
+    applied[gpu] = PSTATED_PSTATE_AUTO;
+  }
+
+  // Run the base policy
+  for (unsigned long i = 0; i < iterations; i++) {
+    for (unsigned int gpu = 0; gpu < count; gpu++) {
+      // Take a snapshot of the GPU
+      pstated_snapshot snapshot = { .size = sizeof(snapshot) };
+
+      if (pstated_snapshot_take(context, gpu, &snapshot) != PSTATED_OK) {
+        continue;
+      }
+
+      // Decide on the performance state and apply it when it changes
+      unsigned int next;
+
+      if (pstated_step(context, gpu, &snapshot, &next) == PSTATED_OK && next != applied[gpu] && pstated_apply(context, gpu, next) == PSTATED_OK) {
+        printf("GPU %u: %u%% busy, %u C, performance state %u -> %u\n", gpu, snapshot.utilization, snapshot.temperature, applied[gpu], next);
+        applied[gpu] = next;
+      }
+    }
+
+    sleep_ms(INTERVAL);
+  }
+
+  // Hand the GPUs back to the driver
+  for (unsigned int gpu = 0; gpu < count; gpu++) {
+    pstated_apply(context, gpu, PSTATED_PSTATE_AUTO);
+  }
+
+  // Release the core
+  free(applied);
+
+  return pstated_close(context) == PSTATED_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
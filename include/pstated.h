@@ -0,0 +1,195 @@
+#pragma once
+
+/*
+ * Embeddable core of nvidia-pstated.
+ *
+ * The core pairs the NVAPI and NVML handles of each GPU, takes telemetry snapshots, runs the base policy (high
+ * performance state while the GPU is busy or work is announced, low performance state after a number of idle
+ * iterations, when an idle predictor foresees a saving, or above the temperature threshold) and applies performance
+ * states. The nvidia-pstated executable is built on top of it and takes every per-iteration decision through it.
+ *
+ * Stability: the context is opaque and only reached through these functions. Within a major version, functions are
+ * only added and structures only grow at their end. Callers set the size field of a structure to its size as they
+ * were compiled with, so that an older caller keeps working against a newer library.
+ *
+ * The core is not thread-safe: a context must be used by one thread at a time.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Version of the API, the major version changes when the ABI breaks
+#define PSTATED_API_VERSION_MAJOR 1
+#define PSTATED_API_VERSION_MINOR 3
+
+// Performance state that lets the driver manage the GPU
+#define PSTATED_PSTATE_AUTO 16
+
+// Symbols exported by the library
+#if defined(__GNUC__)
+  #define PSTATED_API __attribute__((visibility("default")))
+#else
+  #define PSTATED_API
+#endif
+
+/***** ***** ***** ***** ***** TYPES ***** ***** ***** ***** *****/
+
+// Status returned by the functions
+typedef enum {
+  PSTATED_OK = 0,
+  PSTATED_ERROR_INVALID_ARGUMENT = -1,
+  PSTATED_ERROR_VERSION = -2,
+  PSTATED_ERROR_NO_MEMORY = -3,
+  PSTATED_ERROR_NVAPI = -4,
+  PSTATED_ERROR_NVML = -5
+} pstated_status;
+
+// Reason of the performance state chosen by the last step of a GPU (since 1.2)
+typedef enum {
+  // No step was taken yet
+  PSTATED_REASON_NONE = 0,
+
+  // Above the temperature threshold
+  PSTATED_REASON_TEMPERATURE = 1,
+
+  // Busy or announced work
+  PSTATED_REASON_BUSY = 2,
+
+  // Idle, and still waiting for the switch
+  PSTATED_REASON_WAIT = 3,
+
+  // Idle for the number of iterations before switching
+  PSTATED_REASON_IDLE = 4,
+
+  // Idle, after an idle hint shortened the wait
+  PSTATED_REASON_HINT = 5,
+
+  // Idle, and the idle predictor foresees a saving
+  PSTATED_REASON_MODEL = 6
+} pstated_reason;
+
+// Opaque handle of an initialized core
+typedef struct pstated_context pstated_context;
+
+// Telemetry of a GPU
+typedef struct {
+  // Size of the structure, set by the caller
+  size_t size;
+
+  // Temperature (in degrees C)
+  unsigned int temperature;
+
+  // Utilization (in percent)
+  unsigned int utilization;
+
+  // Performance state reported by the driver (32 when the GPU doesn't report it)
+  unsigned int pstate;
+
+  // Power draw (in milliwatts, 0 when not supported)
+  unsigned int power;
+
+  // Non-zero when work is announced besides the utilization (application hints, queued requests, host-CPU activity,
+  // ramps of peers), which keeps the GPU in high performance state (since 1.2)
+  unsigned int demand;
+
+  // Non-zero when the caller keeps the GPU under the temperature threshold by other means (fans), so that the
+  // threshold doesn't cut the clocks (since 1.2)
+  unsigned int cooled;
+
+  // Non-zero while an application announced an idle period: the GPU switches once the number of idle iterations is
+  // reached, even if the idle predictor disagrees (since 1.2)
+  unsigned int idleHint;
+} pstated_snapshot;
+
+// Parameters of the base policy of a GPU
+typedef struct {
+  // Size of the structure, set by the caller
+  size_t size;
+
+  // High and low performance states
+  unsigned int performanceStateHigh;
+  unsigned int performanceStateLow;
+
+  // Number of idle iterations before switching to the low performance state
+  unsigned int iterationsBeforeSwitch;
+
+  // Temperature threshold (in degrees C) above which the GPU is kept in the low performance state
+  unsigned int temperatureThreshold;
+
+  // Optional idle predictor: when set, an idle GPU switches to the low performance state as soon as it returns
+  // non-zero, and after the number of idle iterations at the latest (since 1.2)
+  int (*predictIdle)(void * user, unsigned int gpu);
+  void * predictUser;
+} pstated_policy;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+// Get the version of the library, as (major << 16) | minor
+PSTATED_API unsigned int pstated_version(void);
+
+// Get a description of a status
+PSTATED_API const char * pstated_status_string(int status);
+
+// Initialize NVAPI and NVML and pair the handles of each GPU, version is PSTATED_API_VERSION_MAJOR
+PSTATED_API int pstated_open(unsigned int version, pstated_context ** context);
+
+// Initialize a core without NVAPI and NVML for a number of simulated GPUs (since 1.1): snapshots are supplied by the
+// caller, performance states are only recorded, and the GPUs have no handles
+PSTATED_API int pstated_open_mock(unsigned int version, unsigned int gpuCount, pstated_context ** context);
+
+// Release NVAPI and NVML and free the context, the GPUs are left in their current performance state
+PSTATED_API int pstated_close(pstated_context * context);
+
+// Get the number of GPUs, numbered as by nvidia-smi
+PSTATED_API unsigned int pstated_gpu_count(const pstated_context * context);
+
+// Get the UUID of a GPU
+PSTATED_API int pstated_gpu_uuid(const pstated_context * context, unsigned int gpu, char * buffer, size_t size);
+
+// Get the version of the driver
+PSTATED_API const char * pstated_driver_version(const pstated_context * context);
+
+// Get the paired NVML (nvmlDevice_t) and NVAPI (NvPhysicalGpuHandle) handles of a GPU, NULL for an unknown GPU
+PSTATED_API void * pstated_nvml_device(const pstated_context * context, unsigned int gpu);
+PSTATED_API void * pstated_nvapi_device(const pstated_context * context, unsigned int gpu);
+
+// Take a telemetry snapshot of a GPU
+PSTATED_API int pstated_snapshot_take(pstated_context * context, unsigned int gpu, pstated_snapshot * snapshot);
+
+// Fill the parameters of the base policy with the defaults of nvidia-pstated, up to the size set by the caller
+PSTATED_API void pstated_policy_default(pstated_policy * policy);
+
+// Set the parameters of the base policy of a GPU
+PSTATED_API int pstated_policy_set(pstated_context * context, unsigned int gpu, const pstated_policy * policy);
+
+// Run one iteration of the base policy on a snapshot, and get the performance state the GPU should be in
+PSTATED_API int pstated_step(pstated_context * context, unsigned int gpu, const pstated_snapshot * snapshot, unsigned int * pstate);
+
+// Force a performance state (PSTATED_PSTATE_AUTO hands the GPU back to the driver)
+PSTATED_API int pstated_apply(pstated_context * context, unsigned int gpu, unsigned int pstate);
+
+// Get the reason of the performance state chosen by the last step of a GPU, as a pstated_reason (since 1.2)
+PSTATED_API int pstated_step_reason(const pstated_context * context, unsigned int gpu);
+
+// Get the performance state of a GPU and its number of idle iterations (since 1.2)
+PSTATED_API int pstated_state(const pstated_context * context, unsigned int gpu, unsigned int * pstate, unsigned int * iterations);
+
+// Record a performance state reached without pstated_apply() (clock control, a previous process) and the number of
+// idle iterations, without touching the GPU (since 1.2)
+PSTATED_API int pstated_adopt(pstated_context * context, unsigned int gpu, unsigned int pstate, unsigned int iterations);
+
+// Get the number of performance states forced on a GPU through pstated_apply() since the core was opened (since 1.3)
+PSTATED_API int pstated_apply_count(const pstated_context * context, unsigned int gpu, unsigned long * count);
+
+// Get the driver call that failed last on a GPU and the error message of the driver, after pstated_snapshot_take() or
+// pstated_apply() returned PSTATED_ERROR_NVML or PSTATED_ERROR_NVAPI; the core doesn't print them (since 1.3)
+PSTATED_API int pstated_last_error(const pstated_context * context, unsigned int gpu, const char ** call, const char ** message);
+
+#ifdef __cplusplus
+}
+#endif
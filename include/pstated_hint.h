@@ -0,0 +1,31 @@
+#pragma once
+
+/*
+ * Client library to send scheduling hints to nvidia-pstated.
+ *
+ * Hints are sent as datagrams to the hint socket of the daemon (started with --hint-socket). Sending never blocks:
+ * if the daemon is not running or its socket buffer is full, the hint is dropped and -1 is returned.
+ *
+ * The socket path is taken from the PSTATED_HINT_SOCKET environment variable, or PSTATED_HINT_SOCKET_DEFAULT.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Default path of the hint socket
+#define PSTATED_HINT_SOCKET_DEFAULT "/run/nvidia-pstated/hint.sock"
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+// Announce that the GPU (as numbered by nvidia-smi) will be busy for the given duration in milliseconds
+int pstated_hint_busy(unsigned int gpu, unsigned int duration);
+
+// Announce that the GPU (as numbered by nvidia-smi) is going to be idle
+int pstated_hint_idle(unsigned int gpu);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,188 @@
+#include "calibration.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// First line of the calibration file
+#define CALIBRATION_HEADER "nvidia-pstated-calibration"
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+bool calibration_path(char *path, size_t size, const char *dir, const char *model) {
+  // Start with the directory
+  int length = snprintf(path, size, "%s/", dir);
+  if (length < 0 || (size_t) length >= size) {
+    return false;
+  }
+
+  // Append the model name, keeping only characters that are safe in a file name
+  for (const char *c = model; *c != '\0'; c++) {
+    if ((size_t) length + 1 >= size) {
+      return false;
+    }
+
+    path[length++] = (isalnum((unsigned char) *c) || *c == '-' || *c == '.') ? *c : '_';
+  }
+
+  // Append the extension
+  int written = snprintf(path + length, size - length, ".cal");
+
+  return written >= 0 && (size_t) written < size - length;
+}
+
+bool calibration_save(const calibration *calibration, const char *dir, const char *model) {
+  // Build the path of the file
+  char path[CALIBRATION_PATH_MAX];
+
+  if (!calibration_path(path, sizeof(path), dir, model)) {
+    fprintf(stderr, "Calibration path too long for %s\n", model);
+    return false;
+  }
+
+  // Open the file
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    fprintf(stderr, "Unable to open calibration file %s\n", path);
+    return false;
+  }
+
+  // Write the header, the model and the driver version
+  fprintf(file, CALIBRATION_HEADER " %u\n", CALIBRATION_VERSION);
+  fprintf(file, "# model: %s\n", model);
+  fprintf(file, "driver %s\n", calibration->driver);
+  fprintf(file, "# pstate mem_mhz gpu_mhz settle_ms power_w return_ms\n");
+
+  // Write one line per point
+  for (unsigned int i = 0; i < calibration->count; i++) {
+    const calibrationPoint *point = &calibration->points[i];
+
+    fprintf(file, "%u %u %u %llu %.2f %llu\n",
+      point->pstateId, point->memClock, point->gpuClock, point->settle, point->power, point->returnLatency);
+  }
+
+  // Flush the file and check for write errors
+  bool ok = fflush(file) == 0 && !ferror(file);
+
+  if (fclose(file) != 0 || !ok) {
+    fprintf(stderr, "Unable to write calibration file %s\n", path);
+    return false;
+  }
+
+  // Print the path of the file
+  printf("Calibration of %s written to %s\n", model, path);
+
+  // Return true to indicate success
+  return true;
+}
+
+bool calibration_load(calibration *calibration, const char *dir, const char *model) {
+  // Start from an empty calibration
+  memset(calibration, 0, sizeof(*calibration));
+
+  // Build the path of the file
+  char path[CALIBRATION_PATH_MAX];
+
+  if (!calibration_path(path, sizeof(path), dir, model)) {
+    return false;
+  }
+
+  // Open the file, a missing file means the model wasn't calibrated
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return false;
+  }
+
+  // Check the header
+  unsigned int version;
+
+  if (fscanf(file, CALIBRATION_HEADER " %u\n", &version) != 1 || version != CALIBRATION_VERSION) {
+    fprintf(stderr, "Ignoring calibration file %s with unknown format\n", path);
+    fclose(file);
+    return false;
+  }
+
+  // Read the file line by line
+  char line[256];
+
+  while (fgets(line, sizeof(line), file) != NULL) {
+    // Skip comments and empty lines
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+
+    // Read the driver version
+    if (sscanf(line, "driver %79s", calibration->driver) == 1) {
+      continue;
+    }
+
+    // Stop at the maximum number of points
+    if (calibration->count == CALIBRATION_MAX_POINTS) {
+      break;
+    }
+
+    // Read a point
+    calibrationPoint *point = &calibration->points[calibration->count];
+
+    if (sscanf(line, "%u %u %u %llu %lf %llu",
+        &point->pstateId, &point->memClock, &point->gpuClock, &point->settle, &point->power, &point->returnLatency) != 6) {
+      fprintf(stderr, "Ignoring calibration file %s with invalid line: %s", path, line);
+      fclose(file);
+      return false;
+    }
+
+    calibration->count++;
+  }
+
+  // Close the file
+  fclose(file);
+
+  // A calibration without points is useless
+  calibration->loaded = calibration->count > 0;
+
+  return calibration->loaded;
+}
+
+const calibrationPoint * calibration_find(const calibration *calibration, unsigned int pstateId, unsigned int memClock, unsigned int gpuClock) {
+  // Look the point up by performance state and clocks
+  for (unsigned int i = 0; i < calibration->count; i++) {
+    const calibrationPoint *point = &calibration->points[i];
+
+    if (point->pstateId == pstateId && point->memClock == memClock && point->gpuClock == gpuClock) {
+      return point;
+    }
+  }
+
+  return NULL;
+}
+
+const calibrationPoint * calibration_recommend(const calibration *calibration, double tolerance) {
+  // Nothing to recommend without a point besides the high point
+  if (calibration->count < 2) {
+    return NULL;
+  }
+
+  // Find the lowest idle power
+  double lowest = calibration->points[1].power;
+
+  for (unsigned int i = 2; i < calibration->count; i++) {
+    if (calibration->points[i].power < lowest) {
+      lowest = calibration->points[i].power;
+    }
+  }
+
+  // Among the points within the tolerance of the lowest idle power, pick the one that returns to high fastest
+  const calibrationPoint *best = NULL;
+
+  for (unsigned int i = 1; i < calibration->count; i++) {
+    const calibrationPoint *point = &calibration->points[i];
+
+    if (point->power <= lowest + tolerance && (best == NULL || point->returnLatency < best->returnLatency)) {
+      best = point;
+    }
+  }
+
+  return best;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of points in a calibration
+#define CALIBRATION_MAX_POINTS 32
+
+// Maximum length of a calibration file path
+#define CALIBRATION_PATH_MAX 4096
+
+// Version of the calibration file format
+#define CALIBRATION_VERSION 1
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the measurements of a performance state or clock point
+typedef struct {
+  // Performance state of the point (16 for clock points)
+  unsigned int pstateId;
+
+  // Memory and GPU clocks (in MHz) of the point (0 for performance states)
+  unsigned int memClock;
+  unsigned int gpuClock;
+
+  // Time (in milliseconds) from the write until the read-back showed the point
+  unsigned long long settle;
+
+  // Average power draw (in watts) of the idle GPU at the point
+  double power;
+
+  // Time (in milliseconds) from the write of the high point until the read-back showed it
+  unsigned long long returnLatency;
+} calibrationPoint;
+
+// Structure to hold the calibration of a GPU model
+typedef struct {
+  // Flag to indicate if the calibration was loaded
+  bool loaded;
+
+  // Driver version the calibration was measured with
+  char driver[80];
+
+  // Measured points, the first one is the high point the others return to
+  calibrationPoint points[CALIBRATION_MAX_POINTS];
+  unsigned int count;
+} calibration;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool calibration_path(char *path, size_t size, const char *dir, const char *model);
+bool calibration_save(const calibration *calibration, const char *dir, const char *model);
+bool calibration_load(calibration *calibration, const char *dir, const char *model);
+const calibrationPoint * calibration_find(const calibration *calibration, unsigned int pstateId, unsigned int memClock, unsigned int gpuClock);
+const calibrationPoint * calibration_recommend(const calibration *calibration, double tolerance);
@@ -0,0 +1,146 @@
+#include "classify.h"
+
+#include <string.h>
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+static const char * classNames[WORKLOAD_CLASS_COUNT] = { "idle", "steady", "bursty", "interactive" };
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+void classifier_add_sample(workloadClassifier *classifier, bool busy) {
+  // Store the sample at the head of the ring buffer
+  classifier->samples[classifier->head] = busy;
+
+  // Advance the head
+  classifier->head = (classifier->head + 1) % CLASSIFY_WINDOW;
+
+  // Increase the number of valid samples until the buffer is full
+  if (classifier->count < CLASSIFY_WINDOW) {
+    classifier->count++;
+  }
+}
+
+workloadClass classifier_evaluate(const workloadClassifier *classifier, unsigned long gapThreshold) {
+  // Not enough samples yet, keep the current class
+  if (classifier->count < CLASSIFY_MIN_SAMPLES) {
+    return classifier->current;
+  }
+
+  // Index of the oldest sample
+  unsigned int start = (classifier->head + CLASSIFY_WINDOW - classifier->count) % CLASSIFY_WINDOW;
+
+  // Counters for busy samples, bursts and gaps enclosed by bursts
+  unsigned int busySamples = 0;
+  unsigned int bursts = 0;
+  unsigned int gaps = 0;
+  unsigned int gapSamples = 0;
+
+  // Length of the gap that is still open
+  unsigned int openGap = 0;
+
+  // Walk the samples from the oldest to the newest
+  for (unsigned int j = 0; j < classifier->count; j++) {
+    if (classifier->samples[(start + j) % CLASSIFY_WINDOW]) {
+      // A burst closes the open gap, count it if a burst preceded it
+      if (openGap > 0 && busySamples > 0) {
+        gaps++;
+        gapSamples += openGap;
+      }
+
+      // A busy sample after an idle one (or at the start of the window) starts a burst
+      if (openGap > 0 || busySamples == 0) {
+        bursts++;
+      }
+
+      // Count the busy sample and reset the open gap
+      busySamples++;
+      openGap = 0;
+    } else {
+      // Extend the open gap
+      openGap++;
+    }
+  }
+
+  // Calculate the duty cycle in percent
+  unsigned int duty = busySamples * 100 / classifier->count;
+
+  // Almost no activity
+  if (duty < CLASSIFY_DUTY_IDLE) {
+    return WORKLOAD_IDLE;
+  }
+
+  // Activity most of the time
+  if (duty >= CLASSIFY_DUTY_STEADY) {
+    return WORKLOAD_STEADY;
+  }
+
+  // A single burst without a gap in the window, treat as sporadic use
+  if (gaps == 0) {
+    return WORKLOAD_INTERACTIVE;
+  }
+
+  // Long gaps between bursts indicate interactive use
+  if (gapSamples / gaps > gapThreshold) {
+    return WORKLOAD_INTERACTIVE;
+  }
+
+  // Long bursts with short pauses indicate steady work with stalls (e.g. data loading), short ones a stream of requests
+  return busySamples / bursts > gapThreshold ? WORKLOAD_STEADY : WORKLOAD_BURSTY;
+}
+
+bool classifier_update(workloadClassifier *classifier, unsigned long gapThreshold, unsigned long hysteresis) {
+  // Classify the recent activity
+  workloadClass observed = classifier_evaluate(classifier, gapThreshold);
+
+  // The observed class matches the current class, drop any pending candidate
+  if (observed == classifier->current) {
+    classifier->candidateCount = 0;
+
+    // No change
+    return false;
+  }
+
+  // Count consecutive observations of the same candidate
+  if (observed == classifier->candidate) {
+    classifier->candidateCount++;
+  } else {
+    classifier->candidate = observed;
+    classifier->candidateCount = 1;
+  }
+
+  // The candidate has not been observed long enough
+  if (classifier->candidateCount < hysteresis) {
+    return false;
+  }
+
+  // Switch to the candidate class
+  classifier->current = observed;
+  classifier->candidateCount = 0;
+  classifier->changes++;
+
+  // The class changed
+  return true;
+}
+
+const char * workload_class_name(workloadClass workload) {
+  // Return the name of the class or a placeholder for invalid values
+  return workload < WORKLOAD_CLASS_COUNT ? classNames[workload] : "unknown";
+}
+
+bool parse_workload_class(const char *name, workloadClass *workload) {
+  // Iterate over the known classes
+  for (unsigned int i = 0; i < WORKLOAD_CLASS_COUNT; i++) {
+    // Check if the name matches
+    if (strcmp(name, classNames[i]) == 0) {
+      // Store the class
+      *workload = (workloadClass) i;
+
+      // The name is valid
+      return true;
+    }
+  }
+
+  // Unknown class name
+  return false;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Number of samples kept for classification
+#define CLASSIFY_WINDOW 600
+
+// Minimum number of samples before a GPU is classified
+#define CLASSIFY_MIN_SAMPLES 50
+
+// Duty cycle (in percent) below which a GPU is considered idle
+#define CLASSIFY_DUTY_IDLE 1
+
+// Duty cycle (in percent) above which a GPU is considered steadily busy
+#define CLASSIFY_DUTY_STEADY 80
+
+// Number of iterations between workload classifications
+#define CLASSIFY_INTERVAL 10
+
+// Number of consecutive classifications required to change the workload class
+#define CLASSIFY_HYSTERESIS 3
+
+// Mean gap (in milliseconds) between bursts above which a workload is considered interactive
+#define CLASSIFY_GAP_THRESHOLD 5000
+
+// Default parameter overrides of each workload class
+#define CLASSIFY_PROFILE_IDLE ""
+#define CLASSIFY_PROFILE_STEADY "ibs=50"
+#define CLASSIFY_PROFILE_BURSTY "ibs=100"
+#define CLASSIFY_PROFILE_INTERACTIVE "ibs=10"
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Workload classes
+typedef enum {
+  WORKLOAD_IDLE,
+  WORKLOAD_STEADY,
+  WORKLOAD_BURSTY,
+  WORKLOAD_INTERACTIVE,
+  WORKLOAD_CLASS_COUNT
+} workloadClass;
+
+// Structure to hold the classification state of a GPU
+typedef struct {
+  // Ring buffer of busy/idle samples
+  unsigned char samples[CLASSIFY_WINDOW];
+
+  // Index of the next sample and number of valid samples
+  unsigned int head;
+  unsigned int count;
+
+  // Current class and the candidate waiting for confirmation
+  workloadClass current;
+  workloadClass candidate;
+
+  // Number of consecutive evaluations that returned the candidate
+  unsigned long candidateCount;
+
+  // Number of class changes
+  unsigned long changes;
+
+  // Time spent in each class (in milliseconds)
+  unsigned long long residency[WORKLOAD_CLASS_COUNT];
+} workloadClassifier;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+void classifier_add_sample(workloadClassifier *classifier, bool busy);
+workloadClass classifier_evaluate(const workloadClassifier *classifier, unsigned long gapThreshold);
+bool classifier_update(workloadClassifier *classifier, unsigned long gapThreshold, unsigned long hysteresis);
+const char * workload_class_name(workloadClass workload);
+bool parse_workload_class(const char *name, workloadClass *workload);
@@ -0,0 +1,76 @@
+#include "coupling.h"
+
+#include <math.h>
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+void coupling_update(thermalCoupling *coupling, unsigned int count, const bool valid[], const double power[], const double residual[]) {
+  // Clamp the number of GPUs to the size of the statistics
+  if (count > COUPLING_MAX_GPUS) {
+    count = COUPLING_MAX_GPUS;
+  }
+
+  // Use a larger weight for the first observations so that the statistics converge quickly
+  double alpha = coupling->samples < 1.0 / COUPLING_ALPHA ? 1.0 / (coupling->samples + 1) : COUPLING_ALPHA;
+
+  // Deviations of the current observation from the means
+  double powerDeviation[COUPLING_MAX_GPUS];
+  double residualDeviation[COUPLING_MAX_GPUS];
+
+  // Update the means and variances of each GPU
+  for (unsigned int i = 0; i < count; i++) {
+    if (valid[i]) {
+      powerDeviation[i] = power[i] - coupling->meanPower[i];
+      residualDeviation[i] = residual[i] - coupling->meanResidual[i];
+
+      coupling->meanPower[i] += alpha * powerDeviation[i];
+      coupling->meanResidual[i] += alpha * residualDeviation[i];
+      coupling->varPower[i] = (1 - alpha) * (coupling->varPower[i] + alpha * powerDeviation[i] * powerDeviation[i]);
+      coupling->varResidual[i] = (1 - alpha) * (coupling->varResidual[i] + alpha * residualDeviation[i] * residualDeviation[i]);
+    }
+  }
+
+  // Update the covariances between each pair of GPUs
+  for (unsigned int target = 0; target < count; target++) {
+    for (unsigned int source = 0; source < count; source++) {
+      if (target != source && valid[target] && valid[source]) {
+        coupling->covariance[target][source] = (1 - alpha) * (coupling->covariance[target][source] + alpha * residualDeviation[target] * powerDeviation[source]);
+      }
+    }
+  }
+
+  // Count the observation
+  coupling->samples++;
+}
+
+double coupling_coefficient(const thermalCoupling *coupling, unsigned int target, unsigned int source) {
+  // A GPU is not coupled to itself and unknown GPUs are not coupled at all
+  if (target == source || target >= COUPLING_MAX_GPUS || source >= COUPLING_MAX_GPUS) {
+    return 0;
+  }
+
+  // Not enough observations yet
+  if (coupling->samples < COUPLING_MIN_SAMPLES) {
+    return 0;
+  }
+
+  // Get the variances of both GPUs
+  double varPower = coupling->varPower[source];
+  double varResidual = coupling->varResidual[target];
+
+  // Without variation there is nothing to correlate
+  if (varPower <= 0 || varResidual <= 0) {
+    return 0;
+  }
+
+  // Get the covariance of the pair
+  double covariance = coupling->covariance[target][source];
+
+  // Only a significant positive correlation (the source heats the target) counts as coupling
+  if (covariance / sqrt(varPower * varResidual) < COUPLING_MIN_CORRELATION) {
+    return 0;
+  }
+
+  // Return the regression coefficient of the residual on the power
+  return covariance / varPower;
+}
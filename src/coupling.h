@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs in a coupled group
+#define COUPLING_MAX_GPUS 64
+
+// Weight of a new observation in the exponentially weighted statistics
+#define COUPLING_ALPHA 0.01
+
+// Minimum number of observations before coupling coefficients are used
+#define COUPLING_MIN_SAMPLES 60
+
+// Minimum correlation between the power of a GPU and the residual heating of another GPU to consider them coupled
+#define COUPLING_MIN_CORRELATION 0.3
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the thermal coupling between GPUs sharing airflow
+//
+// The coupling of a source GPU to a target GPU is the regression coefficient of the target's heating that its own
+// thermal model can't explain (residual) on the power draw of the source, in degrees C per model step per watt.
+typedef struct {
+  // Number of observations
+  unsigned long samples;
+
+  // Exponentially weighted means and variances of the power draw and the residual heating of each GPU
+  double meanPower[COUPLING_MAX_GPUS];
+  double varPower[COUPLING_MAX_GPUS];
+  double meanResidual[COUPLING_MAX_GPUS];
+  double varResidual[COUPLING_MAX_GPUS];
+
+  // Exponentially weighted covariance between the residual of a target (row) and the power of a source (column)
+  double covariance[COUPLING_MAX_GPUS][COUPLING_MAX_GPUS];
+} thermalCoupling;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+void coupling_update(thermalCoupling *coupling, unsigned int count, const bool valid[], const double power[], const double residual[]);
+double coupling_coefficient(const thermalCoupling *coupling, unsigned int target, unsigned int source);
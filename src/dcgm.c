@@ -0,0 +1,402 @@
+#include "dcgm.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+  #include <dlfcn.h>
+  #include <unistd.h>
+#endif
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Return code of successful DCGM calls
+#define DCGM_ST_OK 0
+
+// Identifier of the group of all GPUs, which doesn't need to be created
+#define DCGM_GROUP_ALL_GPUS 0x7fffffff
+
+// Entity group of GPUs
+#define DCGM_FE_GPU 1
+
+// Field types
+#define DCGM_FT_DOUBLE 'd'
+#define DCGM_FT_INT64 'i'
+#define DCGM_FT_STRING 's'
+
+// Values at or above these are blank (not available)
+#define DCGM_INT64_BLANK 0x7ffffff0LL
+#define DCGM_FP64_BLANK 140737488355328.0
+
+// Field identifiers
+#define DCGM_FI_DEV_UUID 54
+#define DCGM_FI_DEV_GPU_TEMP 150
+#define DCGM_FI_DEV_GPU_UTIL 203
+#define DCGM_FI_PROF_GR_ENGINE_ACTIVE 1001
+#define DCGM_FI_PROF_SM_ACTIVE 1002
+#define DCGM_FI_PROF_PIPE_TENSOR_ACTIVE 1004
+#define DCGM_FI_PROF_DRAM_ACTIVE 1005
+
+// Time (in seconds) the host engine keeps the values of the watched fields
+#define DCGM_MAX_KEEP_AGE 10.0
+
+// Length of a UUID
+#define DCGM_UUID_MAX 96
+
+/***** ***** ***** ***** ***** TYPES ***** ***** ***** ***** *****/
+
+typedef int dcgmReturn_t;
+typedef uintptr_t dcgmHandle_t;
+typedef uintptr_t dcgmGpuGrp_t;
+typedef uintptr_t dcgmFieldGrp_t;
+
+// Value of a field, as laid out by the DCGM library
+typedef struct {
+  unsigned int version;
+  unsigned short fieldId;
+  unsigned short fieldType;
+  int status;
+  int64_t ts;
+  union {
+    int64_t i64;
+    double dbl;
+    char str[256];
+    char blob[4096];
+  } value;
+} dcgmFieldValue_v1;
+
+typedef int (*dcgmFieldValueEntityEnumeration_f)(int, unsigned int, dcgmFieldValue_v1 *, int, void *);
+
+typedef dcgmReturn_t (*dcgmInit_t)(void);
+typedef dcgmReturn_t (*dcgmShutdown_t)(void);
+typedef dcgmReturn_t (*dcgmConnect_t)(const char *, dcgmHandle_t *);
+typedef dcgmReturn_t (*dcgmDisconnect_t)(dcgmHandle_t);
+typedef dcgmReturn_t (*dcgmFieldGroupCreate_t)(dcgmHandle_t, int, unsigned short *, const char *, dcgmFieldGrp_t *);
+typedef dcgmReturn_t (*dcgmFieldGroupDestroy_t)(dcgmHandle_t, dcgmFieldGrp_t);
+typedef dcgmReturn_t (*dcgmWatchFields_t)(dcgmHandle_t, dcgmGpuGrp_t, dcgmFieldGrp_t, long long, double, int);
+typedef dcgmReturn_t (*dcgmGetLatestValues_v2_t)(dcgmHandle_t, dcgmGpuGrp_t, dcgmFieldGrp_t, dcgmFieldValueEntityEnumeration_f, void *);
+typedef const char * (*errorString_t)(dcgmReturn_t);
+
+// Structure to hold the latest values of a GPU entity
+typedef struct {
+  // UUID of the GPU
+  char uuid[DCGM_UUID_MAX];
+
+  // Temperature (in degrees C) and activity (in percent)
+  unsigned int temperature;
+  double activity;
+
+  // Times (in microseconds since the epoch) of the values, 0 when not available
+  int64_t temperatureTime;
+  int64_t activityTime;
+} dcgmEntity;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+static void * lib;
+
+static dcgmInit_t               _dcgmInit;
+static dcgmShutdown_t           _dcgmShutdown;
+static dcgmConnect_t            _dcgmConnect;
+static dcgmDisconnect_t         _dcgmDisconnect;
+static dcgmFieldGroupCreate_t   _dcgmFieldGroupCreate;
+static dcgmFieldGroupDestroy_t  _dcgmFieldGroupDestroy;
+static dcgmWatchFields_t        _dcgmWatchFields;
+static dcgmGetLatestValues_v2_t _dcgmGetLatestValues_v2;
+static errorString_t            _errorString;
+
+// Connection to the host engine and the watched field group
+static dcgmHandle_t handle;
+static dcgmFieldGrp_t fieldGroup;
+static bool connected;
+static bool watching;
+
+// Activity field, update interval (in milliseconds) and number of failed updates
+static unsigned short activityField;
+static unsigned long interval;
+static unsigned long errors;
+
+// Latest values of each GPU entity
+static dcgmEntity entities[DCGM_MAX_GPUS];
+
+// Names and field identifiers of the activity signals
+static const char *activityNames[DCGM_ACTIVITY_COUNT] = {
+  [DCGM_ACTIVITY_UTIL] = "util",
+  [DCGM_ACTIVITY_GR] = "gr",
+  [DCGM_ACTIVITY_SM] = "sm",
+  [DCGM_ACTIVITY_TENSOR] = "tensor",
+  [DCGM_ACTIVITY_DRAM] = "dram",
+};
+
+static const unsigned short activityFields[DCGM_ACTIVITY_COUNT] = {
+  [DCGM_ACTIVITY_UTIL] = DCGM_FI_DEV_GPU_UTIL,
+  [DCGM_ACTIVITY_GR] = DCGM_FI_PROF_GR_ENGINE_ACTIVE,
+  [DCGM_ACTIVITY_SM] = DCGM_FI_PROF_SM_ACTIVE,
+  [DCGM_ACTIVITY_TENSOR] = DCGM_FI_PROF_PIPE_TENSOR_ACTIVE,
+  [DCGM_ACTIVITY_DRAM] = DCGM_FI_PROF_DRAM_ACTIVE,
+};
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+#ifdef __linux__
+  static const char * dcgm_error(dcgmReturn_t result) {
+    // Use the library's description if available
+    const char *error = _errorString != NULL ? _errorString(result) : NULL;
+
+    return error != NULL ? error : "unknown error";
+  }
+
+  static int64_t wall_time_us(void) {
+    // Get the wall clock time, DCGM timestamps are relative to the epoch
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
+
+  static int store_values(int entityGroupId, unsigned int entityId, dcgmFieldValue_v1 *values, int numValues, void *userData) {
+    (void) userData;
+
+    // Skip entities that are not GPUs
+    if (entityGroupId != DCGM_FE_GPU || entityId >= DCGM_MAX_GPUS) {
+      return 0;
+    }
+
+    // Get the entry of the GPU
+    dcgmEntity *entity = &entities[entityId];
+
+    // Store each value
+    for (int i = 0; i < numValues; i++) {
+      // Get the current value
+      dcgmFieldValue_v1 *value = &values[i];
+
+      // Skip values the host engine couldn't read
+      if (value->status != DCGM_ST_OK) {
+        continue;
+      }
+
+      if (value->fieldId == DCGM_FI_DEV_UUID && value->fieldType == DCGM_FT_STRING) {
+        // Store the UUID
+        snprintf(entity->uuid, sizeof(entity->uuid), "%.*s", (int) sizeof(entity->uuid) - 1, value->value.str);
+      } else if (value->fieldId == DCGM_FI_DEV_GPU_TEMP && value->fieldType == DCGM_FT_INT64) {
+        // Store the temperature unless it is blank
+        if (value->value.i64 >= 0 && value->value.i64 < DCGM_INT64_BLANK) {
+          entity->temperature = (unsigned int) value->value.i64;
+          entity->temperatureTime = value->ts;
+        }
+      } else if (value->fieldId == activityField && value->fieldType == DCGM_FT_INT64) {
+        // Store the utilization (in percent) unless it is blank
+        if (value->value.i64 >= 0 && value->value.i64 < DCGM_INT64_BLANK) {
+          entity->activity = (double) value->value.i64;
+          entity->activityTime = value->ts;
+        }
+      } else if (value->fieldId == activityField && value->fieldType == DCGM_FT_DOUBLE) {
+        // Store the activity ratio as a percentage unless it is blank
+        if (value->value.dbl >= 0 && value->value.dbl < DCGM_FP64_BLANK) {
+          entity->activity = value->value.dbl * 100;
+          entity->activityTime = value->ts;
+        }
+      }
+    }
+
+    // Continue the enumeration
+    return 0;
+  }
+#endif
+
+bool dcgm_open(const dcgmConfig *config) {
+  #ifdef __linux__
+    // Load the DCGM library
+    if (config->library != NULL) {
+      lib = dlopen(config->library, RTLD_LAZY);
+    } else {
+      lib = dlopen("libdcgm.so.4", RTLD_LAZY);
+
+      if (!lib) {
+        lib = dlopen("libdcgm.so.3", RTLD_LAZY);
+      }
+    }
+
+    if (!lib) {
+      fprintf(stderr, "Unable to load DCGM library: %s\n", dlerror());
+      return false;
+    }
+
+    // Retrieve the addresses of the functions
+    _dcgmInit = (dcgmInit_t) dlsym(lib, "dcgmInit");
+    _dcgmShutdown = (dcgmShutdown_t) dlsym(lib, "dcgmShutdown");
+    _dcgmConnect = (dcgmConnect_t) dlsym(lib, "dcgmConnect");
+    _dcgmDisconnect = (dcgmDisconnect_t) dlsym(lib, "dcgmDisconnect");
+    _dcgmFieldGroupCreate = (dcgmFieldGroupCreate_t) dlsym(lib, "dcgmFieldGroupCreate");
+    _dcgmFieldGroupDestroy = (dcgmFieldGroupDestroy_t) dlsym(lib, "dcgmFieldGroupDestroy");
+    _dcgmWatchFields = (dcgmWatchFields_t) dlsym(lib, "dcgmWatchFields");
+    _dcgmGetLatestValues_v2 = (dcgmGetLatestValues_v2_t) dlsym(lib, "dcgmGetLatestValues_v2");
+    _errorString = (errorString_t) dlsym(lib, "errorString");
+
+    if (!_dcgmInit || !_dcgmShutdown || !_dcgmConnect || !_dcgmDisconnect || !_dcgmFieldGroupCreate ||
+        !_dcgmFieldGroupDestroy || !_dcgmWatchFields || !_dcgmGetLatestValues_v2) {
+      fprintf(stderr, "Unable to retrieve DCGM functions\n");
+      dcgm_close();
+      return false;
+    }
+
+    // Initialize the library and connect to the host engine
+    dcgmReturn_t result = _dcgmInit();
+    if (result != DCGM_ST_OK) {
+      fprintf(stderr, "dcgmInit(): %s\n", dcgm_error(result));
+      dcgm_close();
+      return false;
+    }
+
+    result = _dcgmConnect(config->host, &handle);
+    if (result != DCGM_ST_OK) {
+      fprintf(stderr, "Unable to connect to DCGM host engine %s: %s\n", config->host, dcgm_error(result));
+      _dcgmShutdown();
+      dcgm_close();
+      return false;
+    }
+
+    connected = true;
+
+    // Remember the configuration
+    activityField = activityFields[config->activity];
+    interval = config->interval > DCGM_MIN_INTERVAL ? config->interval : DCGM_MIN_INTERVAL;
+
+    // Create the field group, its name must be unique on the host engine
+    unsigned short fields[] = { DCGM_FI_DEV_UUID, DCGM_FI_DEV_GPU_TEMP, activityField };
+    char name[64];
+    snprintf(name, sizeof(name), "nvidia-pstated-%ld", (long) getpid());
+
+    result = _dcgmFieldGroupCreate(handle, sizeof(fields) / sizeof(fields[0]), fields, name, &fieldGroup);
+    if (result != DCGM_ST_OK) {
+      fprintf(stderr, "Unable to create DCGM field group: %s\n", dcgm_error(result));
+      dcgm_close();
+      return false;
+    }
+
+    watching = true;
+
+    // Watch the fields of all GPUs at the update interval
+    result = _dcgmWatchFields(handle, DCGM_GROUP_ALL_GPUS, fieldGroup, (long long) interval * 1000, DCGM_MAX_KEEP_AGE, 0);
+    if (result != DCGM_ST_OK) {
+      fprintf(stderr, "Unable to watch DCGM fields: %s\n", dcgm_error(result));
+      dcgm_close();
+      return false;
+    }
+
+    // Return true to indicate success
+    return true;
+  #else
+    // Print an error message
+    fprintf(stderr, "DCGM telemetry is not supported on this platform\n");
+
+    (void) config;
+    return false;
+  #endif
+}
+
+void dcgm_close(void) {
+  #ifdef __linux__
+    // Remove the field group, which also removes its watches
+    if (watching) {
+      _dcgmFieldGroupDestroy(handle, fieldGroup);
+      watching = false;
+    }
+
+    // Disconnect from the host engine and shut the library down
+    if (connected) {
+      _dcgmDisconnect(handle);
+      _dcgmShutdown();
+      connected = false;
+    }
+
+    // Unload the library
+    if (lib) {
+      dlclose(lib);
+      lib = NULL;
+    }
+  #endif
+}
+
+bool dcgm_update(void) {
+  #ifdef __linux__
+    // Nothing to do without a connection
+    if (!watching) {
+      return false;
+    }
+
+    // Read the latest values of all GPUs in one call
+    dcgmReturn_t result = _dcgmGetLatestValues_v2(handle, DCGM_GROUP_ALL_GPUS, fieldGroup, store_values, NULL);
+    if (result != DCGM_ST_OK) {
+      // Print the first error only, the host engine may be restarting
+      if (errors++ == 0) {
+        fprintf(stderr, "Unable to read DCGM fields, falling back to NVML: %s\n", dcgm_error(result));
+      }
+
+      return false;
+    }
+
+    return true;
+  #else
+    return false;
+  #endif
+}
+
+bool dcgm_sample(const char *uuid, dcgmSample *sample) {
+  // Nothing is known by default
+  sample->hasTemperature = false;
+  sample->hasActivity = false;
+
+  #ifdef __linux__
+    // Values older than a few update intervals are stale, the host engine may have stopped updating them
+    int64_t oldest = wall_time_us() - (int64_t) interval * DCGM_STALE_INTERVALS * 1000;
+
+    // Find the GPU by UUID, DCGM and NVML may number the GPUs differently
+    for (unsigned int i = 0; i < DCGM_MAX_GPUS; i++) {
+      dcgmEntity *entity = &entities[i];
+
+      if (strcmp(entity->uuid, uuid) != 0) {
+        continue;
+      }
+
+      // Take the fresh values
+      if (entity->temperatureTime != 0 && entity->temperatureTime >= oldest) {
+        sample->hasTemperature = true;
+        sample->temperature = entity->temperature;
+      }
+
+      if (entity->activityTime != 0 && entity->activityTime >= oldest) {
+        sample->hasActivity = true;
+        sample->activity = entity->activity;
+      }
+
+      return true;
+    }
+  #else
+    (void) uuid;
+  #endif
+
+  return false;
+}
+
+unsigned long dcgm_errors(void) {
+  return errors;
+}
+
+bool parse_dcgm_activity(const char *name, dcgmActivity *activity) {
+  // Look the name up
+  for (unsigned int i = 0; i < DCGM_ACTIVITY_COUNT; i++) {
+    if (strcmp(name, activityNames[i]) == 0) {
+      *activity = (dcgmActivity) i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const char * dcgm_activity_name(dcgmActivity activity) {
+  return activityNames[activity];
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs read from the host engine
+#define DCGM_MAX_GPUS 64
+
+// Number of update intervals after which the latest values are considered stale
+#define DCGM_STALE_INTERVALS 4
+
+// Minimum update interval (in milliseconds) of the field watches
+#define DCGM_MIN_INTERVAL 100
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Activity signals that can replace the GPU utilization
+typedef enum {
+  DCGM_ACTIVITY_UTIL,
+  DCGM_ACTIVITY_GR,
+  DCGM_ACTIVITY_SM,
+  DCGM_ACTIVITY_TENSOR,
+  DCGM_ACTIVITY_DRAM,
+  DCGM_ACTIVITY_COUNT
+} dcgmActivity;
+
+// Structure to hold the configuration of the DCGM telemetry backend
+typedef struct {
+  // Path or name of the DCGM library (NULL for the default names)
+  const char *library;
+
+  // Address of the host engine ("host" or "host:port")
+  const char *host;
+
+  // Activity signal used instead of the GPU utilization
+  dcgmActivity activity;
+
+  // Interval (in milliseconds) between updates of the watched fields
+  unsigned long interval;
+} dcgmConfig;
+
+// Structure to hold the latest values of a GPU
+typedef struct {
+  // Flags to indicate if the temperature and the activity are known and fresh
+  bool hasTemperature;
+  bool hasActivity;
+
+  // Temperature (in degrees C)
+  unsigned int temperature;
+
+  // Activity (in percent)
+  double activity;
+} dcgmSample;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool dcgm_open(const dcgmConfig *config);
+void dcgm_close(void);
+bool dcgm_update(void);
+bool dcgm_sample(const char *uuid, dcgmSample *sample);
+unsigned long dcgm_errors(void);
+bool parse_dcgm_activity(const char *name, dcgmActivity *activity);
+const char * dcgm_activity_name(dcgmActivity activity);
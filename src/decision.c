@@ -0,0 +1,59 @@
+#include "decision.h"
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+decisionAction decision_action(int reason, unsigned int current, unsigned int next, bool scheduled) {
+  // Nothing to do while the GPU is already in the decided state
+  if (next == current) {
+    return DECISION_KEEP;
+  }
+
+  switch (reason) {
+    case PSTATED_REASON_BUSY:
+      // Ramp up, through the ramp scheduler if enabled
+      return scheduled ? DECISION_QUEUE : DECISION_RAMP;
+
+    case PSTATED_REASON_TEMPERATURE:
+    case PSTATED_REASON_IDLE:
+    case PSTATED_REASON_HINT:
+    case PSTATED_REASON_MODEL:
+      // Cut the clocks, or switch to low performance state after the wait
+      return DECISION_SWITCH;
+
+    default:
+      // Keep waiting for the switch
+      return DECISION_KEEP;
+  }
+}
+
+const char * decision_reason_name(int reason) {
+  // Name the reason as in the transition log and the metrics
+  switch (reason) {
+    case PSTATED_REASON_TEMPERATURE:
+      return "temperature";
+    case PSTATED_REASON_BUSY:
+      return "busy";
+    case PSTATED_REASON_WAIT:
+      return "wait";
+    case PSTATED_REASON_IDLE:
+      return "idle";
+    case PSTATED_REASON_HINT:
+      return "hint";
+    case PSTATED_REASON_MODEL:
+      return "model";
+    default:
+      return "none";
+  }
+}
+
+bool decision_skip_idle(pstated_context *core, unsigned int gpu, unsigned int iterationsBeforeSwitch, unsigned long trust) {
+  // Get the state and the idle iterations of the GPU
+  unsigned int pstate, iterations;
+
+  if (pstated_state(core, gpu, &pstate, &iterations) != PSTATED_OK) {
+    return false;
+  }
+
+  // Skip the trusted share of the wait before switching to low performance state
+  return pstated_adopt(core, gpu, pstate, iterations + iterationsBeforeSwitch * trust / 100) == PSTATED_OK;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include <pstated.h>
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Actions taken on a decision of the core
+typedef enum {
+  // Keep the GPU in its current state
+  DECISION_KEEP,
+
+  // Ramp the GPU up now
+  DECISION_RAMP,
+
+  // Queue the ramp for the ramp scheduler
+  DECISION_QUEUE,
+
+  // Switch the GPU to the decided state (temperature, idle, hint or model)
+  DECISION_SWITCH,
+} decisionAction;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+decisionAction decision_action(int reason, unsigned int current, unsigned int next, bool scheduled);
+const char * decision_reason_name(int reason);
+bool decision_skip_idle(pstated_context *core, unsigned int gpu, unsigned int iterationsBeforeSwitch, unsigned long trust);
@@ -0,0 +1,265 @@
+#include "events.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+  #include <pthread.h>
+  #include <unistd.h>
+#endif
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Events the listener registers for
+#define EVENTS_TYPES (nvmlEventTypeXidCriticalError | nvmlEventTypeClock | nvmlEventTypePState)
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+#ifdef __linux__
+  // Event set, the devices and whether they are registered in it
+  static nvmlEventSet_t eventSet;
+  static bool eventArmed;
+  static nvmlDevice_t eventDevices[EVENTS_MAX_GPUS];
+  static bool eventWatched[EVENTS_MAX_GPUS];
+  static unsigned int eventDeviceCount;
+
+  // Xids that quarantine a GPU
+  static unsigned long eventFaultXids[EVENTS_MAX_XIDS];
+  static size_t eventFaultXidCount;
+
+  // Listener thread and its run flag
+  static pthread_t eventThread;
+  static volatile bool eventRunning;
+
+  // Lock protecting the events shared with the main loop
+  static pthread_mutex_t eventLock = PTHREAD_MUTEX_INITIALIZER;
+
+  // Events received since they were last taken
+  static gpuEvents eventPending[EVENTS_MAX_GPUS];
+  static bool eventAny;
+#endif
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+#ifdef __linux__
+  static bool is_fault_xid(unsigned long long xid) {
+    // Look the Xid up in the list
+    for (size_t i = 0; i < eventFaultXidCount; i++) {
+      if (eventFaultXids[i] == xid) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  static unsigned int find_gpu(nvmlDevice_t device) {
+    // Look the device up, eventDeviceCount when it is unknown
+    unsigned int gpu = 0;
+
+    while (gpu < eventDeviceCount && eventDevices[gpu] != device) {
+      gpu++;
+    }
+
+    return gpu;
+  }
+
+  static void record_lost(unsigned int gpu) {
+    // Stop watching the GPU, it is left out when the event set is created again
+    eventWatched[gpu] = false;
+
+    // Report the GPU to the main loop, which quarantines it
+    pthread_mutex_lock(&eventLock);
+
+    eventPending[gpu].lost = true;
+    eventAny = true;
+
+    pthread_mutex_unlock(&eventLock);
+  }
+
+  static bool events_arm(void) {
+    // Create the event set
+    nvmlReturn_t result = nvmlEventSetCreate(&eventSet);
+    if (result != NVML_SUCCESS) {
+      fprintf(stderr, "nvmlEventSetCreate(): %s\n", nvmlErrorString(result));
+      return false;
+    }
+
+    eventArmed = true;
+
+    // Register the watched GPUs for the events they support
+    for (unsigned int i = 0; i < eventDeviceCount; i++) {
+      // Skip GPUs that are not watched
+      if (!eventWatched[i]) {
+        continue;
+      }
+
+      // Variable to hold the supported event types
+      unsigned long long types = 0;
+
+      result = nvmlDeviceGetSupportedEventTypes(eventDevices[i], &types);
+
+      if (result == NVML_SUCCESS && (types & EVENTS_TYPES) != 0) {
+        result = nvmlDeviceRegisterEvents(eventDevices[i], types & EVENTS_TYPES, eventSet);
+      }
+
+      // Report a GPU that is gone, and go on with the others
+      if (result == NVML_ERROR_GPU_IS_LOST) {
+        fprintf(stderr, "GPU %u is lost, no longer listening for its events\n", i);
+        record_lost(i);
+      } else if (result != NVML_SUCCESS) {
+        fprintf(stderr, "Warning: Failed to register events for GPU %u: %s\n", i, nvmlErrorString(result));
+      } else if ((types & EVENTS_TYPES) == 0) {
+        fprintf(stderr, "Warning: GPU %u doesn't support events\n", i);
+      }
+    }
+
+    // Return true to indicate success
+    return true;
+  }
+
+  static void events_disarm(void) {
+    // Free the event set if it was created
+    if (eventArmed) {
+      nvmlEventSetFree(eventSet);
+      eventArmed = false;
+    }
+  }
+
+  static void * events_main(void *argument) {
+    (void) argument;
+
+    // Wait for events until stopped
+    while (eventRunning) {
+      // Wait for the next event, the timeout lets the thread notice the stop request
+      nvmlEventData_t data = { 0 };
+      nvmlReturn_t result = nvmlEventSetWait_v2(eventSet, &data, EVENTS_WAIT_TIMEOUT);
+
+      if (result == NVML_ERROR_TIMEOUT) {
+        continue;
+      }
+
+      // Find the GPU of the event or the error
+      unsigned int gpu = find_gpu(data.device);
+
+      if (result != NVML_SUCCESS) {
+        // Report the GPU the error came from if the driver tells it
+        if (result == NVML_ERROR_GPU_IS_LOST && gpu < eventDeviceCount) {
+          record_lost(gpu);
+        }
+
+        fprintf(stderr, "nvmlEventSetWait_v2(): %s, re-arming the event listener\n", nvmlErrorString(result));
+
+        // Create the event set again after a pause, so that a persisting error doesn't spin, registering the GPUs
+        // again finds the lost ones the error didn't name
+        events_disarm();
+
+        do {
+          usleep(EVENTS_WAIT_TIMEOUT * 1000);
+        } while (eventRunning && !events_arm());
+
+        continue;
+      }
+
+      // Skip events of unknown GPUs
+      if (gpu == eventDeviceCount) {
+        continue;
+      }
+
+      // Record the event for the main loop
+      pthread_mutex_lock(&eventLock);
+
+      gpuEvents *events = &eventPending[gpu];
+
+      if (data.eventType == nvmlEventTypeXidCriticalError) {
+        events->xids++;
+        events->lastXid = data.eventData;
+        events->fault |= is_fault_xid(data.eventData);
+      } else {
+        events->changes++;
+      }
+
+      eventAny = true;
+
+      pthread_mutex_unlock(&eventLock);
+    }
+
+    return NULL;
+  }
+#endif
+
+bool events_start(const nvmlDevice_t *devices, const bool *watched, unsigned int count, const unsigned long *faultXids, size_t faultXidCount) {
+  #ifdef __linux__
+    // Store the configuration
+    eventDeviceCount = count < EVENTS_MAX_GPUS ? count : EVENTS_MAX_GPUS;
+    memcpy(eventDevices, devices, eventDeviceCount * sizeof(nvmlDevice_t));
+
+    eventFaultXidCount = faultXidCount < EVENTS_MAX_XIDS ? faultXidCount : EVENTS_MAX_XIDS;
+    memcpy(eventFaultXids, faultXids, eventFaultXidCount * sizeof(unsigned long));
+
+    // Watch the requested GPUs, lost ones are dropped later
+    memcpy(eventWatched, watched, eventDeviceCount * sizeof(bool));
+
+    // Create the event set and register the GPUs
+    if (!events_arm()) {
+      return false;
+    }
+
+    // Start the listener thread
+    eventRunning = true;
+
+    if (pthread_create(&eventThread, NULL, events_main, NULL) != 0) {
+      fprintf(stderr, "Unable to start the event listener\n");
+      eventRunning = false;
+      events_disarm();
+      return false;
+    }
+
+    // Return true to indicate success
+    return true;
+  #else
+    // Print an error message
+    fprintf(stderr, "Event listener is not supported on this platform\n");
+
+    (void) devices;
+    (void) watched;
+    (void) count;
+    (void) faultXids;
+    (void) faultXidCount;
+    return false;
+  #endif
+}
+
+void events_stop(void) {
+  #ifdef __linux__
+    // Stop the listener thread if it is running
+    if (eventRunning) {
+      eventRunning = false;
+      pthread_join(eventThread, NULL);
+      events_disarm();
+    }
+  #endif
+}
+
+bool events_take(gpuEvents events[EVENTS_MAX_GPUS]) {
+  #ifdef __linux__
+    // Move the pending events to the caller
+    pthread_mutex_lock(&eventLock);
+
+    bool any = eventAny;
+
+    if (any) {
+      memcpy(events, eventPending, sizeof(eventPending));
+      memset(eventPending, 0, sizeof(eventPending));
+      eventAny = false;
+    }
+
+    pthread_mutex_unlock(&eventLock);
+
+    // Return whether there were events
+    return any;
+  #else
+    (void) events;
+    return false;
+  #endif
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <nvml.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs watched for events
+#define EVENTS_MAX_GPUS 64
+
+// Maximum number of Xids that quarantine a GPU
+#define EVENTS_MAX_XIDS 32
+
+// Timeout (in milliseconds) of a single wait, bounding the time to stop the listener
+#define EVENTS_WAIT_TIMEOUT 500
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the events of a GPU received since they were last taken
+typedef struct {
+  // Number of Xid errors and the last Xid
+  unsigned long xids;
+  unsigned long long lastXid;
+
+  // Flag to indicate an Xid that quarantines the GPU
+  bool fault;
+
+  // Flag to indicate the GPU was lost (fallen off the bus), which also quarantines it
+  bool lost;
+
+  // Number of clock and performance state change events
+  unsigned long changes;
+} gpuEvents;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool events_start(const nvmlDevice_t *devices, const bool *watched, unsigned int count, const unsigned long *faultXids, size_t faultXidCount);
+void events_stop(void);
+bool events_take(gpuEvents events[EVENTS_MAX_GPUS]);
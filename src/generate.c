@@ -0,0 +1,213 @@
+/*
+ * Generator of synthetic workload traces for nvidia-pstated.
+ *
+ * The generator writes the utilization of a number of GPUs running a parameterized workload pattern (Poisson
+ * inference requests, diurnal inference, training with evaluation pauses or gang-scheduled jobs) as a sample log, the
+ * format recorded by the daemon with --sample-log, along with the temperature of a first-order thermal model and,
+ * optionally, the hints an application announcing its work would send. The same seed always gives the same trace.
+ *
+ * Usage: pstated-generate [options] -o <sample log>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "samples.h"
+#include "synth.h"
+#include "utils.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Number of GPUs
+#define GPUS 1
+
+// Length (in seconds) of the trace
+#define DURATION 3600
+
+// Interval (in milliseconds) between samples, the sleep interval of the daemon
+#define INTERVAL 100
+
+// Performance state written to the samples, the GPUs are left to the driver
+#define PERFORMANCE_STATE_AUTO 16
+
+// Number of processes written to the samples, the server or training process
+#define PROCESSES 1
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+int main(int argc, char * argv[]) {
+  // Variables to hold the options
+  const char * output = NULL;
+  synthPattern pattern = SYNTH_POISSON;
+  synthConfig config;
+  unsigned long gpus = GPUS;
+  unsigned long duration = DURATION;
+  unsigned long interval = INTERVAL;
+  unsigned long seed;
+  unsigned long rate;
+  unsigned long resistance;
+
+  // Find the pattern first, its defaults are overridden by the other options
+  for (int i = 1; i < argc; i++) {
+    // Check if the option is "-p" or "--pattern" and if there is a next argument
+    if ((IS_OPTION("-p") || IS_OPTION("--pattern")) && HAS_NEXT_ARG) {
+      ASSERT_TRUE(synth_parse_pattern(argv[++i], &pattern), usage);
+    }
+  }
+
+  synth_defaults(&config, pattern);
+
+  // Parse the options
+  for (int i = 1; i < argc; i++) {
+    if ((IS_OPTION("-p") || IS_OPTION("--pattern")) && HAS_NEXT_ARG) {
+      // Skip the pattern, it was parsed above
+      i++;
+    } else if ((IS_OPTION("-o") || IS_OPTION("--output")) && HAS_NEXT_ARG) {
+      // Store the path of the sample log
+      output = argv[++i];
+    } else if ((IS_OPTION("-g") || IS_OPTION("--gpus")) && HAS_NEXT_ARG) {
+      // Parse the number of GPUs
+      ASSERT_TRUE(parse_ulong(argv[++i], &gpus) && gpus > 0 && gpus <= SYNTH_MAX_GPUS, usage);
+    } else if ((IS_OPTION("-d") || IS_OPTION("--duration")) && HAS_NEXT_ARG) {
+      // Parse the length of the trace
+      ASSERT_TRUE(parse_ulong(argv[++i], &duration) && duration > 0, usage);
+    } else if ((IS_OPTION("-si") || IS_OPTION("--sleep-interval")) && HAS_NEXT_ARG) {
+      // Parse the interval between samples
+      ASSERT_TRUE(parse_ulong(argv[++i], &interval) && interval > 0, usage);
+    } else if ((IS_OPTION("-s") || IS_OPTION("--seed")) && HAS_NEXT_ARG) {
+      // Parse the seed
+      ASSERT_TRUE(parse_ulong(argv[++i], &seed), usage);
+      config.seed = seed;
+    } else if ((IS_OPTION("-r") || IS_OPTION("--rate")) && HAS_NEXT_ARG) {
+      // Parse the arrival rate
+      ASSERT_TRUE(parse_ulong(argv[++i], &rate), usage);
+      config.rate = rate;
+    } else if ((IS_OPTION("-sv") || IS_OPTION("--service")) && HAS_NEXT_ARG) {
+      // Parse the busy time of a request or job
+      ASSERT_TRUE(parse_ulong(argv[++i], &config.service), usage);
+    } else if ((IS_OPTION("-pd") || IS_OPTION("--period")) && HAS_NEXT_ARG) {
+      // Parse the period of the diurnal cycle or of the training pauses
+      ASSERT_TRUE(parse_ulong(argv[++i], &config.period) && config.period > 0, usage);
+    } else if ((IS_OPTION("-a") || IS_OPTION("--amplitude")) && HAS_NEXT_ARG) {
+      // Parse the swing of the diurnal rate
+      ASSERT_TRUE(parse_ulong(argv[++i], &config.amplitude) && config.amplitude <= 100, usage);
+    } else if ((IS_OPTION("-pp") || IS_OPTION("--pause")) && HAS_NEXT_ARG) {
+      // Parse the length of a training pause
+      ASSERT_TRUE(parse_ulong(argv[++i], &config.pause), usage);
+    } else if ((IS_OPTION("-sk") || IS_OPTION("--skew")) && HAS_NEXT_ARG) {
+      // Parse the skew between the GPUs of a gang
+      ASSERT_TRUE(parse_ulong(argv[++i], &config.skew), usage);
+    } else if ((IS_OPTION("-pi") || IS_OPTION("--power-idle")) && HAS_NEXT_ARG) {
+      // Parse the idle power
+      ASSERT_TRUE(parse_ulong(argv[++i], &config.powerIdle), usage);
+    } else if ((IS_OPTION("-pb") || IS_OPTION("--power-busy")) && HAS_NEXT_ARG) {
+      // Parse the busy power
+      ASSERT_TRUE(parse_ulong(argv[++i], &config.powerBusy), usage);
+    } else if ((IS_OPTION("-hl") || IS_OPTION("--hint-lead")) && HAS_NEXT_ARG) {
+      // Parse the time the work is announced ahead
+      ASSERT_TRUE(parse_ulong(argv[++i], &config.hintLead), usage);
+    } else if ((IS_OPTION("-am") || IS_OPTION("--ambient")) && HAS_NEXT_ARG) {
+      // Parse the ambient temperature
+      ASSERT_TRUE(parse_ulong(argv[++i], &config.ambient), usage);
+    } else if ((IS_OPTION("-tr") || IS_OPTION("--thermal-resistance")) && HAS_NEXT_ARG) {
+      // Parse the thermal resistance, given in millidegrees per watt
+      ASSERT_TRUE(parse_ulong(argv[++i], &resistance), usage);
+      config.resistance = resistance / 1000.0;
+    } else if ((IS_OPTION("-tc") || IS_OPTION("--thermal-time-constant")) && HAS_NEXT_ARG) {
+      // Parse the thermal time constant
+      ASSERT_TRUE(parse_ulong(argv[++i], &config.timeConstant), usage);
+    } else {
+      goto usage;
+    }
+  }
+
+  // The output path is required
+  ASSERT_TRUE(output != NULL, usage);
+
+  // Display usage instructions to the user
+  if (false) {
+    usage:
+
+    // Print the usage instructions
+    printf("Usage: %s [options] -o <sample log>\n", argv[0]);
+    printf("\n");
+    printf("Options:\n");
+    printf("  -o, --output <path>                       Write the trace to this file\n");
+    printf("  -p, --pattern <name>                      Set the pattern: poisson, diurnal, training or gang (default: %s)\n", synth_pattern_name(SYNTH_POISSON));
+    printf("  -g, --gpus <value>                        Set the number of GPUs, up to %u (default: %u)\n", SYNTH_MAX_GPUS, GPUS);
+    printf("  -d, --duration <value>                    Set the length of the trace in seconds (default: %u)\n", DURATION);
+    printf("  -si, --sleep-interval <value>             Set the interval between samples in milliseconds (default: %u)\n", INTERVAL);
+    printf("  -s, --seed <value>                        Set the seed, the same seed gives the same trace (default: 1)\n");
+    printf("  -r, --rate <value>                        Set the mean number of requests or jobs per hour (poisson, diurnal, gang)\n");
+    printf("  -sv, --service <value>                    Set the mean busy time of a request or job in milliseconds (poisson, diurnal, gang)\n");
+    printf("  -pd, --period <value>                     Set the length of the day or between two training pauses in milliseconds (diurnal, training)\n");
+    printf("  -a, --amplitude <value>                   Set the swing of the rate around its mean in percent (diurnal)\n");
+    printf("  -pp, --pause <value>                      Set the length of a training pause in milliseconds (training)\n");
+    printf("  -sk, --skew <value>                       Set the maximum skew between the GPUs in milliseconds (gang)\n");
+    printf("  -pi, --power-idle <value>                 Set the idle power in watts (default: 60)\n");
+    printf("  -pb, --power-busy <value>                 Set the busy power in watts (default: 250)\n");
+    printf("  -hl, --hint-lead <value>                  Announce each request or job this many milliseconds ahead with hints (default: 0, no hints)\n");
+    printf("  -am, --ambient <value>                    Set the ambient temperature in degrees C (default: 30)\n");
+    printf("  -tr, --thermal-resistance <value>         Set the heating in millidegrees C per watt of power draw (default: 180)\n");
+    printf("  -tc, --thermal-time-constant <value>      Set the time constant of the heating in milliseconds (default: 60000)\n");
+
+    // Exit the program
+    return EXIT_FAILURE;
+  }
+
+  // Set up the generator of each GPU
+  synthGpu * generators = calloc(gpus, sizeof(synthGpu));
+  unsigned long long * busySum = calloc(gpus, sizeof(unsigned long long));
+
+  if (generators == NULL || busySum == NULL || !samples_open(output)) {
+    free(generators);
+    free(busySum);
+    return EXIT_FAILURE;
+  }
+
+  for (unsigned int gpu = 0; gpu < gpus; gpu++) {
+    synth_gpu_init(&generators[gpu], &config, gpu);
+  }
+
+  // Write the samples of all GPUs, one interval after the other
+  unsigned long long samples = 0;
+
+  for (unsigned long long time = interval; time <= duration * 1000ull; time += interval) {
+    for (unsigned int gpu = 0; gpu < gpus; gpu++) {
+      unsigned int utilization = synth_gpu_sample(&generators[gpu], &config, time);
+      sampleRecord record = {
+        .time = time,
+        .gpu = gpu,
+        .utilization = utilization,
+        .power = synth_power(&config, utilization),
+        .processes = PROCESSES,
+        .pstateId = PERFORMANCE_STATE_AUTO,
+      };
+
+      // Add the hints of the application and the temperature the power draw leads to
+      synth_gpu_hints(&generators[gpu], &config, time, utilization, &record.demand, &record.idleHint);
+      record.temperature = synth_gpu_temperature(&generators[gpu], &config, time, record.power);
+
+      samples_write(&record);
+      busySum[gpu] += utilization;
+    }
+
+    samples++;
+  }
+
+  samples_close();
+
+  // Print the mean utilization of each GPU
+  printf("%s trace of %lu GPUs over %lu s written to %s (seed %llu)\n", synth_pattern_name(pattern), gpus, duration, output, (unsigned long long) config.seed);
+
+  for (unsigned int gpu = 0; gpu < gpus && samples > 0; gpu++) {
+    printf("GPU %u mean utilization: %.1f%%\n", gpu, (double) busySum[gpu] / samples);
+  }
+
+  // Release the generators
+  free(generators);
+  free(busySum);
+
+  return EXIT_SUCCESS;
+}
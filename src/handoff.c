@@ -0,0 +1,234 @@
+#include "handoff.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// First line of the handoff file
+#define HANDOFF_HEADER "nvidia-pstated-handoff"
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+int handoff_save(const handoffRecord *records, unsigned int count) {
+  #ifdef __linux__
+    // Create an anonymous file, removed once the last descriptor is closed
+    FILE *file = tmpfile();
+    if (file == NULL) {
+      fprintf(stderr, "Unable to create handoff file\n");
+      return -1;
+    }
+
+    // Write the header
+    fprintf(file, HANDOFF_HEADER " %u\n", HANDOFF_VERSION);
+
+    // Write one line per GPU
+    for (unsigned int i = 0; i < count; i++) {
+      const handoffRecord *record = &records[i];
+
+      fprintf(file, "%s %u %u %u %u %u %u %u %u %u %u %u %d\n",
+        record->uuid, record->pstateId, record->iterations,
+        record->usingClockControl, record->currentMemClock, record->currentGpuClock,
+        record->powerLimit, record->defaultPowerLimit,
+        record->fanControlled, record->fanCount, record->fanInitialSpeed, record->fanSpeed,
+        record->lockFd);
+    }
+
+    // Flush the file and check for write errors
+    if (fflush(file) != 0 || ferror(file)) {
+      fprintf(stderr, "Unable to write handoff file\n");
+      fclose(file);
+      return -1;
+    }
+
+    // Duplicate the descriptor so that it outlives the stream and is inherited across exec
+    int fd = dup(fileno(file));
+    fclose(file);
+
+    if (fd < 0) {
+      return -1;
+    }
+
+    // Rewind the file for the next process
+    lseek(fd, 0, SEEK_SET);
+
+    // Return the descriptor
+    return fd;
+  #else
+    // Print an error message
+    fprintf(stderr, "Upgrade handoff is not supported on this platform\n");
+
+    (void) records;
+    (void) count;
+    return -1;
+  #endif
+}
+
+unsigned int handoff_load(handoffRecord *records, unsigned int max) {
+  #ifdef __linux__
+    // Get the descriptor of the handoff file, if this process was started by an upgrade
+    const char *value = getenv(HANDOFF_ENV);
+    if (value == NULL) {
+      return 0;
+    }
+
+    // Parse the descriptor and drop the variable, so that it doesn't leak into child processes
+    int fd = atoi(value);
+    unsetenv(HANDOFF_ENV);
+
+    // Open the file, the stream takes ownership of the descriptor
+    FILE *file = fdopen(fd, "r");
+    if (file == NULL) {
+      fprintf(stderr, "Unable to open handoff file\n");
+      return 0;
+    }
+
+    // Check the header and the version
+    unsigned int version = 0;
+
+    if (fscanf(file, HANDOFF_HEADER " %u", &version) != 1 || version != HANDOFF_VERSION) {
+      fprintf(stderr, "Unsupported handoff file, GPUs will be reinitialized\n");
+      fclose(file);
+      return 0;
+    }
+
+    // Read one line per GPU
+    unsigned int count = 0;
+
+    while (count < max) {
+      handoffRecord *record = &records[count];
+
+      // Variables to hold the flags
+      unsigned int usingClockControl, fanControlled;
+
+      // Read the record
+      if (fscanf(file, "%95s %u %u %u %u %u %u %u %u %u %u %u %d",
+        record->uuid, &record->pstateId, &record->iterations,
+        &usingClockControl, &record->currentMemClock, &record->currentGpuClock,
+        &record->powerLimit, &record->defaultPowerLimit,
+        &fanControlled, &record->fanCount, &record->fanInitialSpeed, &record->fanSpeed,
+        &record->lockFd) != 13) {
+        break;
+      }
+
+      record->usingClockControl = usingClockControl != 0;
+      record->fanControlled = fanControlled != 0;
+
+      count++;
+    }
+
+    // Close the file
+    fclose(file);
+
+    // Return the number of records
+    return count;
+  #else
+    (void) records;
+    (void) max;
+    return 0;
+  #endif
+}
+
+handoffRecord * handoff_find(handoffRecord *records, unsigned int count, const char *uuid) {
+  // Look for the record of the GPU
+  for (unsigned int i = 0; i < count; i++) {
+    if (strcmp(records[i].uuid, uuid) == 0) {
+      return &records[i];
+    }
+  }
+
+  // The GPU was not handed over
+  return NULL;
+}
+
+void handoff_close_locks(handoffRecord *records, unsigned int count) {
+  #ifdef __linux__
+    // Close the ownership locks that were not adopted, so that the GPUs can be taken by another process
+    for (unsigned int i = 0; i < count; i++) {
+      if (records[i].lockFd >= 0) {
+        close(records[i].lockFd);
+        records[i].lockFd = -1;
+      }
+    }
+  #else
+    (void) records;
+    (void) count;
+  #endif
+}
+
+bool handoff_resolve_self(char *path, unsigned int size) {
+  #ifdef __linux__
+    // Resolve the path of the running binary, before it is replaced on disk
+    ssize_t length = readlink("/proc/self/exe", path, size - 1);
+    if (length <= 0) {
+      return false;
+    }
+
+    // Terminate the path
+    path[length] = '\0';
+
+    // Return true to indicate success
+    return true;
+  #else
+    (void) path;
+    (void) size;
+    return false;
+  #endif
+}
+
+bool handoff_check(const char *path) {
+  #ifdef __linux__
+    // Check that the new binary can be executed before committing to the handoff
+    if (access(path, X_OK) != 0) {
+      fprintf(stderr, "Unable to execute %s: %s\n", path, strerror(errno));
+      return false;
+    }
+
+    // Return true to indicate success
+    return true;
+  #else
+    (void) path;
+    return false;
+  #endif
+}
+
+bool handoff_exec(const char *path, char **argv, int fd) {
+  #ifdef __linux__
+    // Buffer to hold the descriptor as a string
+    char value[16];
+    snprintf(value, sizeof(value), "%d", fd);
+
+    // Pass the descriptor to the next process
+    setenv(HANDOFF_ENV, value, 1);
+
+    // Make sure the descriptor is inherited
+    fcntl(fd, F_SETFD, 0);
+
+    // Flush the output before the process image is replaced
+    fflush(stdout);
+    fflush(stderr);
+
+    // Replace the process with the new binary, this only returns on failure
+    execv(path, argv);
+
+    // Print an error message, and drop the handoff file since this process keeps the GPUs
+    perror("execv");
+    unsetenv(HANDOFF_ENV);
+    close(fd);
+
+    // Return false to indicate failure
+    return false;
+  #else
+    (void) path;
+    (void) argv;
+    (void) fd;
+    return false;
+  #endif
+}
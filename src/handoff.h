@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Environment variable holding the descriptor of the handoff file across exec
+#define HANDOFF_ENV "NVIDIA_PSTATED_HANDOFF_FD"
+
+// Version of the handoff format
+#define HANDOFF_VERSION 2
+
+// Maximum length of a GPU UUID
+#define HANDOFF_UUID_MAX 96
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the state of a GPU handed over to the next process
+typedef struct {
+  // UUID of the GPU, to match it independently of its index
+  char uuid[HANDOFF_UUID_MAX];
+
+  // Performance state and iteration counter
+  unsigned int pstateId;
+  unsigned int iterations;
+
+  // Clock control mode and the applied clocks (in MHz)
+  bool usingClockControl;
+  unsigned int currentMemClock;
+  unsigned int currentGpuClock;
+
+  // Current and default power limits (in milliwatts, 0 when not controlled)
+  unsigned int powerLimit;
+  unsigned int defaultPowerLimit;
+
+  // Fan control state
+  bool fanControlled;
+  unsigned int fanCount;
+  unsigned int fanInitialSpeed;
+  unsigned int fanSpeed;
+
+  // Descriptor of the ownership lock, kept open across exec (-1 when the GPU is not locked)
+  int lockFd;
+} handoffRecord;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+int handoff_save(const handoffRecord *records, unsigned int count);
+unsigned int handoff_load(handoffRecord *records, unsigned int max);
+handoffRecord * handoff_find(handoffRecord *records, unsigned int count, const char *uuid);
+void handoff_close_locks(handoffRecord *records, unsigned int count);
+bool handoff_resolve_self(char *path, unsigned int size);
+bool handoff_check(const char *path);
+bool handoff_exec(const char *path, char **argv, int fd);
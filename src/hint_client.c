@@ -0,0 +1,104 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pstated_hint.h"
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Socket used to send hints (opened on first use)
+static int hintSocket = -1;
+
+// Address of the daemon's hint socket
+static struct sockaddr_un hintAddress;
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static int hint_open(void) {
+  // The socket is already open
+  if (hintSocket >= 0) {
+    return 0;
+  }
+
+  // Get the socket path from the environment or use the default
+  const char *path = getenv("PSTATED_HINT_SOCKET");
+  if (path == NULL || path[0] == '\0') {
+    path = PSTATED_HINT_SOCKET_DEFAULT;
+  }
+
+  // Check if the path fits into the address
+  if (strlen(path) >= sizeof(hintAddress.sun_path)) {
+    return -1;
+  }
+
+  // Build the address of the daemon's socket
+  memset(&hintAddress, 0, sizeof(hintAddress));
+  hintAddress.sun_family = AF_UNIX;
+  strcpy(hintAddress.sun_path, path);
+
+  // Create a non-blocking datagram socket
+  int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  // Publish the socket, another thread may have opened one in the meantime
+  if (!__sync_bool_compare_and_swap(&hintSocket, -1, fd)) {
+    close(fd);
+  }
+
+  // Return 0 to indicate success
+  return 0;
+}
+
+static int hint_send(const char *message) {
+  // Open the socket on first use
+  if (hint_open() != 0) {
+    return -1;
+  }
+
+  // Send the message without blocking, the hint is dropped if it can't be delivered right now
+  if (sendto(hintSocket, message, strlen(message), MSG_DONTWAIT | MSG_NOSIGNAL, (struct sockaddr *) &hintAddress, sizeof(hintAddress)) < 0) {
+    return -1;
+  }
+
+  // Return 0 to indicate success
+  return 0;
+}
+
+static unsigned long long hint_time_ms(void) {
+  // Read the monotonic clock, which is shared with the daemon to measure the hint latency
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  // Convert the time to milliseconds
+  return (unsigned long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int pstated_hint_busy(unsigned int gpu, unsigned int duration) {
+  // Buffer to hold the message
+  char message[64];
+
+  // Format the message: "busy <gpu> <duration> <timestamp>"
+  snprintf(message, sizeof(message), "busy %u %u %llu", gpu, duration, hint_time_ms());
+
+  // Send the message
+  return hint_send(message);
+}
+
+int pstated_hint_idle(unsigned int gpu) {
+  // Buffer to hold the message
+  char message[64];
+
+  // Format the message: "idle <gpu> 0 <timestamp>"
+  snprintf(message, sizeof(message), "idle %u 0 %llu", gpu, hint_time_ms());
+
+  // Send the message
+  return hint_send(message);
+}
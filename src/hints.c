@@ -0,0 +1,157 @@
+#include "hints.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+  #include <grp.h>
+  #include <sys/socket.h>
+  #include <sys/stat.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+#ifdef __linux__
+  // Socket hints are received on
+  static int hintSocket = -1;
+
+  // Address the socket is bound to
+  static struct sockaddr_un hintAddress;
+#endif
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+bool hint_socket_open(const char *path, const char *group) {
+  #ifdef __linux__
+    // Check if the path fits into the address
+    if (strlen(path) >= sizeof(hintAddress.sun_path)) {
+      fprintf(stderr, "Hint socket path is too long: %s\n", path);
+      return false;
+    }
+
+    // Build the address of the socket
+    memset(&hintAddress, 0, sizeof(hintAddress));
+    hintAddress.sun_family = AF_UNIX;
+    strcpy(hintAddress.sun_path, path);
+
+    // Create a non-blocking datagram socket
+    hintSocket = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (hintSocket < 0) {
+      perror("socket()");
+      return false;
+    }
+
+    // Remove a stale socket left behind by a previous instance
+    unlink(path);
+
+    // Bind the socket to the path, created for the owner only so that no other user can send hints before the group is
+    // handed over below (the umask is process wide, this runs at startup before any other file is created)
+    mode_t mask = umask(0177);
+    int bound = bind(hintSocket, (struct sockaddr *) &hintAddress, sizeof(hintAddress));
+
+    umask(mask);
+
+    if (bound != 0) {
+      perror("bind()");
+      close(hintSocket);
+      hintSocket = -1;
+      return false;
+    }
+
+    // Hand the socket to the group allowed to send hints, a hint can pin GPUs in high performance state
+    if (group != NULL) {
+      // Look the group up
+      struct group *entry = getgrnam(group);
+
+      if (entry == NULL || chown(path, (uid_t) -1, entry->gr_gid) != 0) {
+        fprintf(stderr, "Unable to give the hint socket to group %s\n", group);
+        hint_socket_close();
+        return false;
+      }
+    }
+
+    // Allow the owner and the members of the group to send hints, not every local user
+    if (chmod(path, 0660) != 0) {
+      perror("chmod()");
+      hint_socket_close();
+      return false;
+    }
+
+    // Return true to indicate success
+    return true;
+  #else
+    // Print an error message
+    fprintf(stderr, "Hint socket is not supported on this platform\n");
+
+    // Return false to indicate failure
+    (void) path;
+    (void) group;
+    return false;
+  #endif
+}
+
+void hint_socket_close(void) {
+  #ifdef __linux__
+    // Close and remove the socket if it was opened
+    if (hintSocket >= 0) {
+      close(hintSocket);
+      unlink(hintAddress.sun_path);
+      hintSocket = -1;
+    }
+  #endif
+}
+
+bool hint_receive(hintMessage *message) {
+  #ifdef __linux__
+    // Buffer to hold the datagram
+    char buffer[128];
+
+    // Read datagrams until a valid one is found or the queue is empty
+    while (hintSocket >= 0) {
+      // Receive the next datagram without blocking
+      ssize_t length = recv(hintSocket, buffer, sizeof(buffer) - 1, MSG_DONTWAIT);
+
+      // The queue is empty
+      if (length < 0) {
+        return false;
+      }
+
+      // Terminate the string
+      buffer[length] = '\0';
+
+      // Return the hint if it is valid, skip it otherwise
+      if (hint_parse(buffer, message)) {
+        return true;
+      }
+    }
+  #else
+    (void) message;
+  #endif
+
+  // No hint available
+  return false;
+}
+
+bool hint_parse(const char *text, hintMessage *message) {
+  // Buffer to hold the hint type
+  char type[8];
+
+  // Parse the message: "<busy|idle> <gpu> <duration> <timestamp>"
+  if (sscanf(text, "%7s %u %lu %llu", type, &message->gpu, &message->duration, &message->timestamp) != 4) {
+    return false;
+  }
+
+  // Parse the hint type
+  if (strcmp(type, "busy") == 0) {
+    message->busy = true;
+  } else if (strcmp(type, "idle") == 0) {
+    message->busy = false;
+  } else {
+    return false;
+  }
+
+  // Return true to indicate success
+  return true;
+}
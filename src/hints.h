@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold a hint received from an application
+typedef struct {
+  // Flag to indicate a busy hint (otherwise an idle hint)
+  bool busy;
+
+  // GPU the hint is about
+  unsigned int gpu;
+
+  // Expected busy duration (in milliseconds)
+  unsigned long duration;
+
+  // Monotonic time (in milliseconds) the hint was sent at
+  unsigned long long timestamp;
+} hintMessage;
+
+// Structure to hold the hints of a GPU
+typedef struct {
+  // Time (in milliseconds) until which a busy hint keeps the GPU in high performance state
+  unsigned long long busyUntil;
+
+  // Flag to indicate an idle hint received since the GPU was last busy, it also shortens the wait of the policy model
+  bool idle;
+
+  // Flag to indicate a busy hint waiting to be acted on, and the time (in milliseconds) it was sent at
+  bool pending;
+  unsigned long long timestamp;
+
+  // Number of busy and idle hints received
+  unsigned long busyCount;
+  unsigned long idleCount;
+
+  // Hint-to-actuation latency (in milliseconds): sum, count and maximum
+  unsigned long long latencySum;
+  unsigned long latencyCount;
+  unsigned long long latencyMax;
+} hintState;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool hint_socket_open(const char *path, const char *group);
+void hint_socket_close(void);
+bool hint_receive(hintMessage *message);
+bool hint_parse(const char *text, hintMessage *message);
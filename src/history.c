@@ -0,0 +1,825 @@
+#include "history.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#endif
+
+#include "utils.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Magic number at the start of every block ("PSTH")
+#define HISTORY_MAGIC 0x48545350
+
+// Values are stored in hundredths, rounded to integers, so that the XOR of consecutive values has few meaningful bits
+#define HISTORY_SCALE 100
+
+// Maximum size (in bits) of a compressed point: timestamp, then control bits, leading zeros, length and payload of each field
+#define HISTORY_POINT_BITS_MAX (36 + HISTORY_FIELD_COUNT * 77)
+
+// Maximum size (in bytes) of a compressed block
+#define HISTORY_BLOCK_BYTES ((HISTORY_BLOCK_POINTS * HISTORY_POINT_BITS_MAX + 7) / 8)
+
+/***** ***** ***** ***** ***** TYPES ***** ***** ***** ***** *****/
+
+// Structure of the header written before every block
+typedef struct {
+  // Magic number to detect damaged files
+  uint32_t magic;
+
+  // Number of points in the block
+  uint32_t count;
+
+  // Time (in seconds) of the first and last point
+  uint64_t start;
+  uint64_t end;
+
+  // Size (in bytes) of the compressed payload
+  uint32_t bytes;
+  uint32_t reserved;
+} historyBlockHeader;
+
+// Structure to hold the state of a block being decompressed
+typedef struct {
+  // Compressed payload, its length and the read position (in bits)
+  const unsigned char *data;
+  size_t bits;
+  size_t position;
+
+  // Number of points decoded and in the block
+  unsigned int index;
+  unsigned int count;
+
+  // Previous timestamp and delta (in seconds)
+  unsigned long long time;
+  long long delta;
+
+  // Previous value and its leading and trailing zero bits, for each field
+  uint64_t values[HISTORY_FIELD_COUNT];
+  unsigned int leading[HISTORY_FIELD_COUNT];
+  unsigned int trailing[HISTORY_FIELD_COUNT];
+} historyDecoder;
+
+// Structure to hold the point averages collected by a query
+typedef struct {
+  // Growable array of the averages, for the percentile
+  double *values;
+  size_t capacity;
+
+  // Sum of the averages
+  double sum;
+} historyValues;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Bucket size (in seconds) of each tier
+static const unsigned long long tierSteps[HISTORY_TIER_COUNT] = { 1, 60, 3600 };
+
+// Retention (in seconds) of each tier
+static const unsigned long long tierRetention[HISTORY_TIER_COUNT] = { 7 * 86400ULL, 90 * 86400ULL, 3 * 365 * 86400ULL };
+
+// Time span (in seconds) of the segment files of each tier, expired points are dropped a whole segment at a time
+static const unsigned long long tierSegments[HISTORY_TIER_COUNT] = { 86400ULL, 10 * 86400ULL, 90 * 86400ULL };
+
+// Names of the tiers, also used in the file names
+static const char * tierNames[HISTORY_TIER_COUNT] = { "1s", "1m", "1h" };
+
+// Names of the metrics
+static const char * metricNames[HISTORY_METRIC_COUNT] = { "temperature", "utilization" };
+
+/***** ***** ***** ***** ***** BIT STREAMS ***** ***** ***** ***** *****/
+
+static void write_bits(historyBlock *block, uint64_t value, unsigned int count) {
+  // Write the bits from the most significant one, the payload is zeroed when the block is reset
+  for (unsigned int i = count; i > 0; i--) {
+    if ((value >> (i - 1)) & 1) {
+      block->data[block->bits >> 3] |= (unsigned char) (0x80 >> (block->bits & 7));
+    }
+
+    block->bits++;
+  }
+}
+
+static bool read_bits(historyDecoder *decoder, unsigned int count, uint64_t *value) {
+  // Check if the payload is too short
+  if (decoder->position + count > decoder->bits) {
+    return false;
+  }
+
+  // Read the bits from the most significant one
+  *value = 0;
+
+  for (unsigned int i = 0; i < count; i++) {
+    *value = (*value << 1) | ((decoder->data[decoder->position >> 3] >> (7 - (decoder->position & 7))) & 1);
+    decoder->position++;
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+static unsigned int leading_zeros(uint64_t value) {
+  // Count the zero bits above the highest set bit
+  unsigned int count = 0;
+
+  while (count < 64 && !(value & (1ULL << (63 - count)))) {
+    count++;
+  }
+
+  return count;
+}
+
+static unsigned int trailing_zeros(uint64_t value) {
+  // Count the zero bits below the lowest set bit
+  unsigned int count = 0;
+
+  while (count < 64 && !(value & (1ULL << count))) {
+    count++;
+  }
+
+  return count;
+}
+
+/***** ***** ***** ***** ***** COMPRESSION ***** ***** ***** ***** *****/
+
+static void block_reset(historyBlock *block) {
+  // Clear the payload and the point count
+  memset(block->data, 0, HISTORY_BLOCK_BYTES);
+  block->bits = 0;
+  block->count = 0;
+}
+
+static void block_append(historyBlock *block, unsigned long long time, long long step, const double fields[HISTORY_FIELD_COUNT]) {
+  // Convert the values to scaled integers stored as doubles
+  uint64_t values[HISTORY_FIELD_COUNT];
+
+  for (unsigned int f = 0; f < HISTORY_FIELD_COUNT; f++) {
+    double scaled = floor(fields[f] * HISTORY_SCALE + 0.5);
+    memcpy(&values[f], &scaled, sizeof(scaled));
+  }
+
+  // The first point only stores its values, its time is in the block header
+  if (block->count == 0) {
+    // Start the block
+    block->start = time;
+    block->delta = step;
+
+    // Store the values uncompressed
+    for (unsigned int f = 0; f < HISTORY_FIELD_COUNT; f++) {
+      write_bits(block, values[f], 64);
+      block->values[f] = values[f];
+      block->leading[f] = 64;
+      block->trailing[f] = 0;
+    }
+  } else {
+    // Compress the timestamp as the difference between consecutive deltas, which is 0 for a regular series
+    long long delta = (long long) (time - block->end);
+    long long deltaOfDelta = delta - block->delta;
+    block->delta = delta;
+
+    if (deltaOfDelta == 0) {
+      write_bits(block, 0, 1);
+    } else if (deltaOfDelta >= -64 && deltaOfDelta <= 63) {
+      write_bits(block, 0x2, 2);
+      write_bits(block, (uint64_t) deltaOfDelta & 0x7F, 7);
+    } else if (deltaOfDelta >= -256 && deltaOfDelta <= 255) {
+      write_bits(block, 0x6, 3);
+      write_bits(block, (uint64_t) deltaOfDelta & 0x1FF, 9);
+    } else if (deltaOfDelta >= -2048 && deltaOfDelta <= 2047) {
+      write_bits(block, 0xE, 4);
+      write_bits(block, (uint64_t) deltaOfDelta & 0xFFF, 12);
+    } else {
+      write_bits(block, 0xF, 4);
+      write_bits(block, (uint64_t) deltaOfDelta & 0xFFFFFFFF, 32);
+    }
+
+    // Compress each value as the XOR with its previous value
+    for (unsigned int f = 0; f < HISTORY_FIELD_COUNT; f++) {
+      // XOR with the previous value
+      uint64_t xor = values[f] ^ block->values[f];
+      block->values[f] = values[f];
+
+      // A repeated value takes a single bit
+      if (xor == 0) {
+        write_bits(block, 0, 1);
+        continue;
+      }
+
+      // Count the zero bits around the meaningful bits, the leading count has to fit into 5 bits
+      unsigned int leading = leading_zeros(xor);
+      unsigned int trailing = trailing_zeros(xor);
+
+      if (leading > 31) {
+        leading = 31;
+      }
+
+      if (leading >= block->leading[f] && trailing >= block->trailing[f]) {
+        // Reuse the window of meaningful bits of the previous value
+        write_bits(block, 0x2, 2);
+        write_bits(block, xor >> block->trailing[f], 64 - block->leading[f] - block->trailing[f]);
+      } else {
+        // Store a new window of meaningful bits
+        unsigned int length = 64 - leading - trailing;
+
+        write_bits(block, 0x3, 2);
+        write_bits(block, leading, 5);
+        write_bits(block, length - 1, 6);
+        write_bits(block, xor >> trailing, length);
+
+        // Remember the window
+        block->leading[f] = leading;
+        block->trailing[f] = trailing;
+      }
+    }
+  }
+
+  // Remember the time of the point
+  block->end = time;
+  block->count++;
+}
+
+static bool decoder_next(historyDecoder *decoder, unsigned long long *time, double fields[HISTORY_FIELD_COUNT]) {
+  // Check if all points were decoded
+  if (decoder->index >= decoder->count) {
+    return false;
+  }
+
+  // Variable to hold the bits being read
+  uint64_t bits;
+
+  if (decoder->index == 0) {
+    // Read the uncompressed values of the first point
+    for (unsigned int f = 0; f < HISTORY_FIELD_COUNT; f++) {
+      if (!read_bits(decoder, 64, &decoder->values[f])) {
+        return false;
+      }
+
+      decoder->leading[f] = 64;
+      decoder->trailing[f] = 0;
+    }
+  } else {
+    // Count the leading one bits of the timestamp control code (at most 4)
+    unsigned int ones = 0;
+
+    while (ones < 4) {
+      if (!read_bits(decoder, 1, &bits)) {
+        return false;
+      }
+
+      if (bits == 0) {
+        break;
+      }
+
+      ones++;
+    }
+
+    // Width of the difference between consecutive deltas for each control code
+    static const unsigned int widths[5] = { 0, 7, 9, 12, 32 };
+    long long deltaOfDelta = 0;
+
+    if (widths[ones] > 0) {
+      // Read the difference
+      if (!read_bits(decoder, widths[ones], &bits)) {
+        return false;
+      }
+
+      // Sign-extend the difference
+      deltaOfDelta = (long long) bits;
+
+      if (bits & (1ULL << (widths[ones] - 1))) {
+        deltaOfDelta -= (long long) (1ULL << widths[ones]);
+      }
+    }
+
+    // Rebuild the timestamp
+    decoder->delta += deltaOfDelta;
+    decoder->time += decoder->delta;
+
+    // Rebuild each value from its XOR with the previous value
+    for (unsigned int f = 0; f < HISTORY_FIELD_COUNT; f++) {
+      // A zero bit marks a repeated value
+      if (!read_bits(decoder, 1, &bits)) {
+        return false;
+      }
+
+      if (bits == 0) {
+        continue;
+      }
+
+      // A zero bit marks a reused window of meaningful bits
+      if (!read_bits(decoder, 1, &bits)) {
+        return false;
+      }
+
+      if (bits != 0) {
+        // Variables to hold the new window
+        uint64_t leading, length;
+
+        // Read the new window
+        if (!read_bits(decoder, 5, &leading) || !read_bits(decoder, 6, &length)) {
+          return false;
+        }
+
+        decoder->leading[f] = (unsigned int) leading;
+        decoder->trailing[f] = 64 - (unsigned int) leading - ((unsigned int) length + 1);
+      }
+
+      // Read the meaningful bits and apply them to the previous value
+      if (!read_bits(decoder, 64 - decoder->leading[f] - decoder->trailing[f], &bits)) {
+        return false;
+      }
+
+      decoder->values[f] ^= bits << decoder->trailing[f];
+    }
+  }
+
+  // Return the point
+  *time = decoder->time;
+
+  for (unsigned int f = 0; f < HISTORY_FIELD_COUNT; f++) {
+    double scaled;
+    memcpy(&scaled, &decoder->values[f], sizeof(scaled));
+    fields[f] = scaled / HISTORY_SCALE;
+  }
+
+  decoder->index++;
+
+  // Return true to indicate success
+  return true;
+}
+
+/***** ***** ***** ***** ***** FILES ***** ***** ***** ***** *****/
+
+static bool history_path(char *buffer, size_t size, const char *dir, unsigned int gpu, historyTier tier, unsigned long long segment) {
+  // Build the path of the segment file of a tier
+  return snprintf(buffer, size, "%s/gpu%u-%s-%llu.hist", dir, gpu, tierNames[tier], segment) < (int) size;
+}
+
+static void history_expire(historySeries *series, historyTier tier, unsigned long long time) {
+  // Nothing expired before the first retention
+  if (time <= tierRetention[tier]) {
+    return;
+  }
+
+  // Segments below this one only hold points older than the retention
+  unsigned long long last = (time - tierRetention[tier]) / tierSegments[tier];
+
+  // Number of segments looked for, enough to also catch the ones left behind by one retention of downtime
+  unsigned long long count = tierRetention[tier] / tierSegments[tier] + 1;
+
+  // Remove the expired segment files, missing ones are skipped
+  for (unsigned long long segment = last > count ? last - count : 0; segment < last; segment++) {
+    // Buffer to hold the path of the file
+    char path[HISTORY_PATH_MAX];
+
+    if (history_path(path, sizeof(path), series->dir, series->gpu, tier, segment)) {
+      remove(path);
+    }
+  }
+}
+
+static void block_flush(historySeries *series, historyTier tier) {
+  // Get the block of the tier
+  historyBlock *block = &series->blocks[tier];
+
+  // Nothing to write for an empty block
+  if (block->count == 0) {
+    return;
+  }
+
+  // Segment the block belongs to, after the time of its first point
+  unsigned long long segment = block->start / tierSegments[tier];
+
+  // Build the path of the file
+  char path[HISTORY_PATH_MAX];
+
+  if (!history_path(path, sizeof(path), series->dir, series->gpu, tier, segment)) {
+    block_reset(block);
+    return;
+  }
+
+  // Build the header of the block
+  historyBlockHeader header = {
+    .magic = HISTORY_MAGIC,
+    .count = block->count,
+    .start = block->start,
+    .end = block->end,
+    .bytes = (uint32_t) ((block->bits + 7) / 8),
+  };
+
+  // Append the block to the file
+  FILE *file = fopen(path, "ab");
+
+  if (file == NULL || fwrite(&header, sizeof(header), 1, file) != 1 || fwrite(block->data, 1, header.bytes, file) != header.bytes) {
+    fprintf(stderr, "Unable to write history file %s\n", path);
+  }
+
+  if (file != NULL) {
+    fclose(file);
+  }
+
+  // Drop the segments that fell out of the retention when a new segment starts, the files are never rewritten
+  if (segment != series->segments[tier]) {
+    series->segments[tier] = segment;
+    history_expire(series, tier, block->end);
+  }
+
+  // Start a new block
+  block_reset(block);
+}
+
+/***** ***** ***** ***** ***** AGGREGATION ***** ***** ***** ***** *****/
+
+static void tier_add(historySeries *series, historyTier tier, unsigned long long time, const double avg[], const double min[], const double max[], unsigned long count);
+
+static void tier_emit(historySeries *series, historyTier tier) {
+  // Get the bucket and the block of the tier
+  historyBucket *bucket = &series->buckets[tier];
+  historyBlock *block = &series->blocks[tier];
+
+  // Variables to hold the averages and the fields of the point
+  double avg[HISTORY_METRIC_COUNT];
+  double fields[HISTORY_FIELD_COUNT];
+
+  // Build the point from the bucket
+  for (unsigned int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+    avg[m] = bucket->sum[m] / bucket->count;
+
+    fields[m * 3 + 0] = avg[m];
+    fields[m * 3 + 1] = bucket->min[m];
+    fields[m * 3 + 2] = bucket->max[m];
+  }
+
+  // Compress the point
+  block_append(block, bucket->start, (long long) tierSteps[tier], fields);
+
+  // Write the block once it is full or spans long enough
+  if (block->count >= HISTORY_BLOCK_POINTS || block->end - block->start >= HISTORY_BLOCK_SPAN) {
+    block_flush(series, tier);
+  }
+
+  // Feed the point into the next tier
+  if (tier + 1 < HISTORY_TIER_COUNT) {
+    tier_add(series, tier + 1, bucket->start, avg, bucket->min, bucket->max, bucket->count);
+  }
+
+  // Empty the bucket
+  bucket->count = 0;
+}
+
+static void tier_add(historySeries *series, historyTier tier, unsigned long long time, const double avg[], const double min[], const double max[], unsigned long count) {
+  // Get the bucket of the tier
+  historyBucket *bucket = &series->buckets[tier];
+
+  // Start time of the bucket the sample belongs to
+  unsigned long long start = time - time % tierSteps[tier];
+
+  // Close the bucket once a later one starts (samples from a clock stepping back stay in the current bucket)
+  if (bucket->count > 0 && start > bucket->start) {
+    tier_emit(series, tier);
+  }
+
+  // Start a new bucket
+  if (bucket->count == 0) {
+    bucket->start = start;
+
+    for (unsigned int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+      bucket->sum[m] = 0;
+      bucket->min[m] = min[m];
+      bucket->max[m] = max[m];
+    }
+  }
+
+  // Aggregate the sample, weighted by the number of raw samples it stands for
+  for (unsigned int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+    bucket->sum[m] += avg[m] * count;
+
+    if (min[m] < bucket->min[m]) {
+      bucket->min[m] = min[m];
+    }
+
+    if (max[m] > bucket->max[m]) {
+      bucket->max[m] = max[m];
+    }
+  }
+
+  bucket->count += count;
+}
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+
+bool history_open(historySeries *series, const char *dir, unsigned int gpu) {
+  // Clear the series
+  memset(series, 0, sizeof(*series));
+
+  // Remember where the files are
+  series->dir = dir;
+  series->gpu = gpu;
+
+  // Current time, to check the segment files being written
+  unsigned long long now = (unsigned long long) time(NULL);
+
+  // Prepare each tier
+  for (unsigned int t = 0; t < HISTORY_TIER_COUNT; t++) {
+    // Buffer to hold the path of the file
+    char path[HISTORY_PATH_MAX];
+
+    // Build the path of the current segment file
+    if (!history_path(path, sizeof(path), dir, gpu, t, now / tierSegments[t])) {
+      history_close(series);
+      return false;
+    }
+
+    // Check if the file can be written
+    FILE *file = fopen(path, "ab");
+
+    if (file == NULL) {
+      fprintf(stderr, "Unable to open history file %s\n", path);
+      history_close(series);
+      return false;
+    }
+
+    fclose(file);
+
+    // Allocate the block payload
+    series->blocks[t].data = calloc(1, HISTORY_BLOCK_BYTES);
+
+    if (series->blocks[t].data == NULL) {
+      history_close(series);
+      return false;
+    }
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+void history_append(historySeries *series, unsigned long long time, const double values[HISTORY_METRIC_COUNT]) {
+  // Time the append
+  unsigned long long begin = get_time_ns();
+
+  // Aggregate the sample into the finest tier, which cascades into the coarser ones
+  tier_add(series, HISTORY_TIER_SECOND, time, values, values, values, 1);
+
+  // Account the duration of the append
+  series->appendTime += get_time_ns() - begin;
+  series->appends++;
+}
+
+void history_close(historySeries *series) {
+  // Emit the partial buckets from the finest tier, so that each one also reaches the coarser tiers
+  for (unsigned int t = 0; t < HISTORY_TIER_COUNT; t++) {
+    if (series->buckets[t].count > 0 && series->blocks[t].data != NULL) {
+      tier_emit(series, t);
+    }
+  }
+
+  // Write the partial blocks and free them
+  for (unsigned int t = 0; t < HISTORY_TIER_COUNT; t++) {
+    if (series->blocks[t].data != NULL) {
+      block_flush(series, t);
+      SAFE_FREE(series->blocks[t].data);
+    }
+  }
+
+  // Mark the series as closed
+  series->dir = NULL;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  // Compare two doubles for sorting
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+
+  return (x > y) - (x < y);
+}
+
+static bool query_segment(const char *path, historyTier tier, historyMetric metric, unsigned long long from, unsigned long long to, unsigned char *payload, historySummary *summary, historyValues *values) {
+  // Open the file for reading
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return false;
+  }
+
+  // Variable to hold a block header
+  historyBlockHeader header;
+
+  // Read the blocks, stopping at a damaged tail
+  while (fread(&header, sizeof(header), 1, file) == 1) {
+    // Check if the block is damaged
+    if (header.magic != HISTORY_MAGIC || header.bytes > HISTORY_BLOCK_BYTES || fread(payload, 1, header.bytes, file) != header.bytes) {
+      break;
+    }
+
+    // Skip blocks outside of the window
+    if (header.end < from || header.start > to) {
+      continue;
+    }
+
+    // Prepare the decoder
+    historyDecoder decoder = {
+      .data = payload,
+      .bits = (size_t) header.bytes * 8,
+      .count = header.count,
+      .time = header.start,
+      .delta = (long long) tierSteps[tier],
+    };
+
+    // Variables to hold a decoded point
+    unsigned long long time;
+    double fields[HISTORY_FIELD_COUNT];
+
+    // Decode the points
+    while (decoder_next(&decoder, &time, fields)) {
+      // Skip points outside of the window
+      if (time < from || time > to) {
+        continue;
+      }
+
+      // Grow the array if it is full
+      if (summary->points == values->capacity) {
+        size_t capacity = values->capacity > 0 ? values->capacity * 2 : 1024;
+
+        double *grown = realloc(values->values, capacity * sizeof(double));
+        if (grown == NULL) {
+          break;
+        }
+
+        values->values = grown;
+        values->capacity = capacity;
+      }
+
+      // Add the point to the statistics
+      double avg = fields[metric * 3 + 0];
+      double min = fields[metric * 3 + 1];
+      double max = fields[metric * 3 + 2];
+
+      if (summary->points == 0 || min < summary->min) {
+        summary->min = min;
+      }
+
+      if (summary->points == 0 || max > summary->max) {
+        summary->max = max;
+      }
+
+      values->sum += avg;
+      values->values[summary->points++] = avg;
+    }
+  }
+
+  // Close the file
+  fclose(file);
+
+  // Return true to indicate the segment exists
+  return true;
+}
+
+bool history_query(const char *dir, unsigned int gpu, historyMetric metric, unsigned long long from, unsigned long long to, historySummary *summary) {
+  // Clear the summary
+  memset(summary, 0, sizeof(*summary));
+
+  // Use the finest tier that still covers the window
+  summary->tier = history_tier_for_window(to - from);
+
+  // Buffer to hold a block payload
+  unsigned char *payload = malloc(HISTORY_BLOCK_BYTES);
+  if (payload == NULL) {
+    return false;
+  }
+
+  // Averages in the window
+  historyValues values = { 0 };
+
+  // Flag to indicate if any segment file exists
+  bool found = false;
+
+  // Read the segments overlapping the window, from the one before it since a block may cross into the next segment
+  unsigned long long first = from / tierSegments[summary->tier];
+  unsigned long long last = to / tierSegments[summary->tier];
+
+  for (unsigned long long segment = first > 0 ? first - 1 : 0; segment <= last; segment++) {
+    // Buffer to hold the path of the file
+    char path[HISTORY_PATH_MAX];
+
+    if (history_path(path, sizeof(path), dir, gpu, summary->tier, segment) && query_segment(path, summary->tier, metric, from, to, payload, summary, &values)) {
+      found = true;
+    }
+  }
+
+  // Compute the average and the 95th percentile (nearest rank) of the point averages
+  if (summary->points > 0) {
+    summary->avg = values.sum / summary->points;
+
+    qsort(values.values, summary->points, sizeof(double), compare_doubles);
+    summary->p95 = values.values[(size_t) ceil(0.95 * summary->points) - 1];
+  }
+
+  // Free the buffers
+  SAFE_FREE(values.values);
+  SAFE_FREE(payload);
+
+  // Return true if the GPU has a history
+  return found;
+}
+
+unsigned long long history_size(const char *dir, unsigned int gpu, historyTier tier, unsigned long long from, unsigned long long to) {
+  // Total size (in bytes) of the segment files
+  unsigned long long size = 0;
+
+  // Add up the segments overlapping the time range
+  for (unsigned long long segment = from / tierSegments[tier]; segment <= to / tierSegments[tier]; segment++) {
+    // Buffer to hold the path of the file
+    char path[HISTORY_PATH_MAX];
+
+    // Open the file for reading
+    FILE *file = history_path(path, sizeof(path), dir, gpu, tier, segment) ? fopen(path, "rb") : NULL;
+
+    if (file != NULL) {
+      fseek(file, 0, SEEK_END);
+      size += (unsigned long long) ftell(file);
+      fclose(file);
+    }
+  }
+
+  return size;
+}
+
+void history_remove(const char *dir, unsigned int gpu, unsigned long long from, unsigned long long to) {
+  // Remove the segment files of every tier overlapping the time range
+  for (unsigned int t = 0; t < HISTORY_TIER_COUNT; t++) {
+    for (unsigned long long segment = from / tierSegments[t]; segment <= to / tierSegments[t]; segment++) {
+      // Buffer to hold the path of the file
+      char path[HISTORY_PATH_MAX];
+
+      if (history_path(path, sizeof(path), dir, gpu, t, segment)) {
+        remove(path);
+      }
+    }
+  }
+}
+
+historyTier history_tier_for_window(unsigned long long window) {
+  // Find the finest tier whose retention covers the window
+  for (unsigned int t = 0; t < HISTORY_TIER_COUNT; t++) {
+    if (window <= tierRetention[t]) {
+      return t;
+    }
+  }
+
+  // Fall back to the coarsest tier
+  return HISTORY_TIER_HOUR;
+}
+
+const char * history_tier_name(historyTier tier) {
+  // Return the name of the tier
+  return tierNames[tier];
+}
+
+const char * history_metric_name(historyMetric metric) {
+  // Return the name of the metric
+  return metricNames[metric];
+}
+
+bool parse_history_metric(const char *name, historyMetric *metric) {
+  // Look for the metric by name
+  for (unsigned int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+    if (strcmp(name, metricNames[m]) == 0) {
+      *metric = m;
+      return true;
+    }
+  }
+
+  // Unknown metric
+  return false;
+}
+
+bool parse_history_window(const char *arg, unsigned long long *window) {
+  // Parse the number
+  char *end;
+  unsigned long long value = strtoull(arg, &end, 10);
+
+  // Check if the number is missing
+  if (end == arg || value == 0) {
+    return false;
+  }
+
+  // Apply the unit (seconds by default)
+  switch (*end) {
+    case '\0': case 's': *window = value; break;
+    case 'm': *window = value * 60; break;
+    case 'h': *window = value * 3600; break;
+    case 'd': *window = value * 86400; break;
+    case 'w': *window = value * 604800; break;
+    default: return false;
+  }
+
+  // Check for trailing characters after the unit
+  return *end == '\0' || end[1] == '\0';
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of points in a compressed block
+#define HISTORY_BLOCK_POINTS 600
+
+// Maximum time span (in seconds) of a block, so that readers see recent data
+#define HISTORY_BLOCK_SPAN 600
+
+// Maximum length of a history file path
+#define HISTORY_PATH_MAX 4096
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Recorded metrics
+typedef enum {
+  HISTORY_TEMPERATURE,
+  HISTORY_UTILIZATION,
+  HISTORY_METRIC_COUNT
+} historyMetric;
+
+// Downsampling tiers
+typedef enum {
+  HISTORY_TIER_SECOND,
+  HISTORY_TIER_MINUTE,
+  HISTORY_TIER_HOUR,
+  HISTORY_TIER_COUNT
+} historyTier;
+
+// Number of values stored per point: average, minimum and maximum of each metric
+#define HISTORY_FIELD_COUNT (HISTORY_METRIC_COUNT * 3)
+
+// Structure to hold the samples aggregated into the current bucket of a tier
+typedef struct {
+  // Start time (in seconds) of the bucket
+  unsigned long long start;
+
+  // Number of raw samples in the bucket
+  unsigned long count;
+
+  // Sum, minimum and maximum of each metric
+  double sum[HISTORY_METRIC_COUNT];
+  double min[HISTORY_METRIC_COUNT];
+  double max[HISTORY_METRIC_COUNT];
+} historyBucket;
+
+// Structure to hold a block being compressed
+typedef struct {
+  // Compressed payload and its length in bits
+  unsigned char *data;
+  size_t bits;
+
+  // Number of points and time (in seconds) of the first and last point
+  unsigned int count;
+  unsigned long long start;
+  unsigned long long end;
+
+  // Previous timestamp delta (in seconds)
+  long long delta;
+
+  // Previous value and its leading and trailing zero bits, for each field
+  uint64_t values[HISTORY_FIELD_COUNT];
+  unsigned int leading[HISTORY_FIELD_COUNT];
+  unsigned int trailing[HISTORY_FIELD_COUNT];
+} historyBlock;
+
+// Structure to hold the history of a GPU
+typedef struct {
+  // Directory of the files and index of the GPU
+  const char *dir;
+  unsigned int gpu;
+
+  // Current bucket and block of each tier
+  historyBucket buckets[HISTORY_TIER_COUNT];
+  historyBlock blocks[HISTORY_TIER_COUNT];
+
+  // Segment last written by each tier, expired segments are removed when the next one starts
+  unsigned long long segments[HISTORY_TIER_COUNT];
+
+  // Number of appends and their total duration (in nanoseconds)
+  unsigned long long appends;
+  unsigned long long appendTime;
+} historySeries;
+
+// Structure to hold the result of a query
+typedef struct {
+  // Tier the result was computed from
+  historyTier tier;
+
+  // Number of points in the window
+  unsigned long points;
+
+  // Statistics of the metric over the window
+  double min;
+  double max;
+  double avg;
+  double p95;
+} historySummary;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool history_open(historySeries *series, const char *dir, unsigned int gpu);
+void history_append(historySeries *series, unsigned long long time, const double values[HISTORY_METRIC_COUNT]);
+void history_close(historySeries *series);
+bool history_query(const char *dir, unsigned int gpu, historyMetric metric, unsigned long long from, unsigned long long to, historySummary *summary);
+unsigned long long history_size(const char *dir, unsigned int gpu, historyTier tier, unsigned long long from, unsigned long long to);
+void history_remove(const char *dir, unsigned int gpu, unsigned long long from, unsigned long long to);
+historyTier history_tier_for_window(unsigned long long window);
+const char * history_tier_name(historyTier tier);
+const char * history_metric_name(historyMetric metric);
+bool parse_history_metric(const char *name, historyMetric *metric);
+bool parse_history_window(const char *arg, unsigned long long *window);
@@ -3,6 +3,8 @@
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #ifdef _WIN32
   #include <windows.h>
@@ -11,7 +13,31 @@
 #endif
 
 #include "nvapi.h"
+#include "calibration.h"
+#include "classify.h"
+#include "coupling.h"
+#include "dcgm.h"
+#include "decision.h"
+#include "events.h"
+#include "handoff.h"
+#include "hints.h"
+#include "history.h"
+#include "metrics.h"
+#include "model.h"
 #include "nvml.h"
+#include "ownership.h"
+#include "params.h"
+#include "peers.h"
+#include "procs.h"
+#include "pstated.h"
+#include "queue.h"
+#include "ramp.h"
+#include "samples.h"
+#include "schedule.h"
+#include "stats.h"
+#include "subscribe.h"
+#include "thermal.h"
+#include "trace.h"
 #include "utils.h"
 
 /***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
@@ -40,14 +66,159 @@
 // Flag to enable clock control fallback mode
 #define ENABLE_CLOCK_FALLBACK true
 
+// Percentage of GPUs assigned to the canary arm by UUID hash
+#define CANARY_PERCENT 0
+
+// Interval (in seconds) between arm reports (0 means only on exit)
+#define REPORT_INTERVAL 0
+
+// Number of arms (control and canary)
+#define ARM_COUNT 2
+
+// Flag to enable automatic workload classification
+#define AUTO_CLASSIFY false
+
+// Interval (in seconds) between metrics file updates
+#define METRICS_INTERVAL 10
+
+// Flag to enable the predictive thermal model
+#define THERMAL_PREDICT false
+
+// Forecast horizon (in seconds) of the predictive thermal model
+#define THERMAL_PREDICT_HORIZON 30
+
+// Margin (in degrees C) below the temperature threshold the predictive thermal model aims for
+#define THERMAL_PREDICT_MARGIN 2
+
+// Maximum power limit change per model step (in percent of the default power limit)
+#define THERMAL_PREDICT_STEP 5
+
+// Flag to enable node-level coordination of thermal reductions
+#define THERMAL_COORDINATE false
+
+// Flag to enable fan control before cutting clocks
+#define FAN_CONTROL false
+
+// Maximum fan speed (in percent) the daemon may set
+#define FAN_SPEED_MAX 100
+
+// Fan speed change (in percent) per step
+#define FAN_SPEED_STEP 10
+
+// Interval (in milliseconds) between fan speed changes, to let the temperature settle
+#define FAN_STEP_INTERVAL 2000
+
+// Temperature (in degrees C) above the threshold at which clocks are cut even if the fans could go faster
+#define FAN_TOLERANCE 3
+
+// Temperature (in degrees C) below the threshold at which the fans are slowed down again
+#define FAN_HYSTERESIS 5
+
+// Flag to enable per-process accounting
+#define PROCESS_TRACKING false
+
+// Interval (in milliseconds) between process list polls
+#define PROCESS_TRACKING_INTERVAL 1000
+
+// Flag to enable pre-ramps on the host-CPU activity of the processes on a GPU
+#define CPU_PREDICT false
+
+// Interval (in milliseconds) between CPU time reads of the processes on a GPU
+#define CPU_PREDICT_INTERVAL 200
+
+// CPU load (in percent of a core) at which the processes on a GPU count as busy
+#define CPU_PREDICT_THRESHOLD 50
+
+// CPU load (in percent of a core) below which the processes on a GPU count as idle
+#define CPU_PREDICT_IDLE 10
+
+// Time (in milliseconds) a GPU is kept in high performance state after its processes got busy on the CPU
+#define CPU_PREDICT_HOLD 2000
+
+// Trust (in percent) placed in application hints
+#define HINT_TRUST 100
+
+// Job ID shared by the daemons of a peer group
+#define PEER_JOB PEERS_JOB_DEFAULT
+
+// Time (in milliseconds) a GPU is kept in high performance state after a peer of the same job ramped
+#define PEER_HOLD 2000
+
+// Interval (in milliseconds) between queue-depth scrapes
+#define QUEUE_INTERVAL 250
+
+// Number of days covered by the schedule dry run
+#define SCHEDULE_DRY_RUN_DAYS 7
+
+// Number of days of samples simulated by the history benchmark
+#define HISTORY_BENCHMARK_DAYS 7
+
+// Activity signal read from DCGM instead of the GPU utilization
+#define DCGM_ACTIVITY DCGM_ACTIVITY_SM
+
+// Flag to enable the per-GPU ownership lock
+#define OWNERSHIP_LOCK false
+
+// Interval (in milliseconds) between attempts to take over a GPU owned by another process
+#define OWNERSHIP_BACKOFF 60000
+
+// Action taken when another process changes the state of a GPU
+#define FOREIGN_WRITE_POLICY FOREIGN_WRITES_IGNORE
+
+// Interval (in milliseconds) between read-backs of the applied state
+#define FOREIGN_WRITE_CHECK_INTERVAL 1000
+
+// Time (in milliseconds) after a write before the state is read back, to let the GPU settle
+#define FOREIGN_WRITE_SETTLE 2000
+
+// Number of consecutive mismatching read-backs that confirm a foreign write
+#define FOREIGN_WRITE_CONFIRMATIONS 2
+
+// Interval (in milliseconds) between read-backs of the applied state when change events trigger them
+#define FOREIGN_WRITE_EVENT_CHECK_INTERVAL 10000
+
+// Flag to enable the event listener
+#define EVENTS false
+
+// Flag to enable the verification of transitions by read-back
+#define VERIFY_TRANSITIONS false
+
+// Time (in milliseconds) a transition has to show in the read-back, doubled after each retry
+#define VERIFY_DEADLINE 500
+
+// Number of times a transition that didn't show is written again
+#define VERIFY_RETRIES 2
+
+// Number of consecutive failed transitions after which the GPU is switched to clock control (0 means never)
+#define VERIFY_ESCALATE 3
+
+// Length (in seconds) of the window covered by the trace file
+#define TRACE_WINDOW 300
+
+// Idle power (in watts) above the lowest calibrated one within which the point that returns to high fastest is preferred
+#define CALIBRATION_POWER_TOLERANCE 1.0
+
+// Utilization (in percent) above which a GPU is too busy to be calibrated
+#define CALIBRATE_IDLE_THRESHOLD 5
+
+// Interval (in milliseconds) between read-backs while calibrating
+#define CALIBRATE_POLL_INTERVAL 10
+
+// Maximum time (in milliseconds) a point may take to show in the read-back while calibrating
+#define CALIBRATE_TIMEOUT 5000
+
+// Time (in milliseconds) the power draw is averaged over at each point, and interval between its samples
+#define CALIBRATE_POWER_WINDOW 2000
+#define CALIBRATE_POWER_INTERVAL 100
+
+// Xids that quarantine a GPU (double-bit ECC, row remapping, NVLink, fallen off the bus, uncontained ECC, GSP)
+#define EVENTS_FAULT_XIDS "48,63,64,74,79,92,94,95,119,120"
+
 /***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
 
 // Structure to hold the state of each GPU
 typedef struct {
-  // Counter for iterations when in a specific state
-  unsigned int iterations;
-
-  // Current performance state of the GPU
+  // Current performance state of the GPU, the core counts the idle iterations in it
   unsigned int pstateId;
 
   // GPU management state
@@ -63,6 +234,132 @@ typedef struct {
   // Current clock frequencies
   unsigned int currentMemClock;
   unsigned int currentGpuClock;
+
+  // Policy parameters applied to this GPU
+  gpuParams params;
+
+  // Policy parameters of the arm, before the workload class profile is applied
+  gpuParams baseParams;
+
+  // Workload classification state
+  workloadClassifier classifier;
+
+  // Last observed temperature (in degrees C)
+  unsigned int temperature;
+
+  // Predictive thermal model
+  thermalModel thermal;
+
+  // Flag to indicate if the power limit can be controlled
+  bool powerLimitSupported;
+
+  // Default, minimum and current power limits (in milliwatts)
+  unsigned int defaultPowerLimit;
+  unsigned int minPowerLimit;
+  unsigned int powerLimit;
+
+  // Number of early power limit reductions made by the predictive thermal model
+  unsigned long thermalInterventions;
+
+  // Fan control
+  fanState fans;
+
+  // Number of thermal decisions handled by cutting clocks or power
+  unsigned long clockDecisions;
+
+  // Flag to indicate if the thermal model observed the GPU in the current iteration
+  bool thermalObserved;
+
+  // Power draw (in watts) and unexplained heating (in degrees C) of the last thermal model step
+  double thermalPower;
+  double thermalResidual;
+
+  // Power reduction (in watts) requested by the node-level controller for this GPU's own and its neighbors' heat
+  double ownReduction;
+  double sharedReduction;
+
+  // Arm this GPU belongs to (0 is control, 1 is canary)
+  unsigned int arm;
+
+  // UUID of the GPU
+  char uuid[NVML_DEVICE_UUID_V2_BUFFER_SIZE];
+
+  // Flag to indicate if the state of the GPU was adopted from the previous process after an upgrade
+  bool adopted;
+
+  // Flag to indicate if the daemon owns the GPU, and the lock that keeps other processes away
+  bool owned;
+  ownershipLock lock;
+
+  // Time (in milliseconds) of the last write, of the last read-back and of the last loss of ownership
+  unsigned long long lastWrite;
+  unsigned long long lastReadBack;
+  unsigned long long lastYield;
+
+  // Number of consecutive read-backs that didn't match the applied state
+  unsigned int mismatches;
+
+  // Flag to indicate a change event asking for a read-back of the applied state
+  bool readBackDue;
+
+  // Flag to indicate a GPU left alone after a fault
+  bool quarantined;
+
+  // Number of Xid errors and the last Xid, and number of clock and performance state change events
+  unsigned long xidEvents;
+  unsigned long long lastXid;
+  unsigned long changeEvents;
+
+  // Flag to indicate a transition waiting to show in the read-back, and the number of times it was written again
+  bool verifyPending;
+  unsigned int verifyRetries;
+
+  // Number of consecutive transitions that didn't show after all retries
+  unsigned int verifySilent;
+
+  // Number of transitions verified and read-backs past the deadline, and of switches to clock control
+  unsigned long verified;
+  unsigned long verifyFailures;
+  unsigned long verifyEscalations;
+
+  // Number of foreign writes detected, and of takeovers, yields and reasserts
+  unsigned long foreignWrites;
+  unsigned long takeovers;
+  unsigned long yields;
+  unsigned long reasserts;
+
+  // Accumulated metrics of this GPU
+  gpuStats stats;
+
+  // Processes running on this GPU
+  processTable processes;
+
+  // Host-CPU activity of the processes on the GPU
+  processCpu cpu;
+
+  // Hints of applications, the queue of the inference server and the ramps of peers, which announce work
+  hintState hints;
+  queueState queue;
+  peerState peers;
+
+  // Ramps of the GPU through the ramp scheduler
+  rampState ramp;
+
+  // Number of iterations that took the activity from DCGM
+  unsigned long dcgmSamples;
+
+  // Calibration of the GPU model
+  calibration calibration;
+
+  // Latest GPU utilization (in percent) and the recorded history
+  unsigned int utilization;
+  historySeries history;
+
+  // Evaluations of the policy model
+  modelUsage model;
+
+  // Time (in milliseconds) of the previous sample
+  unsigned long long lastSampleTime;
 } gpuState;
 
 /***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
@@ -73,29 +370,73 @@ static volatile sig_atomic_t shouldRun = true;
 // Flag indicating whether an error has occurred
 static bool errorOccurred = false;
 
-// Flags to check initialization status of NVML and NVAPI libraries
-static bool nvapiInitialized = false;
-static bool nvmlInitialized = false;
+// Core that initialized NVML and NVAPI and paired their handles
+static pstated_context * core;
 
-// Variables to store device handles for all GPUs
-static NvPhysicalGpuHandle nvapiDevices[NVAPI_MAX_PHYSICAL_GPUS];
+// Variable to store NVML device handles for all GPUs
 static nvmlDevice_t nvmlDevices[NVAPI_MAX_PHYSICAL_GPUS];
 
 // Variable to store the number of GPU devices
 static unsigned int deviceCount;
 
-// Variable to store GPU temperature
-static unsigned int temperature;
-
-// Variable to store GPU utilization information
-static nvmlUtilization_t utilization;
-
 // Variable to store GPU states
 static gpuState gpuStates[NVAPI_MAX_PHYSICAL_GPUS];
 
 // Flag to track if fallback to clock control is enabled
 static bool enableClockFallback = ENABLE_CLOCK_FALLBACK;
 
+// Version of the installed driver
+static char driverVersion[NVML_SYSTEM_DRIVER_VERSION_BUFFER_SIZE] = "unknown";
+
+// Thermal coupling between GPUs
+static thermalCoupling coupling;
+
+// Number of node-level thermal steps that reduced a GPU on behalf of another
+static unsigned long thermalCoordinatedSteps;
+
+// File to append per-process summary records to
+static FILE * processLog;
+
+// Decision tree deciding when idle GPUs switch to the low performance state (no nodes when not loaded)
+static model policyModel;
+
+// Names of the arms
+static const char * armNames[ARM_COUNT] = { "control", "canary" };
+
+// Parameter overrides applied for each workload class
+static const char * classProfiles[WORKLOAD_CLASS_COUNT] = {
+  [WORKLOAD_IDLE] = CLASSIFY_PROFILE_IDLE,
+  [WORKLOAD_STEADY] = CLASSIFY_PROFILE_STEADY,
+  [WORKLOAD_BURSTY] = CLASSIFY_PROFILE_BURSTY,
+  [WORKLOAD_INTERACTIVE] = CLASSIFY_PROFILE_INTERACTIVE,
+};
+
+// Parameter overrides of the canary arm, applied over the schedule and workload class profiles
+static const char * canaryOverrides;
+
+// Cron-like rules selecting parameter profiles by time of day
+static scheduleRule scheduleRules[SCHEDULE_MAX_RULES];
+static unsigned int scheduleRuleCount;
+
+// Index of the active schedule rule (-1 when no rule matches)
+static int scheduleActive = -1;
+
+// Flag indicating whether the program should hand its GPUs over to a new binary
+static volatile sig_atomic_t upgradeRequested = false;
+
+// Path of the running binary, executed again on upgrade
+static char selfPath[4096];
+
+// State of the GPUs handed over by the previous process, or to the next one
+static handoffRecord handoffRecords[NVAPI_MAX_PHYSICAL_GPUS];
+static unsigned int handoffCount;
+
+// Descriptor of the handoff file passed to the new binary (-1 when not upgrading)
+static int handoffFd = -1;
+
+// Flag indicating whether the trace file should be written
+static volatile sig_atomic_t traceRequested = false;
+
 /***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
 
 static void handle_exit(int signal) {
@@ -106,6 +447,19 @@ static void handle_exit(int signal) {
   }
 }
 
+static void handle_upgrade(int signal) {
+  // Stop the main loop and hand the GPUs over to the new binary
+  (void) signal;
+  upgradeRequested = true;
+  shouldRun = false;
+}
+
+static void handle_trace(int signal) {
+  // Write the trace file in the next iteration of the main loop
+  (void) signal;
+  traceRequested = true;
+}
+
 static bool get_supported_clocks(unsigned int i) {
   // Get the current state of the GPU
   gpuState * state = &gpuStates[i];
@@ -179,19 +533,22 @@ static bool get_supported_clocks(unsigned int i) {
   return true;
 }
 
-static bool set_clocks(unsigned int i, bool highPerformance, unsigned long memFreqHigh, unsigned long gpuFreqHigh, unsigned long memFreqLow, unsigned long gpuFreqLow) {
+static bool set_clocks(unsigned int i, bool highPerformance) {
   // Get the current state of the GPU
   gpuState * state = &gpuStates[i];
   
-  // If GPU is unmanaged, we don't need to set clocks
-  if (!state->managed) {
+  // If GPU is unmanaged or owned by another process, we don't need to set clocks
+  if (!state->managed || !state->owned) {
     return true;
   }
   
+  // Get the policy parameters of the GPU
+  gpuParams * params = &state->params;
+
   unsigned int memClock, gpuClock;
   if (highPerformance) {
     // For high performance, if 0 is specified, reset to auto by calling reset
-    if (memFreqHigh == 0 && gpuFreqHigh == 0) {
+    if (params->clockFreqMemHigh == 0 && params->clockFreqGpuHigh == 0) {
       nvmlReturn_t result = nvmlDeviceResetApplicationsClocks(nvmlDevices[i]);
       if (result != NVML_SUCCESS) {
         fprintf(stderr, "Unable to reset clocks for GPU %u: %s\n", 
@@ -207,13 +564,13 @@ static bool set_clocks(unsigned int i, bool highPerformance, unsigned long memFr
       return true;
     } else {
       // Use specified high performance clocks
-      memClock = memFreqHigh;
-      gpuClock = gpuFreqHigh;
+      memClock = params->clockFreqMemHigh;
+      gpuClock = params->clockFreqGpuHigh;
     }
   } else {
     // Use low performance clocks or the lowest available
-    memClock = memFreqLow > 0 ? memFreqLow : state->minMemClock;
-    gpuClock = gpuFreqLow > 0 ? gpuFreqLow : state->minGpuClock;
+    memClock = params->clockFreqMemLow > 0 ? params->clockFreqMemLow : state->minMemClock;
+    gpuClock = params->clockFreqGpuLow > 0 ? params->clockFreqGpuLow : state->minGpuClock;
   }
   
   // Set memory and GPU clocks
@@ -232,12 +589,65 @@ static bool set_clocks(unsigned int i, bool highPerformance, unsigned long memFr
   return true;
 }
 
-static bool enter_pstate(unsigned int i, unsigned int pstateId, unsigned long memFreqHigh, unsigned long gpuFreqHigh, unsigned long memFreqLow, unsigned long gpuFreqLow) {
+static unsigned long long get_epoch_ms(void) {
+  // Get the wall-clock time in milliseconds since the Unix epoch
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+
+  return (unsigned long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void publish_event(unsigned int i, const char * event, const char * fields) {
+  // Nothing to do without subscribers
+  if (!subscribe_active()) {
+    return;
+  }
+
+  // Build the event as one JSON line, stamped with the wall-clock time so that consumers can line it up with their logs
+  char line[512];
+
+  snprintf(line, sizeof(line), "{\"event\":\"%s\",\"gpu\":%u,\"uuid\":\"%s\",\"time\":%llu%s%s}\n",
+    event, i, gpuStates[i].uuid, get_epoch_ms(), fields[0] != '\0' ? "," : "", fields);
+
+  // Queue the event for every subscriber
+  subscribe_publish(line);
+}
+
+static void publish_transition(unsigned int i, const char * reason) {
+  // Publish the new performance state and the reason of the change
+  char fields[128];
+
+  snprintf(fields, sizeof(fields), "\"pstate\":%u,\"reason\":\"%s\"", gpuStates[i].pstateId, reason);
+  publish_event(i, "transition", fields);
+}
+
+static bool apply_pstate(unsigned int i, unsigned int pstateId) {
+  // Force the performance state through the core
+  int status = pstated_apply(core, i, pstateId);
+
+  if (status == PSTATED_OK) {
+    return true;
+  }
+
+  // Print the failed NVAPI call, the core doesn't print
+  const char * call;
+  const char * message;
+
+  if (status == PSTATED_ERROR_NVAPI && pstated_last_error(core, i, &call, &message) == PSTATED_OK) {
+    fprintf(stderr, "%s for GPU %u (performance state %u): %s\n", call, i, pstateId, message);
+  } else {
+    fprintf(stderr, "Unable to force performance state %u on GPU %u: %s\n", pstateId, i, pstated_status_string(status));
+  }
+
+  return false;
+}
+
+static bool enter_pstate(unsigned int i, unsigned int pstateId, const char * reason) {
   // Get the current state of the GPU
   gpuState * state = &gpuStates[i];
 
-  // If GPU are unmanaged
-  if (!state->managed) {
+  // If GPU are unmanaged or owned by another process
+  if (!state->managed || !state->owned) {
     // Return true to indicate success
     return true;
   }
@@ -245,23 +655,36 @@ static bool enter_pstate(unsigned int i, unsigned int pstateId, unsigned long me
   // If we're already using clock control
   if (state->usingClockControl) {
     // Use clock control instead of pstate
-    bool isHighPerformance = (pstateId == PERFORMANCE_STATE_HIGH);
-    if (!set_clocks(i, isHighPerformance, memFreqHigh, gpuFreqHigh, memFreqLow, gpuFreqLow)) {
+    bool isHighPerformance = (pstateId == state->params.performanceStateHigh);
+    if (!set_clocks(i, isHighPerformance)) {
       return false;
     }
     
-    // Reset the iteration counter
-    state->iterations = 0;
+    // Record the state in the core and reset the iteration counter
+    pstated_adopt(core, i, pstateId, 0);
+
+    // Count the transition
+    state->stats.transitions++;
     
     // Update the GPU state with the new performance state
     state->pstateId = pstateId;
+
+    // Remember the time of the write for the read-back
+    state->lastWrite = get_time_ms();
+
+    // Wait for the transition to show in the read-back
+    state->verifyPending = true;
+    state->verifyRetries = 0;
+
+    // Trace and publish the transition and its reason
+    trace_state(i, pstateId, reason);
+    publish_transition(i, reason);
     
     return true;
   }
 
   // Try to set the GPU to the desired performance state using NVAPI
-  NvAPI_Status status = NvAPI_GPU_SetForcePstate(nvapiDevices[i], pstateId, 0);
-  if (status != NVAPI_OK) {
+  if (!apply_pstate(i, pstateId)) {
     // If fallback to clock control is enabled and this is the first failure
     if (enableClockFallback) {
       fprintf(stderr, "Failed to set pstate for GPU %u, trying to use clock control instead\n", i);
@@ -275,28 +698,35 @@ static bool enter_pstate(unsigned int i, unsigned int pstateId, unsigned long me
       state->usingClockControl = true;
       
       // Use clock control instead
-      bool isHighPerformance = (pstateId == PERFORMANCE_STATE_HIGH);
-      if (!set_clocks(i, isHighPerformance, memFreqHigh, gpuFreqHigh, memFreqLow, gpuFreqLow)) {
+      bool isHighPerformance = (pstateId == state->params.performanceStateHigh);
+      if (!set_clocks(i, isHighPerformance)) {
         return false;
       }
     } else {
-      // Get error message
-      NvAPI_ShortString error;
-      if (NvAPI_GetErrorMessage(status, error) != NVAPI_OK) {
-        strcpy(error, "<NvAPI_GetErrorMessage() call failed>");
-      }
-      
-      fprintf(stderr, "NvAPI_GPU_SetForcePstate(nvapiDevices[%u], %u, 0): %s\n", i, pstateId, error);
       return false;
     }
   }
 
-  // Reset the iteration counter
-  state->iterations = 0;
+  // Record the state in the core, also when clocks were set instead, and reset the iteration counter
+  pstated_adopt(core, i, pstateId, 0);
+
+  // Count the transition
+  state->stats.transitions++;
 
   // Update the GPU state with the new performance state
   state->pstateId = pstateId;
 
+  // Remember the time of the write for the read-back
+  state->lastWrite = get_time_ms();
+
+  // Wait for the transition to show in the read-back
+  state->verifyPending = true;
+  state->verifyRetries = 0;
+
+  // Trace and publish the transition and its reason
+  trace_state(i, pstateId, reason);
+  publish_transition(i, reason);
+
   // Print the current GPU state
   printf("GPU %u entered performance state %u\n", i, state->pstateId);
 
@@ -304,222 +734,3057 @@ static bool enter_pstate(unsigned int i, unsigned int pstateId, unsigned long me
   return true;
 }
 
-static int run(int argc, char * argv[]) {
-  /***** OPTIONS *****/
-  unsigned long ids[NVAPI_MAX_PHYSICAL_GPUS] = { 0 };
-  size_t idsCount = 0;
-  unsigned long iterationsBeforeSwitch = ITERATIONS_BEFORE_SWITCH;
-  unsigned long performanceStateHigh = PERFORMANCE_STATE_HIGH;
-  unsigned long performanceStateLow = PERFORMANCE_STATE_LOW;
-  unsigned long sleepInterval = SLEEP_INTERVAL;
-  unsigned long temperatureThreshold = TEMPERATURE_THRESHOLD;
-  unsigned long clockFreqMemHigh = CLOCK_FREQ_MEM_HIGH;
-  unsigned long clockFreqGpuHigh = CLOCK_FREQ_GPU_HIGH;
-  unsigned long clockFreqMemLow = CLOCK_FREQ_MEM_LOW;
-  unsigned long clockFreqGpuLow = CLOCK_FREQ_GPU_LOW;
-  enableClockFallback = ENABLE_CLOCK_FALLBACK;
-
-  /***** OPTION PARSING *****/
-  {
-    // Iterate through command-line arguments
-    for (unsigned int i = 1; i < argc; i++) {
-      // Check if the option is "-i" or "--ids" and if there is a next argument
-      if ((IS_OPTION("-i") || IS_OPTION("--ids")) && HAS_NEXT_ARG) {
-        // Parse the integer array option and store it in ids
-        ASSERT_TRUE(parse_ulong_array(argv[++i], ",", NVAPI_MAX_PHYSICAL_GPUS, ids, &idsCount), usage);
-      }
+static void update_energy(unsigned int i) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
 
-      // Check if the option is "-h" or "--help"
-      if ((IS_OPTION("-h") || IS_OPTION("--help"))) {
-        // Print usage instructions
-        goto usage;
-      }
+  // Skip GPUs that don't report their energy consumption
+  if (!state->stats.energySupported) {
+    return;
+  }
 
-      // Check if the option is "-ibs" or "--iterations-before-switch" and if there is a next argument
-      if ((IS_OPTION("-ibs") || IS_OPTION("--iterations-before-switch")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in iterationsBeforeSwitch
-        ASSERT_TRUE(parse_ulong(argv[++i], &iterationsBeforeSwitch), usage);
-      }
+  // Variable to hold the energy counter
+  unsigned long long energy;
 
-      // Check if the option is "-psh" or "--performance-state-high" and if there is a next argument
-      if ((IS_OPTION("-psh") || IS_OPTION("--performance-state-high")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in performanceStateHigh
-        ASSERT_TRUE(parse_ulong(argv[++i], &performanceStateHigh), usage);
-      }
+  // Update the consumed energy if the counter could be read
+  if (nvmlDeviceGetTotalEnergyConsumption(nvmlDevices[i], &energy) == NVML_SUCCESS) {
+    state->stats.energy = energy - state->stats.energyStart;
+  }
+}
 
-      // Check if the option is "-psl" or "--performance-state-low" and if there is a next argument
-      if ((IS_OPTION("-psl") || IS_OPTION("--performance-state-low")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in performanceStateLow
-        ASSERT_TRUE(parse_ulong(argv[++i], &performanceStateLow), usage);
-      }
-      
-      // Check if the option is "-cmh" or "--clock-mem-high" and if there is a next argument
-      if ((IS_OPTION("-cmh") || IS_OPTION("--clock-mem-high")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in clockFreqMemHigh
-        ASSERT_TRUE(parse_ulong(argv[++i], &clockFreqMemHigh), usage);
-      }
-      
-      // Check if the option is "-cgh" or "--clock-gpu-high" and if there is a next argument
-      if ((IS_OPTION("-cgh") || IS_OPTION("--clock-gpu-high")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in clockFreqGpuHigh
-        ASSERT_TRUE(parse_ulong(argv[++i], &clockFreqGpuHigh), usage);
-      }
-      
-      // Check if the option is "-cml" or "--clock-mem-low" and if there is a next argument
-      if ((IS_OPTION("-cml") || IS_OPTION("--clock-mem-low")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in clockFreqMemLow
-        ASSERT_TRUE(parse_ulong(argv[++i], &clockFreqMemLow), usage);
-      }
-      
-      // Check if the option is "-cgl" or "--clock-gpu-low" and if there is a next argument
-      if ((IS_OPTION("-cgl") || IS_OPTION("--clock-gpu-low")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in clockFreqGpuLow
-        ASSERT_TRUE(parse_ulong(argv[++i], &clockFreqGpuLow), usage);
-      }
-      
-      // Check if the option is "-nfc" or "--no-fallback-clocks"
-      if ((IS_OPTION("-nfc") || IS_OPTION("--no-fallback-clocks"))) {
-        // Disable clock fallback mode
-        enableClockFallback = false;
-      }
+static bool set_power_limit(unsigned int i, unsigned int limit) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
 
-      // Check if the option is "-s" or "--service"
-      if ((IS_OPTION("-s") || IS_OPTION("--service"))) {
-        // Skip option
-        continue;
-      }
+  // Nothing to do if the limit is unchanged
+  if (limit == state->powerLimit) {
+    return true;
+  }
 
-      // Check if the option is "-si" or "--sleep-interval" and if there is a next argument
-      if ((IS_OPTION("-si") || IS_OPTION("--sleep-interval")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in sleepInterval
-        ASSERT_TRUE(parse_ulong(argv[++i], &sleepInterval), usage);
-      }
+  // Set the power limit
+  nvmlReturn_t result = nvmlDeviceSetPowerManagementLimit(nvmlDevices[i], limit);
+  if (result != NVML_SUCCESS) {
+    fprintf(stderr, "Unable to set power limit for GPU %u to %u W: %s\n", i, limit / 1000, nvmlErrorString(result));
+    return false;
+  }
 
-      // Check if the option is "-tt" or "--temperature-threshold" and if there is a next argument
-      if ((IS_OPTION("-tt") || IS_OPTION("--temperature-threshold")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in temperatureThreshold
-        ASSERT_TRUE(parse_ulong(argv[++i], &temperatureThreshold), usage);
-      }
-    }
+  // Print the new power limit
+  printf("GPU %u power limit set to %u W\n", i, limit / 1000);
 
-    // Display usage instructions to the user
-    if (false) {
-      // Display usage instructions to the user
-      usage:
+  // Update the current power limit
+  state->powerLimit = limit;
 
-      // Print the usage instructions
-      printf("Usage: %s [options]\n", argv[0]);
-      printf("\n");
-      printf("Options:\n");
-      printf("  -i, --ids <value><,value...>              Set the GPU(s) to control (default: all)\n");
-      printf("  -ibs, --iterations-before-switch <value>  Set the number of iterations to wait before switching states (default: %u)\n", ITERATIONS_BEFORE_SWITCH);
-      printf("  -psh, --performance-state-high <value>    Set the high performance state for the GPU (default: %u)\n", PERFORMANCE_STATE_HIGH);
-      printf("  -psl, --performance-state-low <value>     Set the low performance state for the GPU (default: %u)\n", PERFORMANCE_STATE_LOW);
-      printf("  -cmh, --clock-mem-high <value>            Set the high performance memory clock in MHz for fallback mode (default: auto)\n");
-      printf("  -cgh, --clock-gpu-high <value>            Set the high performance GPU clock in MHz for fallback mode (default: auto)\n");
-      printf("  -cml, --clock-mem-low <value>             Set the low performance memory clock in MHz for fallback mode (default: lowest)\n");
-      printf("  -cgl, --clock-gpu-low <value>             Set the low performance GPU clock in MHz for fallback mode (default: lowest)\n");
-      printf("  -nfc, --no-fallback-clocks                Disable fallback to clock control when pstate setting fails\n");
+  // Trace the power limit
+  trace_counter(i, TRACE_POWER_LIMIT, limit / 1000.0);
 
-      #ifdef _WIN32
-        printf("  -s, --service                             Run as a Windows service\n");
-      #endif
+  // Return true to indicate success
+  return true;
+}
 
-      printf("  -si, --sleep-interval <value>             Set the sleep interval in milliseconds between utilization checks (default: %u)\n", SLEEP_INTERVAL);
-      printf("  -tt, --temperature-threshold <value>      Set the temperature threshold in degrees C (default: %u)\n", TEMPERATURE_THRESHOLD);
+static bool set_fan_speed(unsigned int i, unsigned int speed) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
 
-      // Jump to the error handling code
-      goto errored;
+  // Set the speed of each fan
+  for (unsigned int fan = 0; fan < state->fans.count; fan++) {
+    nvmlReturn_t result = nvmlDeviceSetFanSpeed_v2(nvmlDevices[i], fan, speed);
+    if (result != NVML_SUCCESS) {
+      fprintf(stderr, "Unable to set fan %u speed for GPU %u to %u%%: %s\n", fan, i, speed, nvmlErrorString(result));
+      return false;
     }
   }
 
-  /***** SIGNALS *****/
-  {
-    // Set up signal handling
-    signal(SIGINT, handle_exit);
-    signal(SIGTERM, handle_exit);
-  }
+  // Print the new fan speed
+  printf("GPU %u fan speed set to %u%%\n", i, speed);
 
-  /***** NVAPI INIT *****/
+  // Update the fan state
+  state->fans.speed = speed;
+  state->fans.controlled = true;
+  state->fans.lastChange = get_time_ms();
+
+  // Trace the fan speed
+  trace_counter(i, TRACE_FAN_SPEED, speed);
+
+  // Return true to indicate success
+  return true;
+}
+
+static void restore_fans(unsigned int i) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Nothing to do if the daemon doesn't control the fans
+  if (!state->fans.controlled) {
+    return;
+  }
+
+  // Hand each fan back to the driver
+  for (unsigned int fan = 0; fan < state->fans.count; fan++) {
+    nvmlReturn_t result = nvmlDeviceSetDefaultFanSpeed_v2(nvmlDevices[i], fan);
+    if (result != NVML_SUCCESS) {
+      fprintf(stderr, "Warning: Failed to restore default speed of fan %u for GPU %u: %s\n", fan, i, nvmlErrorString(result));
+    }
+  }
+
+  // Print the fan state
+  printf("GPU %u fan speed restored to automatic\n", i);
+
+  // Update the fan state
+  state->fans.controlled = false;
+  state->fans.lastChange = get_time_ms();
+}
+
+static void adopt_handoff(unsigned int i, const handoffRecord * record, bool thermalPredict, bool fanControl) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Take over the performance state and clocks as they are, without touching the driver
+  state->adopted = true;
+  state->pstateId = record->pstateId;
+  pstated_adopt(core, i, record->pstateId, record->iterations);
+  state->usingClockControl = record->usingClockControl;
+  state->currentMemClock = record->currentMemClock;
+  state->currentGpuClock = record->currentGpuClock;
+
+  // Take over the fans raised by the previous process
+  if (record->fanControlled) {
+    state->fans.controlled = true;
+    state->fans.count = record->fanCount;
+    state->fans.initialSpeed = record->fanInitialSpeed;
+    state->fans.speed = record->fanSpeed;
+    state->fans.lastChange = get_time_ms();
+
+    // Hand the fans back to the driver if this process doesn't control them
+    if (!fanControl || !state->fans.supported) {
+      restore_fans(i);
+    }
+  }
+
+  // Restore the default power limit lowered by the previous process, unless this process manages it
+  if (record->powerLimit != 0 && record->powerLimit != record->defaultPowerLimit && !(thermalPredict && state->powerLimitSupported)) {
+    state->powerLimit = record->powerLimit;
+    set_power_limit(i, record->defaultPowerLimit);
+  }
+
+  // Print the adopted state
+  printf("GPU %u adopted from the previous process in performance state %u\n", i, state->pstateId);
+}
+
+static bool save_handoff(void) {
+  // Number of GPUs handed over
+  handoffCount = 0;
+
+  // Record the state of each managed GPU
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[i];
+
+    // Skip unmanaged and quarantined GPUs, and GPUs owned by another process
+    if (!state->managed || !state->owned || state->quarantined) {
+      continue;
+    }
+
+    // Get the idle iterations counted by the core
+    unsigned int pstateId, iterations;
+
+    if (pstated_state(core, i, &pstateId, &iterations) != PSTATED_OK) {
+      iterations = 0;
+    }
+
+    // Fill the record of the GPU
+    handoffRecord * record = &handoffRecords[handoffCount++];
+
+    snprintf(record->uuid, sizeof(record->uuid), "%s", state->uuid);
+    record->pstateId = state->pstateId;
+    record->iterations = iterations;
+    record->usingClockControl = state->usingClockControl;
+    record->currentMemClock = state->currentMemClock;
+    record->currentGpuClock = state->currentGpuClock;
+    record->powerLimit = state->powerLimitSupported ? state->powerLimit : 0;
+    record->defaultPowerLimit = state->powerLimitSupported ? state->defaultPowerLimit : 0;
+    record->fanControlled = state->fans.controlled;
+    record->fanCount = state->fans.count;
+    record->fanInitialSpeed = state->fans.initialSpeed;
+    record->fanSpeed = state->fans.speed;
+
+    // Keep the ownership lock open across exec, so that no other process can take the GPU in between
+    record->lockFd = ownership_inherit(&state->lock);
+  }
+
+  // Write the records
+  return (handoffFd = handoff_save(handoffRecords, handoffCount)) >= 0;
+}
+
+static bool restore_gpu(unsigned int i) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Hand the fans back to the driver
+  restore_fans(i);
+
+  // Restore the default power limit if the predictive thermal model lowered it
+  if (state->powerLimitSupported && state->powerLimit != state->defaultPowerLimit) {
+    set_power_limit(i, state->defaultPowerLimit);
+  }
+
+  // If we're using clock control for this GPU
+  if (state->usingClockControl) {
+    // Reset to default clocks
+    nvmlReturn_t result = nvmlDeviceResetApplicationsClocks(nvmlDevices[i]);
+    if (result != NVML_SUCCESS) {
+      fprintf(stderr, "Warning: Failed to reset clocks for GPU %u: %s\n", i, nvmlErrorString(result));
+    }
+
+    // Return true to indicate success
+    return true;
+  }
+
+  // Switch to automatic management of performance state
+  return enter_pstate(i, 16, "exit");
+}
+
+static void restore_handoff(void) {
+  // Initialize NVAPI and NVML again, they were released before the new binary was executed
+  int status = pstated_open(PSTATED_API_VERSION_MAJOR, &core);
+
+  if (status != PSTATED_OK) {
+    fprintf(stderr, "Unable to initialize the GPUs: %s\n", pstated_status_string(status));
+    return;
+  }
+
+  // Get the NVML handles again
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    nvmlDevices[i] = pstated_nvml_device(core, i);
+  }
+
+  // Restore the GPUs that were handed over, as on a normal exit
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[i];
+
+    if (state->managed && state->owned && !state->quarantined) {
+      restore_gpu(i);
+    }
+
+    // Release the ownership lock kept for the new binary
+    ownership_release(&state->lock);
+  }
+
+  // Release NVAPI and NVML
+  pstated_close(core);
+  core = NULL;
+}
+
+static void yield_ownership(unsigned int i, bool lock) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Hand the fans and the power limit back, the other owner decides about them
+  restore_fans(i);
+
+  if (state->powerLimitSupported && state->powerLimit != state->defaultPowerLimit) {
+    set_power_limit(i, state->defaultPowerLimit);
+  }
+
+  // Stop managing the GPU and let another daemon take the lock
+  state->owned = false;
+
+  if (lock) {
+    ownership_release(&state->lock);
+  }
+
+  // Count the yield and start the backoff
+  state->yields++;
+  state->lastYield = get_time_ms();
+
+  // Print the yield
+  printf("GPU %u yielded to another process\n", i);
+  trace_event(i, "yield");
+  publish_event(i, "ownership", "\"owned\":false");
+}
+
+static bool reclaim_ownership(unsigned int i, bool lock, unsigned long backoff) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Wait for the backoff to elapse since the last attempt
+  unsigned long long now = get_time_ms();
+
+  if (now - state->lastYield < backoff) {
+    return true;
+  }
+
+  state->lastYield = now;
+
+  // Try to take the lock, it stays with the other owner until that process exits
+  if (lock && !ownership_acquire(&state->lock, state->uuid)) {
+    return true;
+  }
+
+  // Manage the GPU again
+  state->owned = true;
+  state->mismatches = 0;
+  state->takeovers++;
+
+  // Print the takeover
+  printf("GPU %u taken over\n", i);
+  publish_event(i, "ownership", "\"owned\":true");
+
+  // Start from low performance state, the next iterations raise it if the GPU is busy
+  return enter_pstate(i, state->params.performanceStateLow, "takeover");
+}
+
+static const calibrationPoint * current_point(unsigned int i) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Look the applied clocks or performance state up in the calibration
+  if (state->usingClockControl) {
+    return calibration_find(&state->calibration, 16, state->currentMemClock, state->currentGpuClock);
+  }
+
+  return calibration_find(&state->calibration, state->pstateId, 0, 0);
+}
+
+static bool read_back_state(unsigned int i, char *expected, char *found, size_t size) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  if (state->usingClockControl) {
+    // Automatic clocks can't be told apart from clocks chosen by another process
+    if (state->currentMemClock == 0 && state->currentGpuClock == 0) {
+      return false;
+    }
+
+    // Read the applied clocks back
+    unsigned int memClock, gpuClock;
+
+    if (nvmlDeviceGetApplicationsClock(nvmlDevices[i], NVML_CLOCK_MEM, &memClock) != NVML_SUCCESS ||
+        nvmlDeviceGetApplicationsClock(nvmlDevices[i], NVML_CLOCK_GRAPHICS, &gpuClock) != NVML_SUCCESS) {
+      return false;
+    }
+
+    snprintf(expected, size, "%u/%u MHz", state->currentMemClock, state->currentGpuClock);
+    snprintf(found, size, "%u/%u MHz", memClock, gpuClock);
+  } else {
+    // Automatic management lets the driver pick any performance state
+    if (state->pstateId >= 16) {
+      return false;
+    }
+
+    // Read the current performance state back
+    nvmlPstates_t pstate;
+
+    if (nvmlDeviceGetPerformanceState(nvmlDevices[i], &pstate) != NVML_SUCCESS) {
+      return false;
+    }
+
+    snprintf(expected, size, "P%u", state->pstateId);
+    snprintf(found, size, "P%u", (unsigned int) pstate);
+  }
+
+  // Return true to indicate the states can be compared
+  return true;
+}
+
+static bool rewrite_state(unsigned int i) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Set the clocks again
+  if (state->usingClockControl) {
+    return set_clocks(i, state->pstateId == state->params.performanceStateHigh);
+  }
+
+  // Force the performance state again, keeping the idle iterations counted so far
+  unsigned int pstateId, iterations;
+
+  if (pstated_state(core, i, &pstateId, &iterations) != PSTATED_OK || !apply_pstate(i, state->pstateId)) {
+    return false;
+  }
+
+  pstated_adopt(core, i, state->pstateId, iterations);
+
+  return true;
+}
+
+static bool verify_transition(unsigned int i, unsigned long deadline, unsigned long retries, unsigned long escalate) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Nothing to do without a transition in flight
+  if (!state->verifyPending) {
+    return true;
+  }
+
+  // Descriptions of the applied and the observed state
+  char expected[64];
+  char found[64];
+
+  // Automatic management lets the driver pick any state, there is nothing to verify
+  if (!read_back_state(i, expected, found, sizeof(expected))) {
+    state->verifyPending = false;
+    return true;
+  }
+
+  // The transition showed
+  if (strcmp(expected, found) == 0) {
+    state->verifyPending = false;
+    state->verifySilent = 0;
+    state->verified++;
+    return true;
+  }
+
+  // Wait for the deadline, doubled after each retry
+  unsigned long long now = get_time_ms();
+
+  if (now - state->lastWrite < (unsigned long long) deadline << state->verifyRetries) {
+    return true;
+  }
+
+  // Count the failed read-back
+  state->verifyFailures++;
+
+  // Write the state again, some drivers only apply it on the next request
+  if (state->verifyRetries < retries) {
+    state->verifyRetries++;
+
+    printf("GPU %u didn't reach %s within %llu ms (found %s), retrying\n", i, expected, now - state->lastWrite, found);
+    trace_event(i, "verify retry");
+
+    if (!rewrite_state(i)) {
+      return false;
+    }
+
+    state->lastWrite = now;
+    return true;
+  }
+
+  // Give the transition up
+  state->verifyPending = false;
+
+  printf("GPU %u didn't reach %s after %u retries (found %s)\n", i, expected, state->verifyRetries, found);
+  trace_event(i, "verify failed");
+
+  // Keep the backend until the failures repeat, and when there is nothing to switch to
+  if (escalate == 0 || ++state->verifySilent < escalate || state->usingClockControl || !enableClockFallback) {
+    return true;
+  }
+
+  printf("GPU %u ignores performance state requests, trying to use clock control instead\n", i);
+
+  // Get supported clocks
+  if (!get_supported_clocks(i)) {
+    return false;
+  }
+
+  // Count the escalation
+  state->verifyEscalations++;
+  state->verifySilent = 0;
+
+  // Mark that we're using clock control for this GPU
+  state->usingClockControl = true;
+
+  // Apply the state with clock control
+  return enter_pstate(i, state->pstateId, "clock fallback");
+}
+
+static bool check_foreign_writes(unsigned int i, foreignWritePolicy policy, bool lock, unsigned long interval) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Read back at the check interval or after a change event only, and not while the GPU settles after our own write
+  unsigned long long now = get_time_ms();
+
+  if ((!state->readBackDue && now - state->lastReadBack < interval) || now - state->lastWrite < FOREIGN_WRITE_SETTLE) {
+    return true;
+  }
+
+  // Remember if a change event asked for the read-back
+  bool due = state->readBackDue;
+
+  state->lastReadBack = now;
+  state->readBackDue = false;
+
+  // Descriptions of the applied and the observed state
+  char expected[64];
+  char found[64];
+
+  // Automatic management lets the driver pick any state
+  if (!read_back_state(i, expected, found, sizeof(expected))) {
+    state->mismatches = 0;
+    return true;
+  }
+
+  // Nothing to do if the GPU is in the state we applied
+  if (strcmp(expected, found) == 0) {
+    state->mismatches = 0;
+    return true;
+  }
+
+  // Wait for the mismatch to persist, so that a transition in progress isn't mistaken for a foreign write
+  if (++state->mismatches < FOREIGN_WRITE_CONFIRMATIONS) {
+    // Confirm in the next iteration if a change event asked for the read-back
+    state->readBackDue = due;
+    return true;
+  }
+
+  state->mismatches = 0;
+
+  // Count the foreign write
+  state->foreignWrites++;
+
+  // Print the foreign write
+  printf("GPU %u was changed by another process (expected %s, found %s)\n", i, expected, found);
+  trace_event(i, "foreign write");
+
+  // Publish the foreign write
+  char fields[160];
+
+  snprintf(fields, sizeof(fields), "\"expected\":\"%s\",\"found\":\"%s\"", expected, found);
+  publish_event(i, "foreign_write", fields);
+
+  // Apply the policy
+  switch (policy) {
+    case FOREIGN_WRITES_YIELD:
+      yield_ownership(i, lock);
+      break;
+    case FOREIGN_WRITES_REASSERT:
+      // Count the reassert
+      state->reasserts++;
+
+      // Apply our state again
+      return enter_pstate(i, state->pstateId, "reassert");
+    default:
+      break;
+  }
+
+  return true;
+}
+
+static void report_process(unsigned int gpu, const processRecord * record) {
+  // Print the summary of the process
+  printf("GPU %u process %u (%s) finished: %llu ms, %.1f J, %lu ramps, %llu ms ramp penalty\n",
+    gpu, record->pid, record->cgroup[0] != '\0' ? record->cgroup : "N/A", record->lastSeen - record->firstSeen,
+    record->energy / 1000.0, record->ramps, record->rampPenalty);
+
+  // Append the record to the process log
+  if (processLog != NULL) {
+    process_write_record(processLog, gpu, record);
+    fflush(processLog);
+  }
+}
+
+static void poll_processes(unsigned int i) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Get the process table of the GPU
+  processTable * table = &state->processes;
+
+  // Remember the time of the poll
+  unsigned long long now = get_time_ms();
+  table->lastPoll = now;
+
+  // Attribute the energy since the last poll to the processes seen then
+  if (state->stats.energySupported) {
+    // Variable to hold the energy counter
+    unsigned long long energy;
+
+    // Read the energy counter
+    if (nvmlDeviceGetTotalEnergyConsumption(nvmlDevices[i], &energy) == NVML_SUCCESS) {
+      // Split the energy between the processes
+      if (table->hasEnergy) {
+        process_table_account_energy(table, energy - table->lastEnergy);
+      }
+
+      // Remember the energy counter
+      table->lastEnergy = energy;
+      table->hasEnergy = true;
+    }
+  }
+
+  // Buffer to hold the process list
+  nvmlProcessInfo_t infos[PROCESS_MAX];
+  unsigned int count = PROCESS_MAX;
+
+  // Retrieve the compute processes, keep the previous list if that fails
+  if (nvmlDeviceGetComputeRunningProcesses(nvmlDevices[i], &count, infos) != NVML_SUCCESS) {
+    return;
+  }
+
+  // Mark the processes that are still running
+  process_table_begin_poll(table);
+
+  for (unsigned int j = 0; j < count; j++) {
+    process_table_touch(table, infos[j].pid, now);
+  }
+
+  // Report and remove the processes that left the GPU
+  process_table_end_poll(table, i, report_process);
+}
+
+static bool ramp_up(unsigned int i, unsigned long long since) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // The GPU reaches high performance state the calibrated return latency after the write
+  const calibrationPoint * point = current_point(i);
+  unsigned long long returnLatency = point != NULL ? point->returnLatency : 0;
+
+  // Switch to high performance state, for the first signal that asked for it
+  const char * reason =
+    state->utilization != 0 ? "utilization" :
+    state->queue.depth > 0 ? "queue depth" :
+    get_time_ms() < state->cpu.busyUntil ? "host cpu" :
+    get_time_ms() < state->peers.busyUntil ? "peer" :
+    "hint";
+
+  if (!enter_pstate(i, state->params.performanceStateHigh, reason)) {
+    return false;
+  }
+
+  // Ramps ahead of the work (on a hint) don't delay it
+  if (state->utilization != 0) {
+    // The process that triggered the ramp usually started since the last poll, list the processes again to charge it too
+    if (state->processes.tracked) {
+      poll_processes(i);
+    }
+
+    // The work may have started right after the sample before the ramp was requested, count everything until the GPU is up as ramp penalty
+    state->stats.ramps++;
+    state->stats.rampPenalty += get_time_ms() - since + returnLatency;
+
+    // Every process on the GPU waited for the ramp
+    process_table_account_ramp(&state->processes, get_time_ms() - since + returnLatency);
+  } else if (state->queue.depth > 0) {
+    // Count the ramp ahead of the queued work
+    state->queue.ramps++;
+  } else if (get_time_ms() < state->cpu.busyUntil) {
+    // Watch whether GPU work follows the pre-ramp on host-CPU activity
+    state->cpu.preRampPending = true;
+    state->cpu.preRampTime = get_time_ms();
+  } else if (get_time_ms() < state->peers.busyUntil) {
+    // Count the ramp ahead of the work of the job on this node
+    state->peers.ramps++;
+  }
+
+  // Tell the peers if the GPU runs the job, unless the ramp came from them
+  if (strcmp(reason, "peer") != 0 && peers_announce_ramp(&state->processes)) {
+    printf("GPU %u ramp announced to peers\n", i);
+  }
+
+  // Measure the latency from sending the hint to the ramp
+  if (state->hints.pending && get_time_ms() >= state->hints.timestamp) {
+    // Calculate the latency
+    unsigned long long latency = get_time_ms() - state->hints.timestamp;
+
+    // Accumulate the latency
+    state->hints.latencySum += latency;
+    state->hints.latencyCount++;
+
+    // Track the maximum latency
+    if (latency > state->hints.latencyMax) {
+      state->hints.latencyMax = latency;
+    }
+  }
+
+  // The hint has been acted on
+  state->hints.pending = false;
+
+  // Return true to indicate success
+  return true;
+}
+
+static double ramp_power(unsigned int i, unsigned long budget) {
+  // Variables to hold the power limit and the current power draw (in milliwatts)
+  unsigned int limit, power;
+
+  // Assume the whole budget if the power limit can't be read
+  if (nvmlDeviceGetPowerManagementLimit(nvmlDevices[i], &limit) != NVML_SUCCESS) {
+    return budget;
+  }
+
+  // Take the calibrated idle power of the current state if the power draw can't be read
+  if (nvmlDeviceGetPowerUsage(nvmlDevices[i], &power) != NVML_SUCCESS) {
+    const calibrationPoint * point = current_point(i);
+
+    if (point == NULL) {
+      return budget;
+    }
+
+    power = (unsigned int) (point->power * 1000);
+  }
+
+  // The ramp can raise the power draw up to the power limit
+  return power < limit ? (limit - power) / 1000.0 : 0;
+}
+
+static bool grant_ramps(rampScheduler * scheduler, unsigned long long tick) {
+  // Ramps waiting for the scheduler
+  rampRequest requests[NVAPI_MAX_PHYSICAL_GPUS];
+  unsigned int requestCount = 0;
+
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[i];
+
+    // Skip GPUs that don't wait for a ramp, or whose ramp wasn't requested again in this iteration
+    if (!ramp_wait_renewed(&state->ramp.wait, tick)) {
+      continue;
+    }
+
+    // Estimate the power step of the ramp
+    requests[requestCount++] = (rampRequest) {
+      .gpu = i,
+      .priority = state->ramp.priority,
+      .requested = state->ramp.wait.requested,
+      .power = scheduler->budget > 0 ? ramp_power(i, scheduler->budget) : 0,
+    };
+  }
+
+  // Let the scheduler grant the ramps by priority
+  unsigned long long now = get_time_ms();
+
+  ramp_grant(scheduler, now, requests, requestCount);
+
+  for (unsigned int k = 0; k < requestCount; k++) {
+    // Skip the ramps held back
+    if (!requests[k].granted) {
+      continue;
+    }
+
+    // Get the current state of the GPU
+    unsigned int i = requests[k].gpu;
+    gpuState * state = &gpuStates[i];
+
+    // Count the ramps released by the maximum delay
+    if (requests[k].overdue) {
+      state->ramp.overdue++;
+    }
+
+    // Accumulate the delay
+    unsigned long long delay = now - state->ramp.wait.requested;
+
+    state->ramp.delaySum += delay;
+    state->ramp.delayCount++;
+
+    // Track the maximum delay
+    if (delay > state->ramp.delayMax) {
+      state->ramp.delayMax = delay;
+    }
+
+    // Ramp the GPU up
+    state->ramp.wait.waiting = false;
+
+    if (!ramp_up(i, state->ramp.since)) {
+      return false;
+    }
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+static bool cool_with_fans(unsigned int i, unsigned int temperature, double limit, unsigned int step) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Fans can't help if they are not controllable or if the GPU is already too far above the limit
+  if (!state->fans.supported || temperature > limit + FAN_TOLERANCE) {
+    return false;
+  }
+
+  // Check if the last change had time to settle
+  bool settled = get_time_ms() - state->fans.lastChange >= FAN_STEP_INTERVAL;
+
+  // Fans at the maximum, clocks have to be cut once the last change has settled
+  if (state->fans.controlled && state->fans.speed >= state->fans.maxSpeed) {
+    return !settled;
+  }
+
+  // Wait for the last change to settle before raising the speed again
+  if (state->fans.controlled && !settled) {
+    return true;
+  }
+
+  // Raise the fan speed by one step
+  unsigned int speed = (state->fans.controlled ? state->fans.speed : state->fans.initialSpeed) + step;
+
+  // Clamp the speed to the allowed range
+  if (speed > state->fans.maxSpeed) {
+    speed = state->fans.maxSpeed;
+  }
+
+  // Apply the new speed, give up on fan control for this GPU if that is not possible
+  if (!set_fan_speed(i, speed)) {
+    state->fans.supported = false;
+    return false;
+  }
+
+  // Count the decision
+  state->fans.decisions++;
+
+  // The fans handle this
+  return true;
+}
+
+static void relax_fans(unsigned int i, unsigned int temperature, unsigned int step) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Nothing to do if the daemon doesn't control the fans or the last change hasn't settled
+  if (!state->fans.controlled || get_time_ms() - state->fans.lastChange < FAN_STEP_INTERVAL) {
+    return;
+  }
+
+  // Keep the fans up until the GPU is well below the threshold
+  if (temperature + FAN_HYSTERESIS > state->params.temperatureThreshold) {
+    return;
+  }
+
+  // Hand the fans back to the driver once they are back at the initial speed
+  if (state->fans.speed <= state->fans.initialSpeed + step) {
+    restore_fans(i);
+    return;
+  }
+
+  // Lower the fan speed by one step
+  set_fan_speed(i, state->fans.speed - step);
+}
+
+static void predict_thermal(unsigned int i, unsigned int temperature, unsigned int horizon, unsigned int margin, bool coordinate, unsigned int fanStep) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Skip GPUs without power limit control and steps that are not due yet
+  if (!state->powerLimitSupported || !thermal_due(&state->thermal, get_time_ms())) {
+    return;
+  }
+
+  // Variable to hold the power usage (in milliwatts)
+  unsigned int power;
+
+  // Retrieve the current power usage of the GPU
+  if (nvmlDeviceGetPowerUsage(nvmlDevices[i], &power) != NVML_SUCCESS) {
+    return;
+  }
+
+  // Calculate the heating the model doesn't explain, used to find the coupling to other GPUs
+  state->thermalResidual = thermal_ready(&state->thermal) ? thermal_residual(&state->thermal, temperature) : 0;
+  state->thermalPower = power / 1000.0;
+
+  // Feed the observation into the model
+  thermal_observe(&state->thermal, temperature, power / 1000.0, get_time_ms(), horizon);
+
+  // The node-level controller acts on all GPUs at once
+  if (coordinate) {
+    state->thermalObserved = true;
+    return;
+  }
+
+  // Don't act on a model that isn't fitted yet
+  if (!thermal_ready(&state->thermal)) {
+    return;
+  }
+
+  // Temperature to stay below
+  double target = (double) state->params.temperatureThreshold - margin;
+
+  // Largest power limit change per step
+  unsigned int step = state->defaultPowerLimit / 100 * THERMAL_PREDICT_STEP;
+
+  if (state->thermal.forecast > target) {
+    // Try to sustain the power with the fans first
+    if (fanStep != 0 && cool_with_fans(i, temperature, target, fanStep)) {
+      return;
+    }
+
+    // Power draw that keeps the GPU at the target temperature in the steady state
+    double targetPower;
+
+    // Fall back to a single step if the steady state can't be solved
+    if (!thermal_power_for_temperature(&state->thermal, target, &targetPower)) {
+      targetPower = 0;
+    }
+
+    // Reduce the limit towards the target power, by at most one step
+    unsigned int limit = state->powerLimit > state->minPowerLimit + step ? state->powerLimit - step : state->minPowerLimit;
+    if (targetPower * 1000 > limit && targetPower * 1000 < state->powerLimit) {
+      limit = (unsigned int) (targetPower * 1000);
+    }
+
+    // Count the start of an intervention
+    if (state->powerLimit == state->defaultPowerLimit && limit < state->powerLimit) {
+      state->thermalInterventions++;
+      state->clockDecisions++;
+    }
+
+    // Apply the reduced power limit, give up on this GPU if that is not possible
+    if (!set_power_limit(i, limit)) {
+      state->powerLimitSupported = false;
+    }
+  } else if (state->powerLimit < state->defaultPowerLimit) {
+    // Raise the limit by one step
+    unsigned int limit = state->powerLimit + step < state->defaultPowerLimit ? state->powerLimit + step : state->defaultPowerLimit;
+
+    // Only raise the limit if the GPU would still stay below the target with it
+    if (thermal_forecast(&state->thermal, temperature, limit / 1000.0, horizon) <= target) {
+      set_power_limit(i, limit);
+    }
+  }
+}
+
+static void coordinate_thermal(unsigned int horizon, unsigned int margin, unsigned int fanStep) {
+  // Observations of the current step
+  bool valid[NVAPI_MAX_PHYSICAL_GPUS] = { false };
+  double power[NVAPI_MAX_PHYSICAL_GPUS] = { 0 };
+  double residual[NVAPI_MAX_PHYSICAL_GPUS] = { 0 };
+
+  // Flag to indicate if any GPU was observed in this iteration
+  bool observed = false;
+
+  // Collect the observations of the fitted models
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[i];
+
+    // Check if the GPU was observed in this iteration
+    if (state->thermalObserved) {
+      valid[i] = thermal_ready(&state->thermal);
+      power[i] = state->thermalPower;
+      residual[i] = state->thermalResidual;
+      observed = true;
+    }
+
+    // Clear the flag for the next iteration
+    state->thermalObserved = false;
+  }
+
+  // Wait until the models have stepped
+  if (!observed) {
+    return;
+  }
+
+  // Learn the coupling between the GPUs
+  coupling_update(&coupling, deviceCount, valid, power, residual);
+
+  // Clear the requested reductions
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    gpuStates[i].ownReduction = 0;
+    gpuStates[i].sharedReduction = 0;
+  }
+
+  // Spread the reduction each hot GPU needs over the GPUs that heat it
+  for (unsigned int j = 0; j < deviceCount; j++) {
+    // Get the state of the hot GPU
+    gpuState * target = &gpuStates[j];
+
+    // Temperature the GPU must stay below
+    double limit = (double) target->params.temperatureThreshold - margin;
+
+    // Skip GPUs that are not forecasted to exceed the limit
+    if (!valid[j] || !target->powerLimitSupported || target->thermal.forecast <= limit) {
+      continue;
+    }
+
+    // Steady-state temperature rise of the hot GPU per watt drawn by each GPU
+    double gains[NVAPI_MAX_PHYSICAL_GPUS] = { 0 };
+    double norm = 0;
+
+    for (unsigned int i = 0; i < deviceCount; i++) {
+      if (valid[i] && gpuStates[i].powerLimitSupported) {
+        gains[i] = (i == j) ? thermal_gain(&target->thermal) : coupling_coefficient(&coupling, j, i) / -target->thermal.theta[1];
+        norm += gains[i] * gains[i];
+      }
+    }
+
+    // The minimum-norm reduction that cools the hot GPU by the excess, spreading it over the coupled group
+    for (unsigned int i = 0; i < deviceCount && norm > 0; i++) {
+      // Power reduction of this GPU
+      double reduction = (target->thermal.forecast - limit) * gains[i] / norm;
+
+      // Account the reduction as own or shared
+      if (i == j) {
+        gpuStates[i].ownReduction += reduction;
+      } else {
+        gpuStates[i].sharedReduction += reduction;
+      }
+    }
+  }
+
+  // Flag to indicate if any GPU was reduced on behalf of another in this step
+  bool shared = false;
+
+  // Apply the reductions
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[i];
+
+    // Skip GPUs without a fitted model
+    if (!valid[i] || !state->powerLimitSupported) {
+      continue;
+    }
+
+    // Largest power limit change per step
+    unsigned int step = state->defaultPowerLimit / 100 * THERMAL_PREDICT_STEP;
+
+    // Total requested reduction (in milliwatts)
+    double reduction = (state->ownReduction + state->sharedReduction) * 1000;
+
+    if (reduction > 0 && fanStep != 0 && state->ownReduction > 0 && cool_with_fans(i, state->temperature, (double) state->params.temperatureThreshold - margin, fanStep)) {
+      // The fans sustain the power of this GPU for now
+      continue;
+    } else if (reduction > 0) {
+      // Reduce the limit by the requested amount, by at most one step
+      unsigned int decrease = reduction < step ? (unsigned int) reduction : step;
+      unsigned int limit = state->powerLimit > state->minPowerLimit + decrease ? state->powerLimit - decrease : state->minPowerLimit;
+
+      // Count the start of an intervention
+      if (state->powerLimit == state->defaultPowerLimit && limit < state->powerLimit) {
+        state->thermalInterventions++;
+        state->clockDecisions++;
+      }
+
+      // Remember if the GPU was reduced for its neighbors
+      shared |= state->sharedReduction > 0;
+
+      // Apply the reduced power limit, give up on this GPU if that is not possible
+      if (!set_power_limit(i, limit)) {
+        state->powerLimitSupported = false;
+      }
+    } else if (state->powerLimit < state->defaultPowerLimit) {
+      // Raise the limit by one step
+      unsigned int limit = state->powerLimit + step < state->defaultPowerLimit ? state->powerLimit + step : state->defaultPowerLimit;
+
+      // Check that the GPU itself would stay below its limit
+      bool safe = thermal_forecast(&state->thermal, state->temperature, limit / 1000.0, horizon) <= (double) state->params.temperatureThreshold - margin;
+
+      // Check that the GPUs it heats would stay below their limits
+      for (unsigned int j = 0; j < deviceCount && safe; j++) {
+        if (j != i && valid[j]) {
+          double rise = coupling_coefficient(&coupling, j, i) / -gpuStates[j].thermal.theta[1] * (limit - state->powerLimit) / 1000.0;
+          safe = gpuStates[j].thermal.forecast + rise <= (double) gpuStates[j].params.temperatureThreshold - margin;
+        }
+      }
+
+      // Raise the limit if it is safe for the whole group
+      if (safe) {
+        set_power_limit(i, limit);
+      }
+    }
+  }
+
+  // Count the steps in which the load was spread over the group
+  if (shared) {
+    thermalCoordinatedSteps++;
+  }
+}
+
+static void isolate_gpu(unsigned int i) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Hand the GPU back to the driver as far as it still responds, the other GPUs keep being managed
+  if (state->managed && state->owned) {
+    restore_gpu(i);
+  }
+
+  // Leave the GPU alone from now on
+  state->quarantined = true;
+  state->ramp.wait.waiting = false;
+
+  trace_event(i, "quarantine");
+}
+
+static void quarantine_gpu(unsigned int i, const char * call, const char * error) {
+  // Print the failed call
+  printf("GPU %u quarantined after %s failed: %s\n", i, call, error);
+
+  // Hand the GPU back and leave it alone
+  isolate_gpu(i);
+
+  // Publish the fault
+  char fields[160];
+
+  snprintf(fields, sizeof(fields), "\"nvml\":\"%s\",\"quarantined\":true", error);
+  publish_event(i, "fault", fields);
+}
+
+static void handle_events(const gpuEvents * events) {
+  // Iterate through each GPU
+  for (unsigned int i = 0; i < deviceCount && i < EVENTS_MAX_GPUS; i++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[i];
+
+    // Count the Xid errors
+    if (events[i].xids > 0) {
+      state->xidEvents += events[i].xids;
+      state->lastXid = events[i].lastXid;
+
+      printf("GPU %u reported Xid %llu\n", i, events[i].lastXid);
+    }
+
+    // Leave a faulted GPU alone before the next NVML call on it fails
+    if (events[i].fault && state->managed && !state->quarantined) {
+      printf("GPU %u quarantined after Xid %llu\n", i, events[i].lastXid);
+
+      // Hand the GPU back to the driver, a contained error leaves it usable by the applications
+      isolate_gpu(i);
+    }
+
+    // Leave a GPU that fell off the bus alone, the listener no longer watches it
+    if (events[i].lost && state->managed && !state->quarantined) {
+      quarantine_gpu(i, "nvmlEventSetWait_v2()", nvmlErrorString(NVML_ERROR_GPU_IS_LOST));
+    }
+
+    // Publish the fault, once the quarantine decision is made
+    if (events[i].xids > 0) {
+      char fields[96];
+
+      snprintf(fields, sizeof(fields), "\"xid\":%llu,\"quarantined\":%s", events[i].lastXid, state->quarantined ? "true" : "false");
+      publish_event(i, "fault", fields);
+    }
+
+    // Read the applied state back, the change may come from another process
+    if (events[i].changes > 0) {
+      state->changeEvents += events[i].changes;
+      state->readBackDue = true;
+    }
+  }
+}
+
+static void predict_cpu(unsigned int i, unsigned long threshold, unsigned long idle, unsigned long hold) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Read the CPU time at the interval only
+  unsigned long long now = get_time_ms();
+
+  if (now - state->processes.lastCpuPoll < CPU_PREDICT_INTERVAL) {
+    return;
+  }
+
+  // Measure the CPU load of the processes on the GPU
+  state->cpu.load = process_table_cpu_load(&state->processes, now);
+
+  // Remember that the processes were idle
+  if (state->cpu.load * 100 < idle) {
+    state->cpu.idle = true;
+    return;
+  }
+
+  // Pre-ramp the GPU when the processes go from idle to busy, a sustained load doesn't extend the hold
+  if (state->cpu.idle && state->cpu.load * 100 >= threshold) {
+    state->cpu.idle = false;
+    state->cpu.busyUntil = now + hold;
+  }
+}
+
+static void process_hints(unsigned long trust) {
+  // Variable to hold the received hint
+  hintMessage hint;
+
+  // Drain all pending hints
+  while (hint_receive(&hint)) {
+    // Skip hints for unknown or unmanaged GPUs
+    if (hint.gpu >= deviceCount || !gpuStates[hint.gpu].managed) {
+      continue;
+    }
+
+    // Get the state of the GPU
+    gpuState * state = &gpuStates[hint.gpu];
+
+    if (hint.busy) {
+      // Count the hint
+      state->hints.busyCount++;
+
+      // Hold the GPU in high performance state for the trusted share of the announced duration
+      state->hints.busyUntil = get_time_ms() + hint.duration * trust / 100;
+
+      // Ramp up on the next check, remembering when the hint was sent to measure the latency
+      state->hints.pending = trust > 0;
+      state->hints.timestamp = hint.timestamp;
+    } else {
+      // Count the hint
+      state->hints.idleCount++;
+
+      // Cancel any busy hint
+      state->hints.busyUntil = 0;
+      state->hints.pending = false;
+
+      // Skip the trusted share of the wait before switching to low performance state
+      decision_skip_idle(core, hint.gpu, (unsigned int) state->params.iterationsBeforeSwitch, trust);
+
+      state->hints.idle = trust > 0;
+    }
+  }
+}
+
+static void send_snapshot(int client) {
+  // Iterate through each managed GPU
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[i];
+
+    if (!state->managed) {
+      continue;
+    }
+
+    // Send the current state of the GPU, so that the subscriber doesn't wait for the next change
+    char line[512];
+
+    snprintf(line, sizeof(line), "{\"event\":\"state\",\"gpu\":%u,\"uuid\":\"%s\",\"time\":%llu,\"pstate\":%u,\"owned\":%s,\"quarantined\":%s}\n",
+      i, state->uuid, get_epoch_ms(), state->pstateId, state->owned ? "true" : "false", state->quarantined ? "true" : "false");
+
+    subscribe_send(client, line);
+  }
+}
+
+static void process_peers(unsigned long hold) {
+  // Variable to hold the name of the peer
+  char peer[PEERS_NAME_MAX];
+
+  // Drain all pending announcements
+  while (peers_receive(peer, sizeof(peer))) {
+    // Print the announcement
+    printf("Peer %s ramped, pre-ramping\n", peer);
+
+    // Keep the managed GPUs hosting processes of the job in high performance state, the collective waits for the slowest node
+    unsigned long long until = get_time_ms() + hold;
+
+    for (unsigned int i = 0; i < deviceCount; i++) {
+      if (gpuStates[i].managed && !gpuStates[i].quarantined && peers_hosts_job(&gpuStates[i].processes)) {
+        gpuStates[i].peers.busyUntil = until;
+        trace_event(i, "peer ramp");
+      }
+    }
+  }
+}
+
+static int predict_idle_switch(void * user, unsigned int i) {
+  // The policy model is shared by all GPUs
+  (void) user;
+
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Evaluate the policy model on the features of the GPU
+  unsigned long long start = get_time_ns();
+  float saving = model_predict(&policyModel, state->model.features.values);
+
+  // Account the evaluation
+  state->model.evaluations++;
+  state->model.evaluationTime += get_time_ns() - start;
+
+  // Switch when the model predicts a net saving
+  return saving > 0;
+}
+
+static void apply_profiles(unsigned int i) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Start from the parameters of the arm
+  state->params = state->baseParams;
+
+  // Apply the overrides of the active schedule rule, the rules were validated on startup
+  if (scheduleActive >= 0) {
+    parse_params(scheduleRules[scheduleActive].params, &state->params);
+  }
+
+  // Apply the overrides of the current workload class, the profiles were validated on startup
+  parse_params(classProfiles[state->classifier.current], &state->params);
+
+  // Apply the overrides of the canary arm last, so that the arms are compared on their own parameters
+  if (state->arm == 1 && canaryOverrides != NULL) {
+    parse_params(canaryOverrides, &state->params);
+  }
+
+  // Hand the parameters to the core, which takes the decisions of every iteration, with the policy model if loaded
+  pstated_policy policy = {
+    .size = sizeof(policy),
+    .performanceStateHigh = (unsigned int) state->params.performanceStateHigh,
+    .performanceStateLow = (unsigned int) state->params.performanceStateLow,
+    .iterationsBeforeSwitch = (unsigned int) state->params.iterationsBeforeSwitch,
+    .temperatureThreshold = (unsigned int) state->params.temperatureThreshold,
+    .predictIdle = policyModel.count > 0 ? predict_idle_switch : NULL,
+  };
+
+  if (pstated_policy_set(core, i, &policy) != PSTATED_OK) {
+    fprintf(stderr, "Invalid parameters for GPU %u, keeping the previous ones\n", i);
+  }
+}
+
+static const char * schedule_profile_name(int rule) {
+  // Return the name of the rule, or "default" if no rule matches
+  return rule >= 0 ? scheduleRules[rule].name : "default";
+}
+
+static bool update_schedule(time_t now) {
+  // Variable to hold the local time
+  struct tm local;
+
+  // Keep the current profile if the local time is not available
+  if (!schedule_local_time(now, &local)) {
+    return false;
+  }
+
+  // Find the rule matching the local time
+  int rule = schedule_match(scheduleRules, scheduleRuleCount, &local);
+
+  // Nothing to do if the profile didn't change
+  if (rule == scheduleActive) {
+    return false;
+  }
+
+  // Switch to the new profile
+  scheduleActive = rule;
+
+  // Return true to indicate a change
+  return true;
+}
+
+static void print_schedule(time_t start) {
+  // Start at the beginning of the current minute
+  start -= start % 60;
+
+  // Profile active at the previous minute
+  int previous = -2;
+
+  // Step through the covered days minute by minute in virtual time
+  for (time_t now = start; now < start + SCHEDULE_DRY_RUN_DAYS * 24 * 60 * 60; now += 60) {
+    // Variable to hold the local time
+    struct tm local;
+
+    // Skip minutes that can't be converted
+    if (!schedule_local_time(now, &local)) {
+      continue;
+    }
+
+    // Find the rule matching the virtual time
+    int rule = schedule_match(scheduleRules, scheduleRuleCount, &local);
+
+    // Print the profile changes
+    if (rule != previous) {
+      // Buffer to hold the formatted time
+      char buffer[32];
+
+      // Format the time
+      strftime(buffer, sizeof(buffer), "%a %Y-%m-%d %H:%M", &local);
+
+      // Print the change
+      if (rule >= 0) {
+        printf("%s  %-16s %s\n", buffer, scheduleRules[rule].name, scheduleRules[rule].params);
+      } else {
+        printf("%s  default\n", buffer);
+      }
+
+      // Remember the profile
+      previous = rule;
+    }
+  }
+}
+
+static void print_history_query(const char *dir, historyMetric metric, unsigned long long window, const unsigned long *ids, size_t idsCount) {
+  // Query the window ending now
+  unsigned long long now = (unsigned long long) time(NULL);
+
+  // Flag to indicate if any GPU has a history
+  bool found = false;
+
+  // Iterate through the requested GPUs, or all GPUs with a history
+  for (unsigned int i = 0; i < (idsCount > 0 ? idsCount : NVAPI_MAX_PHYSICAL_GPUS); i++) {
+    // Get the index of the GPU
+    unsigned int gpu = idsCount > 0 ? (unsigned int) ids[i] : i;
+
+    // Variable to hold the result
+    historySummary summary;
+
+    // Skip GPUs without a history
+    if (!history_query(dir, gpu, metric, now > window ? now - window : 0, now, &summary)) {
+      continue;
+    }
+
+    found = true;
+
+    // Print the result
+    if (summary.points > 0) {
+      printf("GPU %u %s over %llu s (%s tier, %lu points): min %.2f, max %.2f, avg %.2f, p95 %.2f\n", gpu, history_metric_name(metric), window, history_tier_name(summary.tier), summary.points, summary.min, summary.max, summary.avg, summary.p95);
+    } else {
+      printf("GPU %u %s over %llu s (%s tier): no data\n", gpu, history_metric_name(metric), window, history_tier_name(summary.tier));
+    }
+  }
+
+  // Print a notice if there is no history at all
+  if (!found) {
+    printf("No history found in %s\n", dir);
+  }
+}
+
+static bool print_history_benchmark(unsigned long interval) {
+  // Buffer to hold the path of a temporary directory, so that no existing history is touched
+  char dir[HISTORY_PATH_MAX];
+
+  // Create the temporary directory
+  #ifdef _WIN32
+    char base[MAX_PATH];
+
+    if (GetTempPathA(sizeof(base), base) == 0 || snprintf(dir, sizeof(dir), "%spstated-history-%lu", base, GetCurrentProcessId()) >= (int) sizeof(dir) || !CreateDirectoryA(dir, NULL)) {
+      fprintf(stderr, "Unable to create a temporary history directory\n");
+      return false;
+    }
+  #else
+    const char *base = getenv("TMPDIR");
+
+    if (snprintf(dir, sizeof(dir), "%s/pstated-history-XXXXXX", base != NULL && *base != '\0' ? base : "/tmp") >= (int) sizeof(dir) || mkdtemp(dir) == NULL) {
+      perror("Unable to create a temporary history directory");
+      return false;
+    }
+  #endif
+
+  // Series to record the simulated samples into
+  historySeries series;
+
+  // Simulate the days up to now, one sample per sleep interval
+  unsigned long long end = (unsigned long long) time(NULL);
+  unsigned long long start = end - HISTORY_BENCHMARK_DAYS * 86400ULL;
+  unsigned long long samples = HISTORY_BENCHMARK_DAYS * 86400ULL * 1000 / interval;
+
+  // Open the history of GPU 0
+  bool opened = history_open(&series, dir, 0);
+
+  if (opened) {
+    // State of the simulated GPU and of the pseudo-random generator
+    double temperature = 35;
+    bool busy = false;
+    unsigned int seed = 1;
+
+    for (unsigned long long k = 0; k < samples; k++) {
+      // Toggle between busy and idle phases now and then
+      seed = seed * 1103515245 + 12345;
+      if ((seed >> 16) % 1000 < 2) {
+        busy = !busy;
+      }
+
+      // Utilization while busy varies, temperature follows the utilization slowly
+      unsigned int utilization = busy ? 60 + (seed >> 20) % 41 : 0;
+      temperature += (35 + 0.45 * utilization - temperature) * 0.01;
+
+      // Record the sample at its virtual time
+      double values[HISTORY_METRIC_COUNT] = {
+        [HISTORY_TEMPERATURE] = (unsigned int) temperature,
+        [HISTORY_UTILIZATION] = utilization,
+      };
+
+      history_append(&series, start + k * interval / 1000, values);
+    }
+
+    // Time spent appending
+    unsigned long long appendTime = series.appendTime;
+
+    // Write the partial blocks
+    history_close(&series);
+
+    // Print the append cost
+    printf("Appended %llu samples (%u days at %lu ms): %.1f ns per append\n", samples, HISTORY_BENCHMARK_DAYS, interval, (double) appendTime / samples);
+
+    // Print the size of each tier
+    for (unsigned int t = 0; t < HISTORY_TIER_COUNT; t++) {
+      printf("  %s tier: %llu bytes\n", history_tier_name(t), history_size(dir, 0, t, start, end));
+    }
+  }
+
+  // Remove the files and the temporary directory
+  history_remove(dir, 0, start, end);
+
+  #ifdef _WIN32
+    RemoveDirectoryA(dir);
+  #else
+    rmdir(dir);
+  #endif
+
+  // Return true to indicate success
+  return opened;
+}
+
+static void wait_ms(unsigned long ms) {
+  #ifdef _WIN32
+    Sleep(ms);
+  #elif __linux__
+    usleep(ms * 1000);
+  #endif
+}
+
+static bool write_point(unsigned int i, const calibrationPoint * point) {
+  // Set the clocks of a clock point
+  if (point->pstateId == 16) {
+    nvmlReturn_t result = nvmlDeviceSetApplicationsClocks(nvmlDevices[i], point->memClock, point->gpuClock);
+    if (result != NVML_SUCCESS) {
+      fprintf(stderr, "Unable to set clocks for GPU %u to Memory: %u MHz, GPU: %u MHz: %s\n",
+              i, point->memClock, point->gpuClock, nvmlErrorString(result));
+      return false;
+    }
+
+    return true;
+  }
+
+  // Force the performance state
+  return apply_pstate(i, point->pstateId);
+}
+
+static bool reached_point(unsigned int i, const calibrationPoint * point) {
+  // Read the applied clocks back
+  if (point->pstateId == 16) {
+    unsigned int memClock, gpuClock;
+
+    return nvmlDeviceGetApplicationsClock(nvmlDevices[i], NVML_CLOCK_MEM, &memClock) == NVML_SUCCESS &&
+           nvmlDeviceGetApplicationsClock(nvmlDevices[i], NVML_CLOCK_GRAPHICS, &gpuClock) == NVML_SUCCESS &&
+           memClock == point->memClock && gpuClock == point->gpuClock;
+  }
+
+  // Read the current performance state back
+  nvmlPstates_t pstate;
+
+  return nvmlDeviceGetPerformanceState(nvmlDevices[i], &pstate) == NVML_SUCCESS && (unsigned int) pstate == point->pstateId;
+}
+
+static bool move_to_point(unsigned int i, const calibrationPoint * point, unsigned long long * latency) {
+  // Remember the time of the write
+  unsigned long long start = get_time_ms();
+
+  if (!write_point(i, point)) {
+    return false;
+  }
+
+  // Wait for the point to show in the read-back
+  while (!reached_point(i, point)) {
+    if (get_time_ms() - start >= CALIBRATE_TIMEOUT) {
+      return false;
+    }
+
+    wait_ms(CALIBRATE_POLL_INTERVAL);
+  }
+
+  // Measure the latency
+  *latency = get_time_ms() - start;
+
+  return true;
+}
+
+static bool measure_idle_power(unsigned int i, double * power) {
+  // Sum of the samples (in milliwatts) and their count
+  double sum = 0;
+  unsigned int count = 0;
+
+  for (unsigned long elapsed = 0; elapsed < CALIBRATE_POWER_WINDOW; elapsed += CALIBRATE_POWER_INTERVAL) {
+    wait_ms(CALIBRATE_POWER_INTERVAL);
+
+    // Check that the GPU is still idle, the power draw of a busy GPU says nothing about the point
+    nvmlUtilization_t rates;
+
+    if (nvmlDeviceGetUtilizationRates(nvmlDevices[i], &rates) == NVML_SUCCESS && rates.gpu > CALIBRATE_IDLE_THRESHOLD) {
+      fprintf(stderr, "GPU %u got busy during calibration\n", i);
+      return false;
+    }
+
+    // Sample the power draw
+    unsigned int sample;
+
+    nvmlReturn_t result = nvmlDeviceGetPowerUsage(nvmlDevices[i], &sample);
+    if (result != NVML_SUCCESS) {
+      fprintf(stderr, "Unable to get power usage for GPU %u: %s\n", i, nvmlErrorString(result));
+      return false;
+    }
+
+    sum += sample;
+    count++;
+  }
+
+  // Average the samples
+  *power = count > 0 ? sum / count / 1000.0 : 0;
+
+  return true;
+}
+
+static unsigned int list_points(unsigned int i, calibrationPoint points[CALIBRATION_MAX_POINTS]) {
+  // Number of points found
+  unsigned int count = 0;
+
+  // List the supported performance states, the lowest number is the high point
+  nvmlPstates_t pstates[NVML_MAX_GPU_PERF_PSTATES];
+
+  if (nvmlDeviceGetSupportedPerformanceStates(nvmlDevices[i], pstates, NVML_MAX_GPU_PERF_PSTATES) == NVML_SUCCESS) {
+    for (unsigned int id = 0; id < NVML_MAX_GPU_PERF_PSTATES; id++) {
+      for (unsigned int j = 0; j < NVML_MAX_GPU_PERF_PSTATES; j++) {
+        if ((unsigned int) pstates[j] == id) {
+          points[count++] = (calibrationPoint) { .pstateId = id };
+          break;
+        }
+      }
+    }
+  }
+
+  // Use the performance states if the high one can be forced
+  if (count > 1 && write_point(i, &points[0])) {
+    return count;
+  }
+
+  // Fall back to clock points, like the daemon does when performance states can't be forced
+  if (!enableClockFallback) {
+    return 0;
+  }
+
+  fprintf(stderr, "Failed to force pstates for GPU %u, calibrating clocks instead\n", i);
+
+  // List the supported memory clocks
+  unsigned int memClocks[256];
+  unsigned int memClockCount = 256;
+
+  if (nvmlDeviceGetSupportedMemoryClocks(nvmlDevices[i], &memClockCount, memClocks) != NVML_SUCCESS) {
+    return 0;
+  }
+
+  // Keep the first slot for the high point
+  count = 1;
+
+  // Highest memory clock and its highest GPU clock
+  unsigned int highMemClock = 0;
+  unsigned int highGpuClock = 0;
+
+  for (unsigned int j = 0; j < memClockCount && count < CALIBRATION_MAX_POINTS; j++) {
+    // List the GPU clocks of the memory clock
+    unsigned int gpuClocks[512];
+    unsigned int gpuClockCount = 512;
+
+    if (nvmlDeviceGetSupportedGraphicsClocks(nvmlDevices[i], memClocks[j], &gpuClockCount, gpuClocks) != NVML_SUCCESS || gpuClockCount == 0) {
+      continue;
+    }
+
+    // Find the lowest and highest GPU clocks
+    unsigned int lowest = gpuClocks[0];
+    unsigned int highest = gpuClocks[0];
+
+    for (unsigned int k = 1; k < gpuClockCount; k++) {
+      lowest = gpuClocks[k] < lowest ? gpuClocks[k] : lowest;
+      highest = gpuClocks[k] > highest ? gpuClocks[k] : highest;
+    }
+
+    // Remember the highest clocks
+    if (memClocks[j] > highMemClock) {
+      highMemClock = memClocks[j];
+      highGpuClock = highest;
+    }
+
+    // Each memory clock with its lowest GPU clock is a low point
+    points[count++] = (calibrationPoint) { .pstateId = 16, .memClock = memClocks[j], .gpuClock = lowest };
+  }
+
+  // The highest clocks are the high point
+  points[0] = (calibrationPoint) { .pstateId = 16, .memClock = highMemClock, .gpuClock = highGpuClock };
+
+  return count > 1 ? count : 0;
+}
+
+static bool calibrate_gpu(unsigned int i, calibration * result) {
+  // Start from an empty calibration
+  memset(result, 0, sizeof(*result));
+  snprintf(result->driver, sizeof(result->driver), "%s", driverVersion);
+
+  // Check that the GPU is idle
+  nvmlUtilization_t rates;
+
+  if (nvmlDeviceGetUtilizationRates(nvmlDevices[i], &rates) != NVML_SUCCESS || rates.gpu > CALIBRATE_IDLE_THRESHOLD) {
+    fprintf(stderr, "GPU %u is busy, skipping calibration\n", i);
+    return false;
+  }
+
+  // List the points to walk
+  calibrationPoint points[CALIBRATION_MAX_POINTS];
+  unsigned int count = list_points(i, points);
+
+  if (count == 0) {
+    fprintf(stderr, "GPU %u has no performance states or clocks to calibrate\n", i);
+    return false;
+  }
+
+  // Flag to indicate that all points could be measured
+  bool ok = true;
+
+  // Walk each point, the first one is the high point itself
+  for (unsigned int j = 0; j < count; j++) {
+    // Get the point
+    calibrationPoint * point = &points[j];
+
+    // Description of the point
+    char name[64];
+
+    if (point->pstateId == 16) {
+      snprintf(name, sizeof(name), "%u/%u MHz", point->memClock, point->gpuClock);
+    } else {
+      snprintf(name, sizeof(name), "P%u", point->pstateId);
+    }
+
+    // Start from the high point
+    unsigned long long latency;
+
+    if (!move_to_point(i, &points[0], &latency)) {
+      fprintf(stderr, "GPU %u didn't return to the high point within %u ms\n", i, CALIBRATE_TIMEOUT);
+      ok = false;
+      break;
+    }
+
+    // Move to the point, some states are only entered under load
+    if (!move_to_point(i, point, &point->settle)) {
+      fprintf(stderr, "GPU %u didn't show %s within %u ms, skipping it\n", i, name, CALIBRATE_TIMEOUT);
+      continue;
+    }
+
+    // Measure the idle power draw at the point
+    if (!measure_idle_power(i, &point->power)) {
+      ok = false;
+      break;
+    }
+
+    // Return to the high point
+    if (!move_to_point(i, &points[0], &point->returnLatency)) {
+      fprintf(stderr, "GPU %u didn't return to the high point within %u ms\n", i, CALIBRATE_TIMEOUT);
+      ok = false;
+      break;
+    }
+
+    // Print the measurements
+    printf("GPU %u %s: settle %llu ms, idle power %.1f W, return %llu ms\n", i, name, point->settle, point->power, point->returnLatency);
+
+    // Keep the point
+    result->points[result->count++] = *point;
+  }
+
+  // Hand the GPU back to the driver
+  if (points[0].pstateId == 16) {
+    nvmlDeviceResetApplicationsClocks(nvmlDevices[i]);
+  } else {
+    apply_pstate(i, PSTATED_PSTATE_AUTO);
+  }
+
+  // The high point and at least one other point are needed
+  return ok && result->count > 1;
+}
+
+static bool calibrate_gpus(const char * dir) {
+  // Models calibrated so far
+  char models[NVAPI_MAX_PHYSICAL_GPUS][256];
+  unsigned int modelCount = 0;
+
+  // Iterate through each GPU
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[i];
+
+    // Skip unmanaged GPUs and GPUs owned by another process
+    if (!state->managed || !state->owned) {
+      continue;
+    }
+
+    // Retrieve the GPU name
+    char gpuName[256];
+
+    if (nvmlDeviceGetName(nvmlDevices[i], gpuName, sizeof(gpuName)) != NVML_SUCCESS) {
+      continue;
+    }
+
+    // Calibrate one GPU per model, the file is shared by all GPUs of the model
+    bool calibrated = false;
+
+    for (unsigned int m = 0; m < modelCount; m++) {
+      if (strcmp(models[m], gpuName) == 0) {
+        calibrated = true;
+      }
+    }
+
+    if (calibrated) {
+      continue;
+    }
+
+    // Walk the points of the GPU
+    printf("Calibrating GPU %u (%s)...\n", i, gpuName);
+
+    calibration result;
+
+    if (!calibrate_gpu(i, &result)) {
+      continue;
+    }
+
+    // Write the calibration file of the model
+    if (!calibration_save(&result, dir, gpuName)) {
+      return false;
+    }
+
+    // Remember the model
+    snprintf(models[modelCount++], sizeof(models[0]), "%s", gpuName);
+  }
+
+  // Report an error if no GPU could be calibrated
+  if (modelCount == 0) {
+    printf("Can't find idle GPUs to calibrate!\n");
+    return false;
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+static void apply_calibration(unsigned int i, bool lowStateGiven) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Find the point with the lowest idle power that returns to high fastest
+  const calibrationPoint * point = calibration_recommend(&state->calibration, CALIBRATION_POWER_TOLERANCE);
+
+  // Print the calibration
+  printf("GPU %u calibration loaded (driver %s, %u points)\n", i, state->calibration.driver, state->calibration.count);
+
+  // Keep the configured low state if it was given, or if there is nothing to pick
+  if (point == NULL || lowStateGiven) {
+    return;
+  }
+
+  if (point->pstateId != 16) {
+    // Use the calibrated low performance state
+    state->baseParams.performanceStateLow = point->pstateId;
+
+    printf("GPU %u calibrated low state: P%u (idle power %.1f W, return %llu ms)\n", i, point->pstateId, point->power, point->returnLatency);
+  } else if (state->baseParams.clockFreqMemLow == 0 && state->baseParams.clockFreqGpuLow == 0) {
+    // Use the calibrated low clocks instead of the lowest supported ones
+    state->baseParams.clockFreqMemLow = point->memClock;
+    state->baseParams.clockFreqGpuLow = point->gpuClock;
+
+    printf("GPU %u calibrated low clocks: Memory %u MHz, GPU %u MHz (idle power %.1f W, return %llu ms)\n", i, point->memClock, point->gpuClock, point->power, point->returnLatency);
+  }
+}
+
+static void write_metrics(const char *path) {
+  // Open the metrics file
+  FILE *file = metrics_open(path);
+
+  // Skip this update if the file could not be opened
+  if (file == NULL) {
+    return;
+  }
+
+  // Buffer to hold performance state labels
+  char label[16];
+
+  // Energy consumption
+  metrics_header(file, "energy_joules_total", "counter", "Energy consumed since the daemon started.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed && gpuStates[i].stats.energySupported) {
+      update_energy(i);
+      metrics_gpu_label_value(file, "energy_joules_total", i, "arm", armNames[gpuStates[i].arm], gpuStates[i].stats.energy / 1000.0);
+    }
+  }
+
+  // Performance state transitions
+  metrics_header(file, "transitions_total", "counter", "Number of performance state transitions.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_label_value(file, "transitions_total", i, "arm", armNames[gpuStates[i].arm], gpuStates[i].stats.transitions);
+    }
+  }
+
+  // Ramps and ramp penalty
+  metrics_header(file, "ramps_total", "counter", "Number of ramps from low to high performance state.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_label_value(file, "ramps_total", i, "arm", armNames[gpuStates[i].arm], gpuStates[i].stats.ramps);
+    }
+  }
+
+  metrics_header(file, "ramp_penalty_seconds_total", "counter", "Time work was pending while the GPU was ramping up.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_label_value(file, "ramp_penalty_seconds_total", i, "arm", armNames[gpuStates[i].arm], gpuStates[i].stats.rampPenalty / 1000.0);
+    }
+  }
+
+  // Time spent in each performance state
+  metrics_header(file, "pstate_seconds_total", "counter", "Time spent in each performance state.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    for (unsigned int j = 0; gpuStates[i].managed && j < STATS_PSTATE_COUNT; j++) {
+      if (gpuStates[i].stats.timeInState[j] != 0) {
+        snprintf(label, sizeof(label), "%u", j);
+        metrics_gpu_labels_value(file, "pstate_seconds_total", i, "arm", armNames[gpuStates[i].arm], "pstate", label, gpuStates[i].stats.timeInState[j] / 1000.0);
+      }
+    }
+  }
+
+  // Workload class and class residency
+  metrics_header(file, "workload_class", "gauge", "Current workload class (1 for the active class).");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    for (unsigned int j = 0; gpuStates[i].managed && j < WORKLOAD_CLASS_COUNT; j++) {
+      metrics_gpu_label_value(file, "workload_class", i, "class", workload_class_name(j), gpuStates[i].classifier.current == j);
+    }
+  }
+
+  metrics_header(file, "workload_class_seconds_total", "counter", "Time spent in each workload class.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    for (unsigned int j = 0; gpuStates[i].managed && j < WORKLOAD_CLASS_COUNT; j++) {
+      metrics_gpu_label_value(file, "workload_class_seconds_total", i, "class", workload_class_name(j), gpuStates[i].classifier.residency[j] / 1000.0);
+    }
+  }
+
+  metrics_header(file, "workload_class_changes_total", "counter", "Number of workload class changes.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "workload_class_changes_total", i, gpuStates[i].classifier.changes);
+    }
+  }
+
+  // Predictive thermal model
+  metrics_header(file, "thermal_forecast_celsius", "gauge", "Temperature forecasted by the predictive thermal model at the horizon.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed && thermal_ready(&gpuStates[i].thermal)) {
+      metrics_gpu_value(file, "thermal_forecast_celsius", i, gpuStates[i].thermal.forecast);
+    }
+  }
+
+  metrics_header(file, "thermal_forecast_error_celsius", "gauge", "Mean absolute error of the thermal forecasts at the horizon.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed && gpuStates[i].thermal.errorCount > 0) {
+      metrics_gpu_value(file, "thermal_forecast_error_celsius", i, thermal_mean_error(&gpuStates[i].thermal));
+    }
+  }
+
+  metrics_header(file, "thermal_interventions_total", "counter", "Number of early power limit reductions by the predictive thermal model.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed && gpuStates[i].powerLimit != 0) {
+      metrics_gpu_value(file, "thermal_interventions_total", i, gpuStates[i].thermalInterventions);
+    }
+  }
+
+  metrics_header(file, "thermal_reduction_watts", "gauge", "Power reduction requested by the node-level thermal controller, for the GPU's own heat or its neighbors'.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed && gpuStates[i].powerLimit != 0) {
+      metrics_gpu_label_value(file, "thermal_reduction_watts", i, "cause", "own", gpuStates[i].ownReduction);
+      metrics_gpu_label_value(file, "thermal_reduction_watts", i, "cause", "neighbor", gpuStates[i].sharedReduction);
+    }
+  }
+
+  metrics_header(file, "thermal_coupling_celsius_per_watt", "gauge", "Steady-state temperature rise of the GPU per watt drawn by the source GPU.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    for (unsigned int j = 0; gpuStates[i].managed && thermal_ready(&gpuStates[i].thermal) && j < deviceCount; j++) {
+      // Get the coupling coefficient of the pair
+      double coefficient = coupling_coefficient(&coupling, i, j);
+
+      // Only print coupled pairs
+      if (coefficient > 0) {
+        snprintf(label, sizeof(label), "%u", j);
+        metrics_gpu_label_value(file, "thermal_coupling_celsius_per_watt", i, "source", label, coefficient / -gpuStates[i].thermal.theta[1]);
+      }
+    }
+  }
+
+  metrics_header(file, "thermal_coordinated_steps_total", "counter", "Number of thermal steps that reduced a GPU on behalf of a coupled GPU.");
+  metrics_value(file, "thermal_coordinated_steps_total", thermalCoordinatedSteps);
+
+  metrics_header(file, "fan_speed_percent", "gauge", "Fan speed set by the daemon (absent while the driver controls the fans).");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed && gpuStates[i].fans.controlled) {
+      metrics_gpu_value(file, "fan_speed_percent", i, gpuStates[i].fans.speed);
+    }
+  }
+
+  metrics_header(file, "thermal_decisions_total", "counter", "Number of thermal decisions, handled by raising the fans or by cutting clocks or power.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_label_value(file, "thermal_decisions_total", i, "action", "fan", gpuStates[i].fans.decisions);
+      metrics_gpu_label_value(file, "thermal_decisions_total", i, "action", "clock", gpuStates[i].clockDecisions);
+    }
+  }
+
+  metrics_header(file, "hints_total", "counter", "Number of hints received from applications.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_label_value(file, "hints_total", i, "type", "busy", gpuStates[i].hints.busyCount);
+      metrics_gpu_label_value(file, "hints_total", i, "type", "idle", gpuStates[i].hints.idleCount);
+    }
+  }
+
+  metrics_header(file, "hint_latency_seconds", "summary", "Latency from sending a busy hint to entering the high performance state.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "hint_latency_seconds_sum", i, gpuStates[i].hints.latencySum / 1000.0);
+      metrics_gpu_value(file, "hint_latency_seconds_count", i, gpuStates[i].hints.latencyCount);
+    }
+  }
+
+  metrics_header(file, "hint_latency_max_seconds", "gauge", "Maximum latency from sending a busy hint to entering the high performance state.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "hint_latency_max_seconds", i, gpuStates[i].hints.latencyMax / 1000.0);
+    }
+  }
+
+  metrics_header(file, "ramp_delay_seconds", "summary", "Time ramps were held back by the ramp scheduler.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "ramp_delay_seconds_sum", i, gpuStates[i].ramp.delaySum / 1000.0);
+      metrics_gpu_value(file, "ramp_delay_seconds_count", i, gpuStates[i].ramp.delayCount);
+    }
+  }
+
+  metrics_header(file, "ramp_delay_max_seconds", "gauge", "Maximum time a ramp was held back by the ramp scheduler.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "ramp_delay_max_seconds", i, gpuStates[i].ramp.delayMax / 1000.0);
+    }
+  }
+
+  metrics_header(file, "ramps_overdue_total", "counter", "Number of ramps released by the maximum delay rather than the stagger or power budget.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "ramps_overdue_total", i, gpuStates[i].ramp.overdue);
+    }
+  }
+
+  metrics_header(file, "host_cpu_cores", "gauge", "CPU load of the processes on the GPU.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "host_cpu_cores", i, gpuStates[i].cpu.load);
+    }
+  }
+
+  metrics_header(file, "host_cpu_pre_ramps_total", "counter", "Number of pre-ramps on host-CPU activity, by whether GPU work followed.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_label_value(file, "host_cpu_pre_ramps_total", i, "outcome", "hit", gpuStates[i].cpu.preRampHits);
+      metrics_gpu_label_value(file, "host_cpu_pre_ramps_total", i, "outcome", "false", gpuStates[i].cpu.preRampMisses);
+    }
+  }
+
+  metrics_header(file, "host_cpu_lead_seconds", "summary", "Time between a pre-ramp on host-CPU activity and the GPU work that followed.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "host_cpu_lead_seconds_sum", i, gpuStates[i].cpu.leadSum / 1000.0);
+      metrics_gpu_value(file, "host_cpu_lead_seconds_count", i, gpuStates[i].cpu.preRampHits);
+    }
+  }
+
+  metrics_header(file, "schedule_profile", "gauge", "Active schedule profile (1 for the active profile).");
+  metrics_label_value(file, "schedule_profile", "profile", "default", scheduleActive < 0);
+  for (unsigned int i = 0; i < scheduleRuleCount; i++) {
+    metrics_label_value(file, "schedule_profile", "profile", scheduleRules[i].name, scheduleActive == (int) i);
+  }
+
+  metrics_header(file, "history_append_seconds", "summary", "Time spent appending samples to the history.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed && gpuStates[i].history.appends > 0) {
+      metrics_gpu_value(file, "history_append_seconds_sum", i, gpuStates[i].history.appendTime / 1e9);
+      metrics_gpu_value(file, "history_append_seconds_count", i, gpuStates[i].history.appends);
+    }
+  }
+
+  metrics_header(file, "owned", "gauge", "Whether the daemon owns the GPU.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "owned", i, gpuStates[i].owned);
+    }
+  }
+
+  metrics_header(file, "foreign_writes_total", "counter", "Number of changes to the GPU state made by another process.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "foreign_writes_total", i, gpuStates[i].foreignWrites);
+    }
+  }
+
+  metrics_header(file, "ownership_events_total", "counter", "Number of takeovers, yields and reasserts.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_label_value(file, "ownership_events_total", i, "event", "takeover", gpuStates[i].takeovers);
+      metrics_gpu_label_value(file, "ownership_events_total", i, "event", "yield", gpuStates[i].yields);
+      metrics_gpu_label_value(file, "ownership_events_total", i, "event", "reassert", gpuStates[i].reasserts);
+    }
+  }
+
+  metrics_header(file, "peer_announcements_total", "counter", "Number of ramp announcements sent to and received from the peers of the job.");
+  metrics_label_value(file, "peer_announcements_total", "direction", "sent", peers_sent());
+  metrics_label_value(file, "peer_announcements_total", "direction", "received", peers_received());
+
+  metrics_header(file, "peer_ramps_total", "counter", "Number of ramps triggered by a ramp of a peer of the job.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "peer_ramps_total", i, gpuStates[i].peers.ramps);
+    }
+  }
+
+  if (policyModel.count > 0) {
+    metrics_header(file, "model_evaluations_total", "counter", "Number of evaluations of the policy model.");
+    for (unsigned int i = 0; i < deviceCount; i++) {
+      if (gpuStates[i].managed) {
+        metrics_gpu_value(file, "model_evaluations_total", i, gpuStates[i].model.evaluations);
+      }
+    }
+
+    metrics_header(file, "model_evaluation_seconds_total", "counter", "Time spent evaluating the policy model.");
+    for (unsigned int i = 0; i < deviceCount; i++) {
+      if (gpuStates[i].managed) {
+        metrics_gpu_value(file, "model_evaluation_seconds_total", i, gpuStates[i].model.evaluationTime / 1e9);
+      }
+    }
+  }
+
+  metrics_header(file, "dcgm_samples_total", "counter", "Number of iterations that took the activity from DCGM instead of NVML.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "dcgm_samples_total", i, gpuStates[i].dcgmSamples);
+    }
+  }
+
+  metrics_header(file, "dcgm_errors_total", "counter", "Number of failed reads from the DCGM host engine.");
+  metrics_value(file, "dcgm_errors_total", dcgm_errors());
+
+  metrics_header(file, "transitions_verified_total", "counter", "Number of transitions confirmed by read-back.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "transitions_verified_total", i, gpuStates[i].verified);
+    }
+  }
+
+  metrics_header(file, "transition_verify_failures_total", "counter", "Number of read-backs that didn't show the transition by the deadline.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_label_value(file, "transition_verify_failures_total", i, "driver", driverVersion, gpuStates[i].verifyFailures);
+    }
+  }
+
+  metrics_header(file, "transition_escalations_total", "counter", "Number of switches to clock control after repeated failed transitions.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "transition_escalations_total", i, gpuStates[i].verifyEscalations);
+    }
+  }
+
+  metrics_header(file, "quarantined", "gauge", "Whether the GPU is quarantined after a fault.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "quarantined", i, gpuStates[i].quarantined);
+    }
+  }
+
+  metrics_header(file, "xid_errors_total", "counter", "Number of Xid errors reported by the event listener.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "xid_errors_total", i, gpuStates[i].xidEvents);
+    }
+  }
+
+  metrics_header(file, "change_events_total", "counter", "Number of clock and performance state change events.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "change_events_total", i, gpuStates[i].changeEvents);
+    }
+  }
+
+  metrics_header(file, "queue_depth", "gauge", "Queue depth reported by the inference server.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "queue_depth", i, gpuStates[i].queue.depth);
+    }
+  }
+
+  metrics_header(file, "queue_ramps_total", "counter", "Number of ramps triggered by a queued request before any utilization was seen.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed) {
+      metrics_gpu_value(file, "queue_ramps_total", i, gpuStates[i].queue.ramps);
+    }
+  }
+
+  metrics_header(file, "queue_scrape_errors_total", "counter", "Number of failed queue-depth scrapes.");
+  metrics_value(file, "queue_scrape_errors_total", queue_errors());
+
+  metrics_header(file, "subscribers", "gauge", "Number of clients connected to the subscription socket.");
+  metrics_value(file, "subscribers", subscribe_clients());
+
+  metrics_header(file, "subscribers_dropped_total", "counter", "Number of subscribers dropped because their queue overflowed.");
+  metrics_value(file, "subscribers_dropped_total", subscribe_dropped());
+
+  metrics_header(file, "power_limit_watts", "gauge", "Current power limit.");
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (gpuStates[i].managed && gpuStates[i].powerLimit != 0) {
+      metrics_gpu_value(file, "power_limit_watts", i, gpuStates[i].powerLimit / 1000.0);
+    }
+  }
+
+  // Close and publish the metrics file
+  metrics_close(file, path);
+}
+
+static void print_arm_report(unsigned long long uptime) {
+  // Accumulated metrics and GPU count of each arm
+  gpuStats armStats[ARM_COUNT] = { 0 };
+  unsigned int armGPUs[ARM_COUNT] = { 0 };
+
+  // Iterate through each GPU
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[i];
+
+    // Skip unmanaged GPUs
+    if (!state->managed) {
+      continue;
+    }
+
+    // Read the current energy counter of the GPU
+    update_energy(i);
+
+    // Add the metrics of the GPU to its arm
+    stats_add(&armStats[state->arm], &state->stats);
+
+    // Count the GPU in its arm
+    armGPUs[state->arm]++;
+  }
+
+  // Print the report header
+  printf("Arm report after %llu s:\n", uptime / 1000);
+
+  // Print the metrics of each non-empty arm
+  for (unsigned int arm = 0; arm < ARM_COUNT; arm++) {
+    if (armGPUs[arm] != 0) {
+      stats_print(armNames[arm], armGPUs[arm], &armStats[arm]);
+    }
+  }
+}
+
+static int run(int argc, char * argv[]) {
+  /***** OPTIONS *****/
+  unsigned long ids[NVAPI_MAX_PHYSICAL_GPUS] = { 0 };
+  size_t idsCount = 0;
+  gpuParams params = {
+    .iterationsBeforeSwitch = ITERATIONS_BEFORE_SWITCH,
+    .performanceStateHigh = PERFORMANCE_STATE_HIGH,
+    .performanceStateLow = PERFORMANCE_STATE_LOW,
+    .temperatureThreshold = TEMPERATURE_THRESHOLD,
+    .clockFreqMemHigh = CLOCK_FREQ_MEM_HIGH,
+    .clockFreqGpuHigh = CLOCK_FREQ_GPU_HIGH,
+    .clockFreqMemLow = CLOCK_FREQ_MEM_LOW,
+    .clockFreqGpuLow = CLOCK_FREQ_GPU_LOW,
+  };
+  unsigned long sleepInterval = SLEEP_INTERVAL;
+  enableClockFallback = ENABLE_CLOCK_FALLBACK;
+  unsigned long canaryIds[NVAPI_MAX_PHYSICAL_GPUS] = { 0 };
+  size_t canaryIdsCount = 0;
+  unsigned long canaryPercent = CANARY_PERCENT;
+  const char * canaryParamsArg = NULL;
+  gpuParams canaryParams;
+  unsigned long reportInterval = REPORT_INTERVAL;
+  bool autoClassify = AUTO_CLASSIFY;
+  unsigned long classifyHysteresis = CLASSIFY_HYSTERESIS;
+  unsigned long classifyGapThreshold = CLASSIFY_GAP_THRESHOLD;
+  const char * metricsFile = NULL;
+  bool thermalPredict = THERMAL_PREDICT;
+  unsigned long thermalPredictHorizon = THERMAL_PREDICT_HORIZON;
+  unsigned long thermalPredictMargin = THERMAL_PREDICT_MARGIN;
+  bool thermalCoordinate = THERMAL_COORDINATE;
+  bool fanControl = FAN_CONTROL;
+  bool processTracking = PROCESS_TRACKING;
+  unsigned long processTrackingInterval = PROCESS_TRACKING_INTERVAL;
+  const char * processLogFile = NULL;
+  const char * hintSocketPath = NULL;
+  const char * hintGroup = NULL;
+  const char * subscribeSocketPath = NULL;
+  unsigned long hintTrust = HINT_TRUST;
+  const char * peerGroup = NULL;
+  const char * peerJob = PEER_JOB;
+  unsigned long peerHold = PEER_HOLD;
+  const char * policyModelPath = NULL;
+  const char * sampleLogPath = NULL;
+  bool cpuPredict = CPU_PREDICT;
+  unsigned long cpuPredictThreshold = CPU_PREDICT_THRESHOLD;
+  unsigned long cpuPredictIdle = CPU_PREDICT_IDLE;
+  unsigned long cpuPredictHold = CPU_PREDICT_HOLD;
+  queueConfig queue = { NULL, NULL, "gpu", QUEUE_INTERVAL };
+  dcgmConfig dcgm = { NULL, NULL, DCGM_ACTIVITY, SLEEP_INTERVAL };
+  bool scheduleDryRun = false;
+  const char * traceFile = NULL;
+  unsigned long traceWindow = TRACE_WINDOW;
+  bool calibrate = false;
+  const char * calibrationDir = NULL;
+  bool lowStateGiven = false;
+  const char * historyDir = NULL;
+  const char * historyQuery = NULL;
+  bool historyBenchmark = false;
+  rampScheduler ramps = {
+    .stagger = RAMP_STAGGER,
+    .budget = RAMP_POWER_BUDGET,
+    .window = RAMP_POWER_WINDOW,
+    .maxDelay = RAMP_MAX_DELAY,
+  };
+  unsigned long rampPriorities[NVAPI_MAX_PHYSICAL_GPUS] = { 0 };
+  bool eventsEnabled = EVENTS;
+  unsigned long faultXids[EVENTS_MAX_XIDS] = { 0 };
+  size_t faultXidCount = 0;
+  bool verifyTransitions = VERIFY_TRANSITIONS;
+  unsigned long verifyDeadline = VERIFY_DEADLINE;
+  unsigned long verifyRetries = VERIFY_RETRIES;
+  unsigned long verifyEscalate = VERIFY_ESCALATE;
+  bool ownershipLocking = OWNERSHIP_LOCK;
+  unsigned long ownershipBackoff = OWNERSHIP_BACKOFF;
+  foreignWritePolicy foreignWrites = FOREIGN_WRITE_POLICY;
+  unsigned long fanSpeedMax = FAN_SPEED_MAX;
+  unsigned long fanSpeedStep = FAN_SPEED_STEP;
+  unsigned long metricsInterval = METRICS_INTERVAL;
+
+  /***** OPTION PARSING *****/
   {
-    // Initialize NVAPI library
-    NVAPI_CALL(NvAPI_Initialize(), errored);
+    // Iterate through command-line arguments
+    for (unsigned int i = 1; i < argc; i++) {
+      // Check if the option is "-dh" or "--dcgm-host" and if there is a next argument
+      if ((IS_OPTION("-dh") || IS_OPTION("--dcgm-host")) && HAS_NEXT_ARG) {
+        // Store the address of the DCGM host engine
+        dcgm.host = argv[++i];
+      }
+
+      // Check if the option is "-da" or "--dcgm-activity" and if there is a next argument
+      if ((IS_OPTION("-da") || IS_OPTION("--dcgm-activity")) && HAS_NEXT_ARG) {
+        // Parse the name of the activity signal
+        ASSERT_TRUE(parse_dcgm_activity(argv[++i], &dcgm.activity), usage);
+      }
+
+      // Check if the option is "-dl" or "--dcgm-library" and if there is a next argument
+      if ((IS_OPTION("-dl") || IS_OPTION("--dcgm-library")) && HAS_NEXT_ARG) {
+        // Store the path of the DCGM library
+        dcgm.library = argv[++i];
+      }
+
+      // Check if the option is "-ev" or "--events"
+      if ((IS_OPTION("-ev") || IS_OPTION("--events"))) {
+        // Enable the event listener
+        eventsEnabled = true;
+      }
+
+      // Check if the option is "-fc" or "--fan-control"
+      if ((IS_OPTION("-fc") || IS_OPTION("--fan-control"))) {
+        // Enable fan control
+        fanControl = true;
+      }
+
+      // Check if the option is "-fsm" or "--fan-speed-max" and if there is a next argument
+      if ((IS_OPTION("-fsm") || IS_OPTION("--fan-speed-max")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in fanSpeedMax
+        ASSERT_TRUE(parse_ulong(argv[++i], &fanSpeedMax), usage);
+
+        // Check if the speed is out of range
+        ASSERT_TRUE(fanSpeedMax <= 100, usage);
+      }
+
+      // Check if the option is "-fss" or "--fan-speed-step" and if there is a next argument
+      if ((IS_OPTION("-fss") || IS_OPTION("--fan-speed-step")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in fanSpeedStep
+        ASSERT_TRUE(parse_ulong(argv[++i], &fanSpeedStep), usage);
+
+        // Check if the step is out of range
+        ASSERT_TRUE(fanSpeedStep > 0 && fanSpeedStep <= 100, usage);
+      }
+
+      // Check if the option is "-fw" or "--foreign-writes" and if there is a next argument
+      if ((IS_OPTION("-fw") || IS_OPTION("--foreign-writes")) && HAS_NEXT_ARG) {
+        // Parse the policy name
+        ASSERT_TRUE(parse_foreign_write_policy(argv[++i], &foreignWrites), usage);
+      }
+
+      // Check if the option is "-hs" or "--hint-socket" and if there is a next argument
+      if ((IS_OPTION("-hs") || IS_OPTION("--hint-socket")) && HAS_NEXT_ARG) {
+        // Store the path of the hint socket
+        hintSocketPath = argv[++i];
+      }
+
+      // Check if the option is "-hg" or "--hint-group" and if there is a next argument
+      if ((IS_OPTION("-hg") || IS_OPTION("--hint-group")) && HAS_NEXT_ARG) {
+        // Store the name of the group allowed to send hints
+        hintGroup = argv[++i];
+      }
+
+      // Check if the option is "-ht" or "--hint-trust" and if there is a next argument
+      if ((IS_OPTION("-ht") || IS_OPTION("--hint-trust")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in hintTrust
+        ASSERT_TRUE(parse_ulong(argv[++i], &hintTrust), usage);
+
+        // Check if the trust is out of range
+        ASSERT_TRUE(hintTrust <= 100, usage);
+      }
+
+      // Check if the option is "-hd" or "--history-dir" and if there is a next argument
+      if ((IS_OPTION("-hd") || IS_OPTION("--history-dir")) && HAS_NEXT_ARG) {
+        // Store the directory of the history files
+        historyDir = argv[++i];
+      }
+
+      // Check if the option is "-hq" or "--history-query" and if there is a next argument
+      if ((IS_OPTION("-hq") || IS_OPTION("--history-query")) && HAS_NEXT_ARG) {
+        // Store the "<metric>:<window>" query
+        historyQuery = argv[++i];
+      }
+
+      // Check if the option is "-hb" or "--history-benchmark"
+      if ((IS_OPTION("-hb") || IS_OPTION("--history-benchmark"))) {
+        // Benchmark the history store instead of running
+        historyBenchmark = true;
+      }
+
+      // Check if the option is "-i" or "--ids" and if there is a next argument
+      if ((IS_OPTION("-i") || IS_OPTION("--ids")) && HAS_NEXT_ARG) {
+        // Parse the integer array option and store it in ids
+        ASSERT_TRUE(parse_ulong_array(argv[++i], ",", NVAPI_MAX_PHYSICAL_GPUS, ids, &idsCount), usage);
+      }
+
+      // Check if the option is "-h" or "--help"
+      if ((IS_OPTION("-h") || IS_OPTION("--help"))) {
+        // Print usage instructions
+        goto usage;
+      }
+
+      // Check if the option is "-ibs" or "--iterations-before-switch" and if there is a next argument
+      if ((IS_OPTION("-ibs") || IS_OPTION("--iterations-before-switch")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in params.iterationsBeforeSwitch
+        ASSERT_TRUE(parse_ulong(argv[++i], &params.iterationsBeforeSwitch), usage);
+      }
+
+      // Check if the option is "-pt" or "--process-tracking"
+      if ((IS_OPTION("-pt") || IS_OPTION("--process-tracking"))) {
+        // Enable per-process accounting
+        processTracking = true;
+      }
+
+      // Check if the option is "-pti" or "--process-tracking-interval" and if there is a next argument
+      if ((IS_OPTION("-pti") || IS_OPTION("--process-tracking-interval")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in processTrackingInterval
+        ASSERT_TRUE(parse_ulong(argv[++i], &processTrackingInterval), usage);
+      }
 
-    // Mark NVAPI as initialized
-    nvapiInitialized = true;
-  }
+      // Check if the option is "-pl" or "--process-log" and if there is a next argument
+      if ((IS_OPTION("-pl") || IS_OPTION("--process-log")) && HAS_NEXT_ARG) {
+        // Store the path of the process log, which implies per-process accounting
+        processLogFile = argv[++i];
+        processTracking = true;
+      }
 
-  /***** NVML INIT *****/
-  {
-    // Initialize NVML library
-    NVML_CALL(nvmlInit(), errored);
+      // Check if the option is "-hcp" or "--host-cpu-predict"
+      if ((IS_OPTION("-hcp") || IS_OPTION("--host-cpu-predict"))) {
+        // Enable pre-ramps on host-CPU activity, which needs the processes of each GPU
+        cpuPredict = true;
+        processTracking = true;
+      }
+
+      // Check if the option is "-hct" or "--host-cpu-threshold" and if there is a next argument
+      if ((IS_OPTION("-hct") || IS_OPTION("--host-cpu-threshold")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in cpuPredictThreshold
+        ASSERT_TRUE(parse_ulong(argv[++i], &cpuPredictThreshold), usage);
+      }
+
+      // Check if the option is "-hci" or "--host-cpu-idle" and if there is a next argument
+      if ((IS_OPTION("-hci") || IS_OPTION("--host-cpu-idle")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in cpuPredictIdle
+        ASSERT_TRUE(parse_ulong(argv[++i], &cpuPredictIdle), usage);
+      }
+
+      // Check if the option is "-hch" or "--host-cpu-hold" and if there is a next argument
+      if ((IS_OPTION("-hch") || IS_OPTION("--host-cpu-hold")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in cpuPredictHold
+        ASSERT_TRUE(parse_ulong(argv[++i], &cpuPredictHold), usage);
+      }
+
+      // Check if the option is "-psh" or "--performance-state-high" and if there is a next argument
+      if ((IS_OPTION("-psh") || IS_OPTION("--performance-state-high")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in params.performanceStateHigh
+        ASSERT_TRUE(parse_ulong(argv[++i], &params.performanceStateHigh), usage);
+      }
+
+      // Check if the option is "-psl" or "--performance-state-low" and if there is a next argument
+      if ((IS_OPTION("-psl") || IS_OPTION("--performance-state-low")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in params.performanceStateLow
+        ASSERT_TRUE(parse_ulong(argv[++i], &params.performanceStateLow), usage);
+
+        // Prefer the given low state over the calibrated one
+        lowStateGiven = true;
+      }
+      
+      // Check if the option is "-cmh" or "--clock-mem-high" and if there is a next argument
+      if ((IS_OPTION("-cmh") || IS_OPTION("--clock-mem-high")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in params.clockFreqMemHigh
+        ASSERT_TRUE(parse_ulong(argv[++i], &params.clockFreqMemHigh), usage);
+      }
+      
+      // Check if the option is "-cgh" or "--clock-gpu-high" and if there is a next argument
+      if ((IS_OPTION("-cgh") || IS_OPTION("--clock-gpu-high")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in params.clockFreqGpuHigh
+        ASSERT_TRUE(parse_ulong(argv[++i], &params.clockFreqGpuHigh), usage);
+      }
+      
+      // Check if the option is "-cml" or "--clock-mem-low" and if there is a next argument
+      if ((IS_OPTION("-cml") || IS_OPTION("--clock-mem-low")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in params.clockFreqMemLow
+        ASSERT_TRUE(parse_ulong(argv[++i], &params.clockFreqMemLow), usage);
+      }
+      
+      // Check if the option is "-cgl" or "--clock-gpu-low" and if there is a next argument
+      if ((IS_OPTION("-cgl") || IS_OPTION("--clock-gpu-low")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in params.clockFreqGpuLow
+        ASSERT_TRUE(parse_ulong(argv[++i], &params.clockFreqGpuLow), usage);
+      }
+      
+      // Check if the option is "-ac" or "--auto-classify"
+      if ((IS_OPTION("-ac") || IS_OPTION("--auto-classify"))) {
+        // Enable automatic workload classification
+        autoClassify = true;
+      }
+
+      // Check if the option is "-acp" or "--auto-classify-profile" and if there is a next argument
+      if ((IS_OPTION("-acp") || IS_OPTION("--auto-classify-profile")) && HAS_NEXT_ARG) {
+        // Get the "<class>:<key=value,...>" argument
+        char * profile = argv[++i];
+
+        // Find the separator between class and parameters
+        char * separator = strchr(profile, ':');
+        ASSERT_TRUE(separator != NULL, usage);
+
+        // Split the argument into class and parameters
+        *separator = '\0';
+
+        // Parse the class name
+        workloadClass workload;
+        ASSERT_TRUE(parse_workload_class(profile, &workload), usage);
+
+        // Validate the parameters against a scratch copy
+        gpuParams scratch = params;
+        ASSERT_TRUE(parse_params(separator + 1, &scratch), usage);
+
+        // Store the profile of the class
+        classProfiles[workload] = separator + 1;
+      }
+
+      // Check if the option is "-ach" or "--auto-classify-hysteresis" and if there is a next argument
+      if ((IS_OPTION("-ach") || IS_OPTION("--auto-classify-hysteresis")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in classifyHysteresis
+        ASSERT_TRUE(parse_ulong(argv[++i], &classifyHysteresis), usage);
+      }
+
+      // Check if the option is "-acg" or "--auto-classify-gap" and if there is a next argument
+      if ((IS_OPTION("-acg") || IS_OPTION("--auto-classify-gap")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in classifyGapThreshold
+        ASSERT_TRUE(parse_ulong(argv[++i], &classifyGapThreshold), usage);
+      }
+
+      // Check if the option is "-cal" or "--calibrate"
+      if ((IS_OPTION("-cal") || IS_OPTION("--calibrate"))) {
+        // Measure the idle GPUs, write the calibration files and exit
+        calibrate = true;
+      }
+
+      // Check if the option is "-cd" or "--calibration-dir" and if there is a next argument
+      if ((IS_OPTION("-cd") || IS_OPTION("--calibration-dir")) && HAS_NEXT_ARG) {
+        // Store the directory of the calibration files
+        calibrationDir = argv[++i];
+      }
+
+      // Check if the option is "-ci" or "--canary-ids" and if there is a next argument
+      if ((IS_OPTION("-ci") || IS_OPTION("--canary-ids")) && HAS_NEXT_ARG) {
+        // Parse the integer array option and store it in canaryIds
+        ASSERT_TRUE(parse_ulong_array(argv[++i], ",", NVAPI_MAX_PHYSICAL_GPUS, canaryIds, &canaryIdsCount), usage);
+      }
+
+      // Check if the option is "-cp" or "--canary-percent" and if there is a next argument
+      if ((IS_OPTION("-cp") || IS_OPTION("--canary-percent")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in canaryPercent
+        ASSERT_TRUE(parse_ulong(argv[++i], &canaryPercent), usage);
+
+        // Check if the percentage is out of range
+        ASSERT_TRUE(canaryPercent <= 100, usage);
+      }
+
+      // Check if the option is "-cpa" or "--canary-params" and if there is a next argument
+      if ((IS_OPTION("-cpa") || IS_OPTION("--canary-params")) && HAS_NEXT_ARG) {
+        // Store the parameter overrides, they are applied after all options are parsed
+        canaryParamsArg = argv[++i];
+      }
+
+      // Check if the option is "-mf" or "--metrics-file" and if there is a next argument
+      if ((IS_OPTION("-mf") || IS_OPTION("--metrics-file")) && HAS_NEXT_ARG) {
+        // Store the path of the metrics file
+        metricsFile = argv[++i];
+      }
+
+      // Check if the option is "-mi" or "--metrics-interval" and if there is a next argument
+      if ((IS_OPTION("-mi") || IS_OPTION("--metrics-interval")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in metricsInterval
+        ASSERT_TRUE(parse_ulong(argv[++i], &metricsInterval), usage);
+      }
+
+      // Check if the option is "-nfc" or "--no-fallback-clocks"
+      if ((IS_OPTION("-nfc") || IS_OPTION("--no-fallback-clocks"))) {
+        // Disable clock fallback mode
+        enableClockFallback = false;
+      }
+
+      // Check if the option is "-ol" or "--ownership-lock"
+      if ((IS_OPTION("-ol") || IS_OPTION("--ownership-lock"))) {
+        // Take a per-GPU lock so that only one daemon manages each GPU
+        ownershipLocking = true;
+      }
+
+      // Check if the option is "-ob" or "--ownership-backoff" and if there is a next argument
+      if ((IS_OPTION("-ob") || IS_OPTION("--ownership-backoff")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in ownershipBackoff
+        ASSERT_TRUE(parse_ulong(argv[++i], &ownershipBackoff), usage);
+      }
+
+      // Check if the option is "-pg" or "--peer-group" and if there is a next argument
+      if ((IS_OPTION("-pg") || IS_OPTION("--peer-group")) && HAS_NEXT_ARG) {
+        // Store the endpoint of the peer group, which needs the processes of each GPU to find the GPUs of the job
+        peerGroup = argv[++i];
+        processTracking = true;
+      }
+
+      // Check if the option is "-pj" or "--peer-job" and if there is a next argument
+      if ((IS_OPTION("-pj") || IS_OPTION("--peer-job")) && HAS_NEXT_ARG) {
+        // Store the job ID
+        peerJob = argv[++i];
+      }
+
+      // Check if the option is "-pm" or "--policy-model" and if there is a next argument
+      if ((IS_OPTION("-pm") || IS_OPTION("--policy-model")) && HAS_NEXT_ARG) {
+        // Store the path of the policy model
+        policyModelPath = argv[++i];
+      }
+
+      // Check if the option is "-sl" or "--sample-log" and if there is a next argument
+      if ((IS_OPTION("-sl") || IS_OPTION("--sample-log")) && HAS_NEXT_ARG) {
+        // Store the path of the sample log
+        sampleLogPath = argv[++i];
+      }
+
+      // Check if the option is "-ph" or "--peer-hold" and if there is a next argument
+      if ((IS_OPTION("-ph") || IS_OPTION("--peer-hold")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in peerHold
+        ASSERT_TRUE(parse_ulong(argv[++i], &peerHold), usage);
+      }
+
+      // Check if the option is "-qu" or "--queue-url" and if there is a next argument
+      if ((IS_OPTION("-qu") || IS_OPTION("--queue-url")) && HAS_NEXT_ARG) {
+        // Store the URL of the metrics endpoint
+        queue.url = argv[++i];
+
+        // Check if the URL has a supported scheme
+        ASSERT_TRUE(strncmp(queue.url, "http://", 7) == 0 || strncmp(queue.url, "unix:", 5) == 0, usage);
+      }
+
+      // Check if the option is "-qm" or "--queue-metric" and if there is a next argument
+      if ((IS_OPTION("-qm") || IS_OPTION("--queue-metric")) && HAS_NEXT_ARG) {
+        // Store the name of the queue-depth gauge
+        queue.metric = argv[++i];
+      }
+
+      // Check if the option is "-ql" or "--queue-label" and if there is a next argument
+      if ((IS_OPTION("-ql") || IS_OPTION("--queue-label")) && HAS_NEXT_ARG) {
+        // Store the name of the GPU label
+        queue.label = argv[++i];
+      }
+
+      // Check if the option is "-qi" or "--queue-interval" and if there is a next argument
+      if ((IS_OPTION("-qi") || IS_OPTION("--queue-interval")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in queue.interval
+        ASSERT_TRUE(parse_ulong(argv[++i], &queue.interval), usage);
+
+        // Check if the interval is out of range
+        ASSERT_TRUE(queue.interval > 0, usage);
+      }
+
+      // Check if the option is "-rs" or "--ramp-stagger" and if there is a next argument
+      if ((IS_OPTION("-rs") || IS_OPTION("--ramp-stagger")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in ramps.stagger
+        ASSERT_TRUE(parse_ulong(argv[++i], &ramps.stagger), usage);
+      }
+
+      // Check if the option is "-rpb" or "--ramp-power-budget" and if there is a next argument
+      if ((IS_OPTION("-rpb") || IS_OPTION("--ramp-power-budget")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in ramps.budget
+        ASSERT_TRUE(parse_ulong(argv[++i], &ramps.budget), usage);
+      }
+
+      // Check if the option is "-rpw" or "--ramp-power-window" and if there is a next argument
+      if ((IS_OPTION("-rpw") || IS_OPTION("--ramp-power-window")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in ramps.window
+        ASSERT_TRUE(parse_ulong(argv[++i], &ramps.window), usage);
+
+        // Check if the window is empty
+        ASSERT_TRUE(ramps.window > 0, usage);
+      }
+
+      // Check if the option is "-rmd" or "--ramp-max-delay" and if there is a next argument
+      if ((IS_OPTION("-rmd") || IS_OPTION("--ramp-max-delay")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in ramps.maxDelay
+        ASSERT_TRUE(parse_ulong(argv[++i], &ramps.maxDelay), usage);
+      }
+
+      // Check if the option is "-rp" or "--ramp-priority" and if there is a next argument
+      if ((IS_OPTION("-rp") || IS_OPTION("--ramp-priority")) && HAS_NEXT_ARG) {
+        // Parse the "<id>:<priority>,..." argument
+        ASSERT_TRUE(parse_ramp_priorities(argv[++i], rampPriorities, NVAPI_MAX_PHYSICAL_GPUS), usage);
+      }
+
+      // Check if the option is "-xq" or "--xid-quarantine" and if there is a next argument
+      if ((IS_OPTION("-xq") || IS_OPTION("--xid-quarantine")) && HAS_NEXT_ARG) {
+        // Parse the comma-separated list of Xids
+        ASSERT_TRUE(parse_ulong_array(argv[++i], ",", EVENTS_MAX_XIDS, faultXids, &faultXidCount), usage);
+      }
+
+      // Check if the option is "-ri" or "--report-interval" and if there is a next argument
+      if ((IS_OPTION("-ri") || IS_OPTION("--report-interval")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in reportInterval
+        ASSERT_TRUE(parse_ulong(argv[++i], &reportInterval), usage);
+      }
+
+      // Check if the option is "-s" or "--service"
+      if ((IS_OPTION("-s") || IS_OPTION("--service"))) {
+        // Skip option
+        continue;
+      }
+
+      // Check if the option is "-sc" or "--schedule" and if there is a next argument
+      if ((IS_OPTION("-sc") || IS_OPTION("--schedule")) && HAS_NEXT_ARG) {
+        // Check if there is room for another rule
+        ASSERT_TRUE(scheduleRuleCount < SCHEDULE_MAX_RULES, usage);
+
+        // Parse the "[<name>@]<minute> <hour> <day> <month> <weekday>:<key=value,...>" argument
+        ASSERT_TRUE(schedule_parse_rule(argv[++i], scheduleRuleCount, &scheduleRules[scheduleRuleCount]), usage);
+
+        // Validate the parameters against a scratch copy
+        gpuParams scratch = params;
+        ASSERT_TRUE(parse_params(scheduleRules[scheduleRuleCount].params, &scratch), usage);
+
+        // Keep the rule
+        scheduleRuleCount++;
+      }
+
+      // Check if the option is "-scd" or "--schedule-dry-run"
+      if ((IS_OPTION("-scd") || IS_OPTION("--schedule-dry-run"))) {
+        // Print the schedule instead of running
+        scheduleDryRun = true;
+      }
+
+      // Check if the option is "-si" or "--sleep-interval" and if there is a next argument
+      if ((IS_OPTION("-si") || IS_OPTION("--sleep-interval")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in sleepInterval
+        ASSERT_TRUE(parse_ulong(argv[++i], &sleepInterval), usage);
+      }
 
-    // Mark NVML as initialized
-    nvmlInitialized = true;
+      // Check if the option is "-ss" or "--subscribe-socket" and if there is a next argument
+      if ((IS_OPTION("-ss") || IS_OPTION("--subscribe-socket")) && HAS_NEXT_ARG) {
+        // Store the path of the subscription socket
+        subscribeSocketPath = argv[++i];
+      }
+
+      // Check if the option is "-tp" or "--thermal-predict"
+      if ((IS_OPTION("-tp") || IS_OPTION("--thermal-predict"))) {
+        // Enable the predictive thermal model
+        thermalPredict = true;
+      }
+
+      // Check if the option is "-tph" or "--thermal-predict-horizon" and if there is a next argument
+      if ((IS_OPTION("-tph") || IS_OPTION("--thermal-predict-horizon")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in thermalPredictHorizon
+        ASSERT_TRUE(parse_ulong(argv[++i], &thermalPredictHorizon), usage);
+
+        // Check if the horizon is out of range
+        ASSERT_TRUE(thermalPredictHorizon > 0 && thermalPredictHorizon <= THERMAL_HORIZON_MAX, usage);
+      }
+
+      // Check if the option is "-tpm" or "--thermal-predict-margin" and if there is a next argument
+      if ((IS_OPTION("-tpm") || IS_OPTION("--thermal-predict-margin")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in thermalPredictMargin
+        ASSERT_TRUE(parse_ulong(argv[++i], &thermalPredictMargin), usage);
+      }
+
+      // Check if the option is "-tc" or "--thermal-coordinate"
+      if ((IS_OPTION("-tc") || IS_OPTION("--thermal-coordinate"))) {
+        // Enable the node-level thermal controller, which requires the predictive thermal model
+        thermalCoordinate = true;
+        thermalPredict = true;
+      }
+
+      // Check if the option is "-tf" or "--trace-file" and if there is a next argument
+      if ((IS_OPTION("-tf") || IS_OPTION("--trace-file")) && HAS_NEXT_ARG) {
+        // Store the path of the trace file
+        traceFile = argv[++i];
+      }
+
+      // Check if the option is "-tw" or "--trace-window" and if there is a next argument
+      if ((IS_OPTION("-tw") || IS_OPTION("--trace-window")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in traceWindow
+        ASSERT_TRUE(parse_ulong(argv[++i], &traceWindow), usage);
+
+        // Check if the window is out of range
+        ASSERT_TRUE(traceWindow > 0, usage);
+      }
+
+      // Check if the option is "-tt" or "--temperature-threshold" and if there is a next argument
+      if ((IS_OPTION("-tt") || IS_OPTION("--temperature-threshold")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in params.temperatureThreshold
+        ASSERT_TRUE(parse_ulong(argv[++i], &params.temperatureThreshold), usage);
+      }
+
+      // Check if the option is "-vt" or "--verify-transitions"
+      if ((IS_OPTION("-vt") || IS_OPTION("--verify-transitions"))) {
+        // Confirm each transition by reading the state back
+        verifyTransitions = true;
+      }
+
+      // Check if the option is "-vd" or "--verify-deadline" and if there is a next argument
+      if ((IS_OPTION("-vd") || IS_OPTION("--verify-deadline")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in verifyDeadline
+        ASSERT_TRUE(parse_ulong(argv[++i], &verifyDeadline), usage);
+
+        // Check if the deadline is out of range
+        ASSERT_TRUE(verifyDeadline > 0, usage);
+      }
+
+      // Check if the option is "-vr" or "--verify-retries" and if there is a next argument
+      if ((IS_OPTION("-vr") || IS_OPTION("--verify-retries")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in verifyRetries
+        ASSERT_TRUE(parse_ulong(argv[++i], &verifyRetries), usage);
+
+        // Check if the deadline of the last retry fits
+        ASSERT_TRUE(verifyRetries < 16, usage);
+      }
+
+      // Check if the option is "-ve" or "--verify-escalate" and if there is a next argument
+      if ((IS_OPTION("-ve") || IS_OPTION("--verify-escalate")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in verifyEscalate
+        ASSERT_TRUE(parse_ulong(argv[++i], &verifyEscalate), usage);
+      }
+    }
+
+    // Check that the calibration files have a directory
+    ASSERT_TRUE(!calibrate || calibrationDir != NULL, usage);
+
+    // Use the default Xids that quarantine a GPU
+    if (faultXidCount == 0) {
+      ASSERT_TRUE(parse_ulong_array(EVENTS_FAULT_XIDS, ",", EVENTS_MAX_XIDS, faultXids, &faultXidCount), usage);
+    }
+
+    // The idle level must be below the busy threshold to detect a rise
+    ASSERT_TRUE(cpuPredictIdle < cpuPredictThreshold, usage);
+
+    // The queue-depth source needs the name of the gauge to read
+    ASSERT_FALSE(queue.url != NULL && queue.metric == NULL, usage);
+
+    // Start the canary parameters from the control parameters
+    canaryParams = params;
+
+    // Apply the canary parameter overrides
+    if (canaryParamsArg != NULL) {
+      ASSERT_TRUE(parse_params(canaryParamsArg, &canaryParams), usage);
+    }
+
+    // Keep the canary overrides to apply them over the schedule and workload class profiles
+    canaryOverrides = canaryParamsArg;
+
+    // Display usage instructions to the user
+    if (false) {
+      // Display usage instructions to the user
+      usage:
+
+      // Print the usage instructions
+      printf("Usage: %s [options]\n", argv[0]);
+      printf("\n");
+      printf("Options:\n");
+      printf("  -dh, --dcgm-host <address>                Read temperature and activity from this DCGM host engine (host[:port], default: disabled)\n");
+      printf("  -da, --dcgm-activity <field>              Set the DCGM activity signal: util, gr, sm, tensor or dram (default: %s)\n", dcgm_activity_name(DCGM_ACTIVITY));
+      printf("  -dl, --dcgm-library <path>                Load this DCGM library instead of libdcgm.so.4 or libdcgm.so.3\n");
+      printf("  -ev, --events                             Listen for Xid errors and clock changes, quarantine faulted GPUs at once\n");
+      printf("  -xq, --xid-quarantine <value><,value...>  Set the Xids that quarantine a GPU (default: %s)\n", EVENTS_FAULT_XIDS);
+      printf("  -fc, --fan-control                        Raise the fan speed before cutting clocks when a GPU gets too hot\n");
+      printf("  -fsm, --fan-speed-max <value>             Set the maximum fan speed in percent (default: %u)\n", FAN_SPEED_MAX);
+      printf("  -fss, --fan-speed-step <value>            Set the fan speed change in percent per step (default: %u)\n", FAN_SPEED_STEP);
+      printf("  -fw, --foreign-writes <policy>            Read the applied state back and ignore, observe, yield or reassert on foreign writes (default: ignore)\n");
+      printf("  -hs, --hint-socket <path>                 Receive busy/idle hints from applications on this datagram socket (default: disabled)\n");
+      printf("  -hg, --hint-group <name>                  Allow the members of this group to send hints, besides root (default: the group of the daemon)\n");
+      printf("  -ht, --hint-trust <value>                 Set the trust in percent placed in application hints (default: %u)\n", HINT_TRUST);
+      printf("  -hd, --history-dir <path>                 Record the temperature and utilization history of each GPU in this directory (default: disabled)\n");
+      printf("  -hq, --history-query <metric>:<window>    Print min/max/avg/p95 of temperature or utilization over the window (e.g. 1h, 7d) and exit\n");
+      printf("  -hb, --history-benchmark                  Record %u simulated days in a temporary directory, print the append cost and exit\n", HISTORY_BENCHMARK_DAYS);
+      printf("  -hcp, --host-cpu-predict                  Pre-ramp a GPU when its processes go from idle to busy on the CPU (implies -pt)\n");
+      printf("  -hct, --host-cpu-threshold <value>        Set the CPU load in percent of a core at which the processes count as busy (default: %u)\n", CPU_PREDICT_THRESHOLD);
+      printf("  -hci, --host-cpu-idle <value>             Set the CPU load in percent of a core below which the processes count as idle (default: %u)\n", CPU_PREDICT_IDLE);
+      printf("  -hch, --host-cpu-hold <value>             Set the time in milliseconds a pre-ramp keeps the GPU in high performance state (default: %u)\n", CPU_PREDICT_HOLD);
+      printf("  -i, --ids <value><,value...>              Set the GPU(s) to control (default: all)\n");
+      printf("  -ibs, --iterations-before-switch <value>  Set the number of iterations to wait before switching states (default: %u)\n", ITERATIONS_BEFORE_SWITCH);
+      printf("  -pt, --process-tracking                   Attribute energy, time per state and ramp penalty to each compute process\n");
+      printf("  -pti, --process-tracking-interval <value> Set the interval in milliseconds between process list polls (default: %u)\n", PROCESS_TRACKING_INTERVAL);
+      printf("  -pl, --process-log <path>                 Append a JSON summary of each finished process to this file (implies -pt)\n");
+      printf("  -psh, --performance-state-high <value>    Set the high performance state for the GPU (default: %u)\n", PERFORMANCE_STATE_HIGH);
+      printf("  -psl, --performance-state-low <value>     Set the low performance state for the GPU (default: %u)\n", PERFORMANCE_STATE_LOW);
+      printf("  -cmh, --clock-mem-high <value>            Set the high performance memory clock in MHz for fallback mode (default: auto)\n");
+      printf("  -cgh, --clock-gpu-high <value>            Set the high performance GPU clock in MHz for fallback mode (default: auto)\n");
+      printf("  -cml, --clock-mem-low <value>             Set the low performance memory clock in MHz for fallback mode (default: lowest)\n");
+      printf("  -cgl, --clock-gpu-low <value>             Set the low performance GPU clock in MHz for fallback mode (default: lowest)\n");
+      printf("  -mf, --metrics-file <path>                Write metrics in Prometheus text format to this file (default: disabled)\n");
+      printf("  -mi, --metrics-interval <value>           Set the interval in seconds between metrics file updates (default: %u)\n", METRICS_INTERVAL);
+      printf("  -nfc, --no-fallback-clocks                Disable fallback to clock control when pstate setting fails\n");
+      printf("  -ac, --auto-classify                      Classify the workload of each GPU and apply the matching parameter profile\n");
+      printf("  -acp, --auto-classify-profile <class>:<key=value,...>\n");
+      printf("                                            Set the parameter overrides for a workload class (idle, steady, bursty, interactive)\n");
+      printf("  -ach, --auto-classify-hysteresis <value>  Set the number of consecutive classifications required to change class (default: %u)\n", CLASSIFY_HYSTERESIS);
+      printf("  -acg, --auto-classify-gap <value>         Set the mean gap in milliseconds above which a workload is interactive (default: %u)\n", CLASSIFY_GAP_THRESHOLD);
+      printf("  -cal, --calibrate                         Measure the settle latency, idle power and return latency of each state on idle GPUs, write the calibration files and exit\n");
+      printf("  -cd, --calibration-dir <path>             Write and load the calibration file of each GPU model in this directory (default: disabled)\n");
+      printf("  -ci, --canary-ids <value><,value...>      Assign the GPU(s) to the canary arm (default: none)\n");
+      printf("  -cp, --canary-percent <value>             Assign this percentage of GPUs to the canary arm by UUID hash (default: %u)\n", CANARY_PERCENT);
+      printf("  -cpa, --canary-params <key=value,...>     Override parameters for the canary arm, keys are option names (e.g. ibs=10,psl=5)\n");
+      printf("  -ol, --ownership-lock                     Take a per-GPU lock so that only one daemon manages each GPU\n");
+      printf("  -ob, --ownership-backoff <value>          Set the interval in milliseconds between takeover attempts of a GPU owned elsewhere (default: %u)\n", OWNERSHIP_BACKOFF);
+      printf("  -pg, --peer-group <address:port|dir>      Announce ramps to and pre-ramp on the ramps of daemons in this multicast group or socket directory (implies -pt, default: disabled)\n");
+      printf("  -pj, --peer-job <id>                      Set the job ID, only peers of the same job are followed (default: %s)\n", PEER_JOB);
+      printf("  -ph, --peer-hold <value>                  Set the time in milliseconds GPUs are kept in high performance state after a peer ramped (default: %u)\n", PEER_HOLD);
+      printf("  -pm, --policy-model <path>                Switch idle GPUs to the low performance state when this model trained by pstated-train predicts a saving, instead of after --iterations-before-switch\n");
+      printf("  -sl, --sample-log <path>                  Write the utilization, power, process count and performance state of each managed GPU on every iteration to this file, to train a policy model on\n");
+      printf("  -qu, --queue-url <url>                    Scrape the queue depth from this Prometheus endpoint (http://host:port/path or unix:/socket[:/path])\n");
+      printf("  -qm, --queue-metric <name>                Set the name of the queue-depth gauge (required with -qu)\n");
+      printf("  -ql, --queue-label <name>                 Set the label holding the GPU index (default: gpu, series without it apply to all GPUs)\n");
+      printf("  -qi, --queue-interval <value>             Set the interval in milliseconds between queue-depth scrapes (default: %u)\n", QUEUE_INTERVAL);
+      printf("  -rs, --ramp-stagger <value>               Set the minimum delay in milliseconds between ramps of different GPUs (default: %u, disabled)\n", RAMP_STAGGER);
+      printf("  -rpb, --ramp-power-budget <value>         Set the maximum power step in watts of all ramps within the window (default: %u, unlimited)\n", RAMP_POWER_BUDGET);
+      printf("  -rpw, --ramp-power-window <value>         Set the length in milliseconds of the ramp power budget window (default: %u)\n", RAMP_POWER_WINDOW);
+      printf("  -rmd, --ramp-max-delay <value>            Set the maximum time in milliseconds a ramp is held back (default: %u)\n", RAMP_MAX_DELAY);
+      printf("  -rp, --ramp-priority <id>:<value><,...>   Set the ramp priority of the GPU(s), higher ramps first (default: 0)\n");
+      printf("  -ri, --report-interval <value>            Set the interval in seconds between arm reports (default: %u, only on exit)\n", REPORT_INTERVAL);
+
+      #ifdef _WIN32
+        printf("  -s, --service                             Run as a Windows service\n");
+      #endif
+
+      printf("  -sc, --schedule [<name>@]<cron>:<key=value,...>\n");
+      printf("                                            Apply parameter overrides while the local time matches a cron expression, first match wins\n");
+      printf("  -scd, --schedule-dry-run                  Print the schedule profile changes over the next %u days and exit\n", SCHEDULE_DRY_RUN_DAYS);
+      printf("  -si, --sleep-interval <value>             Set the sleep interval in milliseconds between utilization checks (default: %u)\n", SLEEP_INTERVAL);
+      printf("  -ss, --subscribe-socket <path>            Stream state changes, ownership changes and faults as JSON lines to clients of this socket (default: disabled)\n");
+      printf("  -tf, --trace-file <path>                  Write the state timeline of the GPUs as a Chrome trace to this file on exit and on SIGUSR1 (default: disabled)\n");
+      printf("  -tw, --trace-window <value>               Set the length in seconds of the window covered by the trace file (default: %u)\n", TRACE_WINDOW);
+      printf("  -tt, --temperature-threshold <value>      Set the temperature threshold in degrees C (default: %u)\n", TEMPERATURE_THRESHOLD);
+      printf("  -tp, --thermal-predict                    Lower the power limit early when a thermal model forecasts crossing the threshold\n");
+      printf("  -tph, --thermal-predict-horizon <value>   Set the forecast horizon in seconds (default: %u, max: %u)\n", THERMAL_PREDICT_HORIZON, THERMAL_HORIZON_MAX);
+      printf("  -tpm, --thermal-predict-margin <value>    Set the margin in degrees C below the threshold to aim for (default: %u)\n", THERMAL_PREDICT_MARGIN);
+      printf("  -tc, --thermal-coordinate                 Spread thermal power reductions over GPUs that heat each other (implies -tp)\n");
+      printf("  -vt, --verify-transitions                 Confirm each transition by reading the state back, and write it again if it didn't show\n");
+      printf("  -vd, --verify-deadline <value>            Set the time in milliseconds a transition has to show, doubled after each retry (default: %u)\n", VERIFY_DEADLINE);
+      printf("  -vr, --verify-retries <value>             Set the number of times a transition is written again (default: %u, max: 15)\n", VERIFY_RETRIES);
+      printf("  -ve, --verify-escalate <value>            Switch to clock control after this many consecutive failed transitions (default: %u, 0 means never)\n", VERIFY_ESCALATE);
+
+      // Jump to the error handling code
+      goto errored;
+    }
   }
 
-  /***** NVAPI HANDLES *****/
+  /***** HISTORY QUERY *****/
   {
-    // Get NVAPI device handles for all GPUs
-    NVAPI_CALL(NvAPI_EnumPhysicalGPUs(nvapiDevices, &deviceCount), errored);
+    // Answer the query from the history files without touching the GPUs
+    if (historyQuery != NULL) {
+      // Variables to hold the parsed query
+      historyMetric metric;
+      unsigned long long window;
+
+      // Find the separator between metric and window
+      char * separator = strchr(historyQuery, ':');
+
+      // Check if the query is valid and the history directory is known
+      ASSERT_TRUE(historyDir != NULL && separator != NULL && parse_history_window(separator + 1, &window), usage);
+
+      // Parse the metric
+      *separator = '\0';
+      ASSERT_TRUE(parse_history_metric(historyQuery, &metric), usage);
+
+      // Print the result of the query
+      print_history_query(historyDir, metric, window, ids, idsCount);
+
+      // Jump to cleanup section
+      goto cleanup;
+    }
+
+    // Benchmark the history store
+    if (historyBenchmark) {
+      // Record the simulated samples into a temporary directory
+      if (!print_history_benchmark(sleepInterval > 0 ? sleepInterval : 1)) {
+        goto errored;
+      }
+
+      // Jump to cleanup section
+      goto cleanup;
+    }
   }
 
-  /***** NVML HANDLES *****/
+  /***** SCHEDULE DRY RUN *****/
   {
-    // Get NVML device handles for all GPUs
-    for (unsigned int i = 0; i < deviceCount; i++) {
-      NVML_CALL(nvmlDeviceGetHandleByIndex(i, &nvmlDevices[i]), errored);
+    // Print the schedule in virtual time without touching the GPUs
+    if (scheduleDryRun) {
+      print_schedule(time(NULL));
+
+      // Jump to cleanup section
+      goto cleanup;
     }
+
+    // Select the profile for the current time before the GPUs are configured
+    update_schedule(time(NULL));
   }
 
-  /***** SORT NVAPI HANDLES */
+  /***** SIGNALS *****/
   {
-    // Array to hold NVML device identifiers
-    NvU32 nvmlIdentifiers[NVAPI_MAX_PHYSICAL_GPUS];
-
-    // Array to hold NVAPI device identifiers
-    NvU32 nvapiIdentifiers[NVAPI_MAX_PHYSICAL_GPUS];
+    // Set up signal handling
+    signal(SIGINT, handle_exit);
+    signal(SIGTERM, handle_exit);
 
-    // Step 1: Loop through each device to retrieve and store NVML and NVAPI identifiers
-    for (unsigned int i = 0; i < deviceCount; i++) {
-      // Initialize struct to hold PCI info
-      nvmlPciInfo_t nvmlPciInfo;
+    // Upgrade in place on SIGUSR2, if the path of the binary is known
+    #ifdef __linux__
+      if (handoff_resolve_self(selfPath, sizeof(selfPath))) {
+        signal(SIGUSR2, handle_upgrade);
+      }
 
-      // Get PCI info
-      NVML_CALL(nvmlDeviceGetPciInfo(nvmlDevices[i], &nvmlPciInfo), errored);
+      // Write the trace file on SIGUSR1
+      if (traceFile != NULL) {
+        signal(SIGUSR1, handle_trace);
+      }
+    #endif
+  }
 
-      // Store bus id in nvmlIdentifiers array
-      nvmlIdentifiers[i] = nvmlPciInfo.bus;
+  /***** HANDOFF *****/
+  {
+    // Load the state of the GPUs handed over by the previous process, if this process was started by an upgrade
+    handoffCount = handoff_load(handoffRecords, NVAPI_MAX_PHYSICAL_GPUS);
 
-      // Variable to hold bus id
-      NvU32 nvapiBusId;
+    // Print the number of GPUs handed over
+    if (handoffCount > 0) {
+      printf("Taking over %u GPUs from the previous process...\n", handoffCount);
+    }
+  }
 
-      // Get bus id
-      NVAPI_CALL(NvAPI_GPU_GetBusId(nvapiDevices[i], &nvapiBusId), errored);
+  /***** CORE INIT *****/
+  {
+    // Initialize NVAPI and NVML and pair the handles of each GPU
+    int status = pstated_open(PSTATED_API_VERSION_MAJOR, &core);
 
-      // Store in nvapiIdentifiers array
-      nvapiIdentifiers[i] = nvapiBusId;
+    if (status != PSTATED_OK) {
+      fprintf(stderr, "Unable to initialize the GPUs: %s\n", pstated_status_string(status));
+      goto errored;
     }
 
-    // Array to store NVAPI device handles in sorted order
-    NvPhysicalGpuHandle sortedNvapiDevices[NVAPI_MAX_PHYSICAL_GPUS];
+    // Get the NVML handles, NVAPI is only reached through the core
+    deviceCount = pstated_gpu_count(core);
 
-    // Step 2: Match and order NVAPI devices based on serial numbers
     for (unsigned int i = 0; i < deviceCount; i++) {
-      for (unsigned int j = 0; j < deviceCount; j++) {
-        // Compare NVML and NVAPI identifiers
-        if (nvmlIdentifiers[i] == nvapiIdentifiers[j]) {
-          // Store matched device handle in sorted array
-          sortedNvapiDevices[i] = nvapiDevices[j];
-
-          // Exit the inner loop
-          break;
-        }
-      }
+      nvmlDevices[i] = pstated_nvml_device(core, i);
     }
 
-    // Step 3: Copy sorted handles back to original array
-    memcpy(nvapiDevices, sortedNvapiDevices, sizeof(sortedNvapiDevices));
+    // Get the driver version, the transition failures are reported per driver
+    snprintf(driverVersion, sizeof(driverVersion), "%s", pstated_driver_version(core));
   }
 
   /***** INIT *****/
@@ -547,21 +3812,144 @@ static int run(int argc, char * argv[]) {
         printf("N/A");
       }
 
-      // Print the count of elements in the array and newline character
-      printf(" (%zu)\n", idsCount);
+      // Print the count of elements in the array and newline character
+      printf(" (%zu)\n", idsCount);
+    }
+
+    // Print remaining variables
+    printf("iterationsBeforeSwitch = %lu\n", params.iterationsBeforeSwitch);
+    printf("performanceStateHigh = %lu\n", params.performanceStateHigh);
+    printf("performanceStateLow = %lu\n", params.performanceStateLow);
+    printf("clockFreqMemHigh = %lu\n", params.clockFreqMemHigh);
+    printf("clockFreqGpuHigh = %lu\n", params.clockFreqGpuHigh);
+    printf("clockFreqMemLow = %lu\n", params.clockFreqMemLow);
+    printf("clockFreqGpuLow = %lu\n", params.clockFreqGpuLow);
+    printf("enableClockFallback = %s\n", enableClockFallback ? "true" : "false");
+    printf("sleepInterval = %lu\n", sleepInterval);
+    printf("temperatureThreshold = %lu\n", params.temperatureThreshold);
+    printf("traceFile = %s\n", traceFile != NULL ? traceFile : "N/A");
+    printf("traceWindow = %lu\n", traceWindow);
+    printf("canaryIdsCount = %zu\n", canaryIdsCount);
+    printf("canaryPercent = %lu\n", canaryPercent);
+    printf("reportInterval = %lu\n", reportInterval);
+    printf("autoClassify = %s\n", autoClassify ? "true" : "false");
+    printf("classifyHysteresis = %lu\n", classifyHysteresis);
+    printf("classifyGapThreshold = %lu\n", classifyGapThreshold);
+    printf("metricsFile = %s\n", metricsFile != NULL ? metricsFile : "N/A");
+    printf("metricsInterval = %lu\n", metricsInterval);
+    printf("thermalPredict = %s\n", thermalPredict ? "true" : "false");
+    printf("thermalPredictHorizon = %lu\n", thermalPredictHorizon);
+    printf("thermalPredictMargin = %lu\n", thermalPredictMargin);
+    printf("thermalCoordinate = %s\n", thermalCoordinate ? "true" : "false");
+    printf("fanControl = %s\n", fanControl ? "true" : "false");
+    printf("fanSpeedMax = %lu\n", fanSpeedMax);
+    printf("fanSpeedStep = %lu\n", fanSpeedStep);
+    printf("processTracking = %s\n", processTracking ? "true" : "false");
+    printf("processTrackingInterval = %lu\n", processTrackingInterval);
+    printf("processLog = %s\n", processLogFile != NULL ? processLogFile : "N/A");
+    printf("hintSocket = %s\n", hintSocketPath != NULL ? hintSocketPath : "N/A");
+    printf("hintGroup = %s\n", hintGroup != NULL ? hintGroup : "N/A");
+    printf("hintTrust = %lu\n", hintTrust);
+    printf("subscribeSocket = %s\n", subscribeSocketPath != NULL ? subscribeSocketPath : "N/A");
+    printf("hostCpuPredict = %s\n", cpuPredict ? "true" : "false");
+    printf("hostCpuThreshold = %lu\n", cpuPredictThreshold);
+    printf("hostCpuIdle = %lu\n", cpuPredictIdle);
+    printf("hostCpuHold = %lu\n", cpuPredictHold);
+    printf("queueUrl = %s\n", queue.url != NULL ? queue.url : "N/A");
+    printf("queueMetric = %s\n", queue.metric != NULL ? queue.metric : "N/A");
+    printf("queueLabel = %s\n", queue.label);
+    printf("queueInterval = %lu\n", queue.interval);
+    printf("dcgmHost = %s\n", dcgm.host != NULL ? dcgm.host : "N/A");
+    printf("dcgmActivity = %s\n", dcgm_activity_name(dcgm.activity));
+    printf("calibrate = %s\n", calibrate ? "true" : "false");
+    printf("calibrationDir = %s\n", calibrationDir != NULL ? calibrationDir : "N/A");
+    printf("historyDir = %s\n", historyDir != NULL ? historyDir : "N/A");
+    printf("rampStagger = %lu\n", ramps.stagger);
+    printf("rampPowerBudget = %lu\n", ramps.budget);
+    printf("rampPowerWindow = %lu\n", ramps.window);
+    printf("rampMaxDelay = %lu\n", ramps.maxDelay);
+    printf("events = %s\n", eventsEnabled ? "true" : "false");
+    printf("xidQuarantineCount = %zu\n", faultXidCount);
+    printf("verifyTransitions = %s\n", verifyTransitions ? "true" : "false");
+    printf("verifyDeadline = %lu\n", verifyDeadline);
+    printf("verifyRetries = %lu\n", verifyRetries);
+    printf("verifyEscalate = %lu\n", verifyEscalate);
+    printf("ownershipLock = %s\n", ownershipLocking ? "true" : "false");
+    printf("ownershipBackoff = %lu\n", ownershipBackoff);
+    printf("peerGroup = %s\n", peerGroup != NULL ? peerGroup : "N/A");
+    printf("peerJob = %s\n", peerJob);
+    printf("peerHold = %lu\n", peerHold);
+    printf("policyModel = %s\n", policyModelPath != NULL ? policyModelPath : "N/A");
+    printf("sampleLog = %s\n", sampleLogPath != NULL ? sampleLogPath : "N/A");
+    printf("foreignWrites = %s\n", foreign_write_policy_name(foreignWrites));
+    printf("scheduleRules = %u\n", scheduleRuleCount);
+    printf("scheduleProfile = %s\n", schedule_profile_name(scheduleActive));
+
+    // Start recording the trace
+    if (traceFile != NULL && !trace_open(traceWindow)) {
+      goto errored;
+    }
+
+    // Start scraping the queue depth
+    if (queue.url != NULL && !queue_start(&queue)) {
+      goto errored;
+    }
+
+    // Watch the DCGM fields at the sleep interval
+    dcgm.interval = sleepInterval;
+
+    if (dcgm.host != NULL && !dcgm_open(&dcgm)) {
+      goto errored;
+    }
+
+    // Open the hint socket
+    if (hintSocketPath != NULL && !hint_socket_open(hintSocketPath, hintGroup)) {
+      goto errored;
+    }
+
+    // Open the subscription socket
+    if (subscribeSocketPath != NULL && !subscribe_socket_open(subscribeSocketPath)) {
+      goto errored;
+    }
+
+    // Join the peer group
+    if (peerGroup != NULL && !peers_open(peerGroup, peerJob)) {
+      goto errored;
+    }
+
+    // Load the policy model
+    if (policyModelPath != NULL) {
+      if (!model_load(&policyModel, policyModelPath)) {
+        goto errored;
+      }
+
+      printf("Policy model %s loaded: %u nodes, window of %u iterations\n", policyModelPath, policyModel.count, policyModel.window);
     }
 
-    // Print remaining variables
-    printf("iterationsBeforeSwitch = %lu\n", iterationsBeforeSwitch);
-    printf("performanceStateHigh = %lu\n", performanceStateHigh);
-    printf("performanceStateLow = %lu\n", performanceStateLow);
-    printf("clockFreqMemHigh = %lu\n", clockFreqMemHigh);
-    printf("clockFreqGpuHigh = %lu\n", clockFreqGpuHigh);
-    printf("clockFreqMemLow = %lu\n", clockFreqMemLow);
-    printf("clockFreqGpuLow = %lu\n", clockFreqGpuLow);
-    printf("enableClockFallback = %s\n", enableClockFallback ? "true" : "false");
-    printf("sleepInterval = %lu\n", sleepInterval);
-    printf("temperatureThreshold = %lu\n", temperatureThreshold);
+    // Open the sample log
+    if (sampleLogPath != NULL && !samples_open(sampleLogPath)) {
+      goto errored;
+    }
+
+    // Open the process log
+    if (processLogFile != NULL) {
+      // Append to the existing log
+      processLog = fopen(processLogFile, "a");
+
+      // Check if the log could not be opened
+      if (processLog == NULL) {
+        // Print error message
+        fprintf(stderr, "Unable to open process log %s\n", processLogFile);
+
+        // Jump to error handling section
+        goto errored;
+      }
+    }
+
+    // Print the canary parameters if a canary arm is configured
+    if (canaryIdsCount != 0 || canaryPercent != 0) {
+      print_params("canary", &canaryParams);
+    }
 
     // Check if there are specific GPU ids to process
     if (idsCount != 0) {
@@ -612,8 +4000,106 @@ static int run(int argc, char * argv[]) {
         // Retrieve the GPU name
         NVML_CALL(nvmlDeviceGetName(nvmlDevices[i], gpuName, sizeof(gpuName)), errored);
 
+        // Retrieve the GPU UUID
+        NVML_CALL(nvmlDeviceGetUUID(nvmlDevices[i], state->uuid, sizeof(state->uuid)), errored);
+
+        // Name the trace tracks of the GPU
+        trace_gpu(i, gpuName);
+
+        // Set the ramp priority of the GPU
+        state->ramp.priority = rampPriorities[i];
+
+        // State handed over by the previous process, if any
+        handoffRecord * record = handoff_find(handoffRecords, handoffCount, state->uuid);
+
+        // Take the ownership lock of the GPU, passed on by the previous process or kept by another daemon until it exits
+        if (ownershipLocking && record != NULL && ownership_adopt(&state->lock, record->lockFd)) {
+          record->lockFd = -1;
+          state->owned = true;
+        } else {
+          state->owned = !ownershipLocking || ownership_acquire(&state->lock, state->uuid);
+        }
+
+        // Leave the GPU alone until it can be taken over
+        if (!state->owned) {
+          printf("GPU %u is owned by another process, waiting for it to be released\n", i);
+          state->lastYield = get_time_ms();
+        }
+
+        // Assign the GPU to the canary arm if its UUID hash falls within the canary percentage
+        state->arm = (hash_string(state->uuid) % 100 < canaryPercent) ? 1 : 0;
+
+        // Assign the GPU to the canary arm if it was explicitly requested
+        for (size_t j = 0; j < canaryIdsCount; j++) {
+          if (canaryIds[j] == i) {
+            state->arm = 1;
+          }
+        }
+
+        // Apply the parameters of the arm
+        state->baseParams = (state->arm == 1) ? canaryParams : params;
+
+        // Load the calibration of the GPU model
+        if (calibrationDir != NULL && !calibrate && calibration_load(&state->calibration, calibrationDir, gpuName)) {
+          apply_calibration(i, lowStateGiven || state->baseParams.performanceStateLow != params.performanceStateLow);
+        }
+
+        // Apply the profile of the initial workload class
+        apply_profiles(i);
+
+        // Track the processes of the GPU if enabled
+        state->processes.tracked = processTracking;
+
+        // Open the history of the GPU if enabled
+        if (historyDir != NULL && !history_open(&state->history, historyDir, i)) {
+          goto errored;
+        }
+
+        // Read the power limits of the GPU if the predictive thermal model is enabled
+        if (thermalPredict) {
+          // Variable to hold the maximum power limit
+          unsigned int maxPowerLimit;
+
+          // Check if the power limits can be read
+          state->powerLimitSupported =
+            nvmlDeviceGetPowerManagementDefaultLimit(nvmlDevices[i], &state->defaultPowerLimit) == NVML_SUCCESS &&
+            nvmlDeviceGetPowerManagementLimitConstraints(nvmlDevices[i], &state->minPowerLimit, &maxPowerLimit) == NVML_SUCCESS &&
+            nvmlDeviceGetPowerManagementLimit(nvmlDevices[i], &state->powerLimit) == NVML_SUCCESS;
+
+          // Print a warning if the power limits can't be read
+          if (!state->powerLimitSupported) {
+            fprintf(stderr, "Warning: Failed to get power limits for GPU %u, predictive thermal model disabled\n", i);
+          }
+        }
+
+        // Read the fan configuration of the GPU if fan control is enabled
+        if (fanControl) {
+          // Variables to hold the supported fan speed range
+          unsigned int minSpeed = 0;
+          unsigned int maxSpeed = 100;
+
+          // Check if the fans can be read
+          state->fans.supported =
+            nvmlDeviceGetNumFans(nvmlDevices[i], &state->fans.count) == NVML_SUCCESS && state->fans.count > 0 &&
+            nvmlDeviceGetFanSpeed_v2(nvmlDevices[i], 0, &state->fans.initialSpeed) == NVML_SUCCESS;
+
+          // Read the supported range, older drivers don't report it
+          nvmlDeviceGetMinMaxFanSpeed(nvmlDevices[i], &minSpeed, &maxSpeed);
+
+          // Limit the range to the configured maximum
+          state->fans.maxSpeed = maxSpeed < fanSpeedMax ? maxSpeed : fanSpeedMax;
+
+          // Print a warning if the fans can't be controlled
+          if (!state->fans.supported) {
+            fprintf(stderr, "Warning: Failed to get fans for GPU %u, fan control disabled\n", i);
+          }
+        }
+
+        // Read the initial energy counter of the GPU
+        state->stats.energySupported = nvmlDeviceGetTotalEnergyConsumption(nvmlDevices[i], &state->stats.energyStart) == NVML_SUCCESS;
+
         // Print the managed GPU details
-        printf("%u. %s (GPU id = %u)\n", managedGPUs, gpuName, i);
+        printf("%u. %s (GPU id = %u, arm = %s)\n", managedGPUs, gpuName, i, armNames[state->arm]);
 
         // Increment the managed GPU counter
         managedGPUs++;
@@ -625,9 +4111,17 @@ static int run(int argc, char * argv[]) {
             fprintf(stderr, "Warning: Failed to get supported clocks for GPU %u, fallback mode may not work\n", i);
           }
         }
+
+        // Adopt the state handed over by the previous process
+        if (record != NULL && state->owned) {
+          adopt_handoff(i, record, thermalPredict, fanControl);
+        }
       }
     }
 
+    // Drop the ownership locks passed on for GPUs this process doesn't manage
+    handoff_close_locks(handoffRecords, handoffCount);
+
     // If no GPUs are managed, report an error
     if (managedGPUs == 0) {
       // Print error message
@@ -637,13 +4131,45 @@ static int run(int argc, char * argv[]) {
       goto errored;
     }
 
+    // Measure the GPUs instead of managing them
+    if (calibrate) {
+      if (!calibrate_gpus(calibrationDir)) {
+        goto errored;
+      }
+
+      // Jump to cleanup section
+      goto cleanup;
+    }
+
     // Print the number of GPUs being managed
     printf("Managing %u GPUs...\n", managedGPUs);
 
     // Iterate through each GPU
     for (unsigned int i = 0; i < deviceCount; i++) {
-      // Switch to low performance state
-      if (!enter_pstate(i, performanceStateLow, clockFreqMemHigh, clockFreqGpuHigh, clockFreqMemLow, clockFreqGpuLow)) {
+      // Switch to low performance state, unless the GPU was adopted as it is
+      if (!gpuStates[i].adopted && !enter_pstate(i, gpuStates[i].params.performanceStateLow, "start")) {
+        goto errored;
+      }
+
+      // Trace the state the GPU was adopted in
+      if (gpuStates[i].adopted) {
+        trace_state(i, gpuStates[i].pstateId, "adopted");
+      }
+
+      // Start accounting time from now
+      gpuStates[i].lastSampleTime = get_time_ms();
+    }
+
+    // Start listening for events on the managed GPUs
+    if (eventsEnabled) {
+      // Flags of the GPUs to watch
+      bool watched[NVAPI_MAX_PHYSICAL_GPUS];
+
+      for (unsigned int i = 0; i < deviceCount; i++) {
+        watched[i] = gpuStates[i].managed;
+      }
+
+      if (!events_start(nvmlDevices, watched, deviceCount, faultXids, faultXidCount)) {
         goto errored;
       }
     }
@@ -651,62 +4177,364 @@ static int run(int argc, char * argv[]) {
 
   /***** MAIN LOOP *****/
   {
+    // Time of the start of the main loop and of the last arm report
+    unsigned long long startTime = get_time_ms();
+    unsigned long long lastReportTime = startTime;
+    unsigned long long lastMetricsTime = startTime;
+
+    // Mean gap threshold converted from milliseconds to iterations
+    unsigned long classifyGapIterations = classifyGapThreshold / (sleepInterval > 0 ? sleepInterval : 1);
+
+    // Counter of main loop iterations
+    unsigned long long tick = 0;
+
+    // Events received by the event listener
+    gpuEvents events[EVENTS_MAX_GPUS];
+
     // Infinite loop to continuously monitor GPU temperature and utilization
     while (shouldRun) {
+      // Write the trace file if requested
+      if (traceRequested) {
+        traceRequested = false;
+        trace_write(traceFile);
+      }
+
+      // Apply the events received since the previous iteration
+      if (eventsEnabled && events_take(events)) {
+        handle_events(events);
+      }
+
+      // Apply the hints received from applications
+      if (hintSocketPath != NULL) {
+        process_hints(hintTrust);
+      }
+
+      // Pre-ramp on the ramps announced by the peers of the job
+      if (peerGroup != NULL) {
+        process_peers(peerHold);
+      }
+
+      // Greet new subscribers with the current state and send what slow subscribers still have queued
+      if (subscribeSocketPath != NULL) {
+        int client;
+
+        while ((client = subscribe_accept()) >= 0) {
+          send_snapshot(client);
+        }
+
+        subscribe_flush();
+      }
+
+      // Switch the schedule profile between ticks, so that every GPU sees a consistent set of parameters
+      if (scheduleRuleCount > 0 && update_schedule(time(NULL))) {
+        // Print the new profile
+        printf("Schedule profile changed to %s\n", schedule_profile_name(scheduleActive));
+
+        // Apply the new profile to all GPUs
+        for (unsigned int i = 0; i < deviceCount; i++) {
+          if (gpuStates[i].managed) {
+            apply_profiles(i);
+          }
+        }
+      }
+
+      // Take the latest queue depths from the scraper
+      if (queue.url != NULL) {
+        // Queue depths of all GPUs
+        double depths[QUEUE_MAX_GPUS];
+
+        // Ignore stale values, so that a dead endpoint doesn't pin the GPUs in high performance state
+        bool fresh = queue_snapshot(depths);
+
+        for (unsigned int i = 0; i < deviceCount; i++) {
+          gpuStates[i].queue.depth = fresh && i < QUEUE_MAX_GPUS ? depths[i] : 0;
+        }
+      }
+
+      // Read the latest DCGM values of all GPUs in one call
+      bool dcgmUpdated = dcgm.host != NULL && dcgm_update();
+
       // Loop through all devices
       for (unsigned int i = 0; i < deviceCount; i++) {
         // Get the current state of the GPU
         gpuState * state = &gpuStates[i];
 
-        // Retrieve the current temperature of the GPU
-        NVML_CALL(nvmlDeviceGetTemperature(nvmlDevices[i], NVML_TEMPERATURE_GPU, &temperature), errored);
+        // Get the policy parameters of the GPU
+        gpuParams * params = &state->params;
 
-        // Check if the GPU temperature exceeds the defined threshold
-        if (temperature > temperatureThreshold) {
-          // If the GPU is not already in low performance state
-          if (state->pstateId != performanceStateLow) {
-            // Switch to low performance state
-            if (!enter_pstate(i, performanceStateLow, clockFreqMemHigh, clockFreqGpuHigh, clockFreqMemLow, clockFreqGpuLow)) {
-              goto errored;
-            }
-          }
+        // Skip quarantined GPUs, any NVML call on them may fail
+        if (state->quarantined) {
+          continue;
+        }
+
+        // Take the fresh DCGM values of the GPU, NVML is read for the others
+        dcgmSample sample = { 0 };
+
+        if (dcgmUpdated && state->managed) {
+          dcgm_sample(state->uuid, &sample);
+        }
+
+        // Account the time since the previous sample to the current performance state
+        unsigned long long sampleTime = get_time_ms();
+        stats_account_time(&state->stats, state->pstateId, sampleTime - state->lastSampleTime);
+
+        // Account the time to the processes on the GPU
+        process_table_account_time(&state->processes, state->pstateId, sampleTime - state->lastSampleTime);
+
+        // Poll the processes on the GPU if the tracking interval has elapsed
+        if (processTracking && state->managed && sampleTime - state->processes.lastPoll >= processTrackingInterval) {
+          poll_processes(i);
+        }
+
+        // Watch the host-CPU activity of the processes on the GPU if enabled
+        if (cpuPredict && state->managed) {
+          predict_cpu(i, cpuPredictThreshold, cpuPredictIdle, cpuPredictHold);
+        }
+
+        // Account the time since the previous sample to the current workload class
+        state->classifier.residency[state->classifier.current] += sampleTime - state->lastSampleTime;
+
+        // Remember the time of the previous sample to measure the ramp penalty
+        unsigned long long previousSampleTime = state->lastSampleTime;
+        state->lastSampleTime = sampleTime;
+
+        // Take a GPU owned by another process over once it is free again
+        if (state->managed && !state->owned && !reclaim_ownership(i, ownershipLocking, ownershipBackoff)) {
+          goto errored;
+        }
+
+        // Check that the last transition showed
+        if (verifyTransitions && state->managed && state->owned && !verify_transition(i, verifyDeadline, verifyRetries, verifyEscalate)) {
+          goto errored;
+        }
+
+        // Check that no other process changed the state of the GPU, a transition still being verified isn't a foreign write
+        if (foreignWrites != FOREIGN_WRITES_IGNORE && state->managed && state->owned && !(verifyTransitions && state->verifyPending) && !check_foreign_writes(i, foreignWrites, ownershipLocking, eventsEnabled ? FOREIGN_WRITE_EVENT_CHECK_INTERVAL : FOREIGN_WRITE_CHECK_INTERVAL)) {
+          goto errored;
+        }
+
+        // Leave GPUs owned by another process alone
+        if (state->managed && !state->owned) {
+          continue;
+        }
+
+        // Take the telemetry of the GPU through the core
+        pstated_snapshot snapshot = { .size = sizeof(snapshot) };
+
+        if (pstated_snapshot_take(core, i, &snapshot) != PSTATED_OK) {
+          // Quarantine a GPU that can't be read anymore with the failed call, the other GPUs keep being managed
+          const char * call;
+          const char * error;
 
-          // Skip further checks for this iteration
+          pstated_last_error(core, i, &call, &error);
+          quarantine_gpu(i, call, error);
           continue;
         }
 
-        // Retrieve the current utilization rates of the GPU
-        NVML_CALL(nvmlDeviceGetUtilizationRates(nvmlDevices[i], &utilization), errored);
+        // Take the temperature from DCGM when it has a fresh value
+        if (sample.hasTemperature) {
+          snapshot.temperature = sample.temperature;
+        }
+
+        unsigned int temperature = snapshot.temperature;
+
+        // Remember the temperature for the node-level controllers
+        state->temperature = temperature;
+
+        // Trace the temperature
+        if (state->managed) {
+          trace_counter(i, TRACE_TEMPERATURE, temperature);
+        }
+
+        // Record the temperature and the latest utilization in the history
+        if (historyDir != NULL && state->managed) {
+          // Values of the sample
+          double values[HISTORY_METRIC_COUNT] = {
+            [HISTORY_TEMPERATURE] = temperature,
+            [HISTORY_UTILIZATION] = state->utilization,
+          };
+
+          // Append the sample
+          history_append(&state->history, (unsigned long long) time(NULL), values);
+        }
+
+        // Lower the power limit early if the temperature is forecasted to cross the threshold
+        if (thermalPredict && state->managed) {
+          predict_thermal(i, state->temperature, thermalPredictHorizon, thermalPredictMargin, thermalCoordinate, fanControl ? fanSpeedStep : 0);
+        }
+
+        // Slow the fans down again once the GPU has cooled off
+        if (fanControl && state->managed) {
+          relax_fans(i, temperature, fanSpeedStep);
+        }
+
+        // Keep the clocks above the temperature threshold if the fans can hold the GPU under it
+        bool cooled = temperature > params->temperatureThreshold && fanControl && state->managed && cool_with_fans(i, temperature, params->temperatureThreshold, fanSpeedStep);
+
+        // Take the activity from DCGM when it has a fresh value, rounded so that background noise below half a percent counts as idle
+        if (sample.hasActivity) {
+          snapshot.utilization = (unsigned int) (sample.activity + 0.5);
+          state->dcgmSamples++;
+        }
+
+        // Remember the utilization for the history
+        state->utilization = snapshot.utilization;
+
+        // Trace the utilization
+        if (state->managed) {
+          trace_counter(i, TRACE_UTILIZATION, snapshot.utilization);
+        }
+
+        // Update the features of the policy model if enabled, the process count is only known with process tracking
+        if (policyModel.count > 0 && state->managed) {
+          model_features_update(&state->model.features, policyModel.window, sampleTime, snapshot.utilization, snapshot.power, state->processes.count);
+        }
+
+        // Check whether GPU work followed the pre-ramp on host-CPU activity
+        if (state->cpu.preRampPending) {
+          if (snapshot.utilization != 0) {
+            // Count the hit and the time the ramp was made ahead of the work
+            state->cpu.preRampHits++;
+            state->cpu.leadSum += sampleTime - state->cpu.preRampTime;
+            state->cpu.preRampPending = false;
+          } else if (sampleTime >= state->cpu.busyUntil) {
+            // Count the pre-ramp that wasn't followed by work
+            state->cpu.preRampMisses++;
+            state->cpu.preRampPending = false;
+          }
+        }
+
+        // Classify the workload of the GPU if enabled
+        if (autoClassify && state->managed) {
+          // Record whether the GPU was busy
+          classifier_add_sample(&state->classifier, snapshot.utilization != 0);
+
+          // Periodically re-evaluate the workload class
+          if (tick % CLASSIFY_INTERVAL == 0 && classifier_update(&state->classifier, classifyGapIterations, classifyHysteresis)) {
+            // Apply the profile of the new workload class
+            apply_profiles(i);
+
+            // Print the new workload class
+            printf("GPU %u workload class changed to %s\n", i, workload_class_name(state->classifier.current));
+          }
+        }
+
+        // Complete the snapshot with the state the daemon forced and the inputs only it knows: an application announced
+        // work, requests are queued, its processes got busy on the CPU or a peer of the job ramped
+        snapshot.pstate = state->pstateId;
+        snapshot.demand = state->hints.pending || sampleTime < state->hints.busyUntil || state->queue.depth > 0 || sampleTime < state->cpu.busyUntil || sampleTime < state->peers.busyUntil;
+        snapshot.cooled = cooled;
+        snapshot.idleHint = state->hints.idle;
+
+        // Record the sample with the inputs of the decision, so that pstated-replay takes the same one
+        if (sampleLogPath != NULL && state->managed) {
+          sampleRecord record = {
+            .time = sampleTime,
+            .gpu = i,
+            .utilization = snapshot.utilization,
+            .power = snapshot.power,
+            .processes = state->processes.count,
+            .pstateId = snapshot.pstate,
+            .temperature = snapshot.temperature,
+            .demand = snapshot.demand,
+            .idleHint = snapshot.idleHint,
+            .cooled = snapshot.cooled,
+          };
+
+          samples_write(&record);
+        }
+
+        // Let the core decide the performance state of the GPU
+        unsigned int pstateId;
+
+        if (pstated_step(core, i, &snapshot, &pstateId) != PSTATED_OK) {
+          goto errored;
+        }
+
+        // Act on the decision, depending on its reason
+        int reason = pstated_step_reason(core, i);
+
+        switch (decision_action(reason, state->pstateId, pstateId, ramp_enabled(&ramps))) {
+          case DECISION_QUEUE:
+            // Queue the ramp, the ramp scheduler spaces it from the ramps of the other GPUs
+            if (ramp_wait(&state->ramp.wait, sampleTime, tick)) {
+              state->ramp.since = previousSampleTime;
+            }
+
+            break;
 
-        // Check if the GPU utilization is not zero
-        if (utilization.gpu != 0) {
-          // If the GPU is not already in high performance state
-          if (state->pstateId != performanceStateHigh) {
-            // Switch to high performance state
-            if (!enter_pstate(i, performanceStateHigh, clockFreqMemHigh, clockFreqGpuHigh, clockFreqMemLow, clockFreqGpuLow)) {
+          case DECISION_RAMP:
+            // Ramp up now
+            if (!ramp_up(i, previousSampleTime)) {
               goto errored;
             }
-          } else {
-            // Reset the iteration counter
-            state->iterations = 0;
-          }
-        } else {
-          // If the GPU is not already in low performance state
-          if (state->pstateId != performanceStateLow) {
-            // If the number of iterations exceeds the threshold
-            if (state->iterations > iterationsBeforeSwitch) {
-              // Switch to low performance state
-              if (!enter_pstate(i, performanceStateLow, clockFreqMemHigh, clockFreqGpuHigh, clockFreqMemLow, clockFreqGpuLow)) {
-                goto errored;
-              }
+
+            break;
+
+          case DECISION_SWITCH:
+            // Count the decision to cut clocks
+            if (reason == PSTATED_REASON_TEMPERATURE) {
+              state->clockDecisions++;
             }
 
-            // Increment the iteration counter
-            state->iterations++;
-          }
+            // Switch to the decided state
+            if (!enter_pstate(i, pstateId, decision_reason_name(reason))) {
+              goto errored;
+            }
+
+            // The idle hint has been acted on
+            if (reason != PSTATED_REASON_TEMPERATURE) {
+              state->hints.idle = false;
+            }
+
+            break;
+
+          default:
+            // The busy hint has been acted on once the GPU is in high performance state
+            if (reason == PSTATED_REASON_BUSY) {
+              state->hints.pending = false;
+            }
+
+            break;
+        }
+
+        // An idle hint only applies to the idle period it was sent in
+        if (reason == PSTATED_REASON_BUSY) {
+          state->hints.idle = false;
         }
       }
 
+      // Grant the ramps held back by the ramp scheduler
+      if (ramp_enabled(&ramps) && !grant_ramps(&ramps, tick)) {
+        goto errored;
+      }
+
+      // Print the arm report if the report interval has elapsed
+      if (reportInterval != 0 && get_time_ms() - lastReportTime >= reportInterval * 1000) {
+        // Remember the time of the report
+        lastReportTime = get_time_ms();
+
+        // Print the arm report
+        print_arm_report(lastReportTime - startTime);
+      }
+
+      // Coordinate the thermal reductions of all GPUs if enabled
+      if (thermalCoordinate) {
+        coordinate_thermal(thermalPredictHorizon, thermalPredictMargin, fanControl ? fanSpeedStep : 0);
+      }
+
+      // Write the metrics file if the metrics interval has elapsed
+      if (metricsFile != NULL && get_time_ms() - lastMetricsTime >= metricsInterval * 1000) {
+        // Remember the time of the update
+        lastMetricsTime = get_time_ms();
+
+        // Write the metrics file
+        write_metrics(metricsFile);
+      }
+
+      // Increment the iteration counter
+      tick++;
+
       // Sleep for a defined interval before the next check
       #ifdef _WIN32
         Sleep(sleepInterval);
@@ -714,6 +4542,31 @@ static int run(int argc, char * argv[]) {
         usleep(sleepInterval * 1000);
       #endif
     }
+
+    // Print the final arm report
+    print_arm_report(get_time_ms() - startTime);
+
+    // Write the final metrics file
+    if (metricsFile != NULL) {
+      write_metrics(metricsFile);
+    }
+  }
+
+  /***** UPGRADE *****/
+  {
+    // Hand the GPUs over to the new binary instead of releasing them
+    if (upgradeRequested) {
+      if (handoff_check(selfPath) && save_handoff()) {
+        // Print the number of GPUs handed over
+        printf("Handing over %u GPUs...\n", handoffCount);
+
+        // Jump to cleanup section, the new binary is executed at the end
+        goto cleanup;
+      }
+
+      // Release the GPUs as usual if the state could not be saved
+      fprintf(stderr, "Unable to hand over the GPUs, exiting instead\n");
+    }
   }
 
   /***** NORMAL EXIT *****/
@@ -723,18 +4576,23 @@ static int run(int argc, char * argv[]) {
       // Get the current state of the GPU
       gpuState * state = &gpuStates[i];
       
-      // If we're using clock control for this GPU
-      if (state->usingClockControl) {
-        // Reset to default clocks
-        nvmlReturn_t result = nvmlDeviceResetApplicationsClocks(nvmlDevices[i]);
-        if (result != NVML_SUCCESS) {
-          fprintf(stderr, "Warning: Failed to reset clocks for GPU %u: %s\n", i, nvmlErrorString(result));
-        }
-      } else {
-        // Switch to automatic management of performance state
-        if (!enter_pstate(i, 16, clockFreqMemHigh, clockFreqGpuHigh, clockFreqMemLow, clockFreqGpuLow)) {
-          goto errored;
+      // Attribute the remaining energy and report the processes still running
+      if (processTracking && state->managed) {
+        if (!state->quarantined) {
+          poll_processes(i);
         }
+
+        process_table_flush(&state->processes, i, report_process);
+      }
+
+      // Leave GPUs owned by another process and quarantined GPUs as they are
+      if (!state->owned || state->quarantined) {
+        continue;
+      }
+
+      // Hand the GPU back to the driver
+      if (!restore_gpu(i)) {
+        goto errored;
       }
     }
 
@@ -752,27 +4610,120 @@ static int run(int argc, char * argv[]) {
   }
 
   cleanup:
-  /***** NVAPI DEINIT *****/
+  /***** QUEUE DEPTH *****/
+  {
+    // Stop scraping the queue depth
+    queue_stop();
+  }
+
+  /***** DCGM *****/
+  {
+    // Disconnect from the DCGM host engine
+    dcgm_close();
+  }
+
+  /***** EVENTS *****/
+  {
+    // Stop the event listener
+    events_stop();
+  }
+
+  /***** TRACE *****/
+  {
+    // Write the trace file and stop recording
+    if (traceFile != NULL) {
+      trace_write(traceFile);
+    }
+
+    trace_close();
+  }
+
+  /***** HINT SOCKET *****/
+  {
+    // Close the hint socket if it was opened
+    hint_socket_close();
+  }
+
+  /***** PEER GROUP *****/
+  {
+    // Leave the peer group if it was joined
+    peers_close();
+  }
+
+  /***** POLICY MODEL *****/
+  {
+    // Release the policy model and close the sample log
+    model_free(&policyModel);
+    samples_close();
+  }
+
+  /***** SUBSCRIBE SOCKET *****/
+  {
+    // Disconnect the subscribers and close the socket if it was opened
+    subscribe_socket_close();
+  }
+
+  /***** HISTORY *****/
+  {
+    // Write the remaining samples of each GPU that records a history
+    for (unsigned int i = 0; i < deviceCount; i++) {
+      if (gpuStates[i].history.dir != NULL) {
+        history_close(&gpuStates[i].history);
+      }
+    }
+  }
+
+  /***** OWNERSHIP *****/
+  {
+    // Release the ownership locks, so that another daemon can take the GPUs over, except the ones passed on to the new binary
+    for (unsigned int i = 0; i < deviceCount; i++) {
+      if (handoffFd < 0 || !gpuStates[i].lock.inherited) {
+        ownership_release(&gpuStates[i].lock);
+      }
+    }
+  }
+
+  /***** PROCESS LOG *****/
   {
-    // Unload NVAPI library if it was initialized
-    if (nvapiInitialized) {
-      // Set NVAPI initialization flag to false
-      nvapiInitialized = false;
+    // Close the process log if it was opened
+    if (processLog != NULL) {
+      fclose(processLog);
+      processLog = NULL;
+    }
+  }
 
-      // Unload NVAPI library
-      NVAPI_CALL(NvAPI_Unload(), errored);
+  /***** CORE DEINIT *****/
+  {
+    // Release NVAPI and NVML if they were initialized
+    if (core != NULL) {
+      // Forget the context first, so that a failure doesn't release it twice
+      pstated_context * context = core;
+      core = NULL;
+
+      // Release NVAPI and NVML
+      if (pstated_close(context) != PSTATED_OK) {
+        goto errored;
+      }
     }
   }
 
-  /***** NVML DEINIT *****/
+  /***** UPGRADE EXEC *****/
   {
-    // Shutdown NVML library if it was initialized
-    if (nvmlInitialized) {
-      // Set NVML initialization flag to false
-      nvmlInitialized = false;
+    // Replace the process with the new binary once everything else is released
+    if (handoffFd >= 0 && !errorOccurred) {
+      // Print the path of the binary
+      printf("Executing %s...\n", selfPath);
+
+      // Execute the binary, this only returns on failure
+      if (!handoff_exec(selfPath, argv, handoffFd)) {
+        // Take the GPUs back and restore them as on a normal exit
+        fprintf(stderr, "Unable to hand over the GPUs, restoring them instead\n");
+        handoffFd = -1;
+        restore_handoff();
+      }
 
-      // Shutdown NVML library
-      NVML_CALL(nvmlShutdown(), errored);
+      // The upgrade failed
+      errorOccurred = true;
     }
   }
 
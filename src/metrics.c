@@ -0,0 +1,107 @@
+#include "metrics.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#endif
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Prefix of all metric names
+#define METRICS_PREFIX "nvidia_pstated_"
+
+// Maximum length of the metrics file path
+#define METRICS_PATH_MAX 4096
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static bool temporary_path(const char *path, char *buffer, size_t size) {
+  // Append a suffix to the target path, the file is renamed over the target once complete
+  return snprintf(buffer, size, "%s.tmp", path) < (int) size;
+}
+
+FILE * metrics_open(const char *path) {
+  // Buffer to hold the temporary file path
+  char temporary[METRICS_PATH_MAX];
+
+  // Build the temporary file path
+  if (!temporary_path(path, temporary, sizeof(temporary))) {
+    return NULL;
+  }
+
+  // Open the temporary file for writing
+  FILE *file = fopen(temporary, "w");
+
+  // Print an error message if the file could not be opened
+  if (file == NULL) {
+    fprintf(stderr, "Unable to open metrics file %s\n", temporary);
+  }
+
+  // Return the file handle
+  return file;
+}
+
+bool metrics_close(FILE *file, const char *path) {
+  // Buffer to hold the temporary file path
+  char temporary[METRICS_PATH_MAX];
+
+  // Build the temporary file path
+  if (!temporary_path(path, temporary, sizeof(temporary))) {
+    fclose(file);
+    return false;
+  }
+
+  // Close the temporary file and check for write errors
+  if (fclose(file) != 0) {
+    fprintf(stderr, "Unable to write metrics file %s\n", temporary);
+    return false;
+  }
+
+  // Atomically replace the target file so that readers never see a partial file
+  #ifdef _WIN32
+    bool replaced = MoveFileExA(temporary, path, MOVEFILE_REPLACE_EXISTING) != 0;
+  #else
+    bool replaced = rename(temporary, path) == 0;
+  #endif
+
+  // Print an error message if the file could not be replaced
+  if (!replaced) {
+    fprintf(stderr, "Unable to replace metrics file %s\n", path);
+  }
+
+  // Return whether the file was replaced
+  return replaced;
+}
+
+void metrics_header(FILE *file, const char *name, const char *type, const char *help) {
+  // Print the help and type lines of the metric
+  fprintf(file, "# HELP " METRICS_PREFIX "%s %s\n", name, help);
+  fprintf(file, "# TYPE " METRICS_PREFIX "%s %s\n", name, type);
+}
+
+void metrics_value(FILE *file, const char *name, double value) {
+  // Print the value of a node-level metric
+  fprintf(file, METRICS_PREFIX "%s %.15g\n", name, value);
+}
+
+void metrics_label_value(FILE *file, const char *name, const char *label, const char *labelValue, double value) {
+  // Print the value of a node-level metric with a label
+  fprintf(file, METRICS_PREFIX "%s{%s=\"%s\"} %.15g\n", name, label, labelValue, value);
+}
+
+void metrics_gpu_value(FILE *file, const char *name, unsigned int gpu, double value) {
+  // Print the value of the metric for a GPU
+  fprintf(file, METRICS_PREFIX "%s{gpu=\"%u\"} %.15g\n", name, gpu, value);
+}
+
+void metrics_gpu_label_value(FILE *file, const char *name, unsigned int gpu, const char *label, const char *labelValue, double value) {
+  // Print the value of the metric for a GPU with an additional label
+  fprintf(file, METRICS_PREFIX "%s{gpu=\"%u\",%s=\"%s\"} %.15g\n", name, gpu, label, labelValue, value);
+}
+
+void metrics_gpu_labels_value(FILE *file, const char *name, unsigned int gpu, const char *label, const char *labelValue, const char *label2, const char *label2Value, double value) {
+  // Print the value of the metric for a GPU with two additional labels
+  fprintf(file, METRICS_PREFIX "%s{gpu=\"%u\",%s=\"%s\",%s=\"%s\"} %.15g\n", name, gpu, label, labelValue, label2, label2Value, value);
+}
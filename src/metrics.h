@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+FILE * metrics_open(const char *path);
+bool metrics_close(FILE *file, const char *path);
+void metrics_header(FILE *file, const char *name, const char *type, const char *help);
+void metrics_value(FILE *file, const char *name, double value);
+void metrics_label_value(FILE *file, const char *name, const char *label, const char *labelValue, double value);
+void metrics_gpu_value(FILE *file, const char *name, unsigned int gpu, double value);
+void metrics_gpu_label_value(FILE *file, const char *name, unsigned int gpu, const char *label, const char *labelValue, double value);
+void metrics_gpu_labels_value(FILE *file, const char *name, unsigned int gpu, const char *label, const char *labelValue, const char *label2, const char *label2Value, double value);
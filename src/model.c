@@ -0,0 +1,259 @@
+#include "model.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// First word of a model file
+#define MODEL_HEADER "pstated-model"
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Names of the features, in the order of modelFeature
+static const char *featureNames[MODEL_FEATURE_COUNT] = {
+  [MODEL_UTILIZATION]      = "utilization",
+  [MODEL_UTILIZATION_MEAN] = "utilization_mean",
+  [MODEL_IDLE_TIME]        = "idle_ms",
+  [MODEL_POWER]            = "power_w",
+  [MODEL_PROCESSES]        = "processes",
+};
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+const char * model_feature_name(modelFeature feature) {
+  // Name of the feature, as written in the model file
+  return feature < MODEL_FEATURE_COUNT ? featureNames[feature] : "unknown";
+}
+
+static bool check_features(const char *line) {
+  // Copy the line, strtok modifies it
+  char copy[256];
+  snprintf(copy, sizeof(copy), "%s", line);
+
+  // Compare each name with the features of this build, in order
+  char *token = strtok(copy, " \n");
+
+  if (token == NULL || strcmp(token, "features") != 0) {
+    return false;
+  }
+
+  for (unsigned int i = 0; i < MODEL_FEATURE_COUNT; i++) {
+    token = strtok(NULL, " \n");
+
+    if (token == NULL || strcmp(token, featureNames[i]) != 0) {
+      return false;
+    }
+  }
+
+  // No extra feature may follow
+  return strtok(NULL, " \n") == NULL;
+}
+
+static bool check_nodes(const model *model) {
+  // Every inner node must point to existing children further down the array, so that a walk always ends at a leaf
+  for (unsigned int i = 0; i < model->count; i++) {
+    const modelNode *node = &model->nodes[i];
+
+    if (node->feature == MODEL_LEAF) {
+      continue;
+    }
+
+    if (node->feature < 0 || node->feature >= MODEL_FEATURE_COUNT || i + 1 >= model->count || node->right <= i + 1 || node->right >= model->count) {
+      return false;
+    }
+  }
+
+  // Return true if the tree is well-formed
+  return model->count > 0;
+}
+
+bool model_load(model *model, const char *path) {
+  // Start from an empty model
+  memset(model, 0, sizeof(*model));
+
+  // Open the file
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "Unable to open model file %s\n", path);
+    return false;
+  }
+
+  // Check the header
+  unsigned int version;
+
+  if (fscanf(file, MODEL_HEADER " %u\n", &version) != 1 || version != MODEL_VERSION) {
+    fprintf(stderr, "Model file %s has an unknown format\n", path);
+    goto errored;
+  }
+
+  // Read the file line by line
+  char line[256];
+  unsigned int declared = 0;
+  bool hasFeatures = false;
+
+  while (fgets(line, sizeof(line), file) != NULL) {
+    // Skip comments and empty lines
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+
+    // Read the window of the utilization mean
+    if (sscanf(line, "window %u", &model->window) == 1) {
+      if (model->window == 0 || model->window > MODEL_WINDOW_MAX) {
+        fprintf(stderr, "Model file %s has an invalid window: %u\n", path, model->window);
+        goto errored;
+      }
+
+      continue;
+    }
+
+    // Check that the model was trained on the features of this build
+    if (strncmp(line, "features", 8) == 0) {
+      if (!check_features(line)) {
+        fprintf(stderr, "Model file %s was trained on other features: %s", path, line);
+        goto errored;
+      }
+
+      hasFeatures = true;
+      continue;
+    }
+
+    // Read the number of nodes and allocate them
+    if (sscanf(line, "nodes %u", &declared) == 1) {
+      if (model->nodes != NULL || declared == 0 || declared > MODEL_MAX_NODES) {
+        fprintf(stderr, "Model file %s has an invalid node count: %u\n", path, declared);
+        goto errored;
+      }
+
+      model->nodes = calloc(declared, sizeof(modelNode));
+
+      if (model->nodes == NULL) {
+        fprintf(stderr, "Unable to allocate %u model nodes\n", declared);
+        goto errored;
+      }
+
+      continue;
+    }
+
+    // Read a node
+    int feature;
+    unsigned int right;
+    float threshold;
+
+    if (model->nodes == NULL || model->count == declared || sscanf(line, "%d %f %u", &feature, &threshold, &right) != 3 || right > MODEL_MAX_NODES) {
+      fprintf(stderr, "Model file %s has an invalid line: %s", path, line);
+      goto errored;
+    }
+
+    model->nodes[model->count].feature = (int16_t) feature;
+    model->nodes[model->count].threshold = threshold;
+    model->nodes[model->count].right = (uint16_t) right;
+    model->count++;
+  }
+
+  // Check that the model is complete and that its tree is well-formed
+  if (model->window == 0 || !hasFeatures || model->count != declared || !check_nodes(model)) {
+    fprintf(stderr, "Model file %s is incomplete or malformed\n", path);
+    goto errored;
+  }
+
+  // Close the file
+  fclose(file);
+
+  // Return true to indicate success
+  return true;
+
+errored:
+  // Close the file and release the nodes read so far
+  fclose(file);
+  model_free(model);
+
+  // Return false to indicate failure
+  return false;
+}
+
+bool model_save(const model *model, const char *path) {
+  // Open the file
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    fprintf(stderr, "Unable to open model file %s\n", path);
+    return false;
+  }
+
+  // Write the header, the window and the features
+  fprintf(file, MODEL_HEADER " %u\n", MODEL_VERSION);
+  fprintf(file, "window %u\n", model->window);
+  fprintf(file, "features");
+
+  for (unsigned int i = 0; i < MODEL_FEATURE_COUNT; i++) {
+    fprintf(file, " %s", featureNames[i]);
+  }
+
+  fprintf(file, "\n");
+
+  // Write one line per node, in pre-order
+  fprintf(file, "nodes %u\n", model->count);
+  fprintf(file, "# feature threshold right (feature %d is a leaf, its threshold is the value)\n", MODEL_LEAF);
+
+  for (unsigned int i = 0; i < model->count; i++) {
+    fprintf(file, "%d %.9g %u\n", model->nodes[i].feature, model->nodes[i].threshold, model->nodes[i].right);
+  }
+
+  // Flush the file and check for write errors
+  bool ok = fflush(file) == 0 && !ferror(file);
+
+  if (fclose(file) != 0 || !ok) {
+    fprintf(stderr, "Unable to write model file %s\n", path);
+    return false;
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+void model_free(model *model) {
+  // Release the nodes
+  free(model->nodes);
+  model->nodes = NULL;
+  model->count = 0;
+}
+
+float model_predict(const model *model, const float *values) {
+  // Walk down from the root until a leaf is reached
+  const modelNode *nodes = model->nodes;
+  unsigned int i = 0;
+
+  while (nodes[i].feature != MODEL_LEAF) {
+    i = values[nodes[i].feature] <= nodes[i].threshold ? i + 1 : nodes[i].right;
+  }
+
+  // Return the value of the leaf
+  return nodes[i].threshold;
+}
+
+void model_features_update(modelFeatures *features, unsigned int window, unsigned long long time, unsigned int utilization, unsigned int power, unsigned int processes) {
+  // Count the idle time from the first sample until the GPU is seen busy
+  if (features->count == 0 || utilization != 0) {
+    features->lastBusy = time;
+  }
+
+  // Replace the oldest utilization once the window is full
+  if (features->count == window) {
+    features->sum -= features->history[features->head];
+  } else {
+    features->count++;
+  }
+
+  features->history[features->head] = (unsigned char) (utilization > 100 ? 100 : utilization);
+  features->sum += features->history[features->head];
+  features->head = (features->head + 1) % window;
+
+  // Compute the features
+  features->values[MODEL_UTILIZATION] = (float) utilization;
+  features->values[MODEL_UTILIZATION_MEAN] = (float) features->sum / features->count;
+  features->values[MODEL_IDLE_TIME] = (float) (time - features->lastBusy);
+  features->values[MODEL_POWER] = power / 1000.0f;
+  features->values[MODEL_PROCESSES] = (float) processes;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Version of the model file format
+#define MODEL_VERSION 1
+
+// Maximum number of nodes of a model, children are addressed with 16 bits
+#define MODEL_MAX_NODES 65535
+
+// Maximum number of samples the utilization mean is taken over
+#define MODEL_WINDOW_MAX 256
+
+// Feature of a leaf node
+#define MODEL_LEAF -1
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Features the model is evaluated on
+typedef enum {
+  MODEL_UTILIZATION,
+  MODEL_UTILIZATION_MEAN,
+  MODEL_IDLE_TIME,
+  MODEL_POWER,
+  MODEL_PROCESSES,
+  MODEL_FEATURE_COUNT
+} modelFeature;
+
+// Node of a decision tree, stored in pre-order so that the left child follows its parent
+typedef struct {
+  // Feature compared by the node, MODEL_LEAF for a leaf
+  int16_t feature;
+
+  // Index of the right child, taken when the feature is above the threshold
+  uint16_t right;
+
+  // Threshold of the comparison, or the value of a leaf
+  float threshold;
+} modelNode;
+
+// Structure to hold a decision tree
+typedef struct {
+  // Nodes of the tree, the root is the first one
+  modelNode *nodes;
+  unsigned int count;
+
+  // Number of samples the utilization mean is taken over
+  unsigned int window;
+} model;
+
+// Structure to hold the features of a GPU, updated on every sample
+typedef struct {
+  // Utilization of the last samples, in a ring buffer, and their sum
+  unsigned char history[MODEL_WINDOW_MAX];
+  unsigned int head;
+  unsigned int count;
+  unsigned int sum;
+
+  // Time (in milliseconds) of the last sample with a busy GPU
+  unsigned long long lastBusy;
+
+  // Current value of each feature
+  float values[MODEL_FEATURE_COUNT];
+} modelFeatures;
+
+// Structure to hold the evaluations of the policy model on a GPU
+typedef struct {
+  // Features the policy model is evaluated on
+  modelFeatures features;
+
+  // Number of evaluations and their total time (in nanoseconds)
+  unsigned long evaluations;
+  unsigned long long evaluationTime;
+} modelUsage;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+const char * model_feature_name(modelFeature feature);
+bool model_load(model *model, const char *path);
+bool model_save(const model *model, const char *path);
+void model_free(model *model);
+float model_predict(const model *model, const float *values);
+void model_features_update(modelFeatures *features, unsigned int window, unsigned long long time, unsigned int utilization, unsigned int power, unsigned int processes);
+
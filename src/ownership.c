@@ -0,0 +1,180 @@
+#include "ownership.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#elif __linux__
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <sys/file.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Names of the foreign write policies
+static const char *policyNames[] = {
+  [FOREIGN_WRITES_IGNORE] = "ignore",
+  [FOREIGN_WRITES_OBSERVE] = "observe",
+  [FOREIGN_WRITES_YIELD] = "yield",
+  [FOREIGN_WRITES_REASSERT] = "reassert",
+};
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+bool ownership_acquire(ownershipLock *lock, const char *uuid) {
+  // Keep a lock that is already held
+  if (lock->held) {
+    return true;
+  }
+
+  #ifdef _WIN32
+    // Build the name of the mutex, visible to all sessions
+    char name[OWNERSHIP_NAME_MAX];
+    snprintf(name, sizeof(name), "Global\\nvidia-pstated-%s", uuid);
+
+    // Create the mutex, it is owned by another process if it already exists
+    HANDLE mutex = CreateMutexA(NULL, TRUE, name);
+    if (mutex == NULL) {
+      fprintf(stderr, "Unable to create ownership mutex %s: error %lu\n", name, GetLastError());
+      return false;
+    }
+
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+      CloseHandle(mutex);
+      return false;
+    }
+
+    // Keep the mutex until the lock is released
+    lock->mutex = mutex;
+    lock->held = true;
+    return true;
+  #elif __linux__
+    // Create the lock directory, it lives on tmpfs and is gone after a reboot
+    if (mkdir(OWNERSHIP_LOCK_DIR, 0755) != 0 && errno != EEXIST) {
+      fprintf(stderr, "Unable to create lock directory %s: %s\n", OWNERSHIP_LOCK_DIR, strerror(errno));
+      return false;
+    }
+
+    // Build the path of the lock file
+    char path[OWNERSHIP_NAME_MAX];
+    snprintf(path, sizeof(path), "%s/%s.lock", OWNERSHIP_LOCK_DIR, uuid);
+
+    // Open the lock file, the lock must not leak into child processes
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      fprintf(stderr, "Unable to open lock file %s: %s\n", path, strerror(errno));
+      return false;
+    }
+
+    // Take the lock without waiting, the kernel drops it when the owner exits
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+      close(fd);
+      return false;
+    }
+
+    // Write the process id, so that administrators can see who owns the GPU
+    if (ftruncate(fd, 0) == 0) {
+      dprintf(fd, "%ld\n", (long) getpid());
+    }
+
+    // Keep the descriptor until the lock is released
+    lock->fd = fd;
+    lock->held = true;
+    return true;
+  #else
+    // Print an error message
+    fprintf(stderr, "Ownership locks are not supported on this platform\n");
+
+    (void) uuid;
+    return false;
+  #endif
+}
+
+void ownership_release(ownershipLock *lock) {
+  // Skip locks that are not held
+  if (!lock->held) {
+    return;
+  }
+
+  #ifdef _WIN32
+    // Release and close the mutex
+    ReleaseMutex(lock->mutex);
+    CloseHandle(lock->mutex);
+  #elif __linux__
+    // Closing the descriptor drops the lock, the file is kept to avoid racing with the next owner
+    close(lock->fd);
+  #endif
+
+  lock->held = false;
+  lock->inherited = false;
+}
+
+int ownership_inherit(ownershipLock *lock) {
+  // Nothing to pass on for locks that are not held
+  if (!lock->held) {
+    return -1;
+  }
+
+  #ifdef __linux__
+    // Keep the descriptor open across exec, the lock then never leaves the GPU
+    if (fcntl(lock->fd, F_SETFD, 0) != 0) {
+      fprintf(stderr, "Unable to pass on the ownership lock: %s\n", strerror(errno));
+      return -1;
+    }
+
+    lock->inherited = true;
+    return lock->fd;
+  #else
+    return -1;
+  #endif
+}
+
+bool ownership_adopt(ownershipLock *lock, int fd) {
+  #ifdef __linux__
+    // Check that the descriptor passed on by the previous process is open, and keep it from leaking any further
+    if (fd < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) != 0) {
+      return false;
+    }
+
+    // Check that it still holds the lock, locking the same open file again doesn't wait
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+      close(fd);
+      return false;
+    }
+
+    // Write the process id of the new owner, the lock itself is unchanged
+    if (ftruncate(fd, 0) == 0) {
+      dprintf(fd, "%ld\n", (long) getpid());
+    }
+
+    // Keep the descriptor until the lock is released
+    lock->fd = fd;
+    lock->held = true;
+    lock->inherited = false;
+    return true;
+  #else
+    (void) lock;
+    (void) fd;
+    return false;
+  #endif
+}
+
+bool parse_foreign_write_policy(const char *name, foreignWritePolicy *policy) {
+  // Look the name up
+  for (unsigned int i = 0; i < sizeof(policyNames) / sizeof(policyNames[0]); i++) {
+    if (strcmp(name, policyNames[i]) == 0) {
+      *policy = (foreignWritePolicy) i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const char * foreign_write_policy_name(foreignWritePolicy policy) {
+  return policyNames[policy];
+}
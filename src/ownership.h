@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Directory holding the per-GPU lock files
+#ifndef OWNERSHIP_LOCK_DIR
+  #define OWNERSHIP_LOCK_DIR "/run/nvidia-pstated"
+#endif
+
+// Maximum length of a lock file path or mutex name
+#define OWNERSHIP_NAME_MAX 256
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Actions taken when another process changes the state of a GPU
+typedef enum {
+  FOREIGN_WRITES_IGNORE,
+  FOREIGN_WRITES_OBSERVE,
+  FOREIGN_WRITES_YIELD,
+  FOREIGN_WRITES_REASSERT
+} foreignWritePolicy;
+
+// Structure to hold the ownership lock of a GPU
+typedef struct {
+  // Flag to indicate if the lock is held
+  bool held;
+
+  // Flag to indicate if the lock is kept open across exec for the next process
+  bool inherited;
+
+  #ifdef _WIN32
+    // Named mutex
+    void *mutex;
+  #else
+    // Locked file descriptor
+    int fd;
+  #endif
+} ownershipLock;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool ownership_acquire(ownershipLock *lock, const char *uuid);
+void ownership_release(ownershipLock *lock);
+int ownership_inherit(ownershipLock *lock);
+bool ownership_adopt(ownershipLock *lock, int fd);
+bool parse_foreign_write_policy(const char *name, foreignWritePolicy *policy);
+const char * foreign_write_policy_name(foreignWritePolicy policy);
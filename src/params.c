@@ -0,0 +1,126 @@
+#include "params.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+/***** ***** ***** ***** ***** TYPES ***** ***** ***** ***** *****/
+
+// Structure to map a parameter name to its field
+typedef struct {
+  // Short name of the parameter (same as the command-line option)
+  const char *shortName;
+
+  // Long name of the parameter (same as the command-line option)
+  const char *longName;
+
+  // Offset of the field in the gpuParams structure
+  size_t offset;
+} paramField;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+static const paramField fields[] = {
+  { "ibs", "iterations-before-switch", offsetof(gpuParams, iterationsBeforeSwitch) },
+  { "psh", "performance-state-high",   offsetof(gpuParams, performanceStateHigh)   },
+  { "psl", "performance-state-low",    offsetof(gpuParams, performanceStateLow)    },
+  { "tt",  "temperature-threshold",    offsetof(gpuParams, temperatureThreshold)   },
+  { "cmh", "clock-mem-high",           offsetof(gpuParams, clockFreqMemHigh)       },
+  { "cgh", "clock-gpu-high",           offsetof(gpuParams, clockFreqGpuHigh)       },
+  { "cml", "clock-mem-low",            offsetof(gpuParams, clockFreqMemLow)        },
+  { "cgl", "clock-gpu-low",            offsetof(gpuParams, clockFreqGpuLow)        },
+};
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static unsigned long * find_field(gpuParams *params, const char *name) {
+  // Iterate over the known fields
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    // Check if the name matches either the short or the long name
+    if (strcmp(name, fields[i].shortName) == 0 || strcmp(name, fields[i].longName) == 0) {
+      // Return a pointer to the field
+      return (unsigned long *) ((char *) params + fields[i].offset);
+    }
+  }
+
+  // Unknown parameter name
+  return NULL;
+}
+
+bool parse_params(const char *arg, gpuParams *params) {
+  // Check if the input or output argument is invalid
+  if (arg == NULL || params == NULL) {
+    return false;
+  }
+
+  // Work on a copy so that a failed parse leaves the parameters untouched
+  gpuParams result = *params;
+
+  // Duplicate the input string
+  char *string = strdup(arg);
+
+  // Check if string duplication failed
+  if (string == NULL) {
+    return false;
+  }
+
+  // Get the first "key=value" token
+  char *token = strtok(string, ",");
+
+  // Iterate over the tokens
+  while (token != NULL) {
+    // Find the separator between key and value
+    char *separator = strchr(token, '=');
+
+    // Check if the separator is missing
+    if (separator == NULL) {
+      // Free the duplicated string
+      SAFE_FREE(string);
+
+      // Return false due to malformed token
+      return false;
+    }
+
+    // Split the token into key and value
+    *separator = '\0';
+
+    // Find the field for the key
+    unsigned long *field = find_field(&result, token);
+
+    // Check if the key is unknown or the value is invalid
+    if (field == NULL || !parse_ulong(separator + 1, field)) {
+      // Free the duplicated string
+      SAFE_FREE(string);
+
+      // Return false due to invalid token
+      return false;
+    }
+
+    // Get the next token
+    token = strtok(NULL, ",");
+  }
+
+  // Free the duplicated string
+  SAFE_FREE(string);
+
+  // Store the parsed parameters
+  *params = result;
+
+  // Return true if parsing were successful
+  return true;
+}
+
+void print_params(const char *name, const gpuParams *params) {
+  // Print each parameter prefixed with the parameter set name
+  printf("%s.iterationsBeforeSwitch = %lu\n", name, params->iterationsBeforeSwitch);
+  printf("%s.performanceStateHigh = %lu\n", name, params->performanceStateHigh);
+  printf("%s.performanceStateLow = %lu\n", name, params->performanceStateLow);
+  printf("%s.temperatureThreshold = %lu\n", name, params->temperatureThreshold);
+  printf("%s.clockFreqMemHigh = %lu\n", name, params->clockFreqMemHigh);
+  printf("%s.clockFreqGpuHigh = %lu\n", name, params->clockFreqGpuHigh);
+  printf("%s.clockFreqMemLow = %lu\n", name, params->clockFreqMemLow);
+  printf("%s.clockFreqGpuLow = %lu\n", name, params->clockFreqGpuLow);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the policy parameters applied to a GPU
+typedef struct {
+  // Number of iterations to wait before switching states
+  unsigned long iterationsBeforeSwitch;
+
+  // High and low performance states
+  unsigned long performanceStateHigh;
+  unsigned long performanceStateLow;
+
+  // Temperature threshold (in degrees C)
+  unsigned long temperatureThreshold;
+
+  // Clock frequencies for fallback mode (in MHz)
+  unsigned long clockFreqMemHigh;
+  unsigned long clockFreqGpuHigh;
+  unsigned long clockFreqMemLow;
+  unsigned long clockFreqGpuLow;
+} gpuParams;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool parse_params(const char *arg, gpuParams *params);
+void print_params(const char *name, const gpuParams *params);
@@ -0,0 +1,364 @@
+#include "peers.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "utils.h"
+
+#ifdef __linux__
+  #include <arpa/inet.h>
+  #include <dirent.h>
+  #include <errno.h>
+  #include <netinet/in.h>
+  #include <sys/socket.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// First word and version of a ramp announcement
+#define PEERS_MESSAGE "pstated-ramp"
+#define PEERS_VERSION 1
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+#ifdef __linux__
+  // Socket announcements are sent and received on
+  static int peersSocket = -1;
+
+  // Flag to indicate a multicast group (otherwise a directory of Unix sockets), and the group address
+  static bool peersMulticast;
+  static struct sockaddr_in peersGroup;
+
+  // Directory shared by the peers, and the address this daemon is bound to in it
+  static char peersDir[256];
+  static struct sockaddr_un peersAddress;
+#endif
+
+// Job the peers coordinate for, and the name of this daemon
+static char peersJob[PEERS_JOB_MAX];
+static char peersName[PEERS_NAME_MAX];
+
+// Time (in milliseconds) of the last announcement, and whether there was one
+static unsigned long long peersLastAnnounce;
+static bool peersAnnounced;
+
+// Number of announcements sent and accepted
+static unsigned long peersSentCount;
+static unsigned long peersReceivedCount;
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+#ifdef __linux__
+  static bool open_multicast(const char *host, unsigned long port) {
+    // Parse the group address
+    memset(&peersGroup, 0, sizeof(peersGroup));
+    peersGroup.sin_family = AF_INET;
+    peersGroup.sin_port = htons((unsigned short) port);
+
+    if (inet_pton(AF_INET, host, &peersGroup.sin_addr) != 1 || !IN_MULTICAST(ntohl(peersGroup.sin_addr.s_addr))) {
+      fprintf(stderr, "Peer group %s is not an IPv4 multicast address\n", host);
+      return false;
+    }
+
+    // Create a non-blocking datagram socket
+    peersSocket = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (peersSocket < 0) {
+      perror("socket()");
+      return false;
+    }
+
+    // Let several daemons on the same host join the group
+    int enable = 1;
+    setsockopt(peersSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    // Bind to the group, so that only its datagrams are received
+    if (bind(peersSocket, (struct sockaddr *) &peersGroup, sizeof(peersGroup)) != 0) {
+      perror("bind()");
+      return false;
+    }
+
+    // Join the group on the default interface
+    struct ip_mreq membership;
+    membership.imr_multiaddr = peersGroup.sin_addr;
+    membership.imr_interface.s_addr = htonl(INADDR_ANY);
+
+    if (setsockopt(peersSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+      perror("setsockopt(IP_ADD_MEMBERSHIP)");
+      return false;
+    }
+
+    // Deliver the announcements to the daemons on this host too, and keep them on the local network
+    unsigned char loop = 1;
+    unsigned char ttl = PEERS_MULTICAST_TTL;
+
+    setsockopt(peersSocket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    setsockopt(peersSocket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+    peersMulticast = true;
+
+    // Return true to indicate success
+    return true;
+  }
+
+  static bool open_directory(const char *dir) {
+    // Remember the directory and build the address of this daemon in it
+    int length = snprintf(peersDir, sizeof(peersDir), "%s", dir);
+
+    memset(&peersAddress, 0, sizeof(peersAddress));
+    peersAddress.sun_family = AF_UNIX;
+
+    int pathLength = snprintf(peersAddress.sun_path, sizeof(peersAddress.sun_path), "%s/%ld.sock", dir, (long) getpid());
+
+    if (length < 0 || (size_t) length >= sizeof(peersDir) || pathLength < 0 || (size_t) pathLength >= sizeof(peersAddress.sun_path)) {
+      fprintf(stderr, "Peer directory path is too long: %s\n", dir);
+      return false;
+    }
+
+    // Create a non-blocking datagram socket
+    peersSocket = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (peersSocket < 0) {
+      perror("socket()");
+      return false;
+    }
+
+    // Remove a stale socket left behind by a previous process with the same ID
+    unlink(peersAddress.sun_path);
+
+    // Bind the socket to its path in the directory
+    if (bind(peersSocket, (struct sockaddr *) &peersAddress, sizeof(peersAddress)) != 0) {
+      perror("bind()");
+      return false;
+    }
+
+    peersMulticast = false;
+
+    // Return true to indicate success
+    return true;
+  }
+
+  static void send_directory(const char *message) {
+    // Open the directory
+    DIR *dir = opendir(peersDir);
+    if (dir == NULL) {
+      return;
+    }
+
+    // Send the message to the socket of every other daemon
+    struct dirent *entry;
+
+    while ((entry = readdir(dir)) != NULL) {
+      // Skip the files that aren't peer sockets
+      size_t length = strlen(entry->d_name);
+
+      if (length < 6 || strcmp(entry->d_name + length - 5, ".sock") != 0) {
+        continue;
+      }
+
+      // Build the address of the peer
+      struct sockaddr_un address;
+
+      memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+
+      int pathLength = snprintf(address.sun_path, sizeof(address.sun_path), "%s/%s", peersDir, entry->d_name);
+
+      if (pathLength < 0 || (size_t) pathLength >= sizeof(address.sun_path) || strcmp(address.sun_path, peersAddress.sun_path) == 0) {
+        continue;
+      }
+
+      // Send the message, and remove the socket of a peer that exited without cleaning up
+      if (sendto(peersSocket, message, strlen(message), MSG_DONTWAIT, (struct sockaddr *) &address, sizeof(address)) < 0 && errno == ECONNREFUSED) {
+        unlink(address.sun_path);
+      }
+    }
+
+    // Close the directory
+    closedir(dir);
+  }
+#endif
+
+bool peers_open(const char *endpoint, const char *job) {
+  // Check the job ID, it is sent as one word
+  size_t jobLength = strlen(job);
+
+  if (jobLength == 0 || jobLength >= sizeof(peersJob)) {
+    fprintf(stderr, "Invalid peer job ID: %s\n", job);
+    return false;
+  }
+
+  for (const char *c = job; *c != '\0'; c++) {
+    if (isspace((unsigned char) *c)) {
+      fprintf(stderr, "Invalid peer job ID: %s\n", job);
+      return false;
+    }
+  }
+
+  strcpy(peersJob, job);
+
+  #ifdef __linux__
+    // Name this daemon after the host and the process, so that it ignores its own announcements
+    char host[64] = "localhost";
+
+    gethostname(host, sizeof(host) - 1);
+    snprintf(peersName, sizeof(peersName), "%s:%ld", host, (long) getpid());
+
+    // An endpoint of the form <address>:<port> is a multicast group, anything else is a directory
+    char address[64];
+    const char *colon = strrchr(endpoint, ':');
+    unsigned long port;
+    bool ok;
+
+    if (colon != NULL && (size_t) (colon - endpoint) < sizeof(address) && parse_ulong(colon + 1, &port) && port > 0 && port <= 65535) {
+      memcpy(address, endpoint, colon - endpoint);
+      address[colon - endpoint] = '\0';
+
+      ok = open_multicast(address, port);
+    } else {
+      ok = open_directory(endpoint);
+    }
+
+    // Close the socket if it couldn't be set up
+    if (!ok) {
+      peers_close();
+    }
+
+    return ok;
+  #else
+    // Print an error message
+    fprintf(stderr, "Peer group is not supported on this platform\n");
+
+    // Return false to indicate failure
+    (void) endpoint;
+    return false;
+  #endif
+}
+
+void peers_close(void) {
+  #ifdef __linux__
+    // Close the socket, and remove it from the directory
+    if (peersSocket >= 0) {
+      close(peersSocket);
+
+      if (!peersMulticast) {
+        unlink(peersAddress.sun_path);
+      }
+
+      peersSocket = -1;
+    }
+  #endif
+
+  // Forget the job
+  peersJob[0] = '\0';
+}
+
+bool peers_announce(void) {
+  #ifdef __linux__
+    // Nothing to do without a peer group
+    if (peersSocket < 0) {
+      return false;
+    }
+
+    // Send one announcement for GPUs ramping together
+    unsigned long long now = get_time_ms();
+
+    if (peersAnnounced && now - peersLastAnnounce < PEERS_ANNOUNCE_INTERVAL) {
+      return false;
+    }
+
+    peersAnnounced = true;
+    peersLastAnnounce = now;
+
+    // Build the announcement
+    char message[256];
+
+    snprintf(message, sizeof(message), PEERS_MESSAGE " %u %s %s\n", PEERS_VERSION, peersJob, peersName);
+
+    // Send it to the group or to every daemon in the directory
+    if (peersMulticast) {
+      if (sendto(peersSocket, message, strlen(message), MSG_DONTWAIT, (struct sockaddr *) &peersGroup, sizeof(peersGroup)) < 0) {
+        perror("sendto()");
+        return false;
+      }
+    } else {
+      send_directory(message);
+    }
+
+    // Count the announcement
+    peersSentCount++;
+
+    // Return true to indicate the announcement was sent
+    return true;
+  #else
+    return false;
+  #endif
+}
+
+bool peers_hosts_job(const processTable *processes) {
+  // No GPU hosts the job without a peer group
+  if (peersJob[0] == '\0') {
+    return false;
+  }
+
+  // Without a job ID, any GPU running processes is taken as part of the job
+  return process_table_runs_job(processes, strcmp(peersJob, PEERS_JOB_DEFAULT) != 0 ? peersJob : NULL);
+}
+
+bool peers_announce_ramp(const processTable *processes) {
+  // Only the ramps of GPUs running the job concern the peers
+  return peers_hosts_job(processes) && peers_announce();
+}
+
+bool peers_receive(char *peer, size_t size) {
+  #ifdef __linux__
+    // Nothing to receive without a peer group
+    if (peersSocket < 0) {
+      return false;
+    }
+
+    // Read the pending datagrams until one announces a ramp of the same job by another daemon
+    char message[256];
+    ssize_t length;
+
+    while ((length = recv(peersSocket, message, sizeof(message) - 1, MSG_DONTWAIT)) >= 0) {
+      message[length] = '\0';
+
+      // Parse the announcement
+      unsigned int version;
+      char job[PEERS_JOB_MAX];
+      char name[PEERS_NAME_MAX];
+
+      if (sscanf(message, PEERS_MESSAGE " %u %63s %127s", &version, job, name) != 3 || version != PEERS_VERSION) {
+        continue;
+      }
+
+      // Skip the other jobs and the own announcements looped back by the group
+      if (strcmp(job, peersJob) != 0 || strcmp(name, peersName) == 0) {
+        continue;
+      }
+
+      // Count the announcement and return the name of the peer
+      peersReceivedCount++;
+      snprintf(peer, size, "%s", name);
+
+      return true;
+    }
+  #else
+    (void) peer;
+    (void) size;
+  #endif
+
+  return false;
+}
+
+unsigned long peers_sent(void) {
+  // Number of ramp announcements sent
+  return peersSentCount;
+}
+
+unsigned long peers_received(void) {
+  // Number of ramp announcements received from the peers of the same job
+  return peersReceivedCount;
+}
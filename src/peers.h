@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "procs.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum length of a job ID
+#define PEERS_JOB_MAX 64
+
+// Job ID of daemons started without one, any GPU running processes is then taken as part of the job
+#define PEERS_JOB_DEFAULT "default"
+
+// Maximum length of a peer name (host name and process ID)
+#define PEERS_NAME_MAX 128
+
+// Minimum interval (in milliseconds) between two ramp announcements, so that GPUs ramping together send one
+#define PEERS_ANNOUNCE_INTERVAL 1000
+
+// Time to live of the multicast announcements (1 keeps them on the local network)
+#define PEERS_MULTICAST_TTL 1
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the ramps of peers on a GPU
+typedef struct {
+  // Time (in milliseconds) until which a ramp of a peer of the same job keeps the GPU in high performance state
+  unsigned long long busyUntil;
+
+  // Number of ramps triggered by a peer
+  unsigned long ramps;
+} peerState;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool peers_open(const char *endpoint, const char *job);
+void peers_close(void);
+bool peers_announce(void);
+bool peers_hosts_job(const processTable *processes);
+bool peers_announce_ramp(const processTable *processes);
+bool peers_receive(char *peer, size_t size);
+unsigned long peers_sent(void);
+unsigned long peers_received(void);
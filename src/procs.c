@@ -0,0 +1,371 @@
+#include "procs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+  #include <unistd.h>
+#endif
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Environment variables holding the job ID, as set by Slurm, PBS, LSF and Grid Engine
+static const char * const jobVariables[] = { "SLURM_JOB_ID=", "PBS_JOBID=", "LSB_JOBID=", "JOB_ID=" };
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+void process_table_begin_poll(processTable *table) {
+  // Clear the seen flag of every process
+  for (unsigned int i = 0; i < table->count; i++) {
+    table->records[i].seen = false;
+  }
+}
+
+processRecord * process_table_touch(processTable *table, unsigned int pid, unsigned long long now) {
+  // Look for the process in the table
+  for (unsigned int i = 0; i < table->count; i++) {
+    if (table->records[i].pid == pid) {
+      // Mark the process as seen
+      table->records[i].seen = true;
+      table->records[i].lastSeen = now;
+
+      // Return the existing record
+      return &table->records[i];
+    }
+  }
+
+  // The table is full, the process is not tracked
+  if (table->count >= PROCESS_MAX) {
+    return NULL;
+  }
+
+  // Add a new record
+  processRecord *record = &table->records[table->count++];
+  memset(record, 0, sizeof(*record));
+
+  // Initialize the record
+  record->pid = pid;
+  record->firstSeen = now;
+  record->lastSeen = now;
+  record->seen = true;
+
+  // Look up the cgroup and the job of the process
+  process_read_cgroup(pid, record->cgroup, sizeof(record->cgroup));
+  process_read_job(pid, record->cgroup, record->job, sizeof(record->job));
+
+  // Return the new record
+  return record;
+}
+
+void process_table_end_poll(processTable *table, unsigned int gpu, processCallback callback) {
+  // Index of the next kept record
+  unsigned int kept = 0;
+
+  // Iterate over the records
+  for (unsigned int i = 0; i < table->count; i++) {
+    if (table->records[i].seen) {
+      // Keep the record, compacting the table
+      if (kept != i) {
+        table->records[kept] = table->records[i];
+      }
+
+      kept++;
+    } else {
+      // Report the process that left the GPU
+      callback(gpu, &table->records[i]);
+    }
+  }
+
+  // Update the number of records
+  table->count = kept;
+}
+
+void process_table_flush(processTable *table, unsigned int gpu, processCallback callback) {
+  // Report every remaining process
+  for (unsigned int i = 0; i < table->count; i++) {
+    callback(gpu, &table->records[i]);
+  }
+
+  // Clear the table
+  table->count = 0;
+}
+
+void process_table_account_time(processTable *table, unsigned int pstateId, unsigned long long elapsed) {
+  // Each process on the GPU spent the whole time in the current performance state
+  for (unsigned int i = 0; i < table->count; i++) {
+    stats_account_time_array(table->records[i].timeInState, pstateId, elapsed);
+  }
+}
+
+void process_table_account_ramp(processTable *table, unsigned long long penalty) {
+  // Each process on the GPU waited for the ramp
+  for (unsigned int i = 0; i < table->count; i++) {
+    table->records[i].ramps++;
+    table->records[i].rampPenalty += penalty;
+  }
+}
+
+void process_table_account_energy(processTable *table, unsigned long long energy) {
+  // Nothing to attribute without processes
+  if (table->count == 0) {
+    return;
+  }
+
+  // Split the energy evenly between the processes on the GPU
+  for (unsigned int i = 0; i < table->count; i++) {
+    table->records[i].energy += energy / table->count;
+  }
+}
+
+double process_table_cpu_load(processTable *table, unsigned long long now) {
+  // CPU time (in microseconds) used since the last CPU poll
+  unsigned long long used = 0;
+
+  // Read the CPU time of each process
+  for (unsigned int i = 0; i < table->count; i++) {
+    processRecord *record = &table->records[i];
+
+    // Count a cgroup once, even if several of its processes use the GPU
+    bool duplicate = false;
+
+    for (unsigned int j = 0; j < i && record->cpuFromCgroup; j++) {
+      if (table->records[j].cpuFromCgroup && strcmp(table->records[j].cgroup, record->cgroup) == 0) {
+        duplicate = true;
+        break;
+      }
+    }
+
+    // Read the current CPU time
+    bool fromCgroup;
+    unsigned long long usage;
+
+    if (!process_read_cpu_usage(record->pid, record->cgroup, &fromCgroup, &usage)) {
+      record->hasCpuUsage = false;
+      continue;
+    }
+
+    // Add the time since the last reading from the same source
+    if (record->hasCpuUsage && record->cpuFromCgroup == fromCgroup && usage >= record->cpuUsage && !duplicate) {
+      used += usage - record->cpuUsage;
+    }
+
+    // Remember the reading
+    record->cpuUsage = usage;
+    record->cpuFromCgroup = fromCgroup;
+    record->hasCpuUsage = true;
+  }
+
+  // Convert the CPU time to a number of busy cores over the interval
+  unsigned long long elapsed = now - table->lastCpuPoll;
+  bool first = table->lastCpuPoll == 0;
+
+  table->lastCpuPoll = now;
+
+  return first || elapsed == 0 ? 0 : used / (elapsed * 1000.0);
+}
+
+bool process_table_runs_job(const processTable *table, const char *job) {
+  // Look for a process of the job, any process counts without a job ID
+  for (unsigned int i = 0; i < table->count; i++) {
+    if (job == NULL || strcmp(table->records[i].job, job) == 0) {
+      return true;
+    }
+  }
+
+  // The GPU doesn't host the job
+  return false;
+}
+
+void process_read_cgroup(unsigned int pid, char *buffer, size_t size) {
+  // Start with an empty cgroup
+  buffer[0] = '\0';
+
+  #ifdef __linux__
+    // Buffer to hold the path of the cgroup file
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/cgroup", pid);
+
+    // Open the cgroup file of the process
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+      return;
+    }
+
+    // Buffer to hold a line of the file
+    char line[PROCESS_CGROUP_MAX + 64];
+
+    // Read the lines, preferring the unified hierarchy ("0::/path") of cgroup v2
+    while (fgets(line, sizeof(line), file) != NULL) {
+      // Find the path after the controller list
+      char *separator = strchr(line, ':');
+      separator = separator != NULL ? strchr(separator + 1, ':') : NULL;
+
+      // Skip malformed lines
+      if (separator == NULL) {
+        continue;
+      }
+
+      // Strip the newline character
+      separator[strcspn(separator, "\n")] = '\0';
+
+      // Store the path
+      snprintf(buffer, size, "%s", separator + 1);
+
+      // Stop at the unified hierarchy
+      if (strncmp(line, "0::", 3) == 0) {
+        break;
+      }
+    }
+
+    // Close the file
+    fclose(file);
+  #else
+    (void) pid;
+    (void) size;
+  #endif
+}
+
+void process_read_job(unsigned int pid, const char *cgroup, char *buffer, size_t size) {
+  // Start with no job
+  buffer[0] = '\0';
+
+  #ifdef __linux__
+    // Buffer to hold the path of the environment file
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/environ", pid);
+
+    // Read the environment of the process, its variables are separated by null characters
+    FILE *file = fopen(path, "r");
+
+    if (file != NULL) {
+      char *entry = NULL;
+      size_t capacity = 0;
+
+      while (buffer[0] == '\0' && getdelim(&entry, &capacity, '\0', file) > 0) {
+        // Look for the variables of the batch schedulers
+        for (size_t i = 0; i < sizeof(jobVariables) / sizeof(jobVariables[0]); i++) {
+          size_t length = strlen(jobVariables[i]);
+
+          if (strncmp(entry, jobVariables[i], length) == 0) {
+            snprintf(buffer, size, "%s", entry + length);
+            break;
+          }
+        }
+      }
+
+      free(entry);
+      fclose(file);
+    }
+
+    // Fall back to the job directory of the Slurm cgroup (".../job_<id>/step_<id>/...")
+    const char *job = buffer[0] == '\0' ? strstr(cgroup, "/job_") : NULL;
+
+    if (job != NULL) {
+      job += strlen("/job_");
+      snprintf(buffer, size, "%.*s", (int) strcspn(job, "/"), job);
+    }
+  #else
+    (void) pid;
+    (void) cgroup;
+    (void) size;
+  #endif
+}
+
+bool process_read_cpu_usage(unsigned int pid, const char *cgroup, bool *fromCgroup, unsigned long long *usage) {
+  #ifdef __linux__
+    // Buffer to hold the path of the file
+    char path[PROCESS_CGROUP_MAX + 64];
+
+    // Prefer the cgroup, which also covers the data loaders and tokenizers that don't use the GPU, but not the root cgroup
+    if (cgroup[0] != '\0' && strcmp(cgroup, "/") != 0) {
+      snprintf(path, sizeof(path), "/sys/fs/cgroup%s/cpu.stat", cgroup);
+
+      // Read the "usage_usec" line of cgroup v2
+      FILE *file = fopen(path, "r");
+      if (file != NULL) {
+        char line[128];
+        bool found = false;
+
+        while (!found && fgets(line, sizeof(line), file) != NULL) {
+          found = sscanf(line, "usage_usec %llu", usage) == 1;
+        }
+
+        fclose(file);
+
+        if (found) {
+          *fromCgroup = true;
+          return true;
+        }
+      }
+    }
+
+    // Fall back to the process itself
+    snprintf(path, sizeof(path), "/proc/%u/stat", pid);
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+      return false;
+    }
+
+    char line[1024];
+    bool valid = fgets(line, sizeof(line), file) != NULL;
+    fclose(file);
+
+    // Skip the command name, which may contain spaces and parentheses
+    char *fields = valid ? strrchr(line, ')') : NULL;
+    if (fields == NULL) {
+      return false;
+    }
+
+    // Read utime and stime, the 14th and 15th fields (the 12th and 13th after the state)
+    unsigned long long utime, stime;
+    if (sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2) {
+      return false;
+    }
+
+    // Convert clock ticks to microseconds
+    *usage = (utime + stime) * 1000000ULL / (unsigned long long) sysconf(_SC_CLK_TCK);
+    *fromCgroup = false;
+    return true;
+  #else
+    (void) pid;
+    (void) cgroup;
+    (void) fromCgroup;
+    (void) usage;
+    return false;
+  #endif
+}
+
+void process_write_record(FILE *file, unsigned int gpu, const processRecord *record) {
+  // Print the identification of the process
+  fprintf(file, "{\"gpu\":%u,\"pid\":%u,\"cgroup\":\"", gpu, record->pid);
+
+  // Print the cgroup, escaping characters that are special in JSON
+  for (const char *c = record->cgroup; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      fputc('\\', file);
+    }
+
+    if ((unsigned char) *c >= 0x20) {
+      fputc(*c, file);
+    }
+  }
+
+  // Print the accounting of the process
+  fprintf(file, "\",\"duration_ms\":%llu,\"energy_j\":%.3f,\"ramps\":%lu,\"ramp_penalty_ms\":%llu,\"time_in_state_ms\":{",
+    record->lastSeen - record->firstSeen, record->energy / 1000.0, record->ramps, record->rampPenalty);
+
+  // Print the time spent in each visited performance state
+  bool first = true;
+
+  for (unsigned int i = 0; i < STATS_PSTATE_COUNT; i++) {
+    if (record->timeInState[i] != 0) {
+      fprintf(file, "%s\"%u\":%llu", first ? "" : ",", i, record->timeInState[i]);
+      first = false;
+    }
+  }
+
+  // Close the record
+  fprintf(file, "}}\n");
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "stats.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of processes tracked per GPU
+#define PROCESS_MAX 32
+
+// Maximum length of a cgroup path
+#define PROCESS_CGROUP_MAX 256
+
+// Maximum length of a job ID
+#define PROCESS_JOB_MAX 64
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the accounting of a process on a GPU
+typedef struct {
+  // Process id and cgroup of the process
+  unsigned int pid;
+  char cgroup[PROCESS_CGROUP_MAX];
+
+  // ID of the batch job the process belongs to, empty if it was not started by a scheduler
+  char job[PROCESS_JOB_MAX];
+
+  // Time (in milliseconds) the process was first and last seen on the GPU
+  unsigned long long firstSeen;
+  unsigned long long lastSeen;
+
+  // Flag to indicate if the process was seen in the current poll
+  bool seen;
+
+  // Share of the GPU energy attributed to the process (in millijoules)
+  unsigned long long energy;
+
+  // Number of ramps and ramp penalty (in milliseconds) the process waited for
+  unsigned long ramps;
+  unsigned long long rampPenalty;
+
+  // Time spent in each performance state while the process was on the GPU (in milliseconds)
+  unsigned long long timeInState[STATS_PSTATE_COUNT];
+
+  // CPU time (in microseconds) of the process or its cgroup at the last CPU poll
+  unsigned long long cpuUsage;
+  bool hasCpuUsage;
+  bool cpuFromCgroup;
+} processRecord;
+
+// Structure to hold the processes running on a GPU
+typedef struct {
+  // Flag to indicate if the processes of the GPU are tracked
+  bool tracked;
+
+  // Processes seen in the last poll
+  processRecord records[PROCESS_MAX];
+  unsigned int count;
+
+  // Time (in milliseconds) of the last poll
+  unsigned long long lastPoll;
+
+  // Energy counter (in millijoules) at the last poll
+  unsigned long long lastEnergy;
+  bool hasEnergy;
+
+  // Time (in milliseconds) of the last CPU poll
+  unsigned long long lastCpuPoll;
+} processTable;
+
+// Structure to hold the host-CPU activity of the processes on a GPU, which ramps the GPU ahead of their work
+typedef struct {
+  // CPU load (in cores) of the processes on the GPU, and whether they were seen idle since the last pre-ramp
+  double load;
+  bool idle;
+
+  // Time (in milliseconds) until which host-CPU activity keeps the GPU in high performance state
+  unsigned long long busyUntil;
+
+  // Flag to indicate a pre-ramp on host-CPU activity waiting for GPU work, and its time (in milliseconds)
+  bool preRampPending;
+  unsigned long long preRampTime;
+
+  // Number of pre-ramps followed by GPU work and not, and the lead time (in milliseconds) of the former
+  unsigned long preRampHits;
+  unsigned long preRampMisses;
+  unsigned long long leadSum;
+} processCpu;
+
+// Callback invoked for each process that left the GPU
+typedef void (*processCallback)(unsigned int gpu, const processRecord *record);
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+void process_table_begin_poll(processTable *table);
+processRecord * process_table_touch(processTable *table, unsigned int pid, unsigned long long now);
+void process_table_end_poll(processTable *table, unsigned int gpu, processCallback callback);
+void process_table_flush(processTable *table, unsigned int gpu, processCallback callback);
+void process_table_account_time(processTable *table, unsigned int pstateId, unsigned long long elapsed);
+void process_table_account_ramp(processTable *table, unsigned long long penalty);
+void process_table_account_energy(processTable *table, unsigned long long energy);
+double process_table_cpu_load(processTable *table, unsigned long long now);
+bool process_table_runs_job(const processTable *table, const char *job);
+void process_read_cgroup(unsigned int pid, char *buffer, size_t size);
+void process_read_job(unsigned int pid, const char *cgroup, char *buffer, size_t size);
+bool process_read_cpu_usage(unsigned int pid, const char *cgroup, bool *fromCgroup, unsigned long long *usage);
+void process_write_record(FILE *file, unsigned int gpu, const processRecord *record);
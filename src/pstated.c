@@ -0,0 +1,667 @@
+#include <nvapi.h>
+#include <nvml.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pstated.h"
+#include "nvapi.h"
+#include "nvml.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Defaults of the base policy, the same as the defaults of nvidia-pstated
+#define PSTATED_DEFAULT_PERFORMANCE_STATE_HIGH 16
+#define PSTATED_DEFAULT_PERFORMANCE_STATE_LOW 8
+#define PSTATED_DEFAULT_ITERATIONS_BEFORE_SWITCH 30
+#define PSTATED_DEFAULT_TEMPERATURE_THRESHOLD 80
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the state of a GPU
+typedef struct {
+  // Paired handles of the GPU
+  NvPhysicalGpuHandle nvapiDevice;
+  nvmlDevice_t nvmlDevice;
+
+  // Parameters of the base policy
+  pstated_policy policy;
+
+  // Performance state applied last, and the number of idle iterations since
+  unsigned int pstate;
+  unsigned int iterations;
+
+  // Reason of the performance state chosen by the last step
+  pstated_reason reason;
+
+  // Number of performance states applied
+  unsigned long applies;
+
+  // Driver call that failed last, and the error message of the driver
+  const char * errorCall;
+  NvAPI_ShortString errorMessage;
+} pstatedGpu;
+
+// Structure to hold an initialized core
+struct pstated_context {
+  // Flags to indicate if NVAPI and NVML were initialized
+  bool nvapiInitialized;
+  bool nvmlInitialized;
+
+  // Flag to indicate simulated GPUs, without NVAPI and NVML
+  bool mock;
+
+  // Version of the driver
+  char driverVersion[NVML_SYSTEM_DRIVER_VERSION_BUFFER_SIZE];
+
+  // GPUs, in NVML order
+  unsigned int gpuCount;
+  pstatedGpu gpus[NVAPI_MAX_PHYSICAL_GPUS];
+};
+
+/***** ***** ***** ***** ***** ABI ***** ***** ***** ***** *****/
+
+// Layouts of the structures as published in version 1.0, a public structure may only grow after them
+typedef struct {
+  size_t size;
+  unsigned int temperature;
+  unsigned int utilization;
+  unsigned int pstate;
+  unsigned int power;
+} pstatedSnapshotV1;
+
+typedef struct {
+  size_t size;
+  unsigned int performanceStateHigh;
+  unsigned int performanceStateLow;
+  unsigned int iterationsBeforeSwitch;
+  unsigned int temperatureThreshold;
+} pstatedPolicyV1;
+
+#define PSTATED_ABI_FIELD(type, v1, field) \
+  _Static_assert(offsetof(type, field) == offsetof(v1, field), "ABI break: " #type "." #field " moved")
+
+PSTATED_ABI_FIELD(pstated_snapshot, pstatedSnapshotV1, size);
+PSTATED_ABI_FIELD(pstated_snapshot, pstatedSnapshotV1, temperature);
+PSTATED_ABI_FIELD(pstated_snapshot, pstatedSnapshotV1, utilization);
+PSTATED_ABI_FIELD(pstated_snapshot, pstatedSnapshotV1, pstate);
+PSTATED_ABI_FIELD(pstated_snapshot, pstatedSnapshotV1, power);
+_Static_assert(sizeof(pstated_snapshot) >= sizeof(pstatedSnapshotV1), "ABI break: pstated_snapshot shrank");
+_Static_assert(offsetof(pstated_snapshot, demand) >= sizeof(pstatedSnapshotV1), "ABI break: pstated_snapshot 1.2 fields moved");
+
+PSTATED_ABI_FIELD(pstated_policy, pstatedPolicyV1, size);
+PSTATED_ABI_FIELD(pstated_policy, pstatedPolicyV1, performanceStateHigh);
+PSTATED_ABI_FIELD(pstated_policy, pstatedPolicyV1, performanceStateLow);
+PSTATED_ABI_FIELD(pstated_policy, pstatedPolicyV1, iterationsBeforeSwitch);
+PSTATED_ABI_FIELD(pstated_policy, pstatedPolicyV1, temperatureThreshold);
+_Static_assert(sizeof(pstated_policy) >= sizeof(pstatedPolicyV1), "ABI break: pstated_policy shrank");
+_Static_assert(offsetof(pstated_policy, predictIdle) >= sizeof(pstatedPolicyV1), "ABI break: pstated_policy 1.2 fields moved");
+
+_Static_assert(PSTATED_REASON_NONE == 0 && PSTATED_REASON_TEMPERATURE == 1 && PSTATED_REASON_BUSY == 2 && PSTATED_REASON_WAIT == 3 &&
+  PSTATED_REASON_IDLE == 4 && PSTATED_REASON_HINT == 5 && PSTATED_REASON_MODEL == 6, "ABI break: reasons changed");
+
+_Static_assert(PSTATED_OK == 0 && PSTATED_ERROR_INVALID_ARGUMENT == -1 && PSTATED_ERROR_VERSION == -2 &&
+  PSTATED_ERROR_NO_MEMORY == -3 && PSTATED_ERROR_NVAPI == -4 && PSTATED_ERROR_NVML == -5, "ABI break: status codes changed");
+
+_Static_assert(PSTATED_API_VERSION_MAJOR == 1, "ABI break: update the 1.0 layouts above and the version script");
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static pstatedGpu * get_gpu(const pstated_context * context, unsigned int gpu) {
+  // Check the context and the index of the GPU
+  if (context == NULL || gpu >= context->gpuCount) {
+    return NULL;
+  }
+
+  return (pstatedGpu *) &context->gpus[gpu];
+}
+
+static void set_nvml_error(pstatedGpu * state, const char * call, nvmlReturn_t result) {
+  // Record the failed call for pstated_last_error(), the caller decides whether and how to report it
+  state->errorCall = call;
+  snprintf(state->errorMessage, sizeof(state->errorMessage), "%s", nvmlErrorString(result));
+}
+
+static void set_nvapi_error(pstatedGpu * state, const char * call, NvAPI_Status status) {
+  // Record the failed call with the message of NVAPI
+  state->errorCall = call;
+
+  if (NvAPI_GetErrorMessage(status, state->errorMessage) != NVAPI_OK) {
+    snprintf(state->errorMessage, sizeof(state->errorMessage), "<NvAPI_GetErrorMessage() call failed>");
+  }
+}
+
+static bool check_size(size_t size, size_t minimum) {
+  // A caller structure has at least the fields of version 1.0
+  return size >= minimum;
+}
+
+unsigned int pstated_version(void) {
+  // Pack the major and minor versions
+  return (PSTATED_API_VERSION_MAJOR << 16) | PSTATED_API_VERSION_MINOR;
+}
+
+const char * pstated_status_string(int status) {
+  // Describe the status
+  switch (status) {
+    case PSTATED_OK: return "success";
+    case PSTATED_ERROR_INVALID_ARGUMENT: return "invalid argument";
+    case PSTATED_ERROR_VERSION: return "unsupported API version";
+    case PSTATED_ERROR_NO_MEMORY: return "out of memory";
+    case PSTATED_ERROR_NVAPI: return "NVAPI call failed";
+    case PSTATED_ERROR_NVML: return "NVML call failed";
+    default: return "unknown status";
+  }
+}
+
+int pstated_open(unsigned int version, pstated_context ** result) {
+  // Check the arguments
+  if (result == NULL) {
+    return PSTATED_ERROR_INVALID_ARGUMENT;
+  }
+
+  *result = NULL;
+
+  // Only callers built against the same major version share the ABI
+  if (version != PSTATED_API_VERSION_MAJOR) {
+    return PSTATED_ERROR_VERSION;
+  }
+
+  // Allocate the context
+  pstated_context * context = calloc(1, sizeof(pstated_context));
+  if (context == NULL) {
+    return PSTATED_ERROR_NO_MEMORY;
+  }
+
+  strcpy(context->driverVersion, "unknown");
+
+  /***** NVAPI INIT *****/
+  {
+    // Initialize NVAPI library
+    NVAPI_CALL(NvAPI_Initialize(), nvapiErrored);
+
+    // Mark NVAPI as initialized
+    context->nvapiInitialized = true;
+  }
+
+  /***** NVML INIT *****/
+  {
+    // Initialize NVML library
+    NVML_CALL(nvmlInit(), nvmlErrored);
+
+    // Mark NVML as initialized
+    context->nvmlInitialized = true;
+
+    // Get the driver version
+    nvmlSystemGetDriverVersion(context->driverVersion, sizeof(context->driverVersion));
+  }
+
+  // Arrays to hold the handles in enumeration order
+  NvPhysicalGpuHandle nvapiDevices[NVAPI_MAX_PHYSICAL_GPUS];
+  NvU32 deviceCount;
+
+  /***** NVAPI HANDLES *****/
+  {
+    // Get NVAPI device handles for all GPUs
+    NVAPI_CALL(NvAPI_EnumPhysicalGPUs(nvapiDevices, &deviceCount), nvapiErrored);
+  }
+
+  /***** NVML HANDLES *****/
+  {
+    // Get NVML device handles for all GPUs
+    for (unsigned int i = 0; i < deviceCount; i++) {
+      NVML_CALL(nvmlDeviceGetHandleByIndex(i, &context->gpus[i].nvmlDevice), nvmlErrored);
+    }
+  }
+
+  /***** PAIR HANDLES *****/
+  {
+    // Array to hold NVML device identifiers
+    NvU32 nvmlIdentifiers[NVAPI_MAX_PHYSICAL_GPUS];
+
+    // Array to hold NVAPI device identifiers
+    NvU32 nvapiIdentifiers[NVAPI_MAX_PHYSICAL_GPUS];
+
+    // Step 1: Loop through each device to retrieve and store NVML and NVAPI identifiers
+    for (unsigned int i = 0; i < deviceCount; i++) {
+      // Initialize struct to hold PCI info
+      nvmlPciInfo_t nvmlPciInfo;
+
+      // Get PCI info
+      NVML_CALL(nvmlDeviceGetPciInfo(context->gpus[i].nvmlDevice, &nvmlPciInfo), nvmlErrored);
+
+      // Store bus id in nvmlIdentifiers array
+      nvmlIdentifiers[i] = nvmlPciInfo.bus;
+
+      // Get bus id and store it in nvapiIdentifiers array
+      NVAPI_CALL(NvAPI_GPU_GetBusId(nvapiDevices[i], &nvapiIdentifiers[i]), nvapiErrored);
+    }
+
+    // Step 2: Match each NVML device with the NVAPI device on the same bus
+    for (unsigned int i = 0; i < deviceCount; i++) {
+      for (unsigned int j = 0; j < deviceCount; j++) {
+        // Compare NVML and NVAPI identifiers
+        if (nvmlIdentifiers[i] == nvapiIdentifiers[j]) {
+          // Store the matched device handle
+          context->gpus[i].nvapiDevice = nvapiDevices[j];
+
+          // Exit the inner loop
+          break;
+        }
+      }
+    }
+  }
+
+  /***** POLICY INIT *****/
+  {
+    // Start every GPU with the default policy, handed to the driver
+    for (unsigned int i = 0; i < deviceCount; i++) {
+      context->gpus[i].policy.size = sizeof(pstated_policy);
+      pstated_policy_default(&context->gpus[i].policy);
+
+      context->gpus[i].pstate = PSTATED_PSTATE_AUTO;
+    }
+
+    context->gpuCount = deviceCount;
+  }
+
+  // Return the context
+  *result = context;
+
+  return PSTATED_OK;
+
+  nvapiErrored:
+  /***** NVAPI ERROR OCCURRED *****/
+  {
+    pstated_close(context);
+    return PSTATED_ERROR_NVAPI;
+  }
+
+  nvmlErrored:
+  /***** NVML ERROR OCCURRED *****/
+  {
+    pstated_close(context);
+    return PSTATED_ERROR_NVML;
+  }
+}
+
+int pstated_open_mock(unsigned int version, unsigned int gpuCount, pstated_context ** result) {
+  // Check the arguments
+  if (result == NULL || gpuCount == 0 || gpuCount > NVAPI_MAX_PHYSICAL_GPUS) {
+    return PSTATED_ERROR_INVALID_ARGUMENT;
+  }
+
+  *result = NULL;
+
+  // Only callers built against the same major version share the ABI
+  if (version != PSTATED_API_VERSION_MAJOR) {
+    return PSTATED_ERROR_VERSION;
+  }
+
+  // Allocate the context
+  pstated_context * context = calloc(1, sizeof(pstated_context));
+  if (context == NULL) {
+    return PSTATED_ERROR_NO_MEMORY;
+  }
+
+  strcpy(context->driverVersion, "mock");
+  context->mock = true;
+
+  // Start every GPU with the default policy, handed to the driver
+  for (unsigned int i = 0; i < gpuCount; i++) {
+    context->gpus[i].policy.size = sizeof(pstated_policy);
+    pstated_policy_default(&context->gpus[i].policy);
+
+    context->gpus[i].pstate = PSTATED_PSTATE_AUTO;
+  }
+
+  context->gpuCount = gpuCount;
+
+  // Return the context
+  *result = context;
+
+  return PSTATED_OK;
+}
+
+int pstated_close(pstated_context * context) {
+  // Nothing to do without a context
+  if (context == NULL) {
+    return PSTATED_OK;
+  }
+
+  // Variable to hold the first failure
+  int status = PSTATED_OK;
+
+  /***** NVAPI DEINIT *****/
+  {
+    // Unload NVAPI library if it was initialized
+    if (context->nvapiInitialized) {
+      // Set NVAPI initialization flag to false
+      context->nvapiInitialized = false;
+
+      // Unload NVAPI library
+      NVAPI_CALL(NvAPI_Unload(), nvapiErrored);
+    }
+  }
+
+  /***** NVML DEINIT *****/
+  nvmlDeinit:
+  {
+    // Shutdown NVML library if it was initialized
+    if (context->nvmlInitialized) {
+      // Set NVML initialization flag to false
+      context->nvmlInitialized = false;
+
+      // Shutdown NVML library
+      NVML_CALL(nvmlShutdown(), nvmlErrored);
+    }
+  }
+
+  // Free the context
+  free(context);
+
+  return status;
+
+  nvapiErrored:
+  /***** NVAPI ERROR OCCURRED *****/
+  {
+    status = PSTATED_ERROR_NVAPI;
+    goto nvmlDeinit;
+  }
+
+  nvmlErrored:
+  /***** NVML ERROR OCCURRED *****/
+  {
+    free(context);
+    return status != PSTATED_OK ? status : PSTATED_ERROR_NVML;
+  }
+}
+
+unsigned int pstated_gpu_count(const pstated_context * context) {
+  // Number of paired GPUs
+  return context != NULL ? context->gpuCount : 0;
+}
+
+int pstated_gpu_uuid(const pstated_context * context, unsigned int gpu, char * buffer, size_t size) {
+  // Get the GPU
+  pstatedGpu * state = get_gpu(context, gpu);
+
+  if (state == NULL || buffer == NULL || size == 0 || size > UINT32_MAX) {
+    return PSTATED_ERROR_INVALID_ARGUMENT;
+  }
+
+  // Name the simulated GPUs after their index
+  if (context->mock) {
+    snprintf(buffer, size, "GPU-mock-%u", gpu);
+    return PSTATED_OK;
+  }
+
+  // Read the UUID
+  NVML_CALL(nvmlDeviceGetUUID(state->nvmlDevice, buffer, (unsigned int) size), nvmlErrored);
+
+  return PSTATED_OK;
+
+  nvmlErrored:
+  return PSTATED_ERROR_NVML;
+}
+
+const char * pstated_driver_version(const pstated_context * context) {
+  // Version read at initialization
+  return context != NULL ? context->driverVersion : "unknown";
+}
+
+void * pstated_nvml_device(const pstated_context * context, unsigned int gpu) {
+  // Get the GPU
+  pstatedGpu * state = get_gpu(context, gpu);
+
+  return state != NULL ? (void *) state->nvmlDevice : NULL;
+}
+
+void * pstated_nvapi_device(const pstated_context * context, unsigned int gpu) {
+  // Get the GPU
+  pstatedGpu * state = get_gpu(context, gpu);
+
+  return state != NULL ? (void *) state->nvapiDevice : NULL;
+}
+
+int pstated_snapshot_take(pstated_context * context, unsigned int gpu, pstated_snapshot * snapshot) {
+  // Get the GPU
+  pstatedGpu * state = get_gpu(context, gpu);
+
+  // Simulated GPUs have no telemetry, their snapshots are supplied by the caller
+  if (state == NULL || snapshot == NULL || !check_size(snapshot->size, sizeof(pstatedSnapshotV1)) || context->mock) {
+    return PSTATED_ERROR_INVALID_ARGUMENT;
+  }
+
+  // Snapshot of the current version
+  pstated_snapshot current = { .size = snapshot->size };
+
+  // Retrieve the temperature and the utilization, a failure is recorded with the call for the caller
+  nvmlUtilization_t utilization;
+  nvmlPstates_t pstate;
+  nvmlReturn_t result;
+
+  if ((result = nvmlDeviceGetTemperature(state->nvmlDevice, NVML_TEMPERATURE_GPU, &current.temperature)) != NVML_SUCCESS) {
+    set_nvml_error(state, "nvmlDeviceGetTemperature()", result);
+    return PSTATED_ERROR_NVML;
+  }
+
+  if ((result = nvmlDeviceGetUtilizationRates(state->nvmlDevice, &utilization)) != NVML_SUCCESS) {
+    set_nvml_error(state, "nvmlDeviceGetUtilizationRates()", result);
+    return PSTATED_ERROR_NVML;
+  }
+
+  current.utilization = utilization.gpu;
+
+  // Retrieve the performance state, unknown on GPUs that don't report it
+  if ((result = nvmlDeviceGetPerformanceState(state->nvmlDevice, &pstate)) == NVML_ERROR_NOT_SUPPORTED) {
+    pstate = NVML_PSTATE_UNKNOWN;
+  } else if (result != NVML_SUCCESS) {
+    set_nvml_error(state, "nvmlDeviceGetPerformanceState()", result);
+    return PSTATED_ERROR_NVML;
+  }
+
+  current.pstate = (unsigned int) pstate;
+
+  // Retrieve the power draw, not every GPU reports it
+  if (nvmlDeviceGetPowerUsage(state->nvmlDevice, &current.power) != NVML_SUCCESS) {
+    current.power = 0;
+  }
+
+  // Copy the fields the caller knows about
+  memcpy(snapshot, &current, snapshot->size < sizeof(current) ? snapshot->size : sizeof(current));
+
+  return PSTATED_OK;
+}
+
+void pstated_policy_default(pstated_policy * policy) {
+  // Nothing to fill without a structure
+  if (policy == NULL || !check_size(policy->size, sizeof(pstatedPolicyV1))) {
+    return;
+  }
+
+  // Defaults of the current version
+  pstated_policy defaults = {
+    .size = policy->size,
+    .performanceStateHigh = PSTATED_DEFAULT_PERFORMANCE_STATE_HIGH,
+    .performanceStateLow = PSTATED_DEFAULT_PERFORMANCE_STATE_LOW,
+    .iterationsBeforeSwitch = PSTATED_DEFAULT_ITERATIONS_BEFORE_SWITCH,
+    .temperatureThreshold = PSTATED_DEFAULT_TEMPERATURE_THRESHOLD,
+  };
+
+  // Copy the fields the caller knows about
+  memcpy(policy, &defaults, policy->size < sizeof(defaults) ? policy->size : sizeof(defaults));
+}
+
+int pstated_policy_set(pstated_context * context, unsigned int gpu, const pstated_policy * policy) {
+  // Get the GPU
+  pstatedGpu * state = get_gpu(context, gpu);
+
+  if (state == NULL || policy == NULL || !check_size(policy->size, sizeof(pstatedPolicyV1))) {
+    return PSTATED_ERROR_INVALID_ARGUMENT;
+  }
+
+  // Start from the defaults, so that the fields the caller doesn't know about keep them
+  pstated_policy current = { .size = sizeof(pstated_policy) };
+
+  pstated_policy_default(&current);
+  memcpy(&current, policy, policy->size < sizeof(current) ? policy->size : sizeof(current));
+  current.size = sizeof(pstated_policy);
+
+  // Check the performance states
+  if (current.performanceStateHigh > PSTATED_PSTATE_AUTO || current.performanceStateLow > PSTATED_PSTATE_AUTO) {
+    return PSTATED_ERROR_INVALID_ARGUMENT;
+  }
+
+  state->policy = current;
+
+  return PSTATED_OK;
+}
+
+int pstated_step(pstated_context * context, unsigned int gpu, const pstated_snapshot * snapshot, unsigned int * pstate) {
+  // Get the GPU
+  pstatedGpu * state = get_gpu(context, gpu);
+
+  if (state == NULL || snapshot == NULL || pstate == NULL || !check_size(snapshot->size, sizeof(pstatedSnapshotV1))) {
+    return PSTATED_ERROR_INVALID_ARGUMENT;
+  }
+
+  // Snapshot of the current version, the fields the caller doesn't know about are left at zero
+  pstated_snapshot current = { .size = sizeof(pstated_snapshot) };
+  memcpy(&current, snapshot, snapshot->size < sizeof(current) ? snapshot->size : sizeof(current));
+
+  // Get the policy of the GPU
+  const pstated_policy * policy = &state->policy;
+
+  // Keep the GPU in low performance state above the temperature threshold, unless the caller cools it otherwise
+  if (current.temperature > policy->temperatureThreshold && current.cooled == 0) {
+    state->reason = PSTATED_REASON_TEMPERATURE;
+    *pstate = policy->performanceStateLow;
+    return PSTATED_OK;
+  }
+
+  // Switch to high performance state as soon as the GPU is busy or work is announced
+  if (current.utilization != 0 || current.demand != 0) {
+    state->iterations = 0;
+    state->reason = PSTATED_REASON_BUSY;
+    *pstate = policy->performanceStateHigh;
+    return PSTATED_OK;
+  }
+
+  // Stay in the current state until the GPU was idle for long enough
+  *pstate = state->pstate;
+  state->reason = PSTATED_REASON_IDLE;
+
+  if (state->pstate != policy->performanceStateLow) {
+    // The number of iterations bounds the wait, with or without an idle predictor, an idle hint only changes the reason
+    bool waited = state->iterations > policy->iterationsBeforeSwitch;
+    bool hinted = current.idleHint != 0 && waited;
+
+    // If the number of iterations exceeds the threshold, or the idle predictor foresees a saving before
+    if (waited || (policy->predictIdle != NULL && policy->predictIdle(policy->predictUser, gpu) != 0)) {
+      *pstate = policy->performanceStateLow;
+      state->reason = hinted ? PSTATED_REASON_HINT : waited ? PSTATED_REASON_IDLE : PSTATED_REASON_MODEL;
+    } else {
+      state->reason = PSTATED_REASON_WAIT;
+    }
+
+    // Increment the iteration counter
+    state->iterations++;
+  }
+
+  return PSTATED_OK;
+}
+
+int pstated_apply(pstated_context * context, unsigned int gpu, unsigned int pstate) {
+  // Get the GPU
+  pstatedGpu * state = get_gpu(context, gpu);
+
+  if (state == NULL || pstate > PSTATED_PSTATE_AUTO) {
+    return PSTATED_ERROR_INVALID_ARGUMENT;
+  }
+
+  // Force the performance state, simulated GPUs only record it
+  NvAPI_Status status = context->mock ? NVAPI_OK : NvAPI_GPU_SetForcePstate(state->nvapiDevice, pstate, 0);
+  if (status != NVAPI_OK) {
+    // Record the failed call, the caller reports it
+    set_nvapi_error(state, "NvAPI_GPU_SetForcePstate()", status);
+    return PSTATED_ERROR_NVAPI;
+  }
+
+  // Remember the state and restart counting the idle iterations
+  state->pstate = pstate;
+  state->iterations = 0;
+  state->applies++;
+
+  return PSTATED_OK;
+}
+
+int pstated_step_reason(const pstated_context * context, unsigned int gpu) {
+  // Get the GPU
+  pstatedGpu * state = get_gpu(context, gpu);
+
+  if (state == NULL) {
+    return PSTATED_ERROR_INVALID_ARGUMENT;
+  }
+
+  return state->reason;
+}
+
+int pstated_state(const pstated_context * context, unsigned int gpu, unsigned int * pstate, unsigned int * iterations) {
+  // Get the GPU
+  pstatedGpu * state = get_gpu(context, gpu);
+
+  if (state == NULL || pstate == NULL || iterations == NULL) {
+    return PSTATED_ERROR_INVALID_ARGUMENT;
+  }
+
+  *pstate = state->pstate;
+  *iterations = state->iterations;
+
+  return PSTATED_OK;
+}
+
+int pstated_adopt(pstated_context * context, unsigned int gpu, unsigned int pstate, unsigned int iterations) {
+  // Get the GPU
+  pstatedGpu * state = get_gpu(context, gpu);
+
+  if (state == NULL || pstate > PSTATED_PSTATE_AUTO) {
+    return PSTATED_ERROR_INVALID_ARGUMENT;
+  }
+
+  // Record the state as if it was applied, the GPU is left as it is
+  state->pstate = pstate;
+  state->iterations = iterations;
+
+  return PSTATED_OK;
+}
+
+int pstated_apply_count(const pstated_context * context, unsigned int gpu, unsigned long * count) {
+  // Get the GPU
+  pstatedGpu * state = get_gpu(context, gpu);
+
+  if (state == NULL || count == NULL) {
+    return PSTATED_ERROR_INVALID_ARGUMENT;
+  }
+
+  *count = state->applies;
+
+  return PSTATED_OK;
+}
+
+int pstated_last_error(const pstated_context * context, unsigned int gpu, const char ** call, const char ** message) {
+  // Get the GPU
+  pstatedGpu * state = get_gpu(context, gpu);
+
+  if (state == NULL || call == NULL || message == NULL) {
+    return PSTATED_ERROR_INVALID_ARGUMENT;
+  }
+
+  // Empty strings until a driver call failed
+  *call = state->errorCall != NULL ? state->errorCall : "";
+  *message = state->errorMessage;
+
+  return PSTATED_OK;
+}
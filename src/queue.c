@@ -0,0 +1,475 @@
+#include "queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+  #include <errno.h>
+  #include <netdb.h>
+  #include <pthread.h>
+  #include <sys/socket.h>
+  #include <sys/time.h>
+  #include <sys/un.h>
+  #include <time.h>
+  #include <unistd.h>
+#endif
+
+#include "utils.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum size of a response
+#define QUEUE_RESPONSE_MAX (4 * 1024 * 1024)
+
+// Timeout (in milliseconds) of a single scrape
+#define QUEUE_TIMEOUT 1000
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+#ifdef __linux__
+  // Configuration of the source
+  static queueConfig queue;
+
+  // Scraper thread and its run flag, protected by the lock
+  static pthread_t queueThread;
+  static bool queueRunning;
+
+  // Lock protecting the values shared with the main loop
+  static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+
+  // Condition the scraper waits on between scrapes, signaled to stop it without waiting for the interval
+  static pthread_cond_t queueWake;
+
+  // Latest queue depths and the time (in milliseconds) of the last successful scrape
+  static double queueDepths[QUEUE_MAX_GPUS];
+  static unsigned long long queueUpdated;
+
+  // Number of failed scrapes
+  static unsigned long queueErrorCount;
+#endif
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static int match_label(const char *labels, const char *end, const char *label, unsigned long *value) {
+  // Length of the label name
+  size_t length = strlen(label);
+
+  // Look for the label in the label set
+  for (const char *c = labels; c + length + 2 < end; c++) {
+    // Check if the label name starts here and is followed by ="
+    if ((c == labels || c[-1] == '{' || c[-1] == ',' || c[-1] == ' ') && strncmp(c, label, length) == 0 && c[length] == '=' && c[length + 1] == '"') {
+      // Parse the label value as the GPU index
+      const char *start = c + length + 2;
+      char *valueEnd;
+      *value = strtoul(start, &valueEnd, 10);
+
+      // The value must be a plain number, anything else (a UUID, a name) is present but unusable
+      return valueEnd != start && *valueEnd == '"' && *start >= '0' && *start <= '9' ? 1 : -1;
+    }
+  }
+
+  // The label is missing
+  return 0;
+}
+
+bool queue_parse(const char *body, const char *metric, const char *label, double depths[QUEUE_MAX_GPUS]) {
+  // Length of the metric name
+  size_t length = strlen(metric);
+
+  // Flag to indicate if the metric was found
+  bool found = false;
+
+  // Clear the depths
+  for (unsigned int i = 0; i < QUEUE_MAX_GPUS; i++) {
+    depths[i] = 0;
+  }
+
+  // Iterate over the lines
+  for (const char *line = body; *line != '\0'; ) {
+    // Find the end of the line
+    const char *end = strchr(line, '\n');
+    if (end == NULL) {
+      end = line + strlen(line);
+    }
+
+    // Check if the line is a sample of the metric
+    if (strncmp(line, metric, length) == 0 && (line[length] == '{' || line[length] == ' ')) {
+      // Start of the value
+      const char *value = line + length;
+
+      // Variable to hold the GPU index, and whether the GPU label is present (1), missing (0) or not a number (-1)
+      unsigned long gpu = 0;
+      int hasGpu = 0;
+
+      // Parse the label set
+      if (*value == '{') {
+        // Find the end of the label set
+        const char *labelsEnd = memchr(value, '}', end - value);
+
+        // Skip malformed lines
+        if (labelsEnd == NULL) {
+          line = *end != '\0' ? end + 1 : end;
+          continue;
+        }
+
+        // Look for the GPU label
+        hasGpu = match_label(value + 1, labelsEnd, label, &gpu);
+        value = labelsEnd + 1;
+      }
+
+      // Skip samples whose GPU label isn't an index, they would otherwise count for the whole node
+      if (hasGpu < 0) {
+        line = *end != '\0' ? end + 1 : end;
+        continue;
+      }
+
+      // Parse the sample value
+      double sample = strtod(value, NULL);
+
+      // Add the sample to its GPU, or to all GPUs if it has no GPU label
+      for (unsigned int i = 0; i < QUEUE_MAX_GPUS; i++) {
+        if (hasGpu == 0 || i == gpu) {
+          depths[i] += sample;
+        }
+      }
+
+      // The metric was found
+      found = true;
+    }
+
+    // Move to the next line
+    line = *end != '\0' ? end + 1 : end;
+  }
+
+  // Return whether the metric was found
+  return found;
+}
+
+#ifdef __linux__
+  static int queue_connect(char *path, size_t size) {
+    // Socket connected to the endpoint
+    int fd = -1;
+
+    if (strncmp(queue.url, "unix:", 5) == 0) {
+      // Address of the Unix socket
+      struct sockaddr_un address = { .sun_family = AF_UNIX };
+
+      // Socket path, optionally followed by ":/<http path>"
+      const char *socketPath = queue.url + 5;
+      const char *separator = strstr(socketPath, ":/");
+      size_t socketLength = separator != NULL ? (size_t) (separator - socketPath) : strlen(socketPath);
+
+      // Check if the path fits into the address
+      if (socketLength >= sizeof(address.sun_path)) {
+        return -1;
+      }
+
+      // Build the address and the HTTP path
+      memcpy(address.sun_path, socketPath, socketLength);
+      snprintf(path, size, "%s", separator != NULL ? separator + 1 : "/metrics");
+
+      // Create the socket
+      fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+      // Apply the timeouts, which also bound the connection attempt
+      struct timeval timeout = { QUEUE_TIMEOUT / 1000, (QUEUE_TIMEOUT % 1000) * 1000 };
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+      // Connect to the endpoint
+      if (fd >= 0 && connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        close(fd);
+        fd = -1;
+      }
+    } else if (strncmp(queue.url, "http://", 7) == 0) {
+      // Buffers to hold the host and the port
+      char host[256];
+      char port[16] = "80";
+
+      // Split the URL into authority and path
+      const char *authority = queue.url + 7;
+      const char *slash = strchr(authority, '/');
+      size_t authorityLength = slash != NULL ? (size_t) (slash - authority) : strlen(authority);
+
+      // Check if the authority fits into the buffer
+      if (authorityLength >= sizeof(host)) {
+        return -1;
+      }
+
+      // Copy the authority and split the port from the host
+      memcpy(host, authority, authorityLength);
+      host[authorityLength] = '\0';
+
+      char *colon = strrchr(host, ':');
+      if (colon != NULL) {
+        snprintf(port, sizeof(port), "%s", colon + 1);
+        *colon = '\0';
+      }
+
+      // Build the HTTP path
+      snprintf(path, size, "%s", slash != NULL ? slash : "/metrics");
+
+      // Resolve the host
+      struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+      struct addrinfo *addresses;
+
+      if (getaddrinfo(host, port, &hints, &addresses) != 0) {
+        return -1;
+      }
+
+      // Connect to the first reachable address
+      for (struct addrinfo *address = addresses; address != NULL && fd < 0; address = address->ai_next) {
+        // Create the socket
+        fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0) {
+          continue;
+        }
+
+        // Apply the timeouts, which also bound the connection attempt
+        struct timeval timeout = { QUEUE_TIMEOUT / 1000, (QUEUE_TIMEOUT % 1000) * 1000 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        // Connect to the endpoint
+        if (connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+          close(fd);
+          fd = -1;
+        }
+      }
+
+      // Free the resolved addresses
+      freeaddrinfo(addresses);
+    }
+
+    // Return the connected socket
+    return fd;
+  }
+
+  static char * queue_fetch(void) {
+    // Buffer to hold the HTTP path
+    char path[1024];
+
+    // Connect to the endpoint
+    int fd = queue_connect(path, sizeof(path));
+    if (fd < 0) {
+      return NULL;
+    }
+
+    // Buffer to hold the request
+    char request[1200];
+
+    // Send a simple HTTP/1.0 request, so that the response is neither chunked nor kept alive
+    int length = snprintf(request, sizeof(request), "GET %s HTTP/1.0\r\nHost: localhost\r\nAccept: text/plain\r\n\r\n", path);
+    if (send(fd, request, length, MSG_NOSIGNAL) != length) {
+      close(fd);
+      return NULL;
+    }
+
+    // Buffer to hold the response
+    size_t capacity = 65536;
+    size_t used = 0;
+    char *response = malloc(capacity);
+
+    // Read the response until the server closes the connection
+    while (response != NULL) {
+      // Grow the buffer if it is full
+      if (used + 1 >= capacity) {
+        // Give up on oversized responses
+        if (capacity >= QUEUE_RESPONSE_MAX) {
+          SAFE_FREE(response);
+          break;
+        }
+
+        // Double the capacity
+        char *grown = realloc(response, capacity * 2);
+        if (grown == NULL) {
+          SAFE_FREE(response);
+          break;
+        }
+
+        response = grown;
+        capacity *= 2;
+      }
+
+      // Read the next chunk
+      ssize_t received = recv(fd, response + used, capacity - used - 1, 0);
+
+      // Stop at the end of the response
+      if (received == 0) {
+        break;
+      }
+
+      // Fail on errors and timeouts
+      if (received < 0) {
+        SAFE_FREE(response);
+        break;
+      }
+
+      used += received;
+    }
+
+    // Close the connection
+    close(fd);
+
+    // Terminate the response
+    if (response != NULL) {
+      response[used] = '\0';
+    }
+
+    // Return the response
+    return response;
+  }
+
+  static bool queue_scrape(double depths[QUEUE_MAX_GPUS]) {
+    // Fetch the metrics
+    char *response = queue_fetch();
+    if (response == NULL) {
+      return false;
+    }
+
+    // Check the status code and find the body
+    char *body = strstr(response, "\r\n\r\n");
+    bool ok = strncmp(response, "HTTP/1.", 7) == 0 && strncmp(response + 8, " 200", 4) == 0 && body != NULL;
+
+    // Parse the metric from the body
+    ok = ok && queue_parse(body + 4, queue.metric, queue.label, depths);
+
+    // Free the response
+    SAFE_FREE(response);
+
+    // Return whether the metric was scraped
+    return ok;
+  }
+
+  static void * queue_main(void *argument) {
+    (void) argument;
+
+    // Scrape until the source is stopped
+    pthread_mutex_lock(&queueLock);
+
+    while (queueRunning) {
+      pthread_mutex_unlock(&queueLock);
+
+      // Scraped queue depths
+      double depths[QUEUE_MAX_GPUS];
+
+      // Scrape the endpoint
+      bool ok = queue_scrape(depths);
+
+      // Publish the result
+      pthread_mutex_lock(&queueLock);
+
+      if (ok) {
+        memcpy(queueDepths, depths, sizeof(queueDepths));
+        queueUpdated = get_time_ms();
+      } else {
+        queueErrorCount++;
+      }
+
+      // Time of the next scrape, on the monotonic clock the condition waits on
+      struct timespec deadline;
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+      deadline.tv_sec += queue.interval / 1000;
+      deadline.tv_nsec += (long) (queue.interval % 1000) * 1000000;
+
+      if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+      }
+
+      // Wait until the next scrape, or until the source is stopped
+      while (queueRunning && pthread_cond_timedwait(&queueWake, &queueLock, &deadline) != ETIMEDOUT);
+    }
+
+    pthread_mutex_unlock(&queueLock);
+
+    return NULL;
+  }
+#endif
+
+bool queue_start(const queueConfig *config) {
+  #ifdef __linux__
+    // Store the configuration
+    queue = *config;
+
+    // Wait between scrapes on the monotonic clock, so that a change of the wall clock doesn't stall the scraper
+    pthread_condattr_t attributes;
+
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&queueWake, &attributes);
+    pthread_condattr_destroy(&attributes);
+
+    // Start the scraper thread
+    queueRunning = true;
+
+    if (pthread_create(&queueThread, NULL, queue_main, NULL) != 0) {
+      fprintf(stderr, "Unable to start the queue-depth scraper\n");
+      queueRunning = false;
+      pthread_cond_destroy(&queueWake);
+      return false;
+    }
+
+    // Return true to indicate success
+    return true;
+  #else
+    // Print an error message
+    fprintf(stderr, "Queue-depth source is not supported on this platform\n");
+
+    // Return false to indicate failure
+    (void) config;
+    return false;
+  #endif
+}
+
+void queue_stop(void) {
+  #ifdef __linux__
+    // Stop the scraper thread if it is running, waking it up if it waits for the next scrape
+    pthread_mutex_lock(&queueLock);
+
+    bool running = queueRunning;
+    queueRunning = false;
+
+    pthread_cond_signal(&queueWake);
+    pthread_mutex_unlock(&queueLock);
+
+    if (running) {
+      pthread_join(queueThread, NULL);
+      pthread_cond_destroy(&queueWake);
+    }
+  #endif
+}
+
+bool queue_snapshot(double depths[QUEUE_MAX_GPUS]) {
+  #ifdef __linux__
+    // Copy the latest values
+    pthread_mutex_lock(&queueLock);
+
+    memcpy(depths, queueDepths, sizeof(queueDepths));
+    bool fresh = queueUpdated != 0 && get_time_ms() - queueUpdated <= QUEUE_STALE_INTERVALS * queue.interval + QUEUE_TIMEOUT;
+
+    pthread_mutex_unlock(&queueLock);
+
+    // Return whether the values are fresh enough to act on
+    return fresh;
+  #else
+    (void) depths;
+    return false;
+  #endif
+}
+
+unsigned long queue_errors(void) {
+  #ifdef __linux__
+    // Read the error counter
+    pthread_mutex_lock(&queueLock);
+    unsigned long errors = queueErrorCount;
+    pthread_mutex_unlock(&queueLock);
+
+    // Return the error counter
+    return errors;
+  #else
+    return 0;
+  #endif
+}
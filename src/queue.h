@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs with a queue depth
+#define QUEUE_MAX_GPUS 64
+
+// Number of scrape intervals after which the last values are considered stale
+#define QUEUE_STALE_INTERVALS 4
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the configuration of the queue-depth source
+typedef struct {
+  // URL of the metrics endpoint ("http://host:port/path" or "unix:/path/to/socket[:/path]")
+  const char *url;
+
+  // Name of the gauge holding the queue depth
+  const char *metric;
+
+  // Name of the label holding the GPU index (series without it apply to all GPUs)
+  const char *label;
+
+  // Interval (in milliseconds) between scrapes
+  unsigned long interval;
+} queueConfig;
+
+// Structure to hold the queue of a GPU
+typedef struct {
+  // Queue depth reported by the inference server (0 when unknown or stale)
+  double depth;
+
+  // Number of ramps triggered by a queued request before any utilization was seen
+  unsigned long ramps;
+} queueState;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool queue_start(const queueConfig *config);
+void queue_stop(void);
+bool queue_snapshot(double depths[QUEUE_MAX_GPUS]);
+unsigned long queue_errors(void);
+bool queue_parse(const char *body, const char *metric, const char *label, double depths[QUEUE_MAX_GPUS]);
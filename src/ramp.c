@@ -0,0 +1,181 @@
+#include "ramp.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+bool ramp_enabled(const rampScheduler *scheduler) {
+  return scheduler->stagger > 0 || scheduler->budget > 0;
+}
+
+double ramp_window_power(rampScheduler *scheduler, unsigned long long now) {
+  // Drop the ramps that left the window
+  unsigned int expired = 0;
+
+  while (expired < scheduler->grantCount && now - scheduler->grants[expired].time >= scheduler->window) {
+    expired++;
+  }
+
+  if (expired > 0) {
+    memmove(scheduler->grants, scheduler->grants + expired, (scheduler->grantCount - expired) * sizeof(rampGrant));
+    scheduler->grantCount -= expired;
+  }
+
+  // Sum the power steps of the remaining ramps
+  double power = 0;
+
+  for (unsigned int i = 0; i < scheduler->grantCount; i++) {
+    power += scheduler->grants[i].power;
+  }
+
+  return power;
+}
+
+bool ramp_admit(rampScheduler *scheduler, unsigned long long now, double power) {
+  // Space the ramps by the stagger delay
+  if (scheduler->granted && now - scheduler->lastGrant < scheduler->stagger) {
+    return false;
+  }
+
+  // Keep the power step of the window within the budget
+  if (scheduler->budget > 0) {
+    double windowPower = ramp_window_power(scheduler, now);
+
+    // A single ramp over the budget still goes through once the window is empty
+    if (windowPower > 0 && windowPower + power > scheduler->budget) {
+      return false;
+    }
+
+    // The window can't remember more ramps
+    if (scheduler->grantCount == RAMP_HISTORY) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void ramp_record(rampScheduler *scheduler, unsigned long long now, double power) {
+  // Remember the time of the ramp for the stagger delay
+  scheduler->granted = true;
+  scheduler->lastGrant = now;
+
+  // Remember the power step for the budget window, dropping the oldest ramp when full
+  if (scheduler->budget > 0) {
+    ramp_window_power(scheduler, now);
+
+    if (scheduler->grantCount == RAMP_HISTORY) {
+      memmove(scheduler->grants, scheduler->grants + 1, (RAMP_HISTORY - 1) * sizeof(rampGrant));
+      scheduler->grantCount--;
+    }
+
+    scheduler->grants[scheduler->grantCount++] = (rampGrant) { now, power };
+  }
+}
+
+static int compare_requests(const void *a, const void *b) {
+  // Get the requests
+  const rampRequest *requestA = a;
+  const rampRequest *requestB = b;
+
+  // Higher priority first
+  if (requestA->priority != requestB->priority) {
+    return requestA->priority > requestB->priority ? -1 : 1;
+  }
+
+  // Then the GPU that waited longest
+  if (requestA->requested != requestB->requested) {
+    return requestA->requested < requestB->requested ? -1 : 1;
+  }
+
+  // Then the lower GPU index
+  return requestA->gpu < requestB->gpu ? -1 : 1;
+}
+
+void ramp_grant(rampScheduler *scheduler, unsigned long long now, rampRequest *requests, unsigned int count) {
+  // Order the ramps by priority, the granted ramps are applied in this order
+  qsort(requests, count, sizeof(rampRequest), compare_requests);
+
+  // Flag to indicate if a ramp of higher priority was held back
+  bool blocked = false;
+
+  // Grant the ramps in order
+  for (unsigned int k = 0; k < count; k++) {
+    rampRequest *request = &requests[k];
+
+    // Admit the ramp unless a ramp of higher priority is held back, or force it once it waited the maximum delay
+    bool admitted = !blocked && ramp_admit(scheduler, now, request->power);
+
+    request->granted = admitted || now - request->requested >= scheduler->maxDelay;
+    request->overdue = !admitted && request->granted;
+
+    if (!request->granted) {
+      blocked = true;
+      continue;
+    }
+
+    // Record the ramp for the following ones
+    ramp_record(scheduler, now, request->power);
+  }
+}
+
+bool ramp_wait(rampWait *wait, unsigned long long now, unsigned long long tick) {
+  // Keep the ramp requested in this iteration
+  wait->tick = tick;
+
+  // Start waiting on the first request
+  if (wait->waiting) {
+    return false;
+  }
+
+  wait->waiting = true;
+  wait->requested = now;
+
+  return true;
+}
+
+bool ramp_wait_renewed(rampWait *wait, unsigned long long tick) {
+  // Drop a ramp that wasn't requested again in this iteration (the GPU went idle, got too hot or was yielded)
+  if (wait->waiting && wait->tick != tick) {
+    wait->waiting = false;
+  }
+
+  return wait->waiting;
+}
+
+bool parse_ramp_priorities(const char *arg, unsigned long *priorities, unsigned int max) {
+  // Duplicate the input string
+  char *string = strdup(arg);
+
+  if (string == NULL) {
+    return false;
+  }
+
+  // Parse each "<id>:<priority>" token
+  bool valid = true;
+
+  for (char *token = strtok(string, ","); token != NULL && valid; token = strtok(NULL, ",")) {
+    // Split the token at the colon
+    char *colon = strchr(token, ':');
+
+    if (colon == NULL) {
+      valid = false;
+      break;
+    }
+
+    *colon = '\0';
+
+    // Parse the GPU id and its priority
+    unsigned long id;
+
+    valid = parse_ulong(token, &id) && id < max && parse_ulong(colon + 1, &priorities[id]);
+  }
+
+  // Free the duplicated string
+  SAFE_FREE(string);
+
+  return valid;
+}
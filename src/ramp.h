@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of ramps remembered for the power budget window
+#define RAMP_HISTORY 64
+
+// Minimum delay (in milliseconds) between ramps of different GPUs (0 means disabled)
+#define RAMP_STAGGER 0
+
+// Maximum power step (in watts) of all ramps within the window (0 means unlimited)
+#define RAMP_POWER_BUDGET 0
+
+// Length (in milliseconds) of the ramp power budget window
+#define RAMP_POWER_WINDOW 1000
+
+// Maximum time (in milliseconds) a ramp is held back by the ramp scheduler
+#define RAMP_MAX_DELAY 500
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold a granted ramp
+typedef struct {
+  // Time (in milliseconds) the ramp was granted at
+  unsigned long long time;
+
+  // Estimated power step (in watts)
+  double power;
+} rampGrant;
+
+// Structure to hold the state of the ramp scheduler
+typedef struct {
+  // Minimum delay (in milliseconds) between two ramps
+  unsigned long stagger;
+
+  // Maximum power step (in watts) of all ramps within the window (0 means unlimited)
+  unsigned long budget;
+
+  // Length (in milliseconds) of the power budget window
+  unsigned long window;
+
+  // Maximum time (in milliseconds) a ramp is held back
+  unsigned long maxDelay;
+
+  // Flag to indicate if a ramp was granted yet, and its time (in milliseconds)
+  bool granted;
+  unsigned long long lastGrant;
+
+  // Ramps granted within the window, oldest first
+  rampGrant grants[RAMP_HISTORY];
+  unsigned int grantCount;
+} rampScheduler;
+
+// Structure to hold a ramp waiting for the scheduler
+typedef struct {
+  // Index of the GPU
+  unsigned int gpu;
+
+  // Priority of the GPU, higher first
+  unsigned long priority;
+
+  // Time (in milliseconds) the ramp was requested at
+  unsigned long long requested;
+
+  // Estimated power step (in watts)
+  double power;
+
+  // Flags set by the scheduler: the ramp was granted, and it was only granted because it waited the maximum delay
+  bool granted;
+  bool overdue;
+} rampRequest;
+
+// Structure to hold the ramp of a GPU held back by the scheduler, requested again on every iteration it still applies
+typedef struct {
+  // Flag to indicate a ramp is waiting
+  bool waiting;
+
+  // Time (in milliseconds) the ramp was first requested at, and the last iteration that requested it
+  unsigned long long requested;
+  unsigned long long tick;
+} rampWait;
+
+// Structure to hold the ramps of a GPU
+typedef struct {
+  // Ramp priority (higher ramps first when ramps are staggered)
+  unsigned long priority;
+
+  // Ramp held back by the ramp scheduler, and the time (in milliseconds) of the sample before it was requested
+  rampWait wait;
+  unsigned long long since;
+
+  // Ramp delay (in milliseconds): sum, count and maximum
+  unsigned long long delaySum;
+  unsigned long delayCount;
+  unsigned long long delayMax;
+
+  // Number of ramps released by the maximum delay
+  unsigned long overdue;
+} rampState;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool ramp_enabled(const rampScheduler *scheduler);
+bool ramp_admit(rampScheduler *scheduler, unsigned long long now, double power);
+void ramp_record(rampScheduler *scheduler, unsigned long long now, double power);
+void ramp_grant(rampScheduler *scheduler, unsigned long long now, rampRequest *requests, unsigned int count);
+bool ramp_wait(rampWait *wait, unsigned long long now, unsigned long long tick);
+bool ramp_wait_renewed(rampWait *wait, unsigned long long tick);
+double ramp_window_power(rampScheduler *scheduler, unsigned long long now);
+bool parse_ramp_priorities(const char *arg, unsigned long *priorities, unsigned int max);
@@ -0,0 +1,1075 @@
+/*
+ * Replay of reference workloads through the policy of nvidia-pstated.
+ *
+ * The replay runs a fixed corpus of seeded synthetic traces, and any sample logs given on the command line, through
+ * the decisions the daemon takes on every iteration, on simulated GPUs: the base policy of the core with the recorded
+ * temperature, hints and announced work, the policy model as its idle predictor, the parameter profiles of the
+ * workload classifier and the ramp scheduler. For each trace it measures the energy, the ramp penalty percentiles, the
+ * number of transitions and the CPU cost of a decision, and compares them with a baseline written by an earlier build.
+ * A metric that got worse by more than its tolerance is reported and fails the run. The decision cost depends on the
+ * machine and its load, it is only reported.
+ *
+ * Usage: pstated-replay [options] [sample log]...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pstated.h>
+
+#include "classify.h"
+#include "decision.h"
+#include "model.h"
+#include "params.h"
+#include "ramp.h"
+#include "samples.h"
+#include "synth.h"
+#include "utils.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Interval (in milliseconds) between the samples of the synthetic traces, the sleep interval of the daemon
+#define INTERVAL 100
+
+// Idle power (in watts) in the high and low performance states, and the power of a busy GPU
+#define POWER_HIGH 60
+#define POWER_LOW 20
+#define POWER_BUSY 250
+
+// Latency (in milliseconds) of a return to the high performance state
+#define RAMP_LATENCY 100
+
+// Trust (in percent) placed in idle hints, the share of the idle iterations they skip
+#define HINT_TRUST 100
+
+// Number of replays the decision cost is measured over, the lowest is kept
+#define TIMING_ROUNDS 3
+
+// Maximum number of traces
+#define MAX_TRACES 64
+
+// First word and version of a baseline file, version 1 baselines have no tolerances
+#define BASELINE_HEADER "pstated-replay"
+#define BASELINE_VERSION 2
+
+/***** ***** ***** ***** ***** TYPES ***** ***** ***** ***** *****/
+
+// Measured metrics, a higher value is always worse
+typedef enum {
+  METRIC_ENERGY,
+  METRIC_RAMP_P50,
+  METRIC_RAMP_P95,
+  METRIC_RAMP_P99,
+  METRIC_TRANSITIONS,
+  METRIC_DECISION_COST,
+  METRIC_COUNT
+} replayMetric;
+
+// Structure to describe a metric and its tolerance
+typedef struct {
+  // Name of the metric in the baseline file
+  const char *name;
+
+  // Allowed increase over the baseline, in percent plus an absolute slack
+  double tolerance;
+  double slack;
+
+  // Flag to indicate that the metric is only reported, it never fails the run
+  bool reportOnly;
+
+  // Flag to indicate that the tolerance was set on the command line, over the one of the baseline
+  bool overridden;
+} metricInfo;
+
+// Structure to describe a trace of the corpus, 0 keeps the default of the pattern
+typedef struct {
+  const char *name;
+  synthPattern pattern;
+  unsigned int gpus;
+  unsigned long duration;
+  uint64_t seed;
+  double rate;
+  unsigned long service;
+  unsigned long hintLead;
+  double resistance;
+} corpusTrace;
+
+// Structure to hold the results of a trace
+typedef struct {
+  char name[64];
+  double values[METRIC_COUNT];
+} traceResult;
+
+// Structure to hold the simulated state of a GPU
+typedef struct {
+  // Flag to indicate if the GPU was sampled, and the time (in milliseconds) of its last sample
+  bool started;
+  unsigned long long lastTime;
+
+  // Performance state applied last
+  unsigned int pstate;
+
+  // Number of idle iterations of the parameters applied last, and the idle hint of the previous sample
+  unsigned int iterationsBeforeSwitch;
+  bool idleHint;
+
+  // Features of the policy model
+  modelFeatures features;
+
+  // Workload classifier
+  workloadClassifier classifier;
+
+  // Ramp held back by the ramp scheduler, the busy share (in milliseconds) of the interval work first waited in for it
+  // (negative when no work waited for it), and its estimated power step (in watts)
+  rampWait ramp;
+  double rampWork;
+  double rampPower;
+} replayGpu;
+
+// Structure to hold the accumulators of a replay
+typedef struct {
+  // Energy (in joules)
+  double energy;
+
+  // Ramp penalties (in milliseconds)
+  double *penalties;
+  size_t penaltyCount;
+  size_t penaltyCapacity;
+
+  // Number of transitions
+  unsigned long transitions;
+
+  // Number of decisions and their total time (in nanoseconds)
+  unsigned long long decisions;
+  unsigned long long decisionTime;
+} replayRun;
+
+// Structure to hold the options of the replay
+typedef struct {
+  // Policy of the simulated GPUs, and the policy model deciding when idle GPUs switch when loaded
+  pstated_policy policy;
+  model model;
+
+  // Power (in watts) and ramp latency (in milliseconds) of the simulated GPUs
+  unsigned long powerHigh;
+  unsigned long powerLow;
+  unsigned long powerBusy;
+  unsigned long rampLatency;
+
+  // Interval (in milliseconds) between the samples of the synthetic traces
+  unsigned long interval;
+
+  // Trust (in percent) placed in idle hints
+  unsigned long hintTrust;
+
+  // Workload classification and the parameter overrides of each class
+  bool autoClassify;
+  unsigned long classifyHysteresis;
+  unsigned long classifyGapThreshold;
+  const char *classProfiles[WORKLOAD_CLASS_COUNT];
+
+  // Settings of the ramp scheduler and the ramp priority of each GPU
+  rampScheduler ramps;
+  unsigned long rampPriorities[SYNTH_MAX_GPUS];
+} replayOptions;
+
+// Structure to hold a trace being replayed
+typedef struct {
+  // Options of the replay
+  const replayOptions *options;
+
+  // Simulated GPUs
+  pstated_context *context;
+  replayGpu *gpus;
+  unsigned int gpuCount;
+
+  // Ramp scheduler, shared by the GPUs
+  rampScheduler ramps;
+
+  // Number of the current iteration
+  unsigned long long tick;
+
+  // Accumulators
+  replayRun *run;
+} replaySession;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Metrics, in the order of replayMetric
+static metricInfo metrics[METRIC_COUNT] = {
+  [METRIC_ENERGY]        = { "energy_j",          1, 1  },
+  [METRIC_RAMP_P50]      = { "ramp_p50_ms",       5, 1  },
+  [METRIC_RAMP_P95]      = { "ramp_p95_ms",       5, 1  },
+  [METRIC_RAMP_P99]      = { "ramp_p99_ms",       5, 1  },
+  [METRIC_TRANSITIONS]   = { "transitions",       5, 2  },
+  [METRIC_DECISION_COST] = { "decision_ns",       0, 0, true },
+};
+
+// Reference traces, changing one changes its baseline
+static const corpusTrace corpus[] = {
+  { "poisson-sparse", SYNTH_POISSON,  4, 3600,  101, 60,   2000, 0,    0    },
+  { "poisson-busy",   SYNTH_POISSON,  8, 3600,  102, 1800, 300,  0,    0    },
+  { "poisson-hinted", SYNTH_POISSON,  4, 3600,  106, 360,  500,  1000, 0    },
+  { "diurnal-day",    SYNTH_DIURNAL,  2, 86400, 103, 0,    0,    0,    0    },
+  { "training",       SYNTH_TRAINING, 8, 7200,  104, 0,    0,    0,    0    },
+  { "training-hot",   SYNTH_TRAINING, 4, 7200,  107, 0,    0,    0,    0.25 },
+  { "gang",           SYNTH_GANG,     8, 3600,  105, 0,    0,    0,    0    },
+};
+
+// Results of the traces
+static traceResult results[MAX_TRACES];
+static unsigned int resultCount;
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static int compare_doubles(const void *a, const void *b) {
+  // Order the values ascending
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+static double percentile(const double *values, size_t count, double rank) {
+  // Nearest-rank percentile of sorted values, 0 without values
+  if (count == 0) {
+    return 0;
+  }
+
+  size_t index = (size_t) (rank / 100.0 * count + 0.999999);
+
+  return values[(index > 0 ? index : 1) - 1];
+}
+
+static bool add_penalty(replayRun *run, double penalty) {
+  // Grow the array when it is full
+  if (run->penaltyCount == run->penaltyCapacity) {
+    size_t capacity = run->penaltyCapacity > 0 ? run->penaltyCapacity * 2 : 1024;
+    double *grown = realloc(run->penalties, capacity * sizeof(double));
+
+    if (grown == NULL) {
+      fprintf(stderr, "Unable to allocate %zu ramp penalties\n", capacity);
+      return false;
+    }
+
+    run->penalties = grown;
+    run->penaltyCapacity = capacity;
+  }
+
+  run->penalties[run->penaltyCount++] = penalty;
+
+  return true;
+}
+
+static int predict_idle_switch(void *user, unsigned int gpu) {
+  // Evaluate the policy model on the features of the GPU, as the daemon does
+  replaySession *session = user;
+
+  // Switch when the model predicts a net saving
+  return model_predict(&session->options->model, session->gpus[gpu].features.values) > 0;
+}
+
+static bool apply_profile(replaySession *session, unsigned int gpu) {
+  // Start from the parameters of the replay
+  const replayOptions *options = session->options;
+  gpuParams params = {
+    .iterationsBeforeSwitch = options->policy.iterationsBeforeSwitch,
+    .performanceStateHigh = options->policy.performanceStateHigh,
+    .performanceStateLow = options->policy.performanceStateLow,
+    .temperatureThreshold = options->policy.temperatureThreshold,
+  };
+
+  // Apply the overrides of the current workload class, the profiles were validated on startup
+  if (options->autoClassify) {
+    parse_params(options->classProfiles[session->gpus[gpu].classifier.current], &params);
+  }
+
+  session->gpus[gpu].iterationsBeforeSwitch = (unsigned int) params.iterationsBeforeSwitch;
+
+  // Hand the parameters to the core, with the policy model as its idle predictor if loaded
+  pstated_policy policy = {
+    .size = sizeof(policy),
+    .performanceStateHigh = (unsigned int) params.performanceStateHigh,
+    .performanceStateLow = (unsigned int) params.performanceStateLow,
+    .iterationsBeforeSwitch = (unsigned int) params.iterationsBeforeSwitch,
+    .temperatureThreshold = (unsigned int) params.temperatureThreshold,
+    .predictIdle = options->model.count > 0 ? predict_idle_switch : NULL,
+    .predictUser = session,
+  };
+
+  return pstated_policy_set(session->context, gpu, &policy) == PSTATED_OK;
+}
+
+static bool replay_open(replaySession *session, const replayOptions *options, unsigned int gpuCount, replayRun *run) {
+  // Start from an empty session
+  memset(session, 0, sizeof(*session));
+
+  session->options = options;
+  session->gpuCount = gpuCount;
+  session->ramps = options->ramps;
+  session->run = run;
+
+  // Open the simulated GPUs
+  session->gpus = calloc(gpuCount, sizeof(replayGpu));
+
+  if (session->gpus == NULL || pstated_open_mock(PSTATED_API_VERSION_MAJOR, gpuCount, &session->context) != PSTATED_OK) {
+    free(session->gpus);
+    return false;
+  }
+
+  // Apply the parameters of each GPU
+  for (unsigned int gpu = 0; gpu < gpuCount; gpu++) {
+    if (!apply_profile(session, gpu)) {
+      pstated_close(session->context);
+      free(session->gpus);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void replay_close(replaySession *session) {
+  // Release the simulated GPUs
+  pstated_close(session->context);
+  free(session->gpus);
+}
+
+static bool switch_pstate(replaySession *session, unsigned int gpu, unsigned int pstate) {
+  // Apply the state and count the transition
+  if (pstated_apply(session->context, gpu, pstate) != PSTATED_OK) {
+    return false;
+  }
+
+  session->gpus[gpu].pstate = pstate;
+  session->run->transitions++;
+
+  return true;
+}
+
+static bool replay_sample(replaySession *session, const sampleRecord *record) {
+  // Get the simulated GPU
+  const replayOptions *options = session->options;
+  replayGpu *gpu = &session->gpus[record->gpu];
+  replayRun *run = session->run;
+  unsigned int low = options->policy.performanceStateLow;
+
+  // Hand the GPU the low performance state on its first sample, as the daemon does at start
+  if (!gpu->started) {
+    gpu->started = true;
+    gpu->lastTime = record->time;
+    gpu->pstate = low;
+
+    return pstated_apply(session->context, record->gpu, low) == PSTATED_OK;
+  }
+
+  // The utilization of the sample covers the time since the previous one, spent in the state applied then
+  unsigned long long elapsed = record->time - gpu->lastTime;
+  double idle = gpu->pstate == low ? options->powerLow : options->powerHigh;
+  double power = idle + ((double) options->powerBusy - options->powerHigh) * record->utilization / 100.0;
+
+  run->energy += power * elapsed / 1000.0;
+  gpu->lastTime = record->time;
+
+  // Update the features of the policy model
+  if (options->model.count > 0) {
+    model_features_update(&gpu->features, options->model.window, record->time, record->utilization, record->power, record->processes);
+  }
+
+  // Classify the workload and apply the profile of a new class, the gap threshold is converted to sample intervals
+  if (options->autoClassify) {
+    classifier_add_sample(&gpu->classifier, record->utilization != 0);
+
+    unsigned long gapIterations = options->classifyGapThreshold / (elapsed > 0 ? elapsed : 1);
+
+    if (session->tick % CLASSIFY_INTERVAL == 0 && classifier_update(&gpu->classifier, gapIterations, options->classifyHysteresis) && !apply_profile(session, record->gpu)) {
+      return false;
+    }
+  }
+
+  // A new idle hint skips the trusted share of the wait, as the daemon does when it receives one
+  if (record->idleHint && !gpu->idleHint && !decision_skip_idle(session->context, record->gpu, gpu->iterationsBeforeSwitch, options->hintTrust)) {
+    return false;
+  }
+
+  gpu->idleHint = record->idleHint != 0;
+
+  // Decide on the performance state from the same snapshot as the daemon
+  unsigned long long start = get_time_ns();
+  pstated_snapshot snapshot = {
+    .size = sizeof(snapshot),
+    .temperature = record->temperature,
+    .utilization = record->utilization,
+    .pstate = gpu->pstate,
+    .power = record->power,
+    .demand = record->demand,
+    .cooled = record->cooled,
+    .idleHint = record->idleHint,
+  };
+  unsigned int next;
+
+  if (pstated_step(session->context, record->gpu, &snapshot, &next) != PSTATED_OK) {
+    return false;
+  }
+
+  // Act on the decision as the daemon does, depending on its reason
+  decisionAction action = decision_action(pstated_step_reason(session->context, record->gpu), gpu->pstate, next, ramp_enabled(&session->ramps));
+
+  // The busy share of the interval waited in the low state, then for the return to high
+  double work = record->utilization != 0 ? record->utilization * elapsed / 100.0 : -1;
+
+  if (action == DECISION_QUEUE) {
+    // Queue the ramp, the ramp scheduler spaces it from the ramps of the other GPUs
+    if (ramp_wait(&gpu->ramp, record->time, session->tick)) {
+      gpu->rampWork = work;
+      gpu->rampPower = options->powerBusy > power ? options->powerBusy - power : 0;
+    } else if (gpu->rampWork < 0) {
+      gpu->rampWork = work;
+    }
+  } else if (action != DECISION_KEEP && !switch_pstate(session, record->gpu, next)) {
+    return false;
+  }
+
+  run->decisionTime += get_time_ns() - start;
+  run->decisions++;
+
+  // Count the penalty of a direct ramp
+  if (action == DECISION_RAMP && work >= 0 && !add_penalty(run, work + options->rampLatency)) {
+    return false;
+  }
+
+  return true;
+}
+
+static bool replay_tick(replaySession *session, unsigned long long now) {
+  // Ramps waiting for the scheduler
+  rampRequest requests[SYNTH_MAX_GPUS];
+  unsigned int requestCount = 0;
+
+  for (unsigned int gpu = 0; gpu < session->gpuCount && ramp_enabled(&session->ramps); gpu++) {
+    replayGpu *state = &session->gpus[gpu];
+
+    // Skip GPUs that don't wait for a ramp
+    if (!state->ramp.waiting) {
+      continue;
+    }
+
+    // Drop ramps that weren't requested again in this iteration, the work that waited finished in the low state
+    if (!ramp_wait_renewed(&state->ramp, session->tick)) {
+      if (state->rampWork >= 0 && !add_penalty(session->run, state->rampWork + (now - state->ramp.requested))) {
+        return false;
+      }
+
+      continue;
+    }
+
+    requests[requestCount++] = (rampRequest) {
+      .gpu = gpu,
+      .priority = session->options->rampPriorities[gpu],
+      .requested = state->ramp.requested,
+      .power = state->rampPower,
+    };
+  }
+
+  // Let the scheduler grant the ramps by priority, as the daemon does after each iteration
+  ramp_grant(&session->ramps, now, requests, requestCount);
+
+  for (unsigned int k = 0; k < requestCount; k++) {
+    // Skip the ramps held back
+    if (!requests[k].granted) {
+      continue;
+    }
+
+    // Ramp the GPU up, the work waited for the scheduler on top of the ramp latency
+    replayGpu *state = &session->gpus[requests[k].gpu];
+    state->ramp.waiting = false;
+
+    if (!switch_pstate(session, requests[k].gpu, session->options->policy.performanceStateHigh)) {
+      return false;
+    }
+
+    if (state->rampWork >= 0 && !add_penalty(session->run, state->rampWork + (now - state->ramp.requested) + session->options->rampLatency)) {
+      return false;
+    }
+  }
+
+  // Start the next iteration
+  session->tick++;
+
+  return true;
+}
+
+static bool replay_synthetic(const corpusTrace *trace, const replayOptions *options, replayRun *run) {
+  // Set up the generators of the trace
+  synthConfig config;
+  synthGpu generators[SYNTH_MAX_GPUS];
+
+  synth_defaults(&config, trace->pattern);
+  config.seed = trace->seed;
+  config.powerIdle = options->powerHigh;
+  config.powerBusy = options->powerBusy;
+  config.hintLead = trace->hintLead;
+
+  if (trace->rate > 0) {
+    config.rate = trace->rate;
+  }
+
+  if (trace->service > 0) {
+    config.service = trace->service;
+  }
+
+  if (trace->resistance > 0) {
+    config.resistance = trace->resistance;
+  }
+
+  for (unsigned int gpu = 0; gpu < trace->gpus; gpu++) {
+    synth_gpu_init(&generators[gpu], &config, gpu);
+  }
+
+  // Open the simulated GPUs
+  replaySession session;
+
+  if (!replay_open(&session, options, trace->gpus, run)) {
+    return false;
+  }
+
+  // Replay the samples of all GPUs, one interval after the other
+  bool ok = true;
+
+  for (unsigned long long time = 0; time <= trace->duration * 1000ull && ok; time += options->interval) {
+    for (unsigned int gpu = 0; gpu < trace->gpus && ok; gpu++) {
+      unsigned int utilization = synth_gpu_sample(&generators[gpu], &config, time);
+      sampleRecord record = { .time = time, .gpu = gpu, .utilization = utilization, .power = synth_power(&config, utilization), .processes = 1 };
+
+      // Add the hints of the application and the temperature the power draw leads to, as pstated-generate does
+      synth_gpu_hints(&generators[gpu], &config, time, utilization, &record.demand, &record.idleHint);
+      record.temperature = synth_gpu_temperature(&generators[gpu], &config, time, record.power);
+
+      ok = replay_sample(&session, &record);
+    }
+
+    ok = ok && replay_tick(&session, time);
+  }
+
+  replay_close(&session);
+
+  return ok;
+}
+
+static bool replay_log(const char *path, const replayOptions *options, replayRun *run) {
+  // Open the sample log
+  sampleReader reader;
+
+  if (!sample_reader_open(&reader, path)) {
+    return false;
+  }
+
+  // Open the simulated GPUs, as many as a log may hold
+  replaySession session;
+
+  if (!replay_open(&session, options, SYNTH_MAX_GPUS, run)) {
+    sample_reader_close(&reader);
+    return false;
+  }
+
+  // Replay the samples in the order they were recorded, the daemon writes the GPUs of an iteration in order
+  sampleRecord record;
+  unsigned long long tickTime = 0;
+  bool inTick = false;
+  unsigned int lastGpu = 0;
+  bool ok = true;
+  int result = 0;
+
+  while (ok && (result = sample_reader_next(&reader, &record)) == 1) {
+    if (record.gpu >= SYNTH_MAX_GPUS || (session.gpus[record.gpu].started && record.time < session.gpus[record.gpu].lastTime)) {
+      fprintf(stderr, "Sample log %s has an out-of-order or out-of-range sample on line %lu\n", path, reader.line);
+      ok = false;
+      break;
+    }
+
+    // A GPU that isn't after the previous one starts the next iteration
+    if (inTick && record.gpu <= lastGpu) {
+      ok = replay_tick(&session, tickTime);
+    }
+
+    inTick = true;
+    lastGpu = record.gpu;
+    tickTime = record.time;
+
+    ok = ok && replay_sample(&session, &record);
+  }
+
+  // Finish the last iteration
+  if (ok && inTick) {
+    ok = replay_tick(&session, tickTime);
+  }
+
+  replay_close(&session);
+  sample_reader_close(&reader);
+
+  return ok && result == 0;
+}
+
+static bool replay_trace(const char *name, const corpusTrace *trace, const char *path, const replayOptions *options) {
+  // Check that there is room for the result
+  if (resultCount == MAX_TRACES) {
+    fprintf(stderr, "Too many traces, at most %u are replayed\n", MAX_TRACES);
+    return false;
+  }
+
+  traceResult *result = &results[resultCount];
+  snprintf(result->name, sizeof(result->name), "%s", name);
+
+  // Replay the trace a few times, the decision cost is the lowest of the rounds and the other metrics don't change
+  for (unsigned int round = 0; round < TIMING_ROUNDS; round++) {
+    replayRun run;
+    memset(&run, 0, sizeof(run));
+
+    bool ok = trace != NULL ? replay_synthetic(trace, options, &run) : replay_log(path, options, &run);
+
+    if (!ok) {
+      fprintf(stderr, "Unable to replay %s\n", name);
+      free(run.penalties);
+      return false;
+    }
+
+    qsort(run.penalties, run.penaltyCount, sizeof(double), compare_doubles);
+
+    double cost = run.decisions > 0 ? (double) run.decisionTime / run.decisions : 0;
+
+    if (round == 0 || cost < result->values[METRIC_DECISION_COST]) {
+      result->values[METRIC_DECISION_COST] = cost;
+    }
+
+    result->values[METRIC_ENERGY] = run.energy;
+    result->values[METRIC_RAMP_P50] = percentile(run.penalties, run.penaltyCount, 50);
+    result->values[METRIC_RAMP_P95] = percentile(run.penalties, run.penaltyCount, 95);
+    result->values[METRIC_RAMP_P99] = percentile(run.penalties, run.penaltyCount, 99);
+    result->values[METRIC_TRANSITIONS] = run.transitions;
+
+    free(run.penalties);
+  }
+
+  resultCount++;
+
+  return true;
+}
+
+static bool write_baseline(const char *path) {
+  // Open the file
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    fprintf(stderr, "Unable to open baseline file %s\n", path);
+    return false;
+  }
+
+  // Write the header and one line per metric of each trace, with the tolerance the metric is checked with
+  fprintf(file, BASELINE_HEADER " %u\n", BASELINE_VERSION);
+  fprintf(file, "# trace metric value tolerance_percent slack\n");
+
+  for (unsigned int i = 0; i < resultCount; i++) {
+    for (unsigned int metric = 0; metric < METRIC_COUNT; metric++) {
+      fprintf(file, "%s %s %.3f %g %g\n", results[i].name, metrics[metric].name, results[i].values[metric], metrics[metric].tolerance, metrics[metric].slack);
+    }
+  }
+
+  // Flush the file and check for write errors
+  bool ok = fflush(file) == 0 && !ferror(file);
+
+  if (fclose(file) != 0 || !ok) {
+    fprintf(stderr, "Unable to write baseline file %s\n", path);
+    return false;
+  }
+
+  // Print the path of the file
+  printf("Baseline written to %s\n", path);
+
+  // Return true to indicate success
+  return true;
+}
+
+static int compare_baseline(const char *path) {
+  // Open the file
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "Unable to open baseline file %s\n", path);
+    return -1;
+  }
+
+  // Check the header, older versions are still read
+  unsigned int version;
+
+  if (fscanf(file, BASELINE_HEADER " %u\n", &version) != 1 || version < 1 || version > BASELINE_VERSION) {
+    fprintf(stderr, "Baseline file %s has an unknown format\n", path);
+    fclose(file);
+    return -1;
+  }
+
+  // Flags to indicate the metrics found in the baseline
+  bool found[MAX_TRACES][METRIC_COUNT];
+  memset(found, 0, sizeof(found));
+
+  // Compare every metric of the baseline with the replay
+  char line[256];
+  int regressions = 0;
+
+  printf("%-20s %-12s %14s %14s %12s %12s\n", "trace", "metric", "baseline", "current", "change", "limit");
+
+  while (fgets(line, sizeof(line), file) != NULL) {
+    // Skip comments and empty lines
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+
+    // Read the metric, and its tolerance since version 2
+    char name[64];
+    char metricName[32];
+    double baseline;
+    double tolerance;
+    double slack;
+
+    if (sscanf(line, "%63s %31s %lf %lf %lf", name, metricName, &baseline, &tolerance, &slack) != (version == 1 ? 3 : 5)) {
+      fprintf(stderr, "Baseline file %s has an invalid line: %s", path, line);
+      fclose(file);
+      return -1;
+    }
+
+    // Find the trace and the metric
+    int trace = -1;
+    int metric = -1;
+
+    for (unsigned int i = 0; i < resultCount; i++) {
+      if (strcmp(results[i].name, name) == 0) {
+        trace = i;
+      }
+    }
+
+    for (unsigned int i = 0; i < METRIC_COUNT; i++) {
+      if (strcmp(metrics[i].name, metricName) == 0) {
+        metric = i;
+      }
+    }
+
+    // A trace or metric of the baseline that wasn't replayed is a regression of the suite itself
+    if (trace < 0 || metric < 0) {
+      printf("%-20s %-12s %14.3f %14s %12s %12s  MISSING\n", name, metricName, baseline, "-", "-", "-");
+      regressions++;
+      continue;
+    }
+
+    found[trace][metric] = true;
+
+    // Print the metrics that are only reported without a limit
+    double current = results[trace].values[metric];
+    double change = current - baseline;
+
+    if (metrics[metric].reportOnly) {
+      printf("%-20s %-12s %14.3f %14.3f %+12.3f %12s  %s\n", name, metricName, baseline, current, change, "-", "reported");
+      continue;
+    }
+
+    // Take the tolerance of the baseline unless it was set on the command line or the baseline has none
+    if (version == 1 || metrics[metric].overridden) {
+      tolerance = metrics[metric].tolerance;
+      slack = metrics[metric].slack;
+    }
+
+    // Compare with the allowed increase
+    double limit = baseline * tolerance / 100.0 + slack;
+    const char *verdict = change > limit ? "REGRESSED" : change < -limit ? "improved" : "";
+
+    printf("%-20s %-12s %14.3f %14.3f %+12.3f %+12.3f  %s\n", name, metricName, baseline, current, change, limit, verdict);
+
+    if (change > limit) {
+      regressions++;
+    }
+  }
+
+  fclose(file);
+
+  // Print the metrics that have no baseline yet, they don't fail the run
+  for (unsigned int i = 0; i < resultCount; i++) {
+    for (unsigned int metric = 0; metric < METRIC_COUNT; metric++) {
+      if (!found[i][metric]) {
+        printf("%-20s %-12s %14s %14.3f %12s %12s  new\n", results[i].name, metrics[metric].name, "-", results[i].values[metric], "-", "-");
+      }
+    }
+  }
+
+  return regressions;
+}
+
+static bool parse_tolerances(const char *arg) {
+  // Duplicate the input string, strtok modifies it
+  char *string = strdup(arg);
+
+  if (string == NULL) {
+    return false;
+  }
+
+  // Read the "metric=percent" pairs
+  bool ok = true;
+
+  for (char *token = strtok(string, ","); token != NULL && ok; token = strtok(NULL, ",")) {
+    char *separator = strchr(token, '=');
+    unsigned long percent;
+
+    ok = separator != NULL;
+
+    if (ok) {
+      *separator = '\0';
+      ok = parse_ulong(separator + 1, &percent);
+    }
+
+    // Find the metric
+    bool known = false;
+
+    for (unsigned int metric = 0; metric < METRIC_COUNT && ok; metric++) {
+      if (strcmp(token, metrics[metric].name) == 0 && !metrics[metric].reportOnly) {
+        metrics[metric].tolerance = percent;
+        metrics[metric].overridden = true;
+        known = true;
+      }
+    }
+
+    ok = ok && known;
+  }
+
+  free(string);
+
+  return ok;
+}
+
+int main(int argc, char * argv[]) {
+  // Variables to hold the options
+  const char * baselinePath = NULL;
+  const char * writePath = NULL;
+  const char * modelPath = NULL;
+  bool useCorpus = true;
+  unsigned long iterationsBeforeSwitch;
+  replayOptions options = {
+    .powerHigh = POWER_HIGH,
+    .powerLow = POWER_LOW,
+    .powerBusy = POWER_BUSY,
+    .rampLatency = RAMP_LATENCY,
+    .interval = INTERVAL,
+    .hintTrust = HINT_TRUST,
+    .classifyHysteresis = CLASSIFY_HYSTERESIS,
+    .classifyGapThreshold = CLASSIFY_GAP_THRESHOLD,
+    .classProfiles = {
+      [WORKLOAD_IDLE] = CLASSIFY_PROFILE_IDLE,
+      [WORKLOAD_STEADY] = CLASSIFY_PROFILE_STEADY,
+      [WORKLOAD_BURSTY] = CLASSIFY_PROFILE_BURSTY,
+      [WORKLOAD_INTERACTIVE] = CLASSIFY_PROFILE_INTERACTIVE,
+    },
+    .ramps = {
+      .stagger = RAMP_STAGGER,
+      .budget = RAMP_POWER_BUDGET,
+      .window = RAMP_POWER_WINDOW,
+      .maxDelay = RAMP_MAX_DELAY,
+    },
+  };
+
+  options.policy.size = sizeof(options.policy);
+  pstated_policy_default(&options.policy);
+
+  // Exit code
+  int result = EXIT_FAILURE;
+
+  // Parse the options
+  for (int i = 1; i < argc; i++) {
+    if ((IS_OPTION("-b") || IS_OPTION("--baseline")) && HAS_NEXT_ARG) {
+      // Store the path of the baseline to compare with
+      baselinePath = argv[++i];
+    } else if ((IS_OPTION("-wb") || IS_OPTION("--write-baseline")) && HAS_NEXT_ARG) {
+      // Store the path of the baseline to write
+      writePath = argv[++i];
+    } else if ((IS_OPTION("-pm") || IS_OPTION("--policy-model")) && HAS_NEXT_ARG) {
+      // Store the path of the policy model
+      modelPath = argv[++i];
+    } else if ((IS_OPTION("-ibs") || IS_OPTION("--iterations-before-switch")) && HAS_NEXT_ARG) {
+      // Parse the number of idle iterations before switching
+      ASSERT_TRUE(parse_ulong(argv[++i], &iterationsBeforeSwitch), usage);
+      options.policy.iterationsBeforeSwitch = (unsigned int) iterationsBeforeSwitch;
+    } else if ((IS_OPTION("-si") || IS_OPTION("--sleep-interval")) && HAS_NEXT_ARG) {
+      // Parse the interval between the samples of the synthetic traces
+      ASSERT_TRUE(parse_ulong(argv[++i], &options.interval) && options.interval > 0, usage);
+    } else if ((IS_OPTION("-ph") || IS_OPTION("--power-high")) && HAS_NEXT_ARG) {
+      // Parse the idle power in the high performance state
+      ASSERT_TRUE(parse_ulong(argv[++i], &options.powerHigh), usage);
+    } else if ((IS_OPTION("-pl") || IS_OPTION("--power-low")) && HAS_NEXT_ARG) {
+      // Parse the idle power in the low performance state
+      ASSERT_TRUE(parse_ulong(argv[++i], &options.powerLow), usage);
+    } else if ((IS_OPTION("-pb") || IS_OPTION("--power-busy")) && HAS_NEXT_ARG) {
+      // Parse the power of a busy GPU
+      ASSERT_TRUE(parse_ulong(argv[++i], &options.powerBusy), usage);
+    } else if ((IS_OPTION("-rl") || IS_OPTION("--ramp-latency")) && HAS_NEXT_ARG) {
+      // Parse the ramp latency
+      ASSERT_TRUE(parse_ulong(argv[++i], &options.rampLatency), usage);
+    } else if ((IS_OPTION("-ht") || IS_OPTION("--hint-trust")) && HAS_NEXT_ARG) {
+      // Parse the trust placed in idle hints
+      ASSERT_TRUE(parse_ulong(argv[++i], &options.hintTrust) && options.hintTrust <= 100, usage);
+    } else if ((IS_OPTION("-ac") || IS_OPTION("--auto-classify"))) {
+      // Classify the workload of each GPU and apply the profile of its class
+      options.autoClassify = true;
+    } else if ((IS_OPTION("-acp") || IS_OPTION("--auto-classify-profile")) && HAS_NEXT_ARG) {
+      // Split the "<class>:<key=value,...>" argument, the argument stays alive for the whole run
+      char * profile = argv[++i];
+      char * separator = strchr(profile, ':');
+      ASSERT_TRUE(separator != NULL, usage);
+
+      *separator = '\0';
+
+      // Parse the class and validate the parameters against a scratch copy
+      workloadClass workload;
+      gpuParams scratch = { 0 };
+      ASSERT_TRUE(parse_workload_class(profile, &workload) && parse_params(separator + 1, &scratch), usage);
+
+      options.classProfiles[workload] = separator + 1;
+    } else if ((IS_OPTION("-ach") || IS_OPTION("--auto-classify-hysteresis")) && HAS_NEXT_ARG) {
+      // Parse the number of classifications required to change class
+      ASSERT_TRUE(parse_ulong(argv[++i], &options.classifyHysteresis), usage);
+    } else if ((IS_OPTION("-acg") || IS_OPTION("--auto-classify-gap")) && HAS_NEXT_ARG) {
+      // Parse the mean gap above which a workload is interactive
+      ASSERT_TRUE(parse_ulong(argv[++i], &options.classifyGapThreshold), usage);
+    } else if ((IS_OPTION("-rs") || IS_OPTION("--ramp-stagger")) && HAS_NEXT_ARG) {
+      // Parse the minimum delay between ramps
+      ASSERT_TRUE(parse_ulong(argv[++i], &options.ramps.stagger), usage);
+    } else if ((IS_OPTION("-rpb") || IS_OPTION("--ramp-power-budget")) && HAS_NEXT_ARG) {
+      // Parse the power budget of the ramps
+      ASSERT_TRUE(parse_ulong(argv[++i], &options.ramps.budget), usage);
+    } else if ((IS_OPTION("-rpw") || IS_OPTION("--ramp-power-window")) && HAS_NEXT_ARG) {
+      // Parse the length of the power budget window
+      ASSERT_TRUE(parse_ulong(argv[++i], &options.ramps.window) && options.ramps.window > 0, usage);
+    } else if ((IS_OPTION("-rmd") || IS_OPTION("--ramp-max-delay")) && HAS_NEXT_ARG) {
+      // Parse the maximum time a ramp is held back
+      ASSERT_TRUE(parse_ulong(argv[++i], &options.ramps.maxDelay), usage);
+    } else if ((IS_OPTION("-rp") || IS_OPTION("--ramp-priority")) && HAS_NEXT_ARG) {
+      // Parse the ramp priorities of the GPUs
+      ASSERT_TRUE(parse_ramp_priorities(argv[++i], options.rampPriorities, SYNTH_MAX_GPUS), usage);
+    } else if ((IS_OPTION("-t") || IS_OPTION("--tolerance")) && HAS_NEXT_ARG) {
+      // Parse the tolerance overrides
+      ASSERT_TRUE(parse_tolerances(argv[++i]), usage);
+    } else if ((IS_OPTION("-nc") || IS_OPTION("--no-corpus"))) {
+      // Only replay the sample logs
+      useCorpus = false;
+    } else if (argv[i][0] != '-') {
+      // Sample logs are replayed after the corpus
+      continue;
+    } else {
+      goto usage;
+    }
+  }
+
+  // Display usage instructions to the user
+  if (false) {
+    usage:
+
+    // Print the usage instructions
+    printf("Usage: %s [options] [sample log]...\n", argv[0]);
+    printf("\n");
+    printf("Options:\n");
+    printf("  -b, --baseline <path>                     Compare with this baseline and fail if a metric regressed\n");
+    printf("  -wb, --write-baseline <path>              Write the metrics to this baseline file\n");
+    printf("  -t, --tolerance <metric=percent,...>      Set the allowed increase of metrics over the baseline (decision_ns is only reported)\n");
+    printf("  -nc, --no-corpus                          Only replay the sample logs, not the reference corpus\n");
+    printf("  -pm, --policy-model <path>                Switch idle GPUs when this policy model predicts a saving, as the daemon does\n");
+    printf("  -ibs, --iterations-before-switch <value>  Set the number of idle iterations of the base policy (default: %u)\n", options.policy.iterationsBeforeSwitch);
+    printf("  -si, --sleep-interval <value>             Set the interval between samples of the corpus in milliseconds (default: %u)\n", INTERVAL);
+    printf("  -ph, --power-high <value>                 Set the idle power in watts in the high performance state (default: %u)\n", POWER_HIGH);
+    printf("  -pl, --power-low <value>                  Set the idle power in watts in the low performance state (default: %u)\n", POWER_LOW);
+    printf("  -pb, --power-busy <value>                 Set the power in watts of a busy GPU (default: %u)\n", POWER_BUSY);
+    printf("  -rl, --ramp-latency <value>               Set the latency in milliseconds of a return to high (default: %u)\n", RAMP_LATENCY);
+    printf("  -ht, --hint-trust <value>                 Set the trust in percent placed in idle hints (default: %u)\n", HINT_TRUST);
+    printf("  -ac, --auto-classify                      Classify the workload of each GPU and apply the matching parameter profile\n");
+    printf("  -acp, --auto-classify-profile <class>:<key=value,...>\n");
+    printf("                                            Set the parameter overrides of a workload class (idle, steady, bursty or interactive)\n");
+    printf("  -ach, --auto-classify-hysteresis <value>  Set the number of consecutive classifications required to change class (default: %u)\n", CLASSIFY_HYSTERESIS);
+    printf("  -acg, --auto-classify-gap <value>         Set the mean gap in milliseconds above which a workload is interactive (default: %u)\n", CLASSIFY_GAP_THRESHOLD);
+    printf("  -rs, --ramp-stagger <value>               Set the minimum delay in milliseconds between ramps of different GPUs (default: %u, disabled)\n", RAMP_STAGGER);
+    printf("  -rpb, --ramp-power-budget <value>         Set the maximum power step in watts of all ramps within the window (default: %u, unlimited)\n", RAMP_POWER_BUDGET);
+    printf("  -rpw, --ramp-power-window <value>         Set the length in milliseconds of the ramp power budget window (default: %u)\n", RAMP_POWER_WINDOW);
+    printf("  -rmd, --ramp-max-delay <value>            Set the maximum time in milliseconds a ramp is held back (default: %u)\n", RAMP_MAX_DELAY);
+    printf("  -rp, --ramp-priority <id>:<value><,...>   Set the ramp priority of the GPU(s), higher ramps first (default: 0)\n");
+
+    // Exit the program
+    return EXIT_FAILURE;
+  }
+
+  // Load the policy model
+  if (modelPath != NULL && !model_load(&options.model, modelPath)) {
+    return EXIT_FAILURE;
+  }
+
+  // Replay the corpus
+  for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]) && useCorpus; i++) {
+    if (!replay_trace(corpus[i].name, &corpus[i], NULL, &options)) {
+      goto cleanup;
+    }
+  }
+
+  // Replay the sample logs, named after their file
+  for (int i = 1; i < argc; i++) {
+    // Skip the options and their arguments
+    if (argv[i][0] == '-') {
+      i += !(IS_OPTION("-nc") || IS_OPTION("--no-corpus") || IS_OPTION("-ac") || IS_OPTION("--auto-classify"));
+      continue;
+    }
+
+    const char *name = strrchr(argv[i], '/');
+
+    if (!replay_trace(name != NULL ? name + 1 : argv[i], NULL, argv[i], &options)) {
+      goto cleanup;
+    }
+  }
+
+  // Print the metrics when not comparing them
+  if (baselinePath == NULL) {
+    printf("%-20s", "trace");
+
+    for (unsigned int metric = 0; metric < METRIC_COUNT; metric++) {
+      printf(" %14s", metrics[metric].name);
+    }
+
+    printf("\n");
+
+    for (unsigned int i = 0; i < resultCount; i++) {
+      printf("%-20s", results[i].name);
+
+      for (unsigned int metric = 0; metric < METRIC_COUNT; metric++) {
+        printf(" %14.3f", results[i].values[metric]);
+      }
+
+      printf("\n");
+    }
+  }
+
+  // Write the baseline
+  if (writePath != NULL && !write_baseline(writePath)) {
+    goto cleanup;
+  }
+
+  // Compare with the baseline
+  if (baselinePath != NULL) {
+    int regressions = compare_baseline(baselinePath);
+
+    if (regressions != 0) {
+      if (regressions > 0) {
+        printf("%d metrics regressed\n", regressions);
+      }
+
+      goto cleanup;
+    }
+
+    printf("No regression\n");
+  }
+
+  result = EXIT_SUCCESS;
+
+cleanup:
+  // Release the policy model
+  model_free(&options.model);
+
+  return result;
+}
@@ -0,0 +1,117 @@
+#include "samples.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// First word of a sample log
+#define SAMPLES_HEADER "pstated-samples"
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Sample log being written
+static FILE *samplesFile;
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+bool samples_open(const char *path) {
+  // Open the file, the samples of a previous run are replaced
+  samplesFile = fopen(path, "w");
+  if (samplesFile == NULL) {
+    fprintf(stderr, "Unable to open sample log %s\n", path);
+    return false;
+  }
+
+  // Write the header and the columns
+  fprintf(samplesFile, SAMPLES_HEADER " %u\n", SAMPLES_VERSION);
+  fprintf(samplesFile, "# time_ms gpu utilization power_mw processes pstate temperature demand idle_hint cooled\n");
+
+  // Return true to indicate success
+  return true;
+}
+
+void samples_close(void) {
+  // Flush and close the file if it was opened
+  if (samplesFile != NULL) {
+    fclose(samplesFile);
+    samplesFile = NULL;
+  }
+}
+
+void samples_write(const sampleRecord *record) {
+  // Nothing to do without a sample log
+  if (samplesFile == NULL) {
+    return;
+  }
+
+  // Write one line per sample, the file is flushed by the C library as its buffer fills
+  fprintf(samplesFile, "%llu %u %u %u %u %u %u %u %u %u\n",
+    record->time, record->gpu, record->utilization, record->power, record->processes, record->pstateId,
+    record->temperature, record->demand, record->idleHint, record->cooled);
+}
+
+bool sample_reader_open(sampleReader *reader, const char *path) {
+  // Start from an empty reader
+  memset(reader, 0, sizeof(*reader));
+  reader->path = path;
+
+  // Open the file
+  reader->file = fopen(path, "r");
+  if (reader->file == NULL) {
+    fprintf(stderr, "Unable to open sample log %s\n", path);
+    return false;
+  }
+
+  // Check the header, older versions are still read
+  if (fscanf(reader->file, SAMPLES_HEADER " %u\n", &reader->version) != 1 || reader->version < 1 || reader->version > SAMPLES_VERSION) {
+    fprintf(stderr, "Sample log %s has an unknown format\n", path);
+    sample_reader_close(reader);
+    return false;
+  }
+
+  reader->line = 1;
+
+  // Return true to indicate success
+  return true;
+}
+
+int sample_reader_next(sampleReader *reader, sampleRecord *record) {
+  // Read the file line by line
+  char line[256];
+
+  while (fgets(line, sizeof(line), reader->file) != NULL) {
+    reader->line++;
+
+    // Skip comments and empty lines
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+
+    // Read a sample, the columns a version 1 log lacks are zero
+    memset(record, 0, sizeof(*record));
+
+    int columns = sscanf(line, "%llu %u %u %u %u %u %u %u %u %u",
+      &record->time, &record->gpu, &record->utilization, &record->power, &record->processes, &record->pstateId,
+      &record->temperature, &record->demand, &record->idleHint, &record->cooled);
+
+    if (columns != (reader->version == 1 ? 6 : 10)) {
+      fprintf(stderr, "Sample log %s has an invalid line %lu: %s", reader->path, reader->line, line);
+      return -1;
+    }
+
+    // Return 1 to indicate a sample was read
+    return 1;
+  }
+
+  // Return 0 at the end of the file
+  return 0;
+}
+
+void sample_reader_close(sampleReader *reader) {
+  // Close the file if it was opened
+  if (reader->file != NULL) {
+    fclose(reader->file);
+    reader->file = NULL;
+  }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Version of the sample log format, version 1 logs lack the columns after the performance state
+#define SAMPLES_VERSION 2
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold one sample of a GPU
+typedef struct {
+  // Time (in milliseconds) of the sample
+  unsigned long long time;
+
+  // Index of the GPU
+  unsigned int gpu;
+
+  // Utilization (in percent)
+  unsigned int utilization;
+
+  // Power draw (in milliwatts, 0 when not read)
+  unsigned int power;
+
+  // Number of processes on the GPU
+  unsigned int processes;
+
+  // Performance state the GPU was in
+  unsigned int pstateId;
+
+  // Temperature (in degrees Celsius)
+  unsigned int temperature;
+
+  // Flag to indicate that work was announced for the GPU (hints, queued requests, CPU activity or a peer ramp)
+  unsigned int demand;
+
+  // Flag to indicate that an application announced the end of its work
+  unsigned int idleHint;
+
+  // Flag to indicate that the fans held the GPU under the temperature threshold
+  unsigned int cooled;
+} sampleRecord;
+
+// Structure to hold a sample log being read
+typedef struct {
+  // Open file and its path
+  FILE *file;
+  const char *path;
+
+  // Number of the line read last
+  unsigned long line;
+
+  // Version of the format
+  unsigned int version;
+} sampleReader;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool samples_open(const char *path);
+void samples_close(void);
+void samples_write(const sampleRecord *record);
+bool sample_reader_open(sampleReader *reader, const char *path);
+int sample_reader_next(sampleReader *reader, sampleRecord *record);
+void sample_reader_close(sampleReader *reader);
@@ -0,0 +1,182 @@
+#include "schedule.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static bool parse_field(char *field, unsigned int min, unsigned int max, unsigned long long *mask, bool *restricted) {
+  // Clear the mask
+  *mask = 0;
+
+  // A field is restricted unless it is a plain "*"
+  *restricted = strcmp(field, "*") != 0;
+
+  // Iterate over the comma-separated items
+  for (char *item = strtok(field, ","); item != NULL; item = strtok(NULL, ",")) {
+    // Range and step of the item
+    unsigned long first = min;
+    unsigned long last = max;
+    unsigned long step = 1;
+
+    // Pointer to the remainder of the item
+    char *end = item;
+
+    // Parse the range, "*" selects the whole field
+    if (*item == '*') {
+      end = item + 1;
+    } else {
+      // Parse the first value
+      first = strtoul(item, &end, 10);
+      if (end == item) {
+        return false;
+      }
+
+      // Parse the last value of a range, or select a single value
+      if (*end == '-') {
+        char *start = end + 1;
+        last = strtoul(start, &end, 10);
+        if (end == start) {
+          return false;
+        }
+      } else if (*end != '/') {
+        last = first;
+      }
+    }
+
+    // Parse the step
+    if (*end == '/') {
+      char *start = end + 1;
+      step = strtoul(start, &end, 10);
+      if (end == start || step == 0) {
+        return false;
+      }
+    }
+
+    // Check for trailing characters and out of range values
+    if (*end != '\0' || first < min || last > max || first > last) {
+      return false;
+    }
+
+    // Add the selected values to the mask
+    for (unsigned long value = first; value <= last; value += step) {
+      *mask |= 1ULL << value;
+    }
+  }
+
+  // Return true to indicate success
+  return *mask != 0;
+}
+
+bool schedule_parse_rule(char *arg, unsigned int index, scheduleRule *rule) {
+  // Clear the rule
+  memset(rule, 0, sizeof(*rule));
+
+  // Split the optional "<name>@" prefix
+  char *name = NULL;
+  char *at = strchr(arg, '@');
+
+  if (at != NULL) {
+    *at = '\0';
+    name = arg;
+    arg = at + 1;
+  }
+
+  // Check if the name fits and store it, or name the rule after its position
+  if (name != NULL) {
+    if (*name == '\0' || strlen(name) >= sizeof(rule->name)) {
+      return false;
+    }
+
+    strcpy(rule->name, name);
+  } else {
+    snprintf(rule->name, sizeof(rule->name), "rule%u", index);
+  }
+
+  // Split the time specification from the parameters
+  char *separator = strchr(arg, ':');
+  if (separator == NULL) {
+    return false;
+  }
+
+  *separator = '\0';
+  rule->params = separator + 1;
+
+  // Split the time specification into its five fields (before parsing them, which tokenizes again)
+  char *fields[5];
+
+  for (unsigned int i = 0; i < 5; i++) {
+    fields[i] = strtok(i == 0 ? arg : NULL, " \t");
+    if (fields[i] == NULL) {
+      return false;
+    }
+  }
+
+  // Check for extra fields
+  if (strtok(NULL, " \t") != NULL) {
+    return false;
+  }
+
+  // Variables to hold the parsed fields
+  unsigned long long minutes, hours, days, months, weekdays;
+  bool restricted;
+
+  // Parse the fields
+  if (!parse_field(fields[0], 0, 59, &minutes, &restricted) ||
+      !parse_field(fields[1], 0, 23, &hours, &restricted) ||
+      !parse_field(fields[2], 1, 31, &days, &rule->daysRestricted) ||
+      !parse_field(fields[3], 1, 12, &months, &restricted) ||
+      !parse_field(fields[4], 0, 7, &weekdays, &rule->weekdaysRestricted)) {
+    return false;
+  }
+
+  // Store the masks, Sunday may be written as 0 or 7
+  rule->minutes = minutes;
+  rule->hours = (unsigned long) hours;
+  rule->days = (unsigned long) days;
+  rule->months = (unsigned int) months;
+  rule->weekdays = (unsigned int) ((weekdays | (weekdays >> 7)) & 0x7F);
+
+  // Return true to indicate success
+  return true;
+}
+
+bool schedule_rule_matches(const scheduleRule *rule, const struct tm *time) {
+  // Check the minute, hour and month
+  if (!(rule->minutes & (1ULL << time->tm_min)) || !(rule->hours & (1UL << time->tm_hour)) || !(rule->months & (1U << (time->tm_mon + 1)))) {
+    return false;
+  }
+
+  // Check the day of month and the day of week
+  bool day = (rule->days & (1UL << time->tm_mday)) != 0;
+  bool weekday = (rule->weekdays & (1U << time->tm_wday)) != 0;
+
+  // Like cron, a day matches either field if both are restricted
+  if (rule->daysRestricted && rule->weekdaysRestricted) {
+    return day || weekday;
+  }
+
+  return day && weekday;
+}
+
+int schedule_match(const scheduleRule *rules, unsigned int count, const struct tm *time) {
+  // The first matching rule wins
+  for (unsigned int i = 0; i < count; i++) {
+    if (schedule_rule_matches(&rules[i], time)) {
+      return (int) i;
+    }
+  }
+
+  // No rule matches
+  return -1;
+}
+
+bool schedule_local_time(time_t timestamp, struct tm *time) {
+  // Convert the timestamp to local time
+  #ifdef _WIN32
+    return localtime_s(time, &timestamp) == 0;
+  #else
+    return localtime_r(&timestamp, time) != NULL;
+  #endif
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <time.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of schedule rules
+#define SCHEDULE_MAX_RULES 16
+
+// Maximum length of a rule name
+#define SCHEDULE_NAME_MAX 32
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold a cron-like rule selecting a parameter profile
+typedef struct {
+  // Name of the profile, exported as the active profile
+  char name[SCHEDULE_NAME_MAX];
+
+  // Matching minutes (0-59), hours (0-23), days of month (1-31), months (1-12) and days of week (0-6, Sunday is 0)
+  unsigned long long minutes;
+  unsigned long hours;
+  unsigned long days;
+  unsigned int months;
+  unsigned int weekdays;
+
+  // Flags to indicate if the day of month and day of week fields are restricted (not "*")
+  bool daysRestricted;
+  bool weekdaysRestricted;
+
+  // Parameter overrides of the profile ("key=value,...")
+  const char *params;
+} scheduleRule;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool schedule_parse_rule(char *arg, unsigned int index, scheduleRule *rule);
+bool schedule_rule_matches(const scheduleRule *rule, const struct tm *time);
+int schedule_match(const scheduleRule *rules, unsigned int count, const struct tm *time);
+bool schedule_local_time(time_t timestamp, struct tm *time);
@@ -0,0 +1,74 @@
+#include "stats.h"
+
+#include <stdio.h>
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+void stats_account_time_array(unsigned long long timeInState[STATS_PSTATE_COUNT], unsigned int pstateId, unsigned long long elapsed) {
+  // Clamp unknown performance states to the automatic slot
+  if (pstateId >= STATS_PSTATE_COUNT) {
+    pstateId = STATS_PSTATE_COUNT - 1;
+  }
+
+  // Add the elapsed time to the current performance state
+  timeInState[pstateId] += elapsed;
+}
+
+void stats_account_time(gpuStats *stats, unsigned int pstateId, unsigned long long elapsed) {
+  // Add the elapsed time to the current performance state
+  stats_account_time_array(stats->timeInState, pstateId, elapsed);
+}
+
+void stats_add(gpuStats *total, const gpuStats *stats) {
+  // Accumulate the counters
+  total->energy += stats->energy;
+  total->energySupported |= stats->energySupported;
+  total->transitions += stats->transitions;
+  total->ramps += stats->ramps;
+  total->rampPenalty += stats->rampPenalty;
+
+  // Accumulate the time spent in each performance state
+  for (unsigned int i = 0; i < STATS_PSTATE_COUNT; i++) {
+    total->timeInState[i] += stats->timeInState[i];
+  }
+}
+
+void stats_print(const char *name, unsigned int gpus, const gpuStats *stats) {
+  // Avoid division by zero for empty groups
+  unsigned int divisor = gpus > 0 ? gpus : 1;
+
+  // Calculate the total observed time
+  unsigned long long totalTime = 0;
+
+  for (unsigned int i = 0; i < STATS_PSTATE_COUNT; i++) {
+    totalTime += stats->timeInState[i];
+  }
+
+  // Print the group name and size
+  printf("  %-8s %2u GPUs", name, gpus);
+
+  // Print the energy per GPU if available
+  if (stats->energySupported) {
+    printf(" | energy/GPU %10.1f J", stats->energy / 1000.0 / divisor);
+  } else {
+    printf(" | energy/GPU        N/A  ");
+  }
+
+  // Print the transitions and ramps per GPU
+  printf(" | transitions/GPU %7.1f | ramps/GPU %7.1f", (double) stats->transitions / divisor, (double) stats->ramps / divisor);
+
+  // Print the average ramp penalty
+  printf(" | ramp penalty avg %6.1f ms", stats->ramps > 0 ? (double) stats->rampPenalty / stats->ramps : 0.0);
+
+  // Print the share of time spent in each visited performance state
+  printf(" | time");
+
+  for (unsigned int i = 0; i < STATS_PSTATE_COUNT; i++) {
+    if (stats->timeInState[i] != 0) {
+      printf(" P%u %5.1f%%", i, totalTime > 0 ? 100.0 * stats->timeInState[i] / totalTime : 0.0);
+    }
+  }
+
+  // Print newline character
+  printf("\n");
+}
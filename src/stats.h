@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Number of performance states tracked (P0 - P15 and 16 for automatic)
+#define STATS_PSTATE_COUNT 17
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the accumulated metrics of a GPU
+typedef struct {
+  // Energy counter at the start of the measurement (in millijoules)
+  unsigned long long energyStart;
+
+  // Energy consumed since the start of the measurement (in millijoules)
+  unsigned long long energy;
+
+  // Flag to indicate if the GPU reports its energy consumption
+  bool energySupported;
+
+  // Number of performance state transitions
+  unsigned long transitions;
+
+  // Number of ramps from low to high performance state
+  unsigned long ramps;
+
+  // Accumulated ramp penalty (in milliseconds)
+  unsigned long long rampPenalty;
+
+  // Time spent in each performance state (in milliseconds)
+  unsigned long long timeInState[STATS_PSTATE_COUNT];
+} gpuStats;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+void stats_account_time_array(unsigned long long timeInState[STATS_PSTATE_COUNT], unsigned int pstateId, unsigned long long elapsed);
+void stats_account_time(gpuStats *stats, unsigned int pstateId, unsigned long long elapsed);
+void stats_add(gpuStats *total, const gpuStats *stats);
+void stats_print(const char *name, unsigned int gpus, const gpuStats *stats);
@@ -0,0 +1,329 @@
+#include "subscribe.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "utils.h"
+
+#ifdef __linux__
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <sys/socket.h>
+  #include <sys/stat.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Line sent to a subscriber dropped because its queue overflowed
+#define SUBSCRIBE_DROP_NOTICE "{\"event\":\"dropped\",\"reason\":\"queue overflow\"}\n"
+
+// Line sent to a client rejected because too many subscribers are connected
+#define SUBSCRIBE_REJECT_NOTICE "{\"event\":\"rejected\",\"reason\":\"too many subscribers\"}\n"
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+#ifdef __linux__
+  // Structure to hold a connected subscriber
+  typedef struct {
+    // Flag to indicate if the slot is in use, and the connection
+    bool connected;
+    int fd;
+
+    // Lines waiting to be sent, and whether the last send stopped in the middle of a line
+    char queue[SUBSCRIBE_QUEUE_SIZE];
+    size_t length;
+    bool partial;
+
+    // Flag to indicate the subscriber is being dropped, and the time (in milliseconds) it was
+    bool dropping;
+    unsigned long long dropTime;
+  } subscriber;
+#endif
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+#ifdef __linux__
+  // Socket subscribers connect to
+  static int subscribeSocket = -1;
+
+  // Address the socket is bound to
+  static struct sockaddr_un subscribeAddress;
+
+  // Connected subscribers
+  static subscriber subscribers[SUBSCRIBE_MAX_CLIENTS];
+#endif
+
+// Number of subscribers dropped for being too slow
+static unsigned long subscribeDropped;
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+#ifdef __linux__
+  static void disconnect(subscriber *client) {
+    // Close the connection and free the slot
+    close(client->fd);
+    client->connected = false;
+    client->length = 0;
+    client->partial = false;
+    client->dropping = false;
+  }
+
+  static void drop(subscriber *client) {
+    // Replace the queued lines with the notice telling the subscriber why it is dropped, starting on a new line
+    client->length = 0;
+
+    if (client->partial) {
+      client->queue[client->length++] = '\n';
+    }
+
+    memcpy(client->queue + client->length, SUBSCRIBE_DROP_NOTICE, strlen(SUBSCRIBE_DROP_NOTICE));
+    client->length += strlen(SUBSCRIBE_DROP_NOTICE);
+    client->dropping = true;
+    client->dropTime = get_time_ms();
+
+    // Count the drop
+    subscribeDropped++;
+
+    printf("Dropped a slow subscriber\n");
+  }
+
+  static void flush(subscriber *client) {
+    // Send as much of the queue as the socket takes without blocking
+    while (client->length > 0) {
+      ssize_t sent = send(client->fd, client->queue, client->length, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+      if (sent < 0) {
+        // The subscriber is behind, keep the rest queued
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return;
+        }
+
+        // The subscriber went away
+        disconnect(client);
+        return;
+      }
+
+      // Remember if a line was cut, then remove the sent bytes from the queue
+      client->partial = client->queue[sent - 1] != '\n';
+      client->length -= sent;
+      memmove(client->queue, client->queue + sent, client->length);
+    }
+
+    // Close a dropped subscriber once the notice is out
+    if (client->dropping) {
+      disconnect(client);
+    }
+  }
+
+  static void enqueue(subscriber *client, const char *line) {
+    // Get the length of the line
+    size_t length = strlen(line);
+
+    // Nothing more is sent to a dropped subscriber
+    if (client->dropping) {
+      return;
+    }
+
+    // Drop the subscriber if its queue overflows, rather than waiting for it
+    if (client->length + length > SUBSCRIBE_QUEUE_SIZE) {
+      drop(client);
+      flush(client);
+      return;
+    }
+
+    // Append the line and send what the socket takes
+    memcpy(client->queue + client->length, line, length);
+    client->length += length;
+
+    flush(client);
+  }
+#endif
+
+bool subscribe_socket_open(const char *path) {
+  #ifdef __linux__
+    // Check if the path fits into the address
+    if (strlen(path) >= sizeof(subscribeAddress.sun_path)) {
+      fprintf(stderr, "Subscribe socket path is too long: %s\n", path);
+      return false;
+    }
+
+    // Build the address of the socket
+    memset(&subscribeAddress, 0, sizeof(subscribeAddress));
+    subscribeAddress.sun_family = AF_UNIX;
+    strcpy(subscribeAddress.sun_path, path);
+
+    // Create a non-blocking stream socket
+    subscribeSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (subscribeSocket < 0) {
+      perror("socket()");
+      return false;
+    }
+
+    // Remove a stale socket left behind by a previous instance
+    unlink(path);
+
+    // Bind the socket to the path and listen for subscribers
+    if (bind(subscribeSocket, (struct sockaddr *) &subscribeAddress, sizeof(subscribeAddress)) != 0 ||
+        listen(subscribeSocket, SUBSCRIBE_MAX_CLIENTS) != 0) {
+      perror("bind()");
+      close(subscribeSocket);
+      subscribeSocket = -1;
+      return false;
+    }
+
+    // Allow tools of any user to subscribe
+    chmod(path, 0666);
+
+    // Return true to indicate success
+    return true;
+  #else
+    // Print an error message
+    fprintf(stderr, "Subscribe socket is not supported on this platform\n");
+
+    // Return false to indicate failure
+    (void) path;
+    return false;
+  #endif
+}
+
+void subscribe_socket_close(void) {
+  #ifdef __linux__
+    // Disconnect the subscribers
+    for (unsigned int i = 0; i < SUBSCRIBE_MAX_CLIENTS; i++) {
+      if (subscribers[i].connected) {
+        disconnect(&subscribers[i]);
+      }
+    }
+
+    // Close and remove the socket if it was opened
+    if (subscribeSocket >= 0) {
+      close(subscribeSocket);
+      unlink(subscribeAddress.sun_path);
+      subscribeSocket = -1;
+    }
+  #endif
+}
+
+int subscribe_accept(void) {
+  #ifdef __linux__
+    // Nothing to accept without a socket
+    if (subscribeSocket < 0) {
+      return -1;
+    }
+
+    // Accept the next pending connection without blocking
+    int fd = accept(subscribeSocket, NULL, NULL);
+    if (fd < 0) {
+      return -1;
+    }
+
+    // Never block on a subscriber, and don't leak the connection into child processes
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    // Find a free slot
+    for (int i = 0; i < SUBSCRIBE_MAX_CLIENTS; i++) {
+      if (!subscribers[i].connected) {
+        subscribers[i] = (subscriber) { .connected = true, .fd = fd };
+        return i;
+      }
+    }
+
+    // Reject the connection if all slots are in use
+    send(fd, SUBSCRIBE_REJECT_NOTICE, strlen(SUBSCRIBE_REJECT_NOTICE), MSG_DONTWAIT | MSG_NOSIGNAL);
+    close(fd);
+  #endif
+
+  return -1;
+}
+
+void subscribe_send(int client, const char *line) {
+  #ifdef __linux__
+    // Queue the line for one subscriber
+    if (client >= 0 && client < SUBSCRIBE_MAX_CLIENTS && subscribers[client].connected) {
+      enqueue(&subscribers[client], line);
+    }
+  #else
+    (void) client;
+    (void) line;
+  #endif
+}
+
+void subscribe_publish(const char *line) {
+  #ifdef __linux__
+    // Queue the line for every subscriber
+    for (unsigned int i = 0; i < SUBSCRIBE_MAX_CLIENTS; i++) {
+      if (subscribers[i].connected) {
+        enqueue(&subscribers[i], line);
+      }
+    }
+  #else
+    (void) line;
+  #endif
+}
+
+void subscribe_flush(void) {
+  #ifdef __linux__
+    for (unsigned int i = 0; i < SUBSCRIBE_MAX_CLIENTS; i++) {
+      subscriber *client = &subscribers[i];
+
+      if (!client->connected) {
+        continue;
+      }
+
+      // Discard what the subscriber sent, and notice when it hung up
+      char buffer[256];
+      ssize_t received;
+
+      while ((received = recv(client->fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0);
+
+      if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        disconnect(client);
+        continue;
+      }
+
+      // Send the queued lines
+      flush(client);
+
+      // Give up on the notice of a dropped subscriber after the grace period
+      if (client->connected && client->dropping && get_time_ms() - client->dropTime >= SUBSCRIBE_DROP_GRACE) {
+        disconnect(client);
+      }
+    }
+  #endif
+}
+
+bool subscribe_active(void) {
+  #ifdef __linux__
+    // Check if any subscriber is connected and not being dropped
+    for (unsigned int i = 0; i < SUBSCRIBE_MAX_CLIENTS; i++) {
+      if (subscribers[i].connected && !subscribers[i].dropping) {
+        return true;
+      }
+    }
+  #endif
+
+  return false;
+}
+
+unsigned int subscribe_clients(void) {
+  // Number of connected subscribers
+  unsigned int count = 0;
+
+  #ifdef __linux__
+    for (unsigned int i = 0; i < SUBSCRIBE_MAX_CLIENTS; i++) {
+      if (subscribers[i].connected && !subscribers[i].dropping) {
+        count++;
+      }
+    }
+  #endif
+
+  return count;
+}
+
+unsigned long subscribe_dropped(void) {
+  // Number of subscribers dropped for being too slow
+  return subscribeDropped;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of connected subscribers
+#define SUBSCRIBE_MAX_CLIENTS 16
+
+// Size (in bytes) of the queue of each subscriber, a subscriber whose queue overflows is dropped
+#define SUBSCRIBE_QUEUE_SIZE 16384
+
+// Time (in milliseconds) a dropped subscriber has to read the drop notice before it is disconnected
+#define SUBSCRIBE_DROP_GRACE 1000
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool subscribe_socket_open(const char *path);
+void subscribe_socket_close(void);
+int subscribe_accept(void);
+void subscribe_send(int client, const char *line);
+void subscribe_publish(const char *line);
+void subscribe_flush(void);
+bool subscribe_active(void);
+unsigned int subscribe_clients(void);
+unsigned long subscribe_dropped(void);
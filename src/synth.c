@@ -0,0 +1,278 @@
+#include "synth.h"
+
+#include <math.h>
+#include <string.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Increment of the SplitMix64 generator
+#define SYNTH_GOLDEN 0x9e3779b97f4a7c15ull
+
+// Pi, not defined by every C library
+#define SYNTH_PI 3.14159265358979323846
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Names of the patterns, in the order of synthPattern
+static const char *patternNames[SYNTH_PATTERN_COUNT] = {
+  [SYNTH_POISSON]  = "poisson",
+  [SYNTH_DIURNAL]  = "diurnal",
+  [SYNTH_TRAINING] = "training",
+  [SYNTH_GANG]     = "gang",
+};
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static uint64_t next_random(uint64_t *state) {
+  // SplitMix64, the same sequence on every platform
+  uint64_t z = (*state += SYNTH_GOLDEN);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+
+  return z ^ (z >> 31);
+}
+
+static double next_uniform(uint64_t *state) {
+  // Uniform number in [0, 1) from the 53 high bits
+  return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double next_exponential(uint64_t *state, double mean) {
+  // Exponential number of the given mean, by inversion
+  return -mean * log(1.0 - next_uniform(state));
+}
+
+static void schedule_next(synthGpu *gpu, const synthConfig *config, unsigned long long after) {
+  // Never arrive without a rate, or without a period where one is needed
+  if ((config->pattern != SYNTH_TRAINING && config->rate <= 0) || ((config->pattern == SYNTH_TRAINING || config->pattern == SYNTH_DIURNAL) && config->period == 0)) {
+    gpu->nextArrival = ~0ull;
+    gpu->nextService = 0;
+    return;
+  }
+
+  // Mean time (in milliseconds) between two arrivals
+  double interval = 3600000.0 / config->rate;
+
+  switch (config->pattern) {
+    case SYNTH_POISSON: {
+      // Exponential time to the next request, whose busy time varies by half around the mean
+      gpu->nextArrival = after + (unsigned long long) ceil(next_exponential(&gpu->random, interval));
+      gpu->nextService = (unsigned long long) (config->service * (0.5 + next_uniform(&gpu->random)));
+      break;
+    }
+
+    case SYNTH_DIURNAL: {
+      // Draw arrivals at the peak rate and keep them with the ratio of the rate at their time of day to the peak
+      double swing = config->amplitude / 100.0;
+      double time = after;
+
+      for (;;) {
+        time += ceil(next_exponential(&gpu->random, interval / (1.0 + swing)));
+
+        // The rate is lowest at the start of the period (midnight) and highest half a period later
+        double rate = 1.0 - swing * cos(2.0 * SYNTH_PI * fmod(time, config->period) / config->period);
+
+        if (next_uniform(&gpu->random) * (1.0 + swing) < rate) {
+          break;
+        }
+      }
+
+      gpu->nextArrival = (unsigned long long) time;
+      gpu->nextService = (unsigned long long) (config->service * (0.5 + next_uniform(&gpu->random)));
+      break;
+    }
+
+    case SYNTH_TRAINING: {
+      // Train for the period, minus the pause taken at its end
+      gpu->nextArrival = gpu->step * config->period;
+      gpu->nextService = config->period > config->pause ? config->period - config->pause : 0;
+      gpu->step++;
+      break;
+    }
+
+    case SYNTH_GANG: {
+      // Draw the next job from the generator shared by the gang, so that all GPUs see the same jobs
+      gpu->gangTime += (unsigned long long) ceil(next_exponential(&gpu->shared, interval));
+      gpu->nextService = (unsigned long long) (config->service * (0.5 + next_uniform(&gpu->shared)));
+
+      // Start the job on this GPU after its own skew
+      gpu->nextArrival = gpu->gangTime + (unsigned long long) (next_uniform(&gpu->random) * config->skew);
+      break;
+    }
+
+    default:
+      // Never arrive
+      gpu->nextArrival = ~0ull;
+      gpu->nextService = 0;
+      break;
+  }
+}
+
+const char * synth_pattern_name(synthPattern pattern) {
+  // Name of the pattern, as given on the command line
+  return pattern < SYNTH_PATTERN_COUNT ? patternNames[pattern] : "unknown";
+}
+
+bool synth_parse_pattern(const char *arg, synthPattern *pattern) {
+  // Look the name up
+  for (unsigned int i = 0; i < SYNTH_PATTERN_COUNT; i++) {
+    if (strcmp(arg, patternNames[i]) == 0) {
+      *pattern = (synthPattern) i;
+      return true;
+    }
+  }
+
+  // Unknown pattern
+  return false;
+}
+
+void synth_defaults(synthConfig *config, synthPattern pattern) {
+  // Start from an empty configuration
+  memset(config, 0, sizeof(*config));
+
+  config->pattern = pattern;
+  config->seed = 1;
+  config->powerIdle = 60;
+  config->powerBusy = 250;
+
+  // A GPU settles 45 degrees above a 30 degree room at full power, within a minute
+  config->ambient = 30;
+  config->resistance = 0.18;
+  config->timeConstant = 60 * 1000;
+
+  switch (pattern) {
+    case SYNTH_POISSON:
+      // A request every 10 seconds on average, half a second each
+      config->rate = 360;
+      config->service = 500;
+      break;
+
+    case SYNTH_DIURNAL:
+      // A request every 5 seconds on average over the day, almost none at night
+      config->rate = 720;
+      config->service = 500;
+      config->period = 24 * 60 * 60 * 1000;
+      config->amplitude = 90;
+      break;
+
+    case SYNTH_TRAINING:
+      // Evaluate for 30 seconds every 10 minutes
+      config->period = 10 * 60 * 1000;
+      config->pause = 30 * 1000;
+      break;
+
+    case SYNTH_GANG:
+      // A 20 second job per minute on average, the GPUs start within 200 ms of each other
+      config->rate = 60;
+      config->service = 20 * 1000;
+      config->skew = 200;
+      break;
+
+    default:
+      break;
+  }
+}
+
+void synth_gpu_init(synthGpu *gpu, const synthConfig *config, unsigned int index) {
+  // Start from an idle GPU
+  memset(gpu, 0, sizeof(*gpu));
+
+  // Seed the generator of the GPU apart from the others, and the shared one the same for all
+  gpu->random = config->seed ^ (index + 1) * SYNTH_GOLDEN;
+  gpu->shared = config->seed;
+
+  // Start at the temperature of an idle GPU
+  gpu->temperature = config->ambient + config->resistance * config->powerIdle;
+
+  // Draw the first arrival
+  schedule_next(gpu, config, 0);
+}
+
+unsigned int synth_gpu_sample(synthGpu *gpu, const synthConfig *config, unsigned long long time) {
+  // Apply the arrivals up to the time of the sample
+  while (gpu->nextArrival <= time) {
+    if (gpu->nextArrival > gpu->segmentEnd) {
+      // The GPU was idle, close the busy segment and start a new one
+      gpu->busyClosed += gpu->segmentEnd - gpu->segmentStart;
+      gpu->segmentStart = gpu->nextArrival;
+      gpu->segmentEnd = gpu->nextArrival + gpu->nextService;
+    } else {
+      // The GPU is busy, queue the work at the end of the segment
+      gpu->segmentEnd += gpu->nextService;
+    }
+
+    schedule_next(gpu, config, gpu->nextArrival);
+  }
+
+  // Total busy time up to the sample
+  unsigned long long busy = gpu->busyClosed;
+
+  if (time > gpu->segmentStart) {
+    busy += (time < gpu->segmentEnd ? time : gpu->segmentEnd) - gpu->segmentStart;
+  }
+
+  // Utilization is the busy share of the time since the previous sample, as reported by NVML
+  unsigned long long elapsed = time - gpu->lastTime;
+  unsigned int utilization = 0;
+
+  if (elapsed > 0) {
+    utilization = (unsigned int) (((busy - gpu->lastBusy) * 100 + elapsed / 2) / elapsed);
+  }
+
+  // Remember the sample
+  gpu->lastTime = time;
+  gpu->lastBusy = busy;
+
+  return utilization > 100 ? 100 : utilization;
+}
+
+unsigned int synth_power(const synthConfig *config, unsigned int utilization) {
+  // Power draw (in milliwatts), interpolated between idle and busy
+  return (unsigned int) ((config->powerIdle * 1000.0) + (config->powerBusy - (double) config->powerIdle) * 1000.0 * utilization / 100.0);
+}
+
+void synth_gpu_hints(synthGpu *gpu, const synthConfig *config, unsigned long long time, unsigned int utilization, unsigned int *demand, unsigned int *idleHint) {
+  // Without hints, the daemon only sees the utilization
+  *demand = 0;
+  *idleHint = 0;
+
+  if (config->hintLead == 0) {
+    return;
+  }
+
+  // The application announces the next request or job ahead of its arrival, the arrivals up to the sample were applied
+  *demand = gpu->nextArrival != ~0ull && gpu->nextArrival - time <= config->hintLead;
+
+  // It announces the end of its work once per busy segment, when the segment is over
+  if (!*demand && gpu->segmentEnd > 0 && time >= gpu->segmentEnd && gpu->hintSegment != gpu->segmentEnd) {
+    gpu->hintSegment = gpu->segmentEnd;
+    gpu->hintIdle = true;
+  }
+
+  *idleHint = gpu->hintIdle;
+
+  // The daemon drops the idle hint on the first busy sample, as it only applies to the idle period it was sent in
+  if (utilization != 0 || *demand) {
+    gpu->hintIdle = false;
+  }
+}
+
+unsigned int synth_gpu_temperature(synthGpu *gpu, const synthConfig *config, unsigned long long time, unsigned int power) {
+  // Temperature the GPU settles at with this power draw
+  double steady = config->ambient + config->resistance * power / 1000.0;
+
+  if (config->timeConstant == 0) {
+    // Without inertia, the GPU is always at the steady state
+    gpu->temperature = steady;
+  } else {
+    // Move towards the steady state by the share of the time constant that elapsed
+    double elapsed = (double) (time - gpu->temperatureTime);
+
+    gpu->temperature += (steady - gpu->temperature) * (1.0 - exp(-elapsed / config->timeConstant));
+  }
+
+  gpu->temperatureTime = time;
+
+  return (unsigned int) (gpu->temperature + 0.5);
+}
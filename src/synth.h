@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs of a synthetic trace
+#define SYNTH_MAX_GPUS 64
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Workload patterns
+typedef enum {
+  // Inference requests arriving as a Poisson process
+  SYNTH_POISSON,
+
+  // Inference requests whose rate follows the time of day
+  SYNTH_DIURNAL,
+
+  // Training steps with periodic evaluation or checkpoint pauses
+  SYNTH_TRAINING,
+
+  // Jobs running on all GPUs at once, each GPU starting with a small skew
+  SYNTH_GANG,
+
+  SYNTH_PATTERN_COUNT
+} synthPattern;
+
+// Structure to hold the parameters of a synthetic workload
+typedef struct {
+  // Pattern of the workload
+  synthPattern pattern;
+
+  // Seed of the pseudo-random generators, the same seed gives the same trace
+  uint64_t seed;
+
+  // Mean arrival rate (in requests or jobs per hour)
+  double rate;
+
+  // Mean busy time (in milliseconds) of a request, job or training period
+  unsigned long service;
+
+  // Period (in milliseconds) of the diurnal cycle or between two training pauses
+  unsigned long period;
+
+  // Swing (in percent) of the diurnal rate around its mean
+  unsigned long amplitude;
+
+  // Length (in milliseconds) of a training pause
+  unsigned long pause;
+
+  // Maximum skew (in milliseconds) between the GPUs of a gang
+  unsigned long skew;
+
+  // Idle and busy power (in watts), the power of a sample is interpolated by utilization
+  unsigned long powerIdle;
+  unsigned long powerBusy;
+
+  // Time (in milliseconds) the application announces its work ahead with a busy hint, 0 sends no hints
+  unsigned long hintLead;
+
+  // Ambient temperature (in degrees C), thermal resistance (in degrees C per watt) and time constant (in milliseconds)
+  // of the first-order thermal model the temperature of a GPU follows
+  unsigned long ambient;
+  double resistance;
+  unsigned long timeConstant;
+} synthConfig;
+
+// Structure to hold the generator of a GPU
+typedef struct {
+  // Pseudo-random generator of the GPU, and the one shared by all GPUs of a gang
+  uint64_t random;
+  uint64_t shared;
+
+  // Time (in milliseconds) and busy time of the next arrival
+  unsigned long long nextArrival;
+  unsigned long long nextService;
+
+  // Current busy segment, requests arriving while busy are queued at its end
+  unsigned long long segmentStart;
+  unsigned long long segmentEnd;
+
+  // Busy time (in milliseconds) of the closed segments
+  unsigned long long busyClosed;
+
+  // Time (in milliseconds) and total busy time of the previous sample
+  unsigned long long lastTime;
+  unsigned long long lastBusy;
+
+  // Index of the next training period
+  unsigned long long step;
+
+  // Time (in milliseconds) of the last job of the gang, before the skew of the GPU
+  unsigned long long gangTime;
+
+  // End (in milliseconds) of the busy segment the last idle hint was sent for, and whether the daemon still holds it
+  unsigned long long hintSegment;
+  bool hintIdle;
+
+  // Temperature (in degrees C) and the time (in milliseconds) it was updated at
+  double temperature;
+  unsigned long long temperatureTime;
+} synthGpu;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+const char * synth_pattern_name(synthPattern pattern);
+bool synth_parse_pattern(const char *arg, synthPattern *pattern);
+void synth_defaults(synthConfig *config, synthPattern pattern);
+void synth_gpu_init(synthGpu *gpu, const synthConfig *config, unsigned int index);
+unsigned int synth_gpu_sample(synthGpu *gpu, const synthConfig *config, unsigned long long time);
+unsigned int synth_power(const synthConfig *config, unsigned int utilization);
+void synth_gpu_hints(synthGpu *gpu, const synthConfig *config, unsigned long long time, unsigned int utilization, unsigned int *demand, unsigned int *idleHint);
+unsigned int synth_gpu_temperature(synthGpu *gpu, const synthConfig *config, unsigned long long time, unsigned int power);
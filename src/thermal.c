@@ -0,0 +1,156 @@
+#include "thermal.h"
+
+#include <string.h>
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static void rls_reset(thermalModel *model) {
+  // Clear the coefficients
+  memset(model->theta, 0, sizeof(model->theta));
+
+  // Start with a large covariance, i.e. no confidence in the initial coefficients
+  memset(model->covariance, 0, sizeof(model->covariance));
+
+  for (unsigned int i = 0; i < 3; i++) {
+    model->covariance[i][i] = 1000.0;
+  }
+}
+
+static void rls_update(thermalModel *model, const double x[3], double y) {
+  // Calculate P * x
+  double px[3];
+
+  for (unsigned int i = 0; i < 3; i++) {
+    px[i] = 0;
+
+    for (unsigned int j = 0; j < 3; j++) {
+      px[i] += model->covariance[i][j] * x[j];
+    }
+  }
+
+  // Calculate the denominator lambda + x' * P * x
+  double denominator = THERMAL_FORGETTING;
+
+  for (unsigned int i = 0; i < 3; i++) {
+    denominator += x[i] * px[i];
+  }
+
+  // Calculate the prediction error of the current coefficients
+  double error = y;
+
+  for (unsigned int i = 0; i < 3; i++) {
+    error -= model->theta[i] * x[i];
+  }
+
+  // Update the coefficients with the gain P * x / denominator
+  for (unsigned int i = 0; i < 3; i++) {
+    model->theta[i] += px[i] / denominator * error;
+  }
+
+  // Update the covariance: P = (P - P * x * x' * P / denominator) / lambda
+  for (unsigned int i = 0; i < 3; i++) {
+    for (unsigned int j = 0; j < 3; j++) {
+      model->covariance[i][j] = (model->covariance[i][j] - px[i] * px[j] / denominator) / THERMAL_FORGETTING;
+    }
+  }
+}
+
+bool thermal_due(const thermalModel *model, unsigned long long now) {
+  // A step is due on the first observation and once every step interval
+  return !model->hasPrevious || now - model->previousTime >= THERMAL_STEP;
+}
+
+void thermal_observe(thermalModel *model, double temperature, double power, unsigned long long now, unsigned int horizon) {
+  // Clamp the horizon to the size of the forecast buffer
+  if (horizon == 0 || horizon > THERMAL_HORIZON_MAX) {
+    horizon = THERMAL_HORIZON_MAX;
+  }
+
+  // Initialize the fit on the first observation
+  if (!model->hasPrevious) {
+    rls_reset(model);
+  } else {
+    // Fit the temperature change since the previous observation
+    double x[3] = { model->previousPower, model->previousTemperature, 1.0 };
+    rls_update(model, x, temperature - model->previousTemperature);
+
+    // Count the model step
+    model->samples++;
+  }
+
+  // Store the observation
+  model->hasPrevious = true;
+  model->previousTemperature = temperature;
+  model->previousPower = power;
+  model->previousTime = now;
+
+  // Don't forecast until the model is ready
+  if (!thermal_ready(model)) {
+    model->predictionCount = 0;
+    return;
+  }
+
+  // The oldest forecast was made for this step, compare it with the observed temperature
+  if (model->predictionCount >= horizon) {
+    double error = model->predictions[model->predictionHead] - temperature;
+    model->absoluteError += error < 0 ? -error : error;
+    model->errorCount++;
+  } else {
+    model->predictionCount++;
+  }
+
+  // Forecast the temperature at the horizon assuming a constant power draw
+  model->forecast = thermal_forecast(model, temperature, power, horizon);
+
+  // Store the forecast to check it once the horizon is reached
+  model->predictions[model->predictionHead] = model->forecast;
+  model->predictionHead = (model->predictionHead + 1) % horizon;
+}
+
+bool thermal_ready(const thermalModel *model) {
+  // The model needs enough steps, heating with power and cooling towards ambient
+  return model->samples >= THERMAL_MIN_SAMPLES && model->theta[0] > 0 && model->theta[1] < 0;
+}
+
+double thermal_forecast(const thermalModel *model, double temperature, double power, unsigned int steps) {
+  // Iterate the model for the given number of steps
+  for (unsigned int i = 0; i < steps; i++) {
+    temperature += model->theta[0] * power + model->theta[1] * temperature + model->theta[2];
+  }
+
+  // Return the forecasted temperature
+  return temperature;
+}
+
+bool thermal_power_for_temperature(const thermalModel *model, double temperature, double *power) {
+  // The steady state can't be solved without a valid model
+  if (!thermal_ready(model)) {
+    return false;
+  }
+
+  // Solve 0 = theta[0] * P + theta[1] * T + theta[2] for P
+  *power = -(model->theta[1] * temperature + model->theta[2]) / model->theta[0];
+
+  // The result is only meaningful for positive power
+  return *power > 0;
+}
+
+double thermal_mean_error(const thermalModel *model) {
+  // Return the mean absolute forecast error, or 0 if no forecast has been checked yet
+  return model->errorCount > 0 ? model->absoluteError / model->errorCount : 0.0;
+}
+
+double thermal_residual(const thermalModel *model, double temperature) {
+  // Without a previous observation there is no temperature change to explain
+  if (!model->hasPrevious) {
+    return 0;
+  }
+
+  // Return the temperature change since the previous observation that the model doesn't explain
+  return temperature - thermal_forecast(model, model->previousTemperature, model->previousPower, 1);
+}
+
+double thermal_gain(const thermalModel *model) {
+  // Return the steady-state temperature rise per watt, or 0 without a valid model
+  return thermal_ready(model) ? model->theta[0] / -model->theta[1] : 0.0;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Interval (in milliseconds) between model steps
+#define THERMAL_STEP 1000
+
+// Maximum forecast horizon (in model steps)
+#define THERMAL_HORIZON_MAX 120
+
+// Minimum number of model steps before the model is used
+#define THERMAL_MIN_SAMPLES 30
+
+// Forgetting factor of the recursive least squares fit
+#define THERMAL_FORGETTING 0.995
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the first-order thermal model of a GPU
+//
+// The model predicts the temperature change over one step from the power draw and the current temperature:
+//   T[k + 1] - T[k] = theta[0] * P[k] + theta[1] * T[k] + theta[2]
+typedef struct {
+  // Model coefficients and covariance of the fit
+  double theta[3];
+  double covariance[3][3];
+
+  // Number of model steps
+  unsigned long samples;
+
+  // Previous observation
+  bool hasPrevious;
+  double previousTemperature;
+  double previousPower;
+  unsigned long long previousTime;
+
+  // Forecasts made in the past, used to measure the accuracy at the horizon
+  double predictions[THERMAL_HORIZON_MAX];
+  unsigned int predictionHead;
+  unsigned int predictionCount;
+
+  // Latest forecast at the horizon (in degrees C)
+  double forecast;
+
+  // Accumulated absolute forecast error (in degrees C) and number of checked forecasts
+  double absoluteError;
+  unsigned long errorCount;
+} thermalModel;
+
+// Structure to hold the fan control of a GPU, which holds it under the temperature threshold without cutting clocks
+typedef struct {
+  // Flag to indicate if the fans can be controlled
+  bool supported;
+
+  // Flag to indicate if the daemon currently controls the fans
+  bool controlled;
+
+  // Number of fans
+  unsigned int count;
+
+  // Fan speed when the daemon took control, current speed and maximum allowed speed (in percent)
+  unsigned int initialSpeed;
+  unsigned int speed;
+  unsigned int maxSpeed;
+
+  // Time (in milliseconds) of the last fan speed change
+  unsigned long long lastChange;
+
+  // Number of thermal decisions handled by the fans
+  unsigned long decisions;
+} fanState;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool thermal_due(const thermalModel *model, unsigned long long now);
+void thermal_observe(thermalModel *model, double temperature, double power, unsigned long long now, unsigned int horizon);
+bool thermal_ready(const thermalModel *model);
+double thermal_forecast(const thermalModel *model, double temperature, double power, unsigned int steps);
+bool thermal_power_for_temperature(const thermalModel *model, double temperature, double *power);
+double thermal_mean_error(const thermalModel *model);
+double thermal_residual(const thermalModel *model, double temperature);
+double thermal_gain(const thermalModel *model);
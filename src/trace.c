@@ -0,0 +1,293 @@
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "utils.h"
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Kinds of recorded events
+typedef enum {
+  TRACE_KIND_STATE,
+  TRACE_KIND_COUNTER,
+  TRACE_KIND_EVENT
+} traceKind;
+
+// Structure to hold a recorded event
+typedef struct {
+  // Time (in microseconds of the monotonic clock) of the event
+  unsigned long long time;
+
+  // GPU and kind of the event
+  unsigned int gpu;
+  traceKind kind;
+
+  // Performance state or counter, and the counter value
+  unsigned int id;
+  double value;
+
+  // Reason of the state change or name of the event (static strings)
+  const char *name;
+} traceRecord;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Names of the counters, with their units
+static const char *traceCounterNames[TRACE_COUNTER_COUNT] = {
+  [TRACE_TEMPERATURE] = "Temperature (C)",
+  [TRACE_UTILIZATION] = "Utilization (%)",
+  [TRACE_POWER_LIMIT] = "Power limit (W)",
+  [TRACE_FAN_SPEED] = "Fan speed (%)",
+};
+
+// Ring buffer of the recorded events, with the index of the oldest one and their count
+static traceRecord *traceRecords;
+static size_t traceStart;
+static size_t traceCount;
+
+// Length (in microseconds) of the exported window
+static unsigned long long traceWindow;
+
+// Names of the GPUs
+static char traceNames[TRACE_MAX_GPUS][128];
+
+// Last recorded value of each counter, so that only changes are recorded
+static double traceLast[TRACE_MAX_GPUS][TRACE_COUNTER_COUNT];
+static bool traceSeen[TRACE_MAX_GPUS][TRACE_COUNTER_COUNT];
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static void record(unsigned int gpu, traceKind kind, unsigned int id, double value, const char *name) {
+  // Nothing to do if tracing is disabled
+  if (traceRecords == NULL || gpu >= TRACE_MAX_GPUS) {
+    return;
+  }
+
+  // Drop the oldest event if the buffer is full
+  if (traceCount == TRACE_CAPACITY) {
+    traceStart = (traceStart + 1) % TRACE_CAPACITY;
+    traceCount--;
+  }
+
+  // Append the event
+  traceRecords[(traceStart + traceCount) % TRACE_CAPACITY] = (traceRecord) {
+    .time = get_time_ns() / 1000,
+    .gpu = gpu,
+    .kind = kind,
+    .id = id,
+    .value = value,
+    .name = name,
+  };
+
+  traceCount++;
+}
+
+static void write_string(FILE *file, const char *string) {
+  // Write the string between quotes, escaping the characters JSON doesn't allow
+  fputc('"', file);
+
+  for (const char *c = string; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      fprintf(file, "\\%c", *c);
+    } else if ((unsigned char) *c < 0x20) {
+      fprintf(file, "\\u%04x", (unsigned char) *c);
+    } else {
+      fputc(*c, file);
+    }
+  }
+
+  fputc('"', file);
+}
+
+static void write_slice(FILE *file, const traceRecord *state, unsigned long long from, unsigned long long to, long long offset) {
+  // Skip the slices that ended before the window
+  if (to < from) {
+    return;
+  }
+
+  // Clip the slice to the window
+  unsigned long long start = state->time > from ? state->time : from;
+
+  // Write the slice on the performance state track
+  if (state->id >= 16) {
+    fprintf(file, ",\n{\"name\":\"Auto\"");
+  } else {
+    fprintf(file, ",\n{\"name\":\"P%u\"", state->id);
+  }
+
+  fprintf(file, ",\"ph\":\"X\",\"ts\":%lld,\"dur\":%llu,\"pid\":%u,\"tid\":1,\"args\":{\"reason\":",
+    (long long) start + offset, to - start, state->gpu + 1);
+  write_string(file, state->name);
+  fprintf(file, "}}");
+}
+
+bool trace_open(unsigned long window) {
+  // Allocate the ring buffer
+  traceRecords = malloc(TRACE_CAPACITY * sizeof(traceRecord));
+  if (traceRecords == NULL) {
+    fprintf(stderr, "Unable to allocate the trace buffer\n");
+    return false;
+  }
+
+  // Store the window in microseconds
+  traceWindow = (unsigned long long) window * 1000000;
+  traceStart = 0;
+  traceCount = 0;
+
+  // Return true to indicate success
+  return true;
+}
+
+void trace_close(void) {
+  // Free the ring buffer
+  SAFE_FREE(traceRecords);
+}
+
+void trace_gpu(unsigned int gpu, const char *name) {
+  // Remember the name of the GPU for its track
+  if (gpu < TRACE_MAX_GPUS) {
+    snprintf(traceNames[gpu], sizeof(traceNames[gpu]), "GPU %u (%s)", gpu, name);
+  }
+}
+
+void trace_state(unsigned int gpu, unsigned int pstateId, const char *reason) {
+  // Record the state change and its reason
+  record(gpu, TRACE_KIND_STATE, pstateId, 0, reason);
+}
+
+void trace_counter(unsigned int gpu, traceCounter counter, double value) {
+  // Record the counter only when it changes
+  if (gpu >= TRACE_MAX_GPUS || (traceSeen[gpu][counter] && traceLast[gpu][counter] == value)) {
+    return;
+  }
+
+  traceSeen[gpu][counter] = true;
+  traceLast[gpu][counter] = value;
+
+  record(gpu, TRACE_KIND_COUNTER, counter, value, NULL);
+}
+
+void trace_event(unsigned int gpu, const char *name) {
+  // Record the decision
+  record(gpu, TRACE_KIND_EVENT, 0, 0, name);
+}
+
+bool trace_write(const char *path) {
+  // Nothing to do if tracing is disabled
+  if (traceRecords == NULL) {
+    return true;
+  }
+
+  // Compute the window
+  unsigned long long now = get_time_ns() / 1000;
+  unsigned long long from = now > traceWindow ? now - traceWindow : 0;
+
+  // Compute the offset from the monotonic clock to the Unix epoch, so that the trace lines up with profiler traces
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+
+  long long offset = (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000 - (long long) now;
+
+  // Open the file
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    fprintf(stderr, "Unable to open trace file %s\n", path);
+    return false;
+  }
+
+  // Write the header and the clock of the trace
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"clock\":\"unix-epoch-us\"},\"traceEvents\":[\n");
+  fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"nvidia-pstated\"}}");
+
+  // Name the tracks of each GPU
+  for (unsigned int gpu = 0; gpu < TRACE_MAX_GPUS; gpu++) {
+    if (traceNames[gpu][0] == '\0') {
+      continue;
+    }
+
+    fprintf(file, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":", gpu + 1);
+    write_string(file, traceNames[gpu]);
+    fprintf(file, "}}");
+    fprintf(file, ",\n{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"sort_index\":%u}}", gpu + 1, gpu + 1);
+    fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":1,\"args\":{\"name\":\"Performance state\"}}", gpu + 1);
+    fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":2,\"args\":{\"name\":\"Decisions\"}}", gpu + 1);
+  }
+
+  // State of each GPU whose slice is still open
+  traceRecord states[TRACE_MAX_GPUS];
+  bool open[TRACE_MAX_GPUS] = { false };
+
+  // Counter values from before the window, written at its start
+  double before[TRACE_MAX_GPUS][TRACE_COUNTER_COUNT];
+  bool hasBefore[TRACE_MAX_GPUS][TRACE_COUNTER_COUNT] = { { false } };
+
+  // Write the events in order
+  for (size_t i = 0; i < traceCount; i++) {
+    const traceRecord *event = &traceRecords[(traceStart + i) % TRACE_CAPACITY];
+
+    switch (event->kind) {
+      case TRACE_KIND_STATE:
+        // Close the slice of the previous state, even if it started before the window
+        if (open[event->gpu]) {
+          write_slice(file, &states[event->gpu], from, event->time, offset);
+        }
+
+        states[event->gpu] = *event;
+        open[event->gpu] = true;
+        break;
+      case TRACE_KIND_COUNTER:
+        // Keep the last value from before the window
+        if (event->time < from) {
+          before[event->gpu][event->id] = event->value;
+          hasBefore[event->gpu][event->id] = true;
+        } else {
+          fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%lld,\"pid\":%u,\"args\":{\"value\":%g}}",
+            traceCounterNames[event->id], (long long) event->time + offset, event->gpu + 1, event->value);
+        }
+        break;
+      case TRACE_KIND_EVENT:
+        if (event->time >= from) {
+          fprintf(file, ",\n{\"name\":");
+          write_string(file, event->name);
+          fprintf(file, ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%lld,\"pid\":%u,\"tid\":2}", (long long) event->time + offset, event->gpu + 1);
+        }
+        break;
+    }
+  }
+
+  // Write the counter values at the start of the window
+  for (unsigned int gpu = 0; gpu < TRACE_MAX_GPUS; gpu++) {
+    for (unsigned int counter = 0; counter < TRACE_COUNTER_COUNT; counter++) {
+      if (hasBefore[gpu][counter]) {
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%lld,\"pid\":%u,\"args\":{\"value\":%g}}",
+          traceCounterNames[counter], (long long) from + offset, gpu + 1, before[gpu][counter]);
+      }
+    }
+  }
+
+  // Close the slices of the current states at the end of the window
+  for (unsigned int gpu = 0; gpu < TRACE_MAX_GPUS; gpu++) {
+    if (open[gpu]) {
+      write_slice(file, &states[gpu], from, now, offset);
+    }
+  }
+
+  // Write the footer
+  fprintf(file, "\n]}\n");
+
+  // Flush the file and check for write errors
+  bool ok = fflush(file) == 0 && !ferror(file);
+
+  if (fclose(file) != 0 || !ok) {
+    fprintf(stderr, "Unable to write trace file %s\n", path);
+    return false;
+  }
+
+  // Print the path of the file
+  printf("Trace written to %s\n", path);
+
+  // Return true to indicate success
+  return true;
+}
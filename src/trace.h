@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs traced
+#define TRACE_MAX_GPUS 64
+
+// Maximum number of events kept in memory, the oldest are dropped first
+#define TRACE_CAPACITY 65536
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Traced counters
+typedef enum {
+  TRACE_TEMPERATURE,
+  TRACE_UTILIZATION,
+  TRACE_POWER_LIMIT,
+  TRACE_FAN_SPEED,
+  TRACE_COUNTER_COUNT
+} traceCounter;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool trace_open(unsigned long window);
+void trace_close(void);
+void trace_gpu(unsigned int gpu, const char *name);
+void trace_state(unsigned int gpu, unsigned int pstateId, const char *reason);
+void trace_counter(unsigned int gpu, traceCounter counter, double value);
+void trace_event(unsigned int gpu, const char *name);
+bool trace_write(const char *path);
@@ -0,0 +1,533 @@
+/*
+ * Trainer of the idle policy model of nvidia-pstated.
+ *
+ * The trainer reads sample logs recorded by the daemon with --sample-log, labels every idle sample with the net
+ * benefit of switching to the low performance state at that moment (the idle power saved until the GPU is busy again,
+ * minus the weighted ramp latency paid when it is), fits a regression tree on the features of the samples and writes
+ * it as a flat node array for --policy-model. The daemon switches when the tree predicts a positive benefit.
+ *
+ * Usage: pstated-train [options] -o <model> <sample log>...
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "model.h"
+#include "samples.h"
+#include "utils.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Number of samples the utilization mean is taken over
+#define WINDOW 10
+
+// Maximum depth of the tree, and the limit set by the 16-bit node indices
+#define MAX_DEPTH 6
+#define MAX_DEPTH_LIMIT 15
+
+// Minimum number of samples in a leaf
+#define MIN_LEAF 50
+
+// Low performance state of the recordings
+#define PERFORMANCE_STATE_LOW 8
+
+// Ramp latency (in milliseconds) paid when an idle gap in the low performance state ends
+#define RAMP_LATENCY 100
+
+// Cost (in millijoules) of one millisecond of ramp latency
+#define LATENCY_WEIGHT 1000
+
+// Number of model evaluations timed for the evaluation cost
+#define BENCHMARK_EVALUATIONS 1000000
+
+/***** ***** ***** ***** ***** TYPES ***** ***** ***** ***** *****/
+
+// Structure to hold a training sample
+typedef struct {
+  // Features of the sample
+  float values[MODEL_FEATURE_COUNT];
+
+  // Net benefit (in joules) of switching to the low performance state at the sample
+  double label;
+} trainSample;
+
+// Structure to hold a feature value and the label of its sample, sorted to find the best split
+typedef struct {
+  float value;
+  double label;
+} trainPair;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Training samples
+static trainSample *samples;
+static size_t sampleCount;
+
+// Samples of the sample logs, one GPU after the other
+static sampleRecord *records;
+static size_t recordCount;
+static size_t recordCapacity;
+
+// Tree being built
+static model tree;
+
+// Scratch space of the split search
+static trainPair *pairs;
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static int compare_records(const void *a, const void *b) {
+  // Order the samples by GPU, then by time
+  const sampleRecord *x = a;
+  const sampleRecord *y = b;
+
+  if (x->gpu != y->gpu) {
+    return x->gpu < y->gpu ? -1 : 1;
+  }
+
+  return x->time < y->time ? -1 : x->time > y->time;
+}
+
+static int compare_pairs(const void *a, const void *b) {
+  // Order the pairs by feature value
+  const trainPair *x = a;
+  const trainPair *y = b;
+
+  return x->value < y->value ? -1 : x->value > y->value;
+}
+
+static bool read_log(const char *path) {
+  // Open the sample log
+  sampleReader reader;
+
+  if (!sample_reader_open(&reader, path)) {
+    return false;
+  }
+
+  // Read all the samples
+  sampleRecord record;
+  int result;
+
+  recordCount = 0;
+
+  while ((result = sample_reader_next(&reader, &record)) == 1) {
+    // Grow the array when it is full
+    if (recordCount == recordCapacity) {
+      size_t capacity = recordCapacity > 0 ? recordCapacity * 2 : 4096;
+      sampleRecord *grown = realloc(records, capacity * sizeof(sampleRecord));
+
+      if (grown == NULL) {
+        fprintf(stderr, "Unable to allocate %zu samples\n", capacity);
+        sample_reader_close(&reader);
+        return false;
+      }
+
+      records = grown;
+      recordCapacity = capacity;
+    }
+
+    records[recordCount++] = record;
+  }
+
+  // Close the sample log
+  sample_reader_close(&reader);
+
+  // Group the samples by GPU
+  qsort(records, recordCount, sizeof(sampleRecord), compare_records);
+
+  // Return true if the whole log was read
+  return result == 0;
+}
+
+static void estimate_power(double *powerHigh, double *powerLow, unsigned long performanceStateLow) {
+  // Average the power of the idle samples in each state
+  double sum[2] = { 0 };
+  size_t count[2] = { 0 };
+
+  for (size_t i = 0; i < recordCount; i++) {
+    if (records[i].utilization == 0 && records[i].power != 0) {
+      int low = records[i].pstateId == performanceStateLow;
+
+      sum[low] += records[i].power / 1000.0;
+      count[low]++;
+    }
+  }
+
+  // Keep the values set on the command line
+  if (*powerHigh < 0 && count[0] > 0) {
+    *powerHigh = sum[0] / count[0];
+  }
+
+  if (*powerLow < 0 && count[1] > 0) {
+    *powerLow = sum[1] / count[1];
+  }
+}
+
+static bool add_samples(unsigned int window, double powerHigh, double powerLow, double rampLatency, double latencyWeight) {
+  // Walk the samples of each GPU
+  size_t first = 0;
+
+  while (first < recordCount) {
+    // Find the end of the samples of the GPU
+    size_t end = first;
+
+    while (end < recordCount && records[end].gpu == records[first].gpu) {
+      end++;
+    }
+
+    // Grow the training samples for the worst case of an idle GPU
+    trainSample *grown = realloc(samples, (sampleCount + end - first) * sizeof(trainSample));
+
+    if (grown == NULL) {
+      fprintf(stderr, "Unable to allocate %zu training samples\n", sampleCount + end - first);
+      return false;
+    }
+
+    samples = grown;
+
+    // Time (in milliseconds) the GPU is next busy, walking backwards, 0 if it stays idle until the end of the log
+    unsigned long long nextBusy = 0;
+    size_t base = sampleCount;
+
+    for (size_t i = end; i-- > first;) {
+      if (records[i].utilization != 0) {
+        nextBusy = records[i].time;
+        continue;
+      }
+
+      // Label the idle sample: power saved until the next busy sample, minus the ramp latency paid then
+      unsigned long long until = nextBusy != 0 ? nextBusy : records[end - 1].time;
+      double label = (powerHigh - powerLow) * (until - records[i].time) / 1000.0;
+
+      if (nextBusy != 0) {
+        label -= latencyWeight * rampLatency / 1000.0;
+      }
+
+      samples[base + (i - first)].label = label;
+    }
+
+    // Compute the features forwards, as the daemon does, and keep the idle samples (packed over their own labels)
+    modelFeatures features;
+    memset(&features, 0, sizeof(features));
+
+    for (size_t i = first; i < end; i++) {
+      model_features_update(&features, window, records[i].time, records[i].utilization, records[i].power, records[i].processes);
+
+      if (records[i].utilization == 0) {
+        double label = samples[base + (i - first)].label;
+
+        memcpy(samples[sampleCount].values, features.values, sizeof(features.values));
+        samples[sampleCount].label = label;
+        sampleCount++;
+      }
+    }
+
+    first = end;
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+static void sum_labels(size_t begin, size_t end, double *sum, double *squares) {
+  // Sum the labels and their squares
+  *sum = 0;
+  *squares = 0;
+
+  for (size_t i = begin; i < end; i++) {
+    *sum += samples[i].label;
+    *squares += samples[i].label * samples[i].label;
+  }
+}
+
+static bool build(size_t begin, size_t end, unsigned int depth, unsigned long maxDepth, unsigned long minLeaf) {
+  // Take the next node
+  if (tree.count == MODEL_MAX_NODES) {
+    fprintf(stderr, "The tree has more than %u nodes\n", MODEL_MAX_NODES);
+    return false;
+  }
+
+  unsigned int index = tree.count++;
+  modelNode *node = &tree.nodes[index];
+  size_t n = end - begin;
+
+  // Predict the mean label of the samples
+  double sum, squares;
+  sum_labels(begin, end, &sum, &squares);
+
+  node->feature = MODEL_LEAF;
+  node->threshold = (float) (sum / n);
+  node->right = 0;
+
+  // Stop at the maximum depth or when a split would leave a leaf too small
+  if (depth >= maxDepth || n < 2 * minLeaf) {
+    return true;
+  }
+
+  // Find the split that reduces the squared error the most
+  double bestScore = sum * sum / n + 1e-9 * (squares > 1 ? squares : 1);
+  int bestFeature = MODEL_LEAF;
+  float bestThreshold = 0;
+
+  for (int feature = 0; feature < MODEL_FEATURE_COUNT; feature++) {
+    // Sort the samples by the feature
+    for (size_t i = 0; i < n; i++) {
+      pairs[i].value = samples[begin + i].values[feature];
+      pairs[i].label = samples[begin + i].label;
+    }
+
+    qsort(pairs, n, sizeof(trainPair), compare_pairs);
+
+    // Try every boundary between two distinct values that leaves enough samples on both sides
+    double left = 0;
+
+    for (size_t i = 0; i + 1 < n; i++) {
+      left += pairs[i].label;
+
+      if (i + 1 < minLeaf || n - i - 1 < minLeaf || pairs[i].value == pairs[i + 1].value) {
+        continue;
+      }
+
+      double right = sum - left;
+      double score = left * left / (i + 1) + right * right / (n - i - 1);
+
+      if (score > bestScore) {
+        bestScore = score;
+        bestFeature = feature;
+        bestThreshold = pairs[i].value + (pairs[i + 1].value - pairs[i].value) / 2;
+
+        // Keep the threshold below the next value after rounding
+        if (bestThreshold >= pairs[i + 1].value) {
+          bestThreshold = pairs[i].value;
+        }
+      }
+    }
+  }
+
+  // Keep the leaf if no split helps
+  if (bestFeature == MODEL_LEAF) {
+    return true;
+  }
+
+  // Move the samples at or below the threshold to the front
+  size_t middle = begin;
+
+  for (size_t i = begin; i < end; i++) {
+    if (samples[i].values[bestFeature] <= bestThreshold) {
+      trainSample swap = samples[i];
+      samples[i] = samples[middle];
+      samples[middle] = swap;
+      middle++;
+    }
+  }
+
+  // Turn the leaf into a split, the left subtree follows it and the right one is linked
+  tree.nodes[index].feature = (int16_t) bestFeature;
+  tree.nodes[index].threshold = bestThreshold;
+
+  if (!build(begin, middle, depth + 1, maxDepth, minLeaf)) {
+    return false;
+  }
+
+  tree.nodes[index].right = (uint16_t) tree.count;
+
+  return build(middle, end, depth + 1, maxDepth, minLeaf);
+}
+
+static void print_tree(unsigned int index, unsigned int depth) {
+  // Print the node indented by its depth
+  const modelNode *node = &tree.nodes[index];
+
+  if (node->feature == MODEL_LEAF) {
+    printf("%*s%s (%.2f J)\n", depth * 2, "", node->threshold > 0 ? "switch" : "wait", node->threshold);
+    return;
+  }
+
+  printf("%*s%s <= %g\n", depth * 2, "", model_feature_name(node->feature), node->threshold);
+  print_tree(index + 1, depth + 1);
+  printf("%*s%s > %g\n", depth * 2, "", model_feature_name(node->feature), node->threshold);
+  print_tree(node->right, depth + 1);
+}
+
+int main(int argc, char * argv[]) {
+  // Variables to hold the options
+  const char * output = NULL;
+  unsigned long window = WINDOW;
+  unsigned long maxDepth = MAX_DEPTH;
+  unsigned long minLeaf = MIN_LEAF;
+  unsigned long performanceStateLow = PERFORMANCE_STATE_LOW;
+  unsigned long rampLatency = RAMP_LATENCY;
+  unsigned long latencyWeight = LATENCY_WEIGHT;
+  unsigned long powerHighArg = 0;
+  unsigned long powerLowArg = 0;
+  double powerHigh = -1;
+  double powerLow = -1;
+  int logCount = 0;
+
+  // Exit code
+  int result = EXIT_FAILURE;
+
+  // Parse the options
+  for (int i = 1; i < argc; i++) {
+    // Check if the option is "-o" or "--output" and if there is a next argument
+    if ((IS_OPTION("-o") || IS_OPTION("--output")) && HAS_NEXT_ARG) {
+      // Store the path of the model
+      output = argv[++i];
+    } else if ((IS_OPTION("-w") || IS_OPTION("--window")) && HAS_NEXT_ARG) {
+      // Parse the window of the utilization mean
+      ASSERT_TRUE(parse_ulong(argv[++i], &window) && window > 0 && window <= MODEL_WINDOW_MAX, usage);
+    } else if ((IS_OPTION("-md") || IS_OPTION("--max-depth")) && HAS_NEXT_ARG) {
+      // Parse the maximum depth of the tree
+      ASSERT_TRUE(parse_ulong(argv[++i], &maxDepth) && maxDepth <= MAX_DEPTH_LIMIT, usage);
+    } else if ((IS_OPTION("-ml") || IS_OPTION("--min-leaf")) && HAS_NEXT_ARG) {
+      // Parse the minimum number of samples in a leaf
+      ASSERT_TRUE(parse_ulong(argv[++i], &minLeaf) && minLeaf > 0, usage);
+    } else if ((IS_OPTION("-psl") || IS_OPTION("--performance-state-low")) && HAS_NEXT_ARG) {
+      // Parse the low performance state of the recordings
+      ASSERT_TRUE(parse_ulong(argv[++i], &performanceStateLow), usage);
+    } else if ((IS_OPTION("-ph") || IS_OPTION("--power-high")) && HAS_NEXT_ARG) {
+      // Parse the idle power in the high performance state
+      ASSERT_TRUE(parse_ulong(argv[++i], &powerHighArg), usage);
+      powerHigh = powerHighArg;
+    } else if ((IS_OPTION("-pl") || IS_OPTION("--power-low")) && HAS_NEXT_ARG) {
+      // Parse the idle power in the low performance state
+      ASSERT_TRUE(parse_ulong(argv[++i], &powerLowArg), usage);
+      powerLow = powerLowArg;
+    } else if ((IS_OPTION("-rl") || IS_OPTION("--ramp-latency")) && HAS_NEXT_ARG) {
+      // Parse the ramp latency
+      ASSERT_TRUE(parse_ulong(argv[++i], &rampLatency), usage);
+    } else if ((IS_OPTION("-lw") || IS_OPTION("--latency-weight")) && HAS_NEXT_ARG) {
+      // Parse the cost of the ramp latency
+      ASSERT_TRUE(parse_ulong(argv[++i], &latencyWeight), usage);
+    } else if (argv[i][0] != '-') {
+      // Count the sample logs, they are read below
+      logCount++;
+    } else {
+      goto usage;
+    }
+  }
+
+  // The model path and at least one sample log are required
+  ASSERT_TRUE(output != NULL && logCount > 0, usage);
+
+  // Display usage instructions to the user
+  if (false) {
+    usage:
+
+    // Print the usage instructions
+    printf("Usage: %s [options] -o <model> <sample log>...\n", argv[0]);
+    printf("\n");
+    printf("Options:\n");
+    printf("  -o, --output <path>                       Write the model to this file\n");
+    printf("  -w, --window <value>                      Set the number of samples the utilization mean is taken over (default: %u)\n", WINDOW);
+    printf("  -md, --max-depth <value>                  Set the maximum depth of the tree, up to %u (default: %u)\n", MAX_DEPTH_LIMIT, MAX_DEPTH);
+    printf("  -ml, --min-leaf <value>                   Set the minimum number of samples in a leaf (default: %u)\n", MIN_LEAF);
+    printf("  -psl, --performance-state-low <value>     Set the low performance state the logs were recorded with (default: %u)\n", PERFORMANCE_STATE_LOW);
+    printf("  -ph, --power-high <value>                 Set the idle power in watts in the high performance state (default: measured from the logs)\n");
+    printf("  -pl, --power-low <value>                  Set the idle power in watts in the low performance state (default: measured from the logs)\n");
+    printf("  -rl, --ramp-latency <value>               Set the latency in milliseconds added when work arrives in the low performance state (default: %u)\n", RAMP_LATENCY);
+    printf("  -lw, --latency-weight <value>             Set the cost in millijoules of one millisecond of ramp latency (default: %u)\n", LATENCY_WEIGHT);
+
+    // Exit the program
+    return EXIT_FAILURE;
+  }
+
+  // Read the sample logs, estimating the idle power of each state from the first one that has it
+  for (int i = 1; i < argc; i++) {
+    // Skip the options and their arguments
+    if (argv[i][0] == '-') {
+      i++;
+      continue;
+    }
+
+    // Read the log
+    if (!read_log(argv[i])) {
+      goto cleanup;
+    }
+
+    estimate_power(&powerHigh, &powerLow, performanceStateLow);
+
+    // Check that both idle powers are known
+    if (powerHigh < 0 || powerLow < 0) {
+      fprintf(stderr, "Idle power of the %s performance state is not in %s, set it with %s\n",
+        powerHigh < 0 ? "high" : "low", argv[i], powerHigh < 0 ? "--power-high" : "--power-low");
+      goto cleanup;
+    }
+
+    // Label the idle samples
+    if (!add_samples(window, powerHigh, powerLow, rampLatency, latencyWeight / 1000.0)) {
+      goto cleanup;
+    }
+
+    printf("Read %zu samples from %s\n", recordCount, argv[i]);
+  }
+
+  // Print the cost model
+  printf("Idle power: %.2f W high, %.2f W low, ramp cost: %lu ms at %lu mJ/ms\n", powerHigh, powerLow, rampLatency, latencyWeight);
+
+  // Check that there is something to learn from
+  if (sampleCount < minLeaf) {
+    fprintf(stderr, "Not enough idle samples to train on: %zu\n", sampleCount);
+    goto cleanup;
+  }
+
+  // Allocate the tree and the scratch space
+  tree.window = window;
+  tree.nodes = calloc(MODEL_MAX_NODES, sizeof(modelNode));
+  pairs = malloc(sampleCount * sizeof(trainPair));
+
+  if (tree.nodes == NULL || pairs == NULL) {
+    fprintf(stderr, "Unable to allocate the tree\n");
+    goto cleanup;
+  }
+
+  // Fit the tree
+  if (!build(0, sampleCount, 0, maxDepth, minLeaf)) {
+    goto cleanup;
+  }
+
+  // Print the tree and the share of idle samples it switches at
+  size_t switches = 0;
+  double error = 0;
+
+  for (size_t i = 0; i < sampleCount; i++) {
+    float prediction = model_predict(&tree, samples[i].values);
+
+    switches += prediction > 0;
+    error += (prediction - samples[i].label) * (prediction - samples[i].label);
+  }
+
+  print_tree(0, 0);
+  printf("%u nodes, %zu idle samples, switches at %.1f%% of them, RMS error %.2f J\n",
+    tree.count, sampleCount, 100.0 * switches / sampleCount, sqrt(error / sampleCount));
+
+  // Time the evaluation, as done by the daemon on every idle sample
+  volatile float sink = 0;
+  unsigned long long start = get_time_ns();
+
+  for (unsigned long i = 0; i < BENCHMARK_EVALUATIONS; i++) {
+    sink += model_predict(&tree, samples[i % sampleCount].values);
+  }
+
+  printf("Evaluation takes %.1f ns\n", (double) (get_time_ns() - start) / BENCHMARK_EVALUATIONS);
+  (void) sink;
+
+  // Write the model
+  if (!model_save(&tree, output)) {
+    goto cleanup;
+  }
+
+  printf("Model written to %s\n", output);
+  result = EXIT_SUCCESS;
+
+cleanup:
+  // Release the memory
+  free(samples);
+  free(records);
+  free(pairs);
+  model_free(&tree);
+
+  return result;
+}
@@ -5,6 +5,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+  #include <windows.h>
+#elif __linux__
+  #include <time.h>
+#endif
+
 bool parse_ulong(const char *arg, unsigned long *value) {
   // Check if the input or output argument is invalid
   if (arg == NULL || value == NULL) {
@@ -98,3 +104,54 @@ bool parse_ulong_array(const char *arg, const char *delimiter, const size_t max_
   // Return true if parsing were successful
   return true;
 }
+
+unsigned long long get_time_ms(void) {
+  // Read the monotonic clock of the platform
+  #ifdef _WIN32
+    return GetTickCount64();
+  #elif __linux__
+    struct timespec ts;
+
+    // Get the current time of the monotonic clock
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    // Convert the time to milliseconds
+    return (unsigned long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+  #endif
+}
+
+unsigned long long get_time_ns(void) {
+  // Read the high-resolution monotonic clock of the platform
+  #ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+
+    // Get the current value and the frequency of the performance counter
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+
+    // Convert the counter to nanoseconds
+    return (unsigned long long) (counter.QuadPart / frequency.QuadPart) * 1000000000ULL + (unsigned long long) (counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+  #elif __linux__
+    struct timespec ts;
+
+    // Get the current time of the monotonic clock
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    // Convert the time to nanoseconds
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  #endif
+}
+
+unsigned int hash_string(const char *string) {
+  // Start with the FNV-1a offset basis
+  unsigned int hash = 2166136261u;
+
+  // Mix each byte of the string into the hash
+  for (const unsigned char *c = (const unsigned char *) string; *c != '\0'; c++) {
+    hash ^= *c;
+    hash *= 16777619u;
+  }
+
+  // Return the resulting hash
+  return hash;
+}
@@ -49,3 +49,6 @@
 
 bool parse_ulong(const char *arg, unsigned long *value);
 bool parse_ulong_array(const char *arg, const char *delimiter, const size_t max_count, unsigned long *values, size_t *count);
+unsigned long long get_time_ms(void);
+unsigned long long get_time_ns(void);
+unsigned int hash_string(const char *string);
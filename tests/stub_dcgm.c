@@ -0,0 +1,225 @@
+/*
+ * Stub of the DCGM library, loaded by the DCGM telemetry backend in place of libdcgm.so. The host engine is simulated
+ * by values set through the stub_dcgm_* functions.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Number of simulated GPU entities
+#define STUB_GPUS 4
+
+// Maximum number of watched fields
+#define STUB_FIELDS 8
+
+// Host that the stub refuses to connect to
+#define STUB_UNREACHABLE "unreachable"
+
+// Field identifiers and types, as in the DCGM headers
+#define FI_DEV_UUID 54
+#define FI_DEV_GPU_TEMP 150
+#define FI_DEV_GPU_UTIL 203
+#define FT_DOUBLE 'd'
+#define FT_INT64 'i'
+#define FT_STRING 's'
+
+// Entity group of GPUs
+#define FE_GPU 1
+
+/***** ***** ***** ***** ***** TYPES ***** ***** ***** ***** *****/
+
+// Value of a field, as laid out by the DCGM library
+typedef struct {
+  unsigned int version;
+  unsigned short fieldId;
+  unsigned short fieldType;
+  int status;
+  int64_t ts;
+  union {
+    int64_t i64;
+    double dbl;
+    char str[256];
+    char blob[4096];
+  } value;
+} fieldValue;
+
+typedef int (*enumeration_f)(int, unsigned int, fieldValue *, int, void *);
+
+// Structure to hold the values of a simulated GPU
+typedef struct {
+  // UUID of the GPU, empty for a missing GPU
+  char uuid[96];
+
+  // Temperature (in degrees C) and activity (in percent)
+  long long temperature;
+  double activity;
+
+  // Time (in microseconds since the epoch) of the values
+  long long time;
+} stubGpu;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Simulated GPUs
+static stubGpu gpus[STUB_GPUS];
+
+// Result of the next reads
+static int readResult;
+
+// Connection state
+static int initialized;
+static int connected;
+
+// Watched fields and update interval (in microseconds)
+static unsigned short fields[STUB_FIELDS];
+static int fieldCount;
+static long long updateInterval;
+
+/***** ***** ***** ***** ***** CONTROL ***** ***** ***** ***** *****/
+
+void stub_dcgm_set_gpu(unsigned int entity, const char *uuid, long long temperature, double activity, long long time) {
+  // Store the values of the GPU
+  snprintf(gpus[entity].uuid, sizeof(gpus[entity].uuid), "%s", uuid);
+  gpus[entity].temperature = temperature;
+  gpus[entity].activity = activity;
+  gpus[entity].time = time;
+}
+
+void stub_dcgm_set_result(int result) {
+  // Make the next reads fail or succeed
+  readResult = result;
+}
+
+int stub_dcgm_connected(void) {
+  return initialized && connected;
+}
+
+long long stub_dcgm_interval(void) {
+  return updateInterval;
+}
+
+int stub_dcgm_watches(unsigned short fieldId) {
+  // Check if the field is watched
+  for (int i = 0; i < fieldCount; i++) {
+    if (fields[i] == fieldId) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/***** ***** ***** ***** ***** LIBRARY ***** ***** ***** ***** *****/
+
+int dcgmInit(void) {
+  initialized = 1;
+  return 0;
+}
+
+int dcgmShutdown(void) {
+  initialized = 0;
+  return 0;
+}
+
+int dcgmConnect(const char *host, uintptr_t *handle) {
+  // Refuse the unreachable host
+  if (strcmp(host, STUB_UNREACHABLE) == 0) {
+    return -3;
+  }
+
+  connected = 1;
+  *handle = 1;
+  return 0;
+}
+
+int dcgmDisconnect(uintptr_t handle) {
+  (void) handle;
+  connected = 0;
+  return 0;
+}
+
+int dcgmFieldGroupCreate(uintptr_t handle, int count, unsigned short *ids, const char *name, uintptr_t *group) {
+  (void) handle;
+  (void) name;
+
+  // Remember the fields
+  fieldCount = count < STUB_FIELDS ? count : STUB_FIELDS;
+  memcpy(fields, ids, fieldCount * sizeof(fields[0]));
+
+  *group = 2;
+  return 0;
+}
+
+int dcgmFieldGroupDestroy(uintptr_t handle, uintptr_t group) {
+  (void) handle;
+  (void) group;
+
+  fieldCount = 0;
+  return 0;
+}
+
+int dcgmWatchFields(uintptr_t handle, uintptr_t gpus, uintptr_t group, long long interval, double age, int samples) {
+  (void) handle;
+  (void) gpus;
+  (void) group;
+  (void) age;
+  (void) samples;
+
+  updateInterval = interval;
+  return 0;
+}
+
+int dcgmGetLatestValues_v2(uintptr_t handle, uintptr_t gpuGroup, uintptr_t group, enumeration_f callback, void *userData) {
+  (void) handle;
+  (void) gpuGroup;
+  (void) group;
+
+  // Fail the read if asked to
+  if (readResult != 0) {
+    return readResult;
+  }
+
+  // Enumerate the watched fields of each simulated GPU
+  for (unsigned int entity = 0; entity < STUB_GPUS; entity++) {
+    stubGpu *gpu = &gpus[entity];
+
+    if (gpu->uuid[0] == '\0') {
+      continue;
+    }
+
+    fieldValue values[STUB_FIELDS];
+    memset(values, 0, sizeof(values));
+
+    for (int i = 0; i < fieldCount; i++) {
+      fieldValue *value = &values[i];
+
+      value->fieldId = fields[i];
+      value->ts = gpu->time;
+
+      if (fields[i] == FI_DEV_UUID) {
+        value->fieldType = FT_STRING;
+        snprintf(value->value.str, sizeof(value->value.str), "%s", gpu->uuid);
+      } else if (fields[i] == FI_DEV_GPU_TEMP) {
+        value->fieldType = FT_INT64;
+        value->value.i64 = gpu->temperature;
+      } else if (fields[i] == FI_DEV_GPU_UTIL) {
+        value->fieldType = FT_INT64;
+        value->value.i64 = (int64_t) gpu->activity;
+      } else {
+        value->fieldType = FT_DOUBLE;
+        value->value.dbl = gpu->activity / 100;
+      }
+    }
+
+    callback(FE_GPU, entity, values, fieldCount, userData);
+  }
+
+  return 0;
+}
+
+const char * errorString(int result) {
+  return result == -3 ? "Connection refused" : "Stub error";
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/***** ***** ***** ***** ***** MACROS ***** ***** ***** ***** *****/
+
+// Macro to check a condition, printing and counting the failure without stopping the test
+#define CHECK(condition) do {                                                       \
+  /* Evaluate the condition */                                                      \
+  if (!(condition)) {                                                               \
+    /* Print the failed condition and count it */                                   \
+    fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);   \
+    failures++;                                                                     \
+  }                                                                                 \
+} while (0)
+
+// Macro to end a test, its exit code tells ctest whether every check passed
+#define TEST_RESULT() (failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE)
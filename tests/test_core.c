@@ -0,0 +1,168 @@
+/*
+ * Test of the decisions of the core on mock GPUs, as taken by the daemon every iteration.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "pstated.h"
+#include "test.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Number of idle iterations before switching
+#define ITERATIONS 2
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Number of failed checks
+static unsigned int failures;
+
+// Answer of the idle predictor, and the number of times it was asked
+static int prediction;
+static unsigned int predictions;
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static int predict(void * user, unsigned int gpu) {
+  // Count the question and give the prepared answer
+  (void) user;
+  (void) gpu;
+
+  predictions++;
+  return prediction;
+}
+
+static unsigned int step(pstated_context * core, pstated_snapshot snapshot, int reason) {
+  // Take a step, apply the decision as the daemon does and check its reason
+  unsigned int pstate = 0, current, iterations;
+
+  CHECK(pstated_step(core, 0, &snapshot, &pstate) == PSTATED_OK);
+  CHECK(pstated_step_reason(core, 0) == reason);
+  CHECK(pstated_state(core, 0, &current, &iterations) == PSTATED_OK);
+
+  if (pstate != current) {
+    CHECK(pstated_apply(core, 0, pstate) == PSTATED_OK);
+  }
+
+  return pstate;
+}
+
+static void test_base(pstated_context * core) {
+  // Snapshots of a busy, an idle and a hot GPU
+  pstated_snapshot busy = { .size = sizeof(busy), .temperature = 50, .utilization = 30 };
+  pstated_snapshot idle = { .size = sizeof(idle), .temperature = 50 };
+  pstated_snapshot hot = { .size = sizeof(hot), .temperature = 90, .utilization = 30 };
+
+  // The GPU ramps as soon as it is busy, and switches after the idle iterations
+  CHECK(step(core, busy, PSTATED_REASON_BUSY) == 16);
+
+  for (unsigned int i = 0; i <= ITERATIONS; i++) {
+    CHECK(step(core, idle, PSTATED_REASON_WAIT) == 16);
+  }
+
+  CHECK(step(core, idle, PSTATED_REASON_IDLE) == 8);
+  CHECK(step(core, idle, PSTATED_REASON_IDLE) == 8);
+
+  // Announced work keeps the GPU in high performance state without utilization
+  idle.demand = 1;
+  CHECK(step(core, idle, PSTATED_REASON_BUSY) == 16);
+  idle.demand = 0;
+
+  // Above the threshold, the GPU is cut unless the caller cools it
+  CHECK(step(core, hot, PSTATED_REASON_TEMPERATURE) == 8);
+
+  hot.cooled = 1;
+  CHECK(step(core, hot, PSTATED_REASON_BUSY) == 16);
+
+  // A caller built against 1.0 doesn't know the new fields, they count as zero
+  idle.demand = 1;
+  idle.size = offsetof(pstated_snapshot, demand);
+
+  for (unsigned int i = 0; i <= ITERATIONS; i++) {
+    CHECK(step(core, idle, PSTATED_REASON_WAIT) == 16);
+  }
+
+  CHECK(step(core, idle, PSTATED_REASON_IDLE) == 8);
+}
+
+static void test_predictor(pstated_context * core) {
+  // Let the predictor decide the switch
+  pstated_policy policy = { .size = sizeof(policy) };
+
+  pstated_policy_default(&policy);
+  policy.iterationsBeforeSwitch = ITERATIONS;
+  policy.predictIdle = predict;
+
+  CHECK(policy.predictIdle != NULL);
+  CHECK(pstated_policy_set(core, 0, &policy) == PSTATED_OK);
+
+  pstated_snapshot busy = { .size = sizeof(busy), .utilization = 30 };
+  pstated_snapshot idle = { .size = sizeof(idle) };
+
+  // The predictor switches the GPU as soon as it foresees a saving
+  CHECK(step(core, busy, PSTATED_REASON_BUSY) == 16);
+
+  for (unsigned int i = 0; i < ITERATIONS; i++) {
+    CHECK(step(core, idle, PSTATED_REASON_WAIT) == 16);
+  }
+
+  prediction = 1;
+  CHECK(step(core, idle, PSTATED_REASON_MODEL) == 8);
+  CHECK(predictions == ITERATIONS + 1);
+
+  // A predictor that never foresees a saving doesn't pin the GPU high past the idle iterations
+  prediction = 0;
+  predictions = 0;
+
+  CHECK(step(core, busy, PSTATED_REASON_BUSY) == 16);
+
+  for (unsigned int i = 0; i <= ITERATIONS; i++) {
+    CHECK(step(core, idle, PSTATED_REASON_WAIT) == 16);
+  }
+
+  CHECK(step(core, idle, PSTATED_REASON_IDLE) == 8);
+  CHECK(predictions == ITERATIONS + 1);
+
+  // An idle hint ends the wait once the idle iterations are reached, whatever the predictor says
+  idle.idleHint = 1;
+
+  CHECK(step(core, busy, PSTATED_REASON_BUSY) == 16);
+
+  for (unsigned int i = 0; i <= ITERATIONS; i++) {
+    CHECK(step(core, idle, PSTATED_REASON_WAIT) == 16);
+  }
+
+  CHECK(step(core, idle, PSTATED_REASON_HINT) == 8);
+
+  // Skipped idle iterations are recorded without touching the GPU
+  unsigned int pstate, iterations;
+
+  CHECK(pstated_adopt(core, 0, 16, ITERATIONS + 1) == PSTATED_OK);
+  CHECK(pstated_state(core, 0, &pstate, &iterations) == PSTATED_OK);
+  CHECK(pstate == 16 && iterations == ITERATIONS + 1);
+  CHECK(step(core, idle, PSTATED_REASON_HINT) == 8);
+
+  CHECK(pstated_adopt(core, 0, 17, 0) == PSTATED_ERROR_INVALID_ARGUMENT);
+  CHECK(pstated_step_reason(core, 1) == PSTATED_ERROR_INVALID_ARGUMENT);
+}
+
+int main(void) {
+  // Open a mock GPU with a short idle wait
+  pstated_context * core;
+  CHECK(pstated_open_mock(PSTATED_API_VERSION_MAJOR, 1, &core) == PSTATED_OK);
+  CHECK(pstated_step_reason(core, 0) == PSTATED_REASON_NONE);
+
+  pstated_policy policy = { .size = sizeof(policy) };
+
+  pstated_policy_default(&policy);
+  policy.iterationsBeforeSwitch = ITERATIONS;
+  CHECK(pstated_policy_set(core, 0, &policy) == PSTATED_OK);
+
+  test_base(core);
+  test_predictor(core);
+
+  CHECK(pstated_close(core) == PSTATED_OK);
+
+  return TEST_RESULT();
+}
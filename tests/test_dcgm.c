@@ -0,0 +1,142 @@
+/*
+ * Test of the DCGM telemetry backend against a stub of the DCGM library, loaded through the same dlopen path as
+ * libdcgm.so.
+ */
+
+#include <dlfcn.h>
+#include <math.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "dcgm.h"
+#include "test.h"
+
+/***** ***** ***** ***** ***** TYPES ***** ***** ***** ***** *****/
+
+typedef void (*setGpu_t)(unsigned int, const char *, long long, double, long long);
+typedef void (*setResult_t)(int);
+typedef int (*connected_t)(void);
+typedef long long (*interval_t)(void);
+typedef int (*watches_t)(unsigned short);
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Number of failed checks
+static unsigned int failures;
+
+// Control functions of the stub
+static setGpu_t setGpu;
+static setResult_t setResult;
+static connected_t connected;
+static interval_t watchInterval;
+static watches_t watches;
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static long long now_us(void) {
+  // Get the wall clock time, as DCGM timestamps
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void test_open(void) {
+  // A missing library is reported
+  dcgmConfig missing = { "/nonexistent/libdcgm.so", "localhost", DCGM_ACTIVITY_UTIL, 100 };
+  CHECK(!dcgm_open(&missing));
+
+  // An unreachable host engine is reported and unloads the library
+  dcgmConfig unreachable = { DCGM_STUB_PATH, "unreachable", DCGM_ACTIVITY_UTIL, 100 };
+  CHECK(!dcgm_open(&unreachable));
+  CHECK(!connected());
+}
+
+static void test_values(void) {
+  // Connect with the SM activity, the update interval is raised to the minimum
+  dcgmConfig config = { DCGM_STUB_PATH, "localhost", DCGM_ACTIVITY_SM, 20 };
+
+  CHECK(dcgm_open(&config));
+  CHECK(connected());
+  CHECK(watchInterval() == DCGM_MIN_INTERVAL * 1000LL);
+  CHECK(watches(1002));
+
+  // DCGM numbers the GPUs differently than NVML, they are matched by UUID
+  setGpu(0, "GPU-b", 45, 10, now_us());
+  setGpu(1, "GPU-a", 71, 42.5, now_us());
+
+  CHECK(dcgm_update());
+
+  dcgmSample sample;
+
+  CHECK(dcgm_sample("GPU-a", &sample));
+  CHECK(sample.hasTemperature && sample.temperature == 71);
+  CHECK(sample.hasActivity && fabs(sample.activity - 42.5) < 1e-9);
+
+  CHECK(dcgm_sample("GPU-b", &sample));
+  CHECK(sample.hasTemperature && sample.temperature == 45);
+
+  // GPUs unknown to the host engine fall back to NVML
+  CHECK(!dcgm_sample("GPU-c", &sample));
+  CHECK(!sample.hasTemperature && !sample.hasActivity);
+
+  // Values the host engine stopped updating are stale after a few intervals
+  long long stale = now_us() - (long long) DCGM_MIN_INTERVAL * DCGM_STALE_INTERVALS * 1000 - 1000000;
+  setGpu(1, "GPU-a", 72, 50, stale);
+
+  CHECK(dcgm_update());
+  CHECK(dcgm_sample("GPU-a", &sample));
+  CHECK(!sample.hasTemperature && !sample.hasActivity);
+
+  // Blank values don't replace the last known ones
+  setGpu(1, "GPU-a", 0x7ffffff0LL, 30, now_us());
+
+  CHECK(dcgm_update());
+  CHECK(dcgm_sample("GPU-a", &sample));
+  CHECK(!sample.hasTemperature);
+  CHECK(sample.hasActivity && fabs(sample.activity - 30) < 1e-9);
+
+  // Failed reads are counted and keep the previous values
+  unsigned long errors = dcgm_errors();
+  setResult(-1);
+
+  CHECK(!dcgm_update());
+  CHECK(!dcgm_update());
+  CHECK(dcgm_errors() == errors + 2);
+
+  setResult(0);
+  CHECK(dcgm_update());
+
+  // Closing disconnects from the host engine
+  dcgm_close();
+  CHECK(!connected());
+  CHECK(!dcgm_update());
+}
+
+int main(void) {
+  // Load the stub to reach its control functions, the backend shares it through dlopen
+  void *stub = dlopen(DCGM_STUB_PATH, RTLD_NOW);
+
+  if (stub == NULL) {
+    fprintf(stderr, "Unable to load the DCGM stub: %s\n", dlerror());
+    return EXIT_FAILURE;
+  }
+
+  setGpu = (setGpu_t) dlsym(stub, "stub_dcgm_set_gpu");
+  setResult = (setResult_t) dlsym(stub, "stub_dcgm_set_result");
+  connected = (connected_t) dlsym(stub, "stub_dcgm_connected");
+  watchInterval = (interval_t) dlsym(stub, "stub_dcgm_interval");
+  watches = (watches_t) dlsym(stub, "stub_dcgm_watches");
+
+  if (!setGpu || !setResult || !connected || !watchInterval || !watches) {
+    fprintf(stderr, "Unable to find the DCGM stub functions\n");
+    return EXIT_FAILURE;
+  }
+
+  test_open();
+  test_values();
+
+  dlclose(stub);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,197 @@
+/*
+ * Test of the upgrade handoff on mock GPUs: the test hands its GPUs over to a new copy of itself, which checks that the
+ * state and the ownership locks came through the exec, and that the GPUs are taken over without being written to.
+ */
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "handoff.h"
+#include "ownership.h"
+#include "pstated.h"
+#include "test.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Number of mock GPUs, the first one is locked
+#define GPUS 2
+
+// Path of a binary that doesn't exist
+#define MISSING_PATH "/nonexistent/nvidia-pstated"
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Number of failed checks
+static unsigned int failures;
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static bool lock_free(const char *uuid) {
+  // Build the path of the lock file
+  char path[OWNERSHIP_NAME_MAX];
+  snprintf(path, sizeof(path), "%s/%s.lock", OWNERSHIP_LOCK_DIR, uuid);
+
+  // Try to take the lock as another daemon would, closing the file drops it again
+  int fd = open(path, O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    return true;
+  }
+
+  bool free = flock(fd, LOCK_EX | LOCK_NB) == 0;
+  close(fd);
+
+  return free;
+}
+
+static int hand_over(const char *self) {
+  // Mock GPUs, their UUIDs match the records across the exec
+  pstated_context * core;
+  char uuids[GPUS][HANDOFF_UUID_MAX];
+  ownershipLock locks[GPUS] = { 0 };
+
+  CHECK(pstated_open_mock(PSTATED_API_VERSION_MAJOR, GPUS, &core) == PSTATED_OK);
+
+  for (unsigned int i = 0; i < GPUS; i++) {
+    CHECK(pstated_gpu_uuid(core, i, uuids[i], sizeof(uuids[i])) == PSTATED_OK);
+  }
+
+  // Lock the first GPU and put it in the low performance state
+  unsigned long applies;
+
+  CHECK(ownership_acquire(&locks[0], uuids[0]));
+  CHECK(pstated_apply(core, 0, 8) == PSTATED_OK);
+  CHECK(pstated_apply_count(core, 0, &applies) == PSTATED_OK);
+  CHECK(applies == 1);
+
+  // Record the state of the GPUs, keeping the lock open across exec
+  handoffRecord records[GPUS] = { 0 };
+
+  for (unsigned int i = 0; i < GPUS; i++) {
+    snprintf(records[i].uuid, sizeof(records[i].uuid), "%s", uuids[i]);
+    records[i].pstateId = i == 0 ? 8 : 16;
+    records[i].iterations = 40 + i;
+    records[i].lockFd = ownership_inherit(&locks[i]);
+  }
+
+  CHECK(records[0].lockFd >= 0 && locks[0].inherited);
+  CHECK(records[1].lockFd == -1);
+  CHECK(!lock_free(uuids[0]));
+
+  // A missing binary is caught before committing to the handoff
+  CHECK(!handoff_check(MISSING_PATH));
+  CHECK(handoff_check(self));
+
+  // A failed exec returns with the locks still held, so that the GPUs can be restored
+  int fd = handoff_save(records, GPUS);
+  CHECK(fd >= 0);
+
+  char * missing[] = { MISSING_PATH, NULL };
+
+  CHECK(!handoff_exec(MISSING_PATH, missing, fd));
+  CHECK(getenv(HANDOFF_ENV) == NULL);
+  CHECK(fcntl(fd, F_GETFD) == -1);
+  CHECK(!lock_free(uuids[0]));
+
+  // Hand the GPUs over to a new copy of the test
+  fd = handoff_save(records, GPUS);
+  CHECK(fd >= 0);
+  CHECK(pstated_close(core) == PSTATED_OK);
+
+  if (failures > 0) {
+    return EXIT_FAILURE;
+  }
+
+  char * arguments[] = { (char *) self, "take-over", NULL };
+  handoff_exec(self, arguments, fd);
+
+  // The exec only returns on failure
+  fprintf(stderr, "Unable to execute %s\n", self);
+  return EXIT_FAILURE;
+}
+
+static int take_over(void) {
+  // Load the records handed over
+  handoffRecord records[GPUS + 1];
+  unsigned int count = handoff_load(records, GPUS + 1);
+
+  CHECK(count == GPUS);
+  CHECK(getenv(HANDOFF_ENV) == NULL);
+
+  // Match the records to the mock GPUs
+  pstated_context * core;
+  ownershipLock locks[GPUS] = { 0 };
+
+  CHECK(pstated_open_mock(PSTATED_API_VERSION_MAJOR, GPUS, &core) == PSTATED_OK);
+
+  for (unsigned int i = 0; i < GPUS; i++) {
+    // Find the record of the GPU
+    char uuid[HANDOFF_UUID_MAX];
+    CHECK(pstated_gpu_uuid(core, i, uuid, sizeof(uuid)) == PSTATED_OK);
+
+    handoffRecord * record = handoff_find(records, count, uuid);
+    CHECK(record != NULL);
+
+    if (record == NULL) {
+      continue;
+    }
+
+    // The state came through
+    CHECK(record->pstateId == (i == 0 ? 8u : 16u));
+    CHECK(record->iterations == 40 + i);
+
+    // Adopt the lock of the first GPU, which was held throughout the exec, the second GPU was not locked
+    if (i == 0) {
+      CHECK(ownership_adopt(&locks[i], record->lockFd));
+      CHECK(!lock_free(uuid));
+      CHECK((fcntl(locks[i].fd, F_GETFD) & FD_CLOEXEC) != 0);
+      record->lockFd = -1;
+    } else {
+      CHECK(record->lockFd == -1);
+      CHECK(!ownership_adopt(&locks[i], record->lockFd));
+    }
+
+    // Take the performance state over as the daemon does, without touching the GPU
+    unsigned int pstate, iterations;
+    unsigned long applies;
+
+    CHECK(pstated_adopt(core, i, record->pstateId, record->iterations) == PSTATED_OK);
+    CHECK(pstated_state(core, i, &pstate, &iterations) == PSTATED_OK);
+    CHECK(pstate == record->pstateId && iterations == record->iterations);
+    CHECK(pstated_apply_count(core, i, &applies) == PSTATED_OK);
+    CHECK(applies == 0);
+  }
+
+  // Close the locks that were not adopted
+  handoff_close_locks(records, count);
+
+  // Releasing the adopted lock lets another daemon take the GPU
+  char uuid[HANDOFF_UUID_MAX];
+  CHECK(pstated_gpu_uuid(core, 0, uuid, sizeof(uuid)) == PSTATED_OK);
+
+  ownership_release(&locks[0]);
+  CHECK(lock_free(uuid));
+
+  CHECK(pstated_close(core) == PSTATED_OK);
+
+  return TEST_RESULT();
+}
+
+int main(int argc, char * argv[]) {
+  // Take the GPUs over in the new copy of the test
+  if (argc > 1 && strcmp(argv[1], "take-over") == 0) {
+    return take_over();
+  }
+
+  // Resolve the path of the test, as the daemon does for itself
+  char self[4096];
+
+  if (!handoff_resolve_self(self, sizeof(self))) {
+    fprintf(stderr, "Unable to resolve the path of the test\n");
+    return EXIT_FAILURE;
+  }
+
+  return hand_over(self);
+}
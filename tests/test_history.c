@@ -0,0 +1,122 @@
+/*
+ * Test of the history store: queries over recorded samples, and expiry by whole segment files.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "history.h"
+#include "test.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Time (in seconds) of the first sample, 2026-01-01 00:00 UTC
+#define START 1767225600ULL
+
+// Interval (in seconds) between samples
+#define STEP 10
+
+// Length (in seconds) of a day, the segment span of the 1 second tier
+#define DAY 86400ULL
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Number of failed checks
+static unsigned int failures;
+
+// Temporary directory of the files
+static char dir[] = "/tmp/test-history-XXXXXX";
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static long long segment_size(unsigned long long day) {
+  // Build the path of the 1 second tier segment of a day
+  char path[HISTORY_PATH_MAX];
+  snprintf(path, sizeof(path), "%s/gpu0-1s-%llu.hist", dir, START / DAY + day);
+
+  // Get the size of the file, -1 if it doesn't exist
+  struct stat info;
+  return stat(path, &info) == 0 ? (long long) info.st_size : -1;
+}
+
+static void append_days(historySeries *series, unsigned long long from, unsigned long long to) {
+  // Record a constant temperature and a utilization alternating between 25 and 75 percent
+  for (unsigned long long time = START + from * DAY; time < START + to * DAY; time += STEP) {
+    double values[HISTORY_METRIC_COUNT] = {
+      [HISTORY_TEMPERATURE] = 50,
+      [HISTORY_UTILIZATION] = (time / STEP) % 2 == 0 ? 25 : 75,
+    };
+
+    history_append(series, time, values);
+  }
+}
+
+static void test_query(unsigned long long end) {
+  // Variable to hold the result of a query
+  historySummary summary;
+
+  // The last hour comes from the 1 second tier, one point per sample
+  CHECK(history_query(dir, 0, HISTORY_UTILIZATION, end - 3600, end, &summary));
+  CHECK(summary.tier == HISTORY_TIER_SECOND);
+  CHECK(summary.points >= 3600 / STEP - 1 && summary.points <= 3600 / STEP + 1);
+  CHECK(summary.min == 25 && summary.max == 75);
+  CHECK(summary.p95 == 75);
+
+  // A month comes from the 1 minute tier, averaged over the samples of each minute
+  CHECK(history_query(dir, 0, HISTORY_TEMPERATURE, end - 30 * DAY, end, &summary));
+  CHECK(summary.tier == HISTORY_TIER_MINUTE);
+  CHECK(summary.points > 0);
+  CHECK(summary.avg == 50 && summary.min == 50 && summary.max == 50);
+
+  // Another GPU has no history
+  CHECK(!history_query(dir, 1, HISTORY_TEMPERATURE, end - 3600, end, &summary));
+}
+
+static void test_expiry(void) {
+  // Series of GPU 0
+  historySeries series;
+
+  CHECK(history_open(&series, dir, 0));
+
+  // Record 9 days, the first ones fall out of the 7 day retention of the 1 second tier
+  append_days(&series, 0, 9);
+
+  // Whole segments older than the retention are removed, the later ones kept
+  CHECK(segment_size(0) == -1);
+  CHECK(segment_size(1) > 0);
+  CHECK(segment_size(8) > 0);
+
+  // Recording another day removes one more segment and leaves the retained ones untouched
+  long long size = segment_size(5);
+
+  append_days(&series, 9, 10);
+
+  CHECK(segment_size(1) == -1);
+  CHECK(segment_size(2) > 0);
+  CHECK(segment_size(5) == size);
+
+  // Write the partial blocks and query the files
+  history_close(&series);
+  test_query(START + 10 * DAY - STEP);
+}
+
+int main(void) {
+  // Record into a temporary directory
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+
+  test_expiry();
+
+  // Remove the files, up to the current segments created when the series was opened, and the directory
+  unsigned long long now = (unsigned long long) time(NULL);
+
+  history_remove(dir, 0, START, now > START + 11 * DAY ? now : START + 11 * DAY);
+  CHECK(rmdir(dir) == 0);
+
+  return TEST_RESULT();
+}
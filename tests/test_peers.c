@@ -0,0 +1,221 @@
+/*
+ * Test of the peer group with two daemons on loopback: each daemon is a child process that joins a shared directory of
+ * Unix sockets, and the GPUs of a job are found from the environment of its processes.
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "peers.h"
+#include "procs.h"
+#include "test.h"
+#include "utils.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Job of the two daemons, and of a daemon of another job on the same group
+#define JOB "4242"
+#define OTHER_JOB "1717"
+
+// Time (in milliseconds) to wait for an announcement
+#define RECEIVE_TIMEOUT 2000
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Number of failed checks
+static unsigned int failures;
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static bool receive(char *peer, size_t size) {
+  // Poll for an announcement until the timeout
+  unsigned long long start = get_time_ms();
+
+  while (get_time_ms() - start < RECEIVE_TIMEOUT) {
+    if (peers_receive(peer, size)) {
+      return true;
+    }
+
+    usleep(10000);
+  }
+
+  return false;
+}
+
+static pid_t start_daemon(const char *dir, const char *job, int ready[2], int go[2]) {
+  // Start a daemon in a child process, the peer group keeps its state in the process
+  pid_t pid = fork();
+
+  if (pid != 0) {
+    return pid;
+  }
+
+  // Join the group and tell the test
+  bool joined = peers_open(dir, job);
+
+  if (write(ready[1], &joined, sizeof(joined)) != sizeof(joined) || !joined) {
+    _exit(EXIT_FAILURE);
+  }
+
+  // Wait for the test to ramp, then answer with a ramp of this daemon
+  char buffer;
+  char peer[PEERS_NAME_MAX];
+  bool received = strcmp(job, JOB) == 0 ? receive(peer, sizeof(peer)) : true;
+
+  if (read(go[0], &buffer, 1) != 1 || !peers_announce()) {
+    _exit(EXIT_FAILURE);
+  }
+
+  // Leave the group
+  peers_close();
+
+  _exit(received ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+static bool finished(pid_t pid) {
+  // Wait for the daemon and check its exit status
+  int status;
+
+  return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+static void test_loopback(void) {
+  // Shared directory of the group
+  char dir[] = "/tmp/pstated-peers-XXXXXX";
+  CHECK(mkdtemp(dir) != NULL);
+
+  // Start a peer of the same job and a daemon of another job
+  int ready[2], go[2];
+  CHECK(pipe(ready) == 0 && pipe(go) == 0);
+
+  pid_t peer = start_daemon(dir, JOB, ready, go);
+  pid_t other = start_daemon(dir, OTHER_JOB, ready, go);
+
+  // Join the group once both daemons did, so that they receive the announcement
+  bool joined[2] = { false, false };
+
+  CHECK(read(ready[0], &joined[0], sizeof(bool)) == sizeof(bool) && joined[0]);
+  CHECK(read(ready[0], &joined[1], sizeof(bool)) == sizeof(bool) && joined[1]);
+  CHECK(peers_open(dir, JOB));
+
+  // Announce a ramp, a second ramp within the interval is not announced
+  CHECK(peers_announce());
+  CHECK(!peers_announce());
+  CHECK(peers_sent() == 1);
+
+  // Let the daemons ramp in turn, only the peer of the same job is followed
+  CHECK(write(go[1], "gg", 2) == 2);
+
+  char name[PEERS_NAME_MAX];
+  char expected[PEERS_NAME_MAX];
+  char host[64] = "localhost";
+
+  gethostname(host, sizeof(host) - 1);
+  snprintf(expected, sizeof(expected), "%s:%ld", host, (long) peer);
+
+  CHECK(receive(name, sizeof(name)));
+  CHECK(strcmp(name, expected) == 0);
+  CHECK(finished(peer));
+  CHECK(finished(other));
+
+  // The announcement of the other job and the own announcement are skipped
+  CHECK(!receive(name, sizeof(name)));
+  CHECK(peers_received() == 1);
+
+  // Leave the group, which removes the socket and the directory
+  peers_close();
+  CHECK(rmdir(dir) == 0);
+
+  close(ready[0]);
+  close(ready[1]);
+  close(go[0]);
+  close(go[1]);
+}
+
+static void test_job(void) {
+  // Start a process of the job, the pipe closes on exec so that its environment is read after it was replaced
+  int started[2];
+  CHECK(pipe(started) == 0);
+  CHECK(fcntl(started[1], F_SETFD, FD_CLOEXEC) == 0);
+
+  pid_t pid = fork();
+
+  if (pid == 0) {
+    char * arguments[] = { "sleep", "10", NULL };
+    char * environment[] = { "PATH=/usr/bin:/bin", "SLURM_JOB_ID=" JOB, NULL };
+
+    execve("/bin/sleep", arguments, environment);
+    _exit(EXIT_FAILURE);
+  }
+
+  char buffer;
+  close(started[1]);
+  CHECK(read(started[0], &buffer, 1) == 0);
+  close(started[0]);
+
+  // The job of the process is read from its environment
+  char job[PROCESS_JOB_MAX];
+  process_read_job(pid, "", job, sizeof(job));
+  CHECK(strcmp(job, JOB) == 0);
+
+  // Without a readable environment, the job is read from the Slurm cgroup
+  process_read_job(0, "/system.slice/slurmstepd.scope/job_" OTHER_JOB "/step_0/user/task_0", job, sizeof(job));
+  CHECK(strcmp(job, OTHER_JOB) == 0);
+
+  process_read_job(0, "/user.slice/user-1000.slice", job, sizeof(job));
+  CHECK(job[0] == '\0');
+
+  // Only the GPU running the process hosts the job, and any GPU running processes without a job ID
+  processTable gpus[2];
+  memset(gpus, 0, sizeof(gpus));
+
+  CHECK(process_table_touch(&gpus[0], pid, get_time_ms()) != NULL);
+
+  CHECK(process_table_runs_job(&gpus[0], JOB));
+  CHECK(!process_table_runs_job(&gpus[0], OTHER_JOB));
+  CHECK(!process_table_runs_job(&gpus[1], JOB));
+  CHECK(process_table_runs_job(&gpus[0], NULL));
+  CHECK(!process_table_runs_job(&gpus[1], NULL));
+
+  // Only a ramp of the GPU running the job is announced
+  char dir[] = "/tmp/pstated-peers-XXXXXX";
+  CHECK(mkdtemp(dir) != NULL);
+  CHECK(peers_open(dir, JOB));
+
+  unsigned long sent = peers_sent();
+
+  CHECK(!peers_announce_ramp(&gpus[1]));
+  CHECK(peers_sent() == sent);
+  CHECK(peers_announce_ramp(&gpus[0]));
+  CHECK(peers_sent() == sent + 1);
+
+  peers_close();
+
+  // Without a job ID, any GPU running processes hosts the job, and none of another job
+  CHECK(peers_open(dir, PEERS_JOB_DEFAULT));
+  CHECK(peers_hosts_job(&gpus[0]));
+  CHECK(!peers_hosts_job(&gpus[1]));
+  peers_close();
+
+  CHECK(peers_open(dir, OTHER_JOB));
+  CHECK(!peers_hosts_job(&gpus[0]));
+  peers_close();
+
+  CHECK(!peers_hosts_job(&gpus[0]));
+  CHECK(rmdir(dir) == 0);
+
+  // Stop the process
+  kill(pid, SIGKILL);
+  waitpid(pid, NULL, 0);
+}
+
+int main(void) {
+  test_loopback();
+  test_job();
+
+  return TEST_RESULT();
+}
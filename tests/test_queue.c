@@ -0,0 +1,245 @@
+/*
+ * Test of the queue-depth scraper against a stub metrics endpoint on the loopback interface.
+ */
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "queue.h"
+#include "test.h"
+#include "utils.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Name of the gauge served by the stub
+#define METRIC "vllm:num_requests_waiting"
+
+// Time (in milliseconds) to wait for the scraper to see a change
+#define WAIT_TIMEOUT 3000
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Number of failed checks
+static unsigned int failures;
+
+// Listening socket of the stub and its run flag
+static int listener = -1;
+static volatile bool serving;
+
+// Status line and body served by the stub
+static const char * volatile status = "200 OK";
+static const char * volatile body = "";
+
+// Number of requests served
+static volatile unsigned int requests;
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static void * serve(void *argument) {
+  (void) argument;
+
+  // Answer requests until the test is over
+  while (serving) {
+    // Wait for a connection, waking up now and then to check the run flag
+    struct pollfd entry = { .fd = listener, .events = POLLIN };
+
+    if (poll(&entry, 1, 50) <= 0) {
+      continue;
+    }
+
+    int client = accept(listener, NULL, NULL);
+    if (client < 0) {
+      continue;
+    }
+
+    // Read the request up to the end of its headers
+    char request[2048];
+    size_t used = 0;
+
+    while (used + 1 < sizeof(request)) {
+      ssize_t received = recv(client, request + used, sizeof(request) - used - 1, 0);
+
+      if (received <= 0) {
+        break;
+      }
+
+      used += received;
+      request[used] = '\0';
+
+      if (strstr(request, "\r\n\r\n") != NULL) {
+        break;
+      }
+    }
+
+    // Answer as a plain HTTP/1.0 server and close the connection
+    char response[4096];
+    int length = snprintf(response, sizeof(response), "HTTP/1.0 %s\r\nContent-Type: text/plain\r\n\r\n%s", status, body);
+
+    send(client, response, length, MSG_NOSIGNAL);
+    close(client);
+
+    requests++;
+  }
+
+  return NULL;
+}
+
+static bool wait_for_requests(unsigned int count) {
+  // Wait until the stub served the given number of requests
+  unsigned long long start = get_time_ms();
+
+  while (requests < count) {
+    if (get_time_ms() - start > WAIT_TIMEOUT) {
+      return false;
+    }
+
+    usleep(5000);
+  }
+
+  return true;
+}
+
+static bool wait_for_depth(unsigned int gpu, double depth) {
+  // Wait until the scraper publishes the depth
+  unsigned long long start = get_time_ms();
+  double depths[QUEUE_MAX_GPUS];
+
+  while (!queue_snapshot(depths) || depths[gpu] != depth) {
+    if (get_time_ms() - start > WAIT_TIMEOUT) {
+      return false;
+    }
+
+    usleep(5000);
+  }
+
+  return true;
+}
+
+static void test_parse(void) {
+  // Depths of all GPUs
+  double depths[QUEUE_MAX_GPUS];
+
+  // Series are assigned by their GPU label, and series of the same GPU add up
+  CHECK(queue_parse(
+    "# TYPE " METRIC " gauge\n"
+    METRIC "{model=\"a\",gpu=\"0\"} 3\n"
+    METRIC "{model=\"b\",gpu=\"0\"} 2\n"
+    METRIC "{gpu=\"2\",model=\"a\"} 7.5\n"
+    "other_metric{gpu=\"1\"} 9\n",
+    METRIC, "gpu", depths));
+  CHECK(depths[0] == 5);
+  CHECK(depths[1] == 0);
+  CHECK(depths[2] == 7.5);
+
+  // A series without the GPU label applies to all GPUs
+  CHECK(queue_parse(METRIC " 4\n", METRIC, "gpu", depths));
+  CHECK(depths[0] == 4 && depths[QUEUE_MAX_GPUS - 1] == 4);
+
+  // A label that only ends with the name of the GPU label doesn't count as it
+  CHECK(queue_parse(METRIC "{xgpu=\"1\"} 6\n", METRIC, "gpu", depths));
+  CHECK(depths[0] == 6 && depths[1] == 6);
+
+  // A GPU label that isn't an index is skipped instead of counting for all GPUs
+  CHECK(queue_parse(
+    METRIC "{gpu=\"GPU-8f3a2c1e-1d2b-4c3d-9e8f-0a1b2c3d4e5f\"} 7\n"
+    METRIC "{gpu=\"\"} 5\n"
+    METRIC "{gpu=\"1\"} 2\n",
+    METRIC, "gpu", depths));
+  CHECK(depths[0] == 0 && depths[1] == 2 && depths[QUEUE_MAX_GPUS - 1] == 0);
+
+  // A metric whose name only starts with the gauge's name is another metric
+  CHECK(!queue_parse(METRIC "_total 4\n", METRIC, "gpu", depths));
+  CHECK(depths[0] == 0);
+}
+
+static void test_scrape(const char *url) {
+  // Scrape the stub often
+  queueConfig config = { .url = url, .metric = METRIC, .label = "gpu", .interval = 20 };
+
+  body = METRIC "{gpu=\"0\"} 3\n" METRIC "{gpu=\"1\"} 0\n";
+  status = "200 OK";
+
+  CHECK(queue_start(&config));
+
+  // The depths of the stub are published
+  CHECK(wait_for_depth(0, 3));
+
+  // A change shows on a later scrape
+  body = METRIC "{gpu=\"0\"} 0\n" METRIC "{gpu=\"1\"} 12\n";
+
+  CHECK(wait_for_depth(1, 12));
+
+  // A failing endpoint counts errors
+  unsigned long errors = queue_errors();
+  status = "503 Service Unavailable";
+
+  CHECK(wait_for_requests(requests + 3));
+  CHECK(queue_errors() > errors);
+
+  queue_stop();
+}
+
+static void test_stop(const char *url) {
+  // Scrape the stub once a minute
+  queueConfig config = { .url = url, .metric = METRIC, .label = "gpu", .interval = 60000 };
+
+  status = "200 OK";
+  body = METRIC " 1\n";
+
+  unsigned int served = requests;
+
+  CHECK(queue_start(&config));
+  CHECK(wait_for_requests(served + 1));
+
+  // Stopping wakes the scraper up instead of waiting for the next scrape
+  unsigned long long start = get_time_ms();
+
+  queue_stop();
+
+  CHECK(get_time_ms() - start < 500);
+}
+
+int main(void) {
+  // Parse the metrics format without a server
+  test_parse();
+
+  // Start the stub on an ephemeral loopback port
+  struct sockaddr_in address = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  socklen_t length = sizeof(address);
+
+  listener = socket(AF_INET, SOCK_STREAM, 0);
+
+  if (listener < 0 || bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(listener, 16) != 0 ||
+      getsockname(listener, (struct sockaddr *) &address, &length) != 0) {
+    perror("stub endpoint");
+    return EXIT_FAILURE;
+  }
+
+  pthread_t thread;
+  serving = true;
+
+  if (pthread_create(&thread, NULL, serve, NULL) != 0) {
+    fprintf(stderr, "Unable to start the stub endpoint\n");
+    return EXIT_FAILURE;
+  }
+
+  // URL of the stub
+  char url[64];
+  snprintf(url, sizeof(url), "http://127.0.0.1:%u/metrics", ntohs(address.sin_port));
+
+  // Scrape the stub and stop the scraper
+  test_scrape(url);
+  test_stop(url);
+
+  // Stop the stub
+  serving = false;
+  pthread_join(thread, NULL);
+  close(listener);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,205 @@
+/*
+ * Test of the schedule evaluation on fixed timestamps, across midnight, the end of the year and daylight saving time.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "schedule.h"
+#include "test.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Time zone of the test, US Eastern time written as a POSIX rule so that no time zone database is needed
+// (daylight saving time from 2026-03-08 02:00 to 2026-11-01 02:00)
+#define TIME_ZONE "EST5EDT,M3.2.0,M11.1.0"
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Number of failed checks
+static unsigned int failures;
+
+// Parsed rules of the current test
+static scheduleRule rules[SCHEDULE_MAX_RULES];
+static unsigned int ruleCount;
+
+// Storage of the rule specifications, the rules point into it
+static char specs[SCHEDULE_MAX_RULES][128];
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static void set_rules(const char * const * list, unsigned int count) {
+  // Parse the rules as --schedule does
+  ruleCount = 0;
+
+  for (unsigned int i = 0; i < count; i++) {
+    snprintf(specs[i], sizeof(specs[i]), "%s", list[i]);
+    CHECK(schedule_parse_rule(specs[i], i, &rules[i]));
+    ruleCount++;
+  }
+}
+
+static time_t utc(int year, int month, int day, int hour, int minute) {
+  // Build the timestamp of a UTC time
+  struct tm time = { 0 };
+
+  time.tm_year = year - 1900;
+  time.tm_mon = month - 1;
+  time.tm_mday = day;
+  time.tm_hour = hour;
+  time.tm_min = minute;
+
+  return timegm(&time);
+}
+
+static const char * active(time_t timestamp) {
+  // Convert the timestamp to local time as the daemon does
+  struct tm local;
+
+  if (!schedule_local_time(timestamp, &local)) {
+    return "error";
+  }
+
+  // Find the matching rule
+  int rule = schedule_match(rules, ruleCount, &local);
+
+  // Return the name of the rule, or "default" if no rule matches
+  return rule >= 0 ? rules[rule].name : "default";
+}
+
+static unsigned int count_minutes(time_t start, time_t end, const char *name) {
+  // Count the minutes the rule is active between the timestamps
+  unsigned int minutes = 0;
+
+  for (time_t now = start; now < end; now += 60) {
+    if (strcmp(active(now), name) == 0) {
+      minutes++;
+    }
+  }
+
+  return minutes;
+}
+
+static void test_week(void) {
+  // Office hours, nights across midnight, and weekends with Sunday written as 7
+  static const char * const list[] = {
+    "day@* 9-17 * * 1-5:ibs=10",
+    "night@* 22-23,0-5 * * *:ibs=300",
+    "weekend@* * * * 6,7:ibs=600"
+  };
+
+  set_rules(list, 3);
+
+  // Wednesday 2026-01-14, EST (UTC-5)
+  CHECK(strcmp(active(utc(2026, 1, 14, 15, 0)), "day") == 0);
+  CHECK(strcmp(active(utc(2026, 1, 14, 22, 59)), "day") == 0);
+  CHECK(strcmp(active(utc(2026, 1, 14, 23, 0)), "default") == 0);
+  CHECK(strcmp(active(utc(2026, 1, 15, 3, 0)), "night") == 0);
+
+  // The night continues past midnight into Thursday, then the plain parameters apply
+  CHECK(strcmp(active(utc(2026, 1, 15, 5, 15)), "night") == 0);
+  CHECK(strcmp(active(utc(2026, 1, 15, 10, 59)), "night") == 0);
+  CHECK(strcmp(active(utc(2026, 1, 15, 11, 0)), "default") == 0);
+
+  // Saturday and Sunday, the first matching rule wins at night
+  CHECK(strcmp(active(utc(2026, 1, 17, 17, 0)), "weekend") == 0);
+  CHECK(strcmp(active(utc(2026, 1, 18, 17, 0)), "weekend") == 0);
+  CHECK(strcmp(active(utc(2026, 1, 18, 4, 0)), "night") == 0);
+
+  // Monday morning
+  CHECK(strcmp(active(utc(2026, 1, 19, 13, 59)), "default") == 0);
+  CHECK(strcmp(active(utc(2026, 1, 19, 14, 0)), "day") == 0);
+
+  // Across the end of the year, from Thursday 2026-12-31 to Friday 2027-01-01
+  CHECK(strcmp(active(utc(2027, 1, 1, 4, 59)), "night") == 0);
+  CHECK(strcmp(active(utc(2027, 1, 1, 14, 0)), "day") == 0);
+
+  // In summer, office hours start an hour earlier in UTC (Wednesday 2026-07-01, EDT is UTC-4)
+  CHECK(strcmp(active(utc(2026, 7, 1, 12, 59)), "default") == 0);
+  CHECK(strcmp(active(utc(2026, 7, 1, 13, 0)), "day") == 0);
+  CHECK(strcmp(active(utc(2026, 7, 1, 21, 59)), "day") == 0);
+  CHECK(strcmp(active(utc(2026, 7, 1, 22, 0)), "default") == 0);
+}
+
+static void test_days(void) {
+  // The 1st of the month or any Friday (both day fields restricted), and the last days of the year
+  static const char * const list[] = {
+    "payday@0 12 1 * 5:ibs=10",
+    "holidays@* * 24-31 12 *:ibs=600"
+  };
+
+  set_rules(list, 2);
+
+  // Sunday 2026-02-01, Friday 2026-02-06, and neither on Saturday 2026-02-07
+  CHECK(strcmp(active(utc(2026, 2, 1, 17, 0)), "payday") == 0);
+  CHECK(strcmp(active(utc(2026, 2, 6, 17, 0)), "payday") == 0);
+  CHECK(strcmp(active(utc(2026, 2, 7, 17, 0)), "default") == 0);
+  CHECK(strcmp(active(utc(2026, 2, 6, 17, 1)), "default") == 0);
+
+  // The holidays end with the year in local time, not in UTC
+  CHECK(strcmp(active(utc(2026, 12, 24, 5, 0)), "holidays") == 0);
+  CHECK(strcmp(active(utc(2027, 1, 1, 4, 59)), "holidays") == 0);
+  CHECK(strcmp(active(utc(2027, 1, 1, 5, 0)), "payday") != 0);
+  CHECK(strcmp(active(utc(2027, 1, 1, 5, 0)), "holidays") != 0);
+}
+
+static void test_daylight_saving(void) {
+  // Rules on the hours skipped and repeated by the clock changes
+  static const char * const list[] = {
+    "one@* 1 * * *:ibs=10",
+    "two@* 2 * * *:ibs=20"
+  };
+
+  set_rules(list, 2);
+
+  // On 2026-03-08 the clock jumps from 01:59 EST to 03:00 EDT
+  CHECK(strcmp(active(utc(2026, 3, 8, 6, 59)), "one") == 0);
+  CHECK(strcmp(active(utc(2026, 3, 8, 7, 0)), "default") == 0);
+
+  // Over the local day (23 hours), the skipped hour never matches
+  CHECK(count_minutes(utc(2026, 3, 8, 5, 0), utc(2026, 3, 9, 4, 0), "one") == 60);
+  CHECK(count_minutes(utc(2026, 3, 8, 5, 0), utc(2026, 3, 9, 4, 0), "two") == 0);
+
+  // On 2026-11-01 the clock goes back from 01:59 EDT to 01:00 EST
+  CHECK(strcmp(active(utc(2026, 11, 1, 5, 30)), "one") == 0);
+  CHECK(strcmp(active(utc(2026, 11, 1, 6, 30)), "one") == 0);
+  CHECK(strcmp(active(utc(2026, 11, 1, 7, 0)), "two") == 0);
+
+  // Over the local day (25 hours), the repeated hour matches twice
+  CHECK(count_minutes(utc(2026, 11, 1, 4, 0), utc(2026, 11, 2, 5, 0), "one") == 120);
+  CHECK(count_minutes(utc(2026, 11, 1, 4, 0), utc(2026, 11, 2, 5, 0), "two") == 60);
+}
+
+static void test_invalid(void) {
+  // Malformed rules are rejected
+  static const char * const list[] = {
+    "* * * *:ibs=10",
+    "* 24 * * *:ibs=10",
+    "* * * * *",
+    "* 5-3 * * *:ibs=10"
+  };
+
+  for (unsigned int i = 0; i < sizeof(list) / sizeof(list[0]); i++) {
+    char spec[128];
+    scheduleRule rule;
+
+    snprintf(spec, sizeof(spec), "%s", list[i]);
+    CHECK(!schedule_parse_rule(spec, 0, &rule));
+  }
+}
+
+int main(void) {
+  // Evaluate the schedule in a fixed time zone
+  setenv("TZ", TIME_ZONE, 1);
+  tzset();
+
+  test_week();
+  test_days();
+  test_daylight_saving();
+  test_invalid();
+
+  return TEST_RESULT();
+}